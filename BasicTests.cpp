@@ -2,5 +2,17 @@
 
 int main(int argc, char* argv[]) {
     testLoadingXOR();
+    testLoadingStreamingXOR();
+    testNormalizer();
+    testPackedInstances();
+    testSparseInstances();
     testXORNeuralNetwork();
+    testBoundedQueue();
+    testRollingAverage();
+    testInstanceStream();
+    testBenchmarkRunner();
+    testPhaseTimer();
+    testTraceRecorder();
+    testLogMacros();
+    testPerfCounters();
 }
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <thread>
+#include <ctime>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "./util/Log.h"
+#include "./util/BenchmarkRunner.h"
+#include "./util/PerfCounters.h"
+#include "./util/AllocationCounter.h"
+#include "./data/DataSet.h"
+#include "./data/Instance.h"
+#include "./network/LossFunction.h"
+#include "./network/NeuralNetwork.h"
+#include "./network/Optimizer.h"
+
+// Function to display usage information
+void helpMessage() {
+    Log::info("Usage:");
+    Log::info("\t./Benchmark [options]");
+    Log::info("\t\ttimes building networks, forward and backward passes, gradients, getting and setting weights");
+    Log::info("\t\tand optimizer steps for several topologies, and loading the bundled data sets");
+    Log::info("\toptions:");
+    Log::info("\t\t--output <file>           file the results are written to as JSON (default benchmark.json)");
+    Log::info("\t\t--warmup <n>              repetitions run before the timed ones (default 2)");
+    Log::info("\t\t--repetitions <n>         timed repetitions of each benchmark, one sample each (default 10)");
+    Log::info("\t\t--min-time <ms>           minimum time of a repetition, the iterations are scaled up to it (default 20)");
+    Log::info("\t\t--batch-size <n>          instances in the batches of the batch benchmarks (default 32)");
+    Log::info("\t\t--wide <shape>            shape of the wide network as <inputs>:<hidden sizes>:<outputs> (default 256:512:10)");
+    Log::info("\t\t--deep <shape>            shape of the deep network (default 32:64,64,64,64,64,64,64,64:10)");
+    Log::info("\t\t--topologies <names>      comma separated topologies to run: tiny, small, large, wide, deep and data (default all)");
+    Log::info("\t\t--filter <text>           only run the benchmarks whose name contains the text");
+    Log::info("\t\t--counters                also read the hardware counters: instructions per cycle and cache and branch misses");
+}
+
+struct Options {
+    std::string output = "benchmark.json";
+    int warmup = 2;
+    int repetitions = 10;
+    double minimumMilliseconds = 20.0;
+    int batchSize = 32;
+    std::string wide = "256:512:10";
+    std::string deep = "32:64,64,64,64,64,64,64,64:10";
+    std::vector<std::string> topologies = { "tiny", "small", "large", "wide", "deep", "data" };
+    std::string filter;
+    bool counters = false;
+};
+
+// A network shape and the instances its benchmarks run on
+struct Topology {
+    std::string name;
+    int numberInputs;
+    std::vector<int> layerSizes;
+    int numberOutputs;
+    std::vector<Instance> instances;
+};
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+// Parses <inputs>:<hidden sizes>:<outputs> and gives the network random instances of that many inputs and classes
+Topology parseShape(const std::string& name, const std::string& shape, int numberInstances) {
+    std::vector<std::string> parts = split(shape, ':');
+    if (parts.size() != 3) throw std::runtime_error("the " + name + " shape '" + shape + "' is not <inputs>:<hidden sizes>:<outputs>");
+    Topology topology;
+    topology.name = name;
+    topology.numberInputs = std::stoi(parts[0]);
+    for (const std::string& size : split(parts[1], ',')) {
+        topology.layerSizes.push_back(std::stoi(size));
+    }
+    topology.numberOutputs = std::stoi(parts[2]);
+    if (topology.numberInputs <= 0 || topology.numberOutputs <= 0) throw std::runtime_error("the " + name + " shape '" + shape + "' needs inputs and outputs");
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> input(0.0, 1.0);
+    std::uniform_int_distribution<int> label(0, topology.numberOutputs - 1);
+    for (int i = 0; i < numberInstances; i++) {
+        std::vector<double> inputs(topology.numberInputs);
+        for (double& x : inputs) x = input(generator);
+        topology.instances.emplace_back(std::vector<double>{ static_cast<double>(label(generator)) }, inputs);
+    }
+    return topology;
+}
+
+// The hidden layers of the tiny, small and large networks of NNTestsUtils, on the iris data set
+Topology irisTopology(const std::string& name, const std::vector<int>& layerSizes, const DataSet& iris) {
+    Topology topology;
+    topology.name = name;
+    topology.numberInputs = iris.getNumberInputs();
+    topology.layerSizes = layerSizes;
+    topology.numberOutputs = iris.getNumberClasses();
+    topology.instances = iris.getInstances();
+    return topology;
+}
+
+NeuralNetwork createNetwork(const Topology& topology) {
+    NeuralNetwork nn(topology.numberInputs, topology.layerSizes, topology.numberOutputs, LossFunction::SOFTMAX);
+    nn.connectFully();
+    nn.initializeRandomly(0.1);
+    return nn;
+}
+
+bool selected(const Options& options, const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// The misses are per instance for the benchmarks of instances and batches, per call for the others
+void report(const BenchmarkResult& result, size_t instancesPerCall = 0) {
+    char line[256];
+    char allocations[32] = "     - allocs";
+    if (AllocationCounter::isAvailable()) {
+        snprintf(allocations, sizeof(allocations), "%6llu allocs", static_cast<unsigned long long>(result.allocations));
+    }
+    snprintf(line, sizeof(line), "  %-6s %-28s %14.1f ns  median %14.1f  stddev %5.1f%%  %s  (%zu iterations)", result.topology.c_str(), result.name.c_str(),
+        result.mean, result.median, result.mean != 0.0 ? 100.0 * result.standardDeviation / std::fabs(result.mean) : 0.0,
+        allocations, result.iterations);
+    Log::info(line);
+    if (result.counters.empty()) return;
+    const std::vector<double>& counters = result.counters;
+    double per = instancesPerCall > 0 ? static_cast<double>(instancesPerCall) : 1.0;
+    snprintf(line, sizeof(line), "  %-6s %-28s IPC %5.2f  per %-8s L1 misses %10.1f  LLC misses %8.2f  branch misses %8.2f", "", "",
+        counters[PerfCounters::INSTRUCTIONS] / counters[PerfCounters::CYCLES], instancesPerCall > 0 ? "instance" : "call",
+        counters[PerfCounters::L1_MISSES] / per, counters[PerfCounters::LLC_MISSES] / per, counters[PerfCounters::BRANCH_MISSES] / per);
+    Log::info(line);
+}
+
+void benchmarkTopology(BenchmarkRunner& runner, const Topology& topology, const Options& options) {
+    NeuralNetwork nn = createNetwork(topology);
+    size_t numberWeights = nn.getNumberWeights();
+    Log::info("Benchmarking the " + topology.name + " network, " + std::to_string(numberWeights) + " weights.");
+
+    const std::vector<Instance>& instances = topology.instances;
+    std::vector<Instance> batch;
+    for (int i = 0; i < options.batchSize; i++) {
+        batch.push_back(instances[i % instances.size()]);
+    }
+    size_t next = 0;
+    auto nextInstance = [&]() -> const Instance& {
+        const Instance& instance = instances[next];
+        next = next + 1 == instances.size() ? 0 : next + 1;
+        return instance;
+    };
+
+    if (selected(options, "connectFully")) {
+        // Building the nodes is part of it, a network can only be connected once. The
+        // constructor logs every layer, which would be timed too.
+        Log::setLevel(Log::WARNING);
+        const BenchmarkResult& result = runner.run("connectFully", topology.name, numberWeights, [&] {
+            NeuralNetwork network(topology.numberInputs, topology.layerSizes, topology.numberOutputs, LossFunction::SOFTMAX);
+            network.connectFully();
+            BenchmarkRunner::keep(network.getNumberWeights());
+        });
+        Log::setLevel(Log::INFO);
+        report(result);
+    }
+
+    BenchmarkResult forward;
+    if (selected(options, "forwardPass")) {
+        forward = runner.run("forwardPass", topology.name, numberWeights, [&] {
+            BenchmarkRunner::keep(nn.forwardPass(nextInstance()));
+        });
+        report(forward, 1);
+    }
+
+    if (selected(options, "forwardBackwardPass") || selected(options, "backwardPass")) {
+        // The deltas of a backward pass build on the state of the forward pass before it, so the
+        // backward pass is timed together with one and its own time is the difference
+        BenchmarkResult both = runner.run("forwardBackwardPass", topology.name, numberWeights, [&] {
+            BenchmarkRunner::keep(nn.forwardPass(nextInstance()));
+            nn.backwardPass();
+        });
+        report(both, 1);
+        if (!forward.samples.empty()) {
+            BenchmarkResult backward = both;
+            backward.name = "backwardPass";
+            backward.derived = true;
+            for (size_t i = 0; i < backward.samples.size(); i++) {
+                backward.samples[i] -= forward.samples[i];
+            }
+            for (size_t i = 0; i < backward.counters.size() && i < forward.counters.size(); i++) {
+                backward.counters[i] -= forward.counters[i];
+            }
+            backward.allocations -= std::min(backward.allocations, forward.allocations);
+            backward.allocatedBytes -= std::min(backward.allocatedBytes, forward.allocatedBytes);
+            backward.summarize();
+            runner.add(backward);
+            report(backward, 1);
+        }
+    }
+
+    if (selected(options, "getGradient")) {
+        report(runner.run("getGradient", topology.name, numberWeights, [&] {
+            BenchmarkRunner::keep(nn.getGradient(nextInstance())[0]);
+        }), 1);
+        report(runner.run("getGradient(batch " + std::to_string(batch.size()) + ")", topology.name, numberWeights, [&] {
+            BenchmarkRunner::keep(nn.getGradient(batch)[0]);
+        }), batch.size());
+    }
+
+    std::vector<double> weights = nn.getWeights();
+    if (selected(options, "getWeights")) {
+        report(runner.run("getWeights", topology.name, numberWeights, [&] {
+            BenchmarkRunner::keep(nn.getWeights()[0]);
+        }));
+    }
+    if (selected(options, "setWeights")) {
+        report(runner.run("setWeights", topology.name, numberWeights, [&] {
+            nn.setWeights(weights);
+        }));
+    }
+
+    // Small steps on a fixed gradient, so the weights stay finite however many steps are timed
+    std::vector<double> gradient = nn.getGradient(batch);
+    for (double& g : gradient) g *= 1e-3;
+    OptimizerParameters parameters;
+    parameters.learningRate = 1e-6;
+    for (const char* name : { "sgd", "nesterov", "rmsprop", "adam", "adamw", "lars", "lamb" }) {
+        std::string benchmarkName = "step(" + std::string(name) + ")";
+        if (!selected(options, benchmarkName)) continue;
+        std::unique_ptr<Optimizer> optimizer = Optimizer::create(name, numberWeights, parameters);
+        optimizer->setParameterGroups(nn.getLayerWeightRanges());
+        std::vector<double> stepWeights = weights;
+        report(runner.run(benchmarkName, topology.name, numberWeights, [&] {
+            optimizer->step(stepWeights, gradient);
+        }));
+        BenchmarkRunner::keep(stepWeights[0]);
+    }
+}
+
+void benchmarkDataSets(BenchmarkRunner& runner, const Options& options) {
+    Log::info("Benchmarking loading the data sets.");
+    std::vector<std::pair<std::string, std::string>> files = { { "iris", "./datasets/iris.txt" }, { "mushroom", "./datasets/agaricus-lepiota.txt" } };
+    for (const std::pair<std::string, std::string>& file : files) {
+        if (!selected(options, "DataSet")) continue;
+        report(runner.run("DataSet", file.first, 0, [&] {
+            DataSet dataSet(file.first, file.second);
+            BenchmarkRunner::keep(dataSet.getNumberInstances());
+        }));
+    }
+}
+
+std::string getCompiler() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--output" && hasValue) options.output = argv[++i];
+        else if (option == "--warmup" && hasValue) options.warmup = std::stoi(argv[++i]);
+        else if (option == "--repetitions" && hasValue) options.repetitions = std::max(1, std::stoi(argv[++i]));
+        else if (option == "--min-time" && hasValue) options.minimumMilliseconds = std::stod(argv[++i]);
+        else if (option == "--batch-size" && hasValue) options.batchSize = std::max(1, std::stoi(argv[++i]));
+        else if (option == "--wide" && hasValue) options.wide = argv[++i];
+        else if (option == "--deep" && hasValue) options.deep = argv[++i];
+        else if (option == "--topologies" && hasValue) options.topologies = split(argv[++i], ',');
+        else if (option == "--filter" && hasValue) options.filter = argv[++i];
+        else if (option == "--counters") options.counters = true;
+        else {
+            Log::fatal("unknown or incomplete option: " + option);
+            helpMessage();
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner(options.warmup, options.repetitions, options.minimumMilliseconds / 1000.0);
+    // The benchmarks run on this thread, the one the counters count
+    std::unique_ptr<PerfCounters> counters;
+    if (options.counters) {
+        counters.reset(new PerfCounters());
+        if (!counters->isAvailable()) {
+            Log::warning("the hardware counters are not available, benchmarking without them (" + counters->getUnavailableReason() + ")");
+            counters.reset();
+        }
+        else {
+            if (!counters->getUnavailableReason().empty()) {
+                Log::warning("some hardware counters are not available and are reported as NaN (" + counters->getUnavailableReason() + ")");
+            }
+            runner.setCounters(counters.get());
+        }
+    }
+    try {
+        DataSet iris("iris data", "./datasets/iris.txt");
+        for (const std::string& name : options.topologies) {
+            if (name == "tiny") benchmarkTopology(runner, irisTopology(name, { 2 }, iris), options);
+            else if (name == "small") benchmarkTopology(runner, irisTopology(name, { 3, 3 }, iris), options);
+            else if (name == "large") benchmarkTopology(runner, irisTopology(name, { 3, 5, 4 }, iris), options);
+            else if (name == "wide") benchmarkTopology(runner, parseShape(name, options.wide, 256), options);
+            else if (name == "deep") benchmarkTopology(runner, parseShape(name, options.deep, 256), options);
+            else if (name == "data") benchmarkDataSets(runner, options);
+            else throw std::runtime_error("unknown topology '" + name + "'");
+        }
+    }
+    catch (const std::exception& e) {
+        Log::fatal("benchmarking failed: " + (std::string) e.what());
+        return 1;
+    }
+
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    std::vector<std::pair<std::string, std::string>> context = {
+        { "date", date },
+        { "compiler", getCompiler() },
+        { "hardware_threads", std::to_string(std::thread::hardware_concurrency()) },
+        { "warmup", std::to_string(options.warmup) },
+        { "repetitions", std::to_string(options.repetitions) },
+        { "min_time_ms", std::to_string(options.minimumMilliseconds) },
+        { "batch_size", std::to_string(options.batchSize) },
+        { "wide", options.wide },
+        { "deep", options.deep },
+        { "counters", counters ? "true" : "false" }
+    };
+    std::ofstream file(options.output);
+    runner.writeJson(file, context);
+    if (!file) {
+        Log::fatal("could not write the results to '" + options.output + "'");
+        return 1;
+    }
+    Log::info("Wrote " + std::to_string(runner.getResults().size()) + " results to '" + options.output + "'.");
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include "./util/Log.h"
+#include "./util/ThreadPool.h"
+#include "./util/BoundedQueue.h"
+#include "./util/TraceRecorder.h"
+#include "./network/ModelFile.h"
+#include "./network/LossFunction.h"
+#include "./data/DataSetFile.h"
+
+// Function to display usage information
+void helpMessage() {
+    Log::info("Usage:");
+    Log::info("\t./BulkScore <model file> <data set file> <predictions file> [options]");
+    Log::info("\t\tmodel file is a model saved by GradientDescent with --save-model");
+    Log::info("\t\tdata set file is a '.txt' or '.bin' data set file of any size, it is streamed from disk");
+    Log::info("\t\tpredictions file gets one line 'class,p1,...,pn' per instance, in the order of the data set file");
+    Log::info("\toptions:");
+    Log::info("\t\t--batch-size <n>         number of instances read, scored and written at a time (default 65536)");
+    Log::info("\t\t--threads <n>            number of threads each batch is scored on (default: one per hardware thread)");
+    Log::info("\t\t--chunk-size <bytes>     size of the chunks the data set file is read in (default 1048576)");
+    Log::info("\t\t--class                  only write the predicted class of each instance");
+    Log::info("\t\t--raw                    write the outputs of the network instead of the softmax probabilities of a softmax model");
+    Log::info("\t\t--precision <digits>     significant digits of the written probabilities (default 6)");
+    Log::info("\t\t--trace <file>           record a timeline of the reading, scoring and writing of the batches, written as Chrome trace JSON");
+}
+
+struct Options {
+    size_t batchSize = 65536;
+    int threads = 0;
+    size_t chunkSize = DEFAULT_CHUNK_SIZE;
+    bool classOnly = false;
+    bool raw = false;
+    int precision = 6;
+    std::string trace;
+};
+
+// Number of batches each stage of the pipeline can run ahead of the next one
+const size_t PIPELINE_DEPTH = 2;
+
+// The inputs of consecutive instances one after another, and the class of each
+struct ScoreBatch {
+    size_t numberRows;
+    std::vector<double> inputs;
+    std::vector<int> labels;
+};
+
+// Reads the data set file into the free batches and hands them on in file order
+void readBatches(DataSetReader& reader, size_t numberInputs, size_t batchSize, BoundedQueue<std::unique_ptr<ScoreBatch>>& freeBatches,
+                 BoundedQueue<std::unique_ptr<ScoreBatch>>& fullBatches) {
+    std::vector<double> outputs, inputs;
+    std::vector<int> indices;
+    std::unique_ptr<ScoreBatch> batch;
+    bool endOfFile = false;
+    while (!endOfFile && freeBatches.pop(batch)) {
+        ScopedTrace trace("read batch", "pipeline");
+        batch->inputs.resize(batchSize * numberInputs);
+        batch->labels.resize(batchSize);
+        batch->numberRows = 0;
+        while (batch->numberRows < batchSize) {
+            if (!reader.read(outputs, inputs, indices)) {
+                endOfFile = true;
+                break;
+            }
+            double* row = batch->inputs.data() + batch->numberRows * numberInputs;
+            if (reader.isSparse()) {
+                std::fill(row, row + numberInputs, 0.0);
+                for (size_t i = 0; i < indices.size(); i++) {
+                    if (static_cast<size_t>(indices[i]) >= numberInputs) {
+                        throw std::runtime_error("the data set has an input " + std::to_string(indices[i]) + " but the model only has " + std::to_string(numberInputs) + " inputs");
+                    }
+                    row[indices[i]] = inputs[i];
+                }
+            }
+            else {
+                // The number of inputs of a text file is only known once its first instance is read
+                if (inputs.size() != numberInputs) {
+                    throw std::runtime_error("the data set has " + std::to_string(inputs.size()) + " inputs but the model has " + std::to_string(numberInputs));
+                }
+                std::copy(inputs.begin(), inputs.end(), row);
+            }
+            batch->labels[batch->numberRows] = outputs.empty() ? -1 : static_cast<int>(outputs[0]);
+            batch->numberRows++;
+        }
+        if (batch->numberRows > 0 && !fullBatches.push(std::move(batch))) return;
+    }
+}
+
+// Writes the text of the batches in the order they are queued
+void writeBatches(std::ofstream& file, BoundedQueue<std::vector<std::string>>& texts) {
+    std::vector<std::string> text;
+    while (texts.pop(text)) {
+        ScopedTrace trace("write batch", "pipeline");
+        for (const std::string& part : text) {
+            file.write(part.data(), part.size());
+        }
+        if (!file) throw std::runtime_error("failed writing the predictions");
+    }
+}
+
+// Appends one line for a row to text: the class and, unless only the class is wanted, the probabilities
+void formatRow(const double* outputs, int numberOutputs, int predictedClass, const Options& options, bool softmax, std::vector<double>& probabilities, std::string& text) {
+    char value[32];
+    text.append(value, snprintf(value, sizeof(value), "%d", predictedClass));
+    if (!options.classOnly) {
+        probabilities.assign(outputs, outputs + numberOutputs);
+        if (softmax) {
+            double maximum = outputs[predictedClass];
+            double sum = 0.0;
+            for (double& probability : probabilities) {
+                probability = std::exp(probability - maximum);
+                sum += probability;
+            }
+            for (double& probability : probabilities) {
+                probability /= sum;
+            }
+        }
+        for (double probability : probabilities) {
+            text.push_back(',');
+            text.append(value, snprintf(value, sizeof(value), "%.*g", options.precision, probability));
+        }
+    }
+    text.push_back('\n');
+}
+
+void score(const std::string& modelFilename, const std::string& dataSetFilename, const std::string& predictionsFilename, const Options& options) {
+    MappedModel model(modelFilename);
+    DataSetReader reader(dataSetFilename, options.chunkSize);
+    if (!reader.isOpen()) throw std::runtime_error("could not open the data set file '" + dataSetFilename + "'");
+    std::ofstream file(predictionsFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("could not open the predictions file '" + predictionsFilename + "'");
+
+    int numberInputs = model.getNumberInputs();
+    int numberOutputs = model.getNumberOutputs();
+    bool softmax = model.getLossFunction() == LossFunction::SOFTMAX && !options.raw;
+    std::string header = "class";
+    for (int i = 0; i < numberOutputs && !options.classOnly; i++) {
+        header += (softmax ? ",probability_" : ",output_") + std::to_string(i);
+    }
+    header += "\n";
+    file.write(header.data(), header.size());
+
+    // Reading, scoring and writing overlap: one thread parses the file while the pool scores the
+    // batch before it and another thread writes out the batch before that
+    ThreadPool pool(options.threads);
+    BoundedQueue<std::unique_ptr<ScoreBatch>> freeBatches(PIPELINE_DEPTH + 2);
+    BoundedQueue<std::unique_ptr<ScoreBatch>> fullBatches(PIPELINE_DEPTH);
+    BoundedQueue<std::vector<std::string>> texts(PIPELINE_DEPTH);
+    for (size_t i = 0; i < PIPELINE_DEPTH + 2; i++) {
+        freeBatches.push(std::unique_ptr<ScoreBatch>(new ScoreBatch()));
+    }
+    // The first exception of any stage stops the whole pipeline
+    std::exception_ptr readFailure, writeFailure;
+    auto stopPipeline = [&] {
+        freeBatches.close();
+        fullBatches.close();
+        texts.close();
+    };
+    std::thread readThread([&] {
+        if (TraceRecorder::isEnabled()) TraceRecorder::setThreadName("reader");
+        try {
+            readBatches(reader, model.getNumberInputs(), options.batchSize, freeBatches, fullBatches);
+        }
+        catch (...) {
+            readFailure = std::current_exception();
+            stopPipeline();
+        }
+        fullBatches.close();
+    });
+    std::thread writeThread([&] {
+        if (TraceRecorder::isEnabled()) TraceRecorder::setThreadName("writer");
+        try {
+            writeBatches(file, texts);
+        }
+        catch (...) {
+            writeFailure = std::current_exception();
+            stopPipeline();
+        }
+    });
+
+    std::vector<std::vector<double>> workspaces(pool.getNumberThreads());
+    std::vector<std::vector<double>> probabilities(pool.getNumberThreads());
+    std::vector<size_t> correct(pool.getNumberThreads(), 0);
+    std::vector<double> outputs;
+    size_t numberRows = 0;
+    size_t numberLabeled = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastReport = start;
+    try {
+        std::unique_ptr<ScoreBatch> batch;
+        while (fullBatches.pop(batch)) {
+            ScopedTrace trace("score batch", "pipeline");
+            outputs.resize(batch->numberRows * numberOutputs);
+            std::vector<std::string> text(pool.getNumberThreads());
+            pool.parallelFor(batch->numberRows, [&](size_t begin, size_t end, int thread) {
+                double* rowOutputs = outputs.data() + begin * numberOutputs;
+                model.predict(batch->inputs.data() + begin * numberInputs, end - begin, rowOutputs, workspaces[thread]);
+                for (size_t row = begin; row < end; row++, rowOutputs += numberOutputs) {
+                    int predictedClass = std::max_element(rowOutputs, rowOutputs + numberOutputs) - rowOutputs;
+                    if (batch->labels[row] == predictedClass) correct[thread]++;
+                    formatRow(rowOutputs, numberOutputs, predictedClass, options, softmax, probabilities[thread], text[thread]);
+                }
+            });
+            for (size_t row = 0; row < batch->numberRows; row++) {
+                if (batch->labels[row] >= 0) numberLabeled++;
+            }
+            numberRows += batch->numberRows;
+            if (!texts.push(std::move(text)) || !freeBatches.push(std::move(batch))) break;
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - lastReport).count() >= 10.0) {
+                double seconds = std::chrono::duration<double>(now - start).count();
+                Log::info("Scored " + std::to_string(numberRows) + " instances, " + std::to_string(numberRows / seconds) + " rows/s.");
+                lastReport = now;
+            }
+        }
+    }
+    catch (...) {
+        stopPipeline();
+        readThread.join();
+        writeThread.join();
+        throw;
+    }
+    texts.close();
+    freeBatches.close();
+    readThread.join();
+    writeThread.join();
+    if (readFailure) std::rethrow_exception(readFailure);
+    if (writeFailure) std::rethrow_exception(writeFailure);
+    file.close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t numberCorrect = 0;
+    for (size_t c : correct) numberCorrect += c;
+    Log::info("Scored " + std::to_string(numberRows) + " instances in " + std::to_string(seconds) + "s, " + std::to_string(numberRows / seconds)
+        + " rows/s, on " + std::to_string(pool.getNumberThreads()) + " threads into '" + predictionsFilename + "'.");
+    if (numberLabeled > 0) {
+        Log::info("Accuracy against the classes in the data set file: " + std::to_string(100.0 * numberCorrect / numberLabeled) + "%");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        helpMessage();
+        return 1;
+    }
+
+    Options options;
+    for (int i = 4; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--batch-size" && hasValue) options.batchSize = std::max<size_t>(1, std::stoul(argv[++i]));
+        else if (option == "--threads" && hasValue) options.threads = std::stoi(argv[++i]);
+        else if (option == "--chunk-size" && hasValue) options.chunkSize = std::stoul(argv[++i]);
+        else if (option == "--class") options.classOnly = true;
+        else if (option == "--raw") options.raw = true;
+        else if (option == "--precision" && hasValue) options.precision = std::max(1, std::min(17, std::stoi(argv[++i])));
+        else if (option == "--trace" && hasValue) options.trace = argv[++i];
+        else {
+            Log::fatal("unknown or incomplete option: " + option);
+            helpMessage();
+            return 1;
+        }
+    }
+
+    if (!options.trace.empty()) {
+        TraceRecorder::start();
+        TraceRecorder::setThreadName("main");
+    }
+    try {
+        score(argv[1], argv[2], argv[3], options);
+        if (!options.trace.empty()) {
+            size_t numberEvents = TraceRecorder::write(options.trace);
+            Log::info("Wrote " + std::to_string(numberEvents) + " trace events to '" + options.trace + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        Log::fatal("scoring failed: " + (std::string) e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include "./util/Log.h"
+#include "./util/ThreadPool.h"
+#include "./util/BoundedQueue.h"
+#include "./data/DataSetFile.h"
+
+// Function to display usage information
+void helpMessage() {
+    Log::info("Usage:");
+    Log::info("\t./GenerateDataSet <data set file> [options]");
+    Log::info("\t\twrites a synthetic classification data set with a planted structure: every class has a center,");
+    Log::info("\t\tand the inputs of an instance are its class center plus unit Gaussian noise");
+    Log::info("\t\tthe data set file is written in the text format if it ends in '.txt', otherwise in the binary format");
+    Log::info("\toptions:");
+    Log::info("\t\t--rows <n>               number of instances (default 1000000)");
+    Log::info("\t\t--features <n>           number of inputs (default 100)");
+    Log::info("\t\t--classes <n>            number of classes (default 10)");
+    Log::info("\t\t--sparsity <x>           fraction of the inputs that are 0 (default 0)");
+    Log::info("\t\t--sparse                 only write the nonzero inputs, in the index:value sparse format");
+    Log::info("\t\t--imbalance <x>          ratio of the most to the least frequent class, the classes in between fall off geometrically (default 1)");
+    Log::info("\t\t--separation <x>         expected distance between two class centers in standard deviations of the noise (default 6)");
+    Log::info("\t\t--label-noise <x>        fraction of the instances given a random class after their inputs are drawn (default 0)");
+    Log::info("\t\t--seed <n>               seed of the class centers and instances, the file is the same for any number of threads (default 1)");
+    Log::info("\t\t--threads <n>            threads generating and encoding the instances (default: one per hardware thread)");
+    Log::info("\t\t--chunk-rows <n>         instances generated together, each from its own random stream (default 65536)");
+}
+
+struct Options {
+    uint64_t rows = 1000000;
+    int features = 100;
+    int classes = 10;
+    double sparsity = 0.0;
+    bool sparse = false;
+    double imbalance = 1.0;
+    double separation = 6.0;
+    double labelNoise = 0.0;
+    uint64_t seed = 1;
+    int threads = 0;
+    uint64_t chunkRows = 65536;
+};
+
+/**
+ * The planted structure of a synthetic data set: the center of every class
+ * and how often each class occurs. Each chunk of rows is drawn from a random
+ * stream of its own, seeded by the seed and the chunk number, so the rows do
+ * not depend on which thread draws them or in what order.
+ */
+class SyntheticDataSet {
+private:
+    const Options& options;
+    // classes x features, row major
+    std::vector<double> centers;
+    std::vector<double> classWeights;
+
+public:
+    explicit SyntheticDataSet(const Options& options) : options(options) {
+        std::mt19937_64 generator(options.seed);
+        // Scaled so two centers are about separation apart over the inputs an instance has
+        double nonzeroFeatures = std::max(1.0, options.features * (1.0 - options.sparsity));
+        std::normal_distribution<double> center(0.0, options.separation / std::sqrt(2.0 * nonzeroFeatures));
+        centers.resize(static_cast<size_t>(options.classes) * options.features);
+        for (double& value : centers) value = center(generator);
+
+        for (int k = 0; k < options.classes; k++) {
+            double position = options.classes > 1 ? static_cast<double>(k) / (options.classes - 1) : 0.0;
+            classWeights.push_back(std::pow(options.imbalance, -position));
+        }
+    }
+
+    // Appends the encoded rows of a chunk to records
+    void encodeChunk(uint64_t chunk, const DataSetWriter& writer, std::string& records) const {
+        std::seed_seq seed{ static_cast<uint32_t>(options.seed), static_cast<uint32_t>(options.seed >> 32),
+            static_cast<uint32_t>(chunk), static_cast<uint32_t>(chunk >> 32) };
+        std::mt19937_64 generator(seed);
+        std::normal_distribution<double> noise(0.0, 1.0);
+        std::discrete_distribution<int> label(classWeights.begin(), classWeights.end());
+        std::uniform_int_distribution<int> randomLabel(0, options.classes - 1);
+        std::bernoulli_distribution flipLabel(options.labelNoise);
+        // The gap to the next nonzero input, so a sparse row costs its nonzero inputs and not all of them
+        std::geometric_distribution<int> gap(1.0 - std::min(options.sparsity, 1.0 - 1e-12));
+
+        std::vector<double> outputs(1);
+        std::vector<int> indices;
+        std::vector<double> values;
+        std::vector<double> inputs(options.sparse ? 0 : options.features);
+        uint64_t begin = chunk * options.chunkRows;
+        uint64_t end = std::min(options.rows, begin + options.chunkRows);
+        for (uint64_t row = begin; row < end; row++) {
+            int k = label(generator);
+            const double* center = centers.data() + static_cast<size_t>(k) * options.features;
+            indices.clear();
+            values.clear();
+            if (options.sparsity > 0.0) {
+                for (int64_t j = gap(generator); j < options.features; j += 1 + static_cast<int64_t>(gap(generator))) {
+                    indices.push_back(j);
+                    values.push_back(center[j] + noise(generator));
+                }
+            }
+            else {
+                for (int j = 0; j < options.features; j++) {
+                    indices.push_back(j);
+                    values.push_back(center[j] + noise(generator));
+                }
+            }
+            if (!options.sparse) {
+                std::fill(inputs.begin(), inputs.end(), 0.0);
+                for (size_t i = 0; i < indices.size(); i++) {
+                    inputs[indices[i]] = values[i];
+                }
+            }
+            outputs[0] = flipLabel(generator) ? randomLabel(generator) : k;
+            if (options.sparse) writer.encode(outputs, indices, values, records);
+            else writer.encode(outputs, inputs, records);
+        }
+    }
+};
+
+void generate(const std::string& filename, const Options& options) {
+    bool binary = filename.size() < 4 || filename.compare(filename.size() - 4, 4, ".txt") != 0;
+    DataSetWriter writer(filename, 1, options.features, binary, options.sparse ? DataSetFormat::SPARSE : DataSetFormat::DENSE);
+    SyntheticDataSet dataSet(options);
+    ThreadPool pool(options.threads);
+    uint64_t numberChunks = (options.rows + options.chunkRows - 1) / options.chunkRows;
+
+    // Every round the pool encodes one chunk per thread while the writer thread writes out the
+    // chunks of the round before, in order
+    BoundedQueue<std::string> encoded(2 * pool.getNumberThreads());
+    std::exception_ptr writeFailure;
+    uint64_t bytesWritten = 0;
+    std::thread writeThread([&] {
+        std::string records;
+        try {
+            while (encoded.pop(records)) {
+                writer.writeEncoded(records);
+                bytesWritten += records.size();
+            }
+        }
+        catch (...) {
+            writeFailure = std::current_exception();
+            encoded.close();
+        }
+    });
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastReport = start;
+    try {
+        std::vector<std::string> chunks(pool.getNumberThreads());
+        for (uint64_t first = 0; first < numberChunks; first += chunks.size()) {
+            size_t count = std::min<uint64_t>(chunks.size(), numberChunks - first);
+            pool.parallelFor(count, [&](size_t begin, size_t end, int) {
+                for (size_t i = begin; i < end; i++) {
+                    chunks[i].clear();
+                    dataSet.encodeChunk(first + i, writer, chunks[i]);
+                }
+            });
+            // The writer closes the queue if it fails
+            bool writing = true;
+            for (size_t i = 0; i < count && writing; i++) {
+                writing = encoded.push(std::move(chunks[i]));
+                chunks[i] = std::string();
+            }
+            if (!writing) break;
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - lastReport).count() >= 10.0) {
+                uint64_t rows = std::min(options.rows, (first + count) * options.chunkRows);
+                double seconds = std::chrono::duration<double>(now - start).count();
+                Log::info("Generated " + std::to_string(rows) + " of " + std::to_string(options.rows) + " instances, " + std::to_string(rows / seconds) + " rows/s.");
+                lastReport = now;
+            }
+        }
+    }
+    catch (...) {
+        encoded.close();
+        writeThread.join();
+        throw;
+    }
+    encoded.close();
+    writeThread.join();
+    if (writeFailure) std::rethrow_exception(writeFailure);
+    writer.close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Log::info("Wrote " + std::to_string(options.rows) + " instances with " + std::to_string(options.features) + " inputs and " + std::to_string(options.classes)
+        + " classes to " + (binary ? "binary " : "text ") + (options.sparse ? "sparse " : "") + "data set file '" + filename + "' in " + std::to_string(seconds)
+        + "s, " + std::to_string(options.rows / seconds) + " rows/s, " + std::to_string(bytesWritten / seconds / 1e6) + " MB/s.");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        helpMessage();
+        return 1;
+    }
+
+    Options options;
+    for (int i = 2; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--rows" && hasValue) options.rows = std::stoull(argv[++i]);
+        else if (option == "--features" && hasValue) options.features = std::stoi(argv[++i]);
+        else if (option == "--classes" && hasValue) options.classes = std::stoi(argv[++i]);
+        else if (option == "--sparsity" && hasValue) options.sparsity = std::stod(argv[++i]);
+        else if (option == "--sparse") options.sparse = true;
+        else if (option == "--imbalance" && hasValue) options.imbalance = std::stod(argv[++i]);
+        else if (option == "--separation" && hasValue) options.separation = std::stod(argv[++i]);
+        else if (option == "--label-noise" && hasValue) options.labelNoise = std::stod(argv[++i]);
+        else if (option == "--seed" && hasValue) options.seed = std::stoull(argv[++i]);
+        else if (option == "--threads" && hasValue) options.threads = std::stoi(argv[++i]);
+        else if (option == "--chunk-rows" && hasValue) options.chunkRows = std::max<uint64_t>(1, std::stoull(argv[++i]));
+        else {
+            Log::fatal("unknown or incomplete option: " + option);
+            helpMessage();
+            return 1;
+        }
+    }
+    if (options.features <= 0 || options.classes <= 0 || options.sparsity < 0.0 || options.sparsity >= 1.0 || options.imbalance < 1.0
+            || options.labelNoise < 0.0 || options.labelNoise > 1.0) {
+        Log::fatal("needs features > 0, classes > 0, 0 <= sparsity < 1, imbalance >= 1 and 0 <= label noise <= 1");
+        return 1;
+    }
+
+    try {
+        generate(argv[1], options);
+    }
+    catch (const std::exception& e) {
+        Log::fatal("generating the data set failed: " + (std::string) e.what());
+        return 1;
+    }
+    return 0;
+}
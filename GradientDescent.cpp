@@ -3,34 +3,300 @@
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include "./util/Log.h"
 #include "./data/DataSet.h"
+#include "./data/StreamingDataSet.h"
+#include "./data/Normalizer.h"
 #include "./network/LossFunction.h"
 #include "./network/NeuralNetwork.h"
+#include "./network/Optimizer.h"
+#include "./network/LearningRateSchedule.h"
+#include "./network/EarlyStopping.h"
+#include "./network/ParallelGradient.h"
+#include "./network/TrainingSession.h"
+#include "./network/Ensemble.h"
+#include "./network/LBFGS.h"
+#include "./network/ModelFile.h"
+#include "./network/SnapshotWriter.h"
+#include "./data/InstanceStream.h"
+#include "./util/RollingAverage.h"
+#include "./util/LatencyHistogram.h"
+#include "./util/PhaseTimer.h"
+#include "./util/PerfCounters.h"
+#include "./util/AllocationCounter.h"
+#include "./util/TraceRecorder.h"
 #include "./data/Instance.h"
 #include "./util/Vector.h"
+#include "./util/ThreadPool.h"
 
 // Function to display usage information
 void helpMessage() {
     Log::info("Usage:");
-    Log::info("\t./program <data set> <gradient descent type> <batch size> <loss function> <epochs> <bias> <learning rate> <mu> <adaptive learning rate> <decayRate> <eps> <beta1> <beta2> <layer_size_1 ... layer_size_n");
-    Log::info("\t\tdata set can be: 'and', 'or' or 'xor', 'iris' or 'mushroom'");
-    Log::info("\t\tgradient descent type can be: 'stochastic', 'minibatch' or 'batch'");
-    Log::info("\t\tbatch size should be > 0. Will be ignored for stochastic or batch gradient descent");
+    Log::info("\t./program <data set> <gradient descent type> <batch size> <loss function> <epochs> <bias> <learning rate> <mu> <adaptive learning rate> <decayRate> <eps> <beta1> <beta2> <layer_size_1 ... layer_size_n> [options]");
+    Log::info("\t\tdata set can be: 'and', 'or' or 'xor', 'iris' or 'mushroom', or the path of a '.txt' or '.bin' data set file");
+    Log::info("\t\tgradient descent type can be: 'stochastic', 'minibatch', 'batch' or 'lbfgs' (full batch L-BFGS, which ignores the learning rate and adaptive learning rate)");
+    Log::info("\t\tbatch size should be > 0. Will be ignored for stochastic, batch or lbfgs gradient descent");
     Log::info("\t\tloss function can be: 'svm' or 'softmax'");
     Log::info("\t\tepochs is an integer > 0");
     Log::info("\t\tbias is a double");
     Log::info("\t\tlearning rate is a double usually small and > 0");
     Log::info("\t\tmu is a double < 1 and typical values are 0.5, 0.9, 0.95, and 0.99");
-    Log::info("\t\tadaptive learning rate can be: 'nesterov', 'rmsprop' or 'adam'");
+    Log::info("\t\tadaptive learning rate can be: 'sgd', 'nesterov', 'rmsprop', 'adam', 'adamw', 'lars' or 'lamb'");
     Log::info("\t\tdecayRate is a double");
     Log::info("\t\teps is a double");
     Log::info("\t\tbeta1 is a double");
     Log::info("\t\tbeta2 is a double");
     Log::info("\t\tlayer_size_1..n is a list of integers which are the number of nodes in each hidden layer");
+    Log::info("\toptions:");
+    Log::info("\t\t--stream                 read the data set from disk in chunks each epoch instead of loading it into memory");
+    Log::info("\t\t--shuffle-buffer <n>     number of instances in the shuffle buffer of a streamed data set (default 10000)");
+    Log::info("\t\t--chunk-size <bytes>     size of the chunks a streamed data set is read in (default 1048576)");
+    Log::info("\t\t--threads <n>            number of threads to use, minibatch and batch gradients are computed data-parallel (default: one per hardware thread)");
+    Log::info("\t\t--normalize              normalize the inputs of a data set file (iris is always normalized)");
+    Log::info("\t\t--save-normalizer <file> save the input means and standard deviations used to normalize the data set");
+    Log::info("\t\t--load-normalizer <file> normalize with previously saved means and standard deviations instead of recomputing them");
+    Log::info("\t\t--lazy                   only update the weights of the inputs that are nonzero in the batch (sparse or bit packed data sets)");
+    Log::info("\t\t--weight-decay <x>       weight decay of 'adamw', 'lars' and 'lamb' (default 0.01)");
+    Log::info("\t\t--trust-coefficient <x>  trust coefficient of the layer-wise learning rates of 'lars' (default 0.001)");
+    Log::info("\t\t--schedule <schedule>    learning rate schedule: 'constant' (default), 'step:<epochs>:<factor>', 'exponential:<factor>',");
+    Log::info("\t\t                         'cosine[:<min lr>]' or 'plateau:<patience>:<factor>[:<min lr>]'");
+    Log::info("\t\t--warmup <epochs>        linearly increase the learning rate over the first epochs (default 0)");
+    Log::info("\t\t--validation <file>      data set file of held-out instances to judge the epochs on");
+    Log::info("\t\t--validation-split <x>   hold out this fraction of an in-memory data set instead");
+    Log::info("\t\t--patience <epochs>      stop once the held-out loss has not improved for this many epochs and restore the best weights");
+    Log::info("\t\t--min-delta <x>         smallest decrease of the loss that counts as an improvement (default 0)");
+    Log::info("\t\t--history <m>            number of weight and gradient changes L-BFGS remembers (default 10)");
+    Log::info("\t\t--accumulate <k>         sum the gradients of k minibatches before each update, for an effective batch size of k * batch size (default 1)");
+    Log::info("\t\t--save-model <file>      save the trained network (and its normalizer) as a binary model file that can be memory mapped");
+    Log::info("\t\t--online                 train on the instances of the data set argument as they arrive, which is '-' for standard input or a file or FIFO");
+    Log::info("\t\t                         in the text format, with 'stochastic' or 'minibatch' updates; epochs is ignored");
+    Log::info("\t\t--classes <n>            number of classes of an online stream, when not continuing from --load-model");
+    Log::info("\t\t--load-model <file>      continue training the network (and normalizer) of a saved model file online");
+    Log::info("\t\t--window <n>             number of recent instances the online loss and accuracy are averaged over and reported after (default 1000)");
+    Log::info("\t\t--snapshot-every <n>     save the network to --save-model after every n online instances (default 10000)");
+    Log::info("\t\t--timing                 log the time each epoch spends training and evaluating, and the instances trained per second");
+    Log::info("\t\t--profile                log the time spent loading and normalizing, and the time each epoch spends shuffling, gathering");
+    Log::info("\t\t                         batches, computing gradients (forward and backward passes), updating and evaluating,");
+    Log::info("\t\t                         with the instances per second and estimated GFLOP/s of the gradients");
+    Log::info("\t\t--counters               with --profile, also read the hardware counters of the main thread: instructions per cycle");
+    Log::info("\t\t                         and cache and branch misses per instance of the gradient, update and evaluation phases;");
+    Log::info("\t\t                         the other threads are not counted, use --threads 1 to count all the work");
+    Log::info("\t\t--allocations            log the heap allocations and bytes allocated per training step and per evaluated instance (needs a build with -DCOUNT_ALLOCATIONS)");
+    Log::info("\t\t                         of each epoch, counting them costs an atomic add per allocation");
+    Log::info("\t\t--ensemble <n>           train n networks from different random weights in lockstep with 'minibatch' gradient descent,");
+    Log::info("\t\t                         each with its own optimizer, and report every model and the accuracy of their averaged");
+    Log::info("\t\t                         outputs; --save-model saves model m as <file>.<m>");
+    Log::info("\t\t--trace <file>           record a timeline of the phases, the forward and backward pass of every layer and the");
+    Log::info("\t\t                         tasks of the threads, written as Chrome trace JSON for chrome://tracing or ui.perfetto.dev");
 }
 
-DataSet getDataset(std::string dataSetName) {
+// Optional flags given after the layer sizes
+struct Options {
+    bool stream = false;
+    size_t shuffleBufferSize = 10000;
+    size_t chunkSize = DEFAULT_CHUNK_SIZE;
+    int threads = 0;
+    bool normalize = false;
+    std::string saveNormalizer;
+    std::string loadNormalizer;
+    bool lazy = false;
+    double weightDecay = 0.01;
+    double trustCoefficient = 0.001;
+    std::string schedule = "constant";
+    int warmup = 0;
+    std::string validation;
+    double validationSplit = 0.0;
+    int patience = 0;
+    double minDelta = 0.0;
+    int accumulate = 1;
+    int history = 10;
+    std::string saveModel;
+    bool online = false;
+    int classes = 0;
+    std::string loadModel;
+    size_t window = 1000;
+    size_t snapshotEvery = 10000;
+    bool timing = false;
+    bool profile = false;
+    bool counters = false;
+    bool allocations = false;
+    int ensemble = 0;
+    std::string trace;
+};
+
+Options parseOptions(int argc, char* argv[], int firstOption) {
+    Options options;
+    for (int i = firstOption; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (option == "--stream") {
+            options.stream = true;
+        }
+        else if (option == "--shuffle-buffer" && hasValue) {
+            options.shuffleBufferSize = std::stoul(argv[++i]);
+        }
+        else if (option == "--chunk-size" && hasValue) {
+            options.chunkSize = std::stoul(argv[++i]);
+        }
+        else if (option == "--threads" && hasValue) {
+            options.threads = std::stoi(argv[++i]);
+        }
+        else if (option == "--normalize") {
+            options.normalize = true;
+        }
+        else if (option == "--save-normalizer" && hasValue) {
+            options.saveNormalizer = argv[++i];
+        }
+        else if (option == "--load-normalizer" && hasValue) {
+            options.loadNormalizer = argv[++i];
+        }
+        else if (option == "--lazy") {
+            options.lazy = true;
+        }
+        else if (option == "--weight-decay" && hasValue) {
+            options.weightDecay = std::stod(argv[++i]);
+        }
+        else if (option == "--trust-coefficient" && hasValue) {
+            options.trustCoefficient = std::stod(argv[++i]);
+        }
+        else if (option == "--schedule" && hasValue) {
+            options.schedule = argv[++i];
+        }
+        else if (option == "--warmup" && hasValue) {
+            options.warmup = std::stoi(argv[++i]);
+        }
+        else if (option == "--validation" && hasValue) {
+            options.validation = argv[++i];
+        }
+        else if (option == "--validation-split" && hasValue) {
+            options.validationSplit = std::stod(argv[++i]);
+        }
+        else if (option == "--patience" && hasValue) {
+            options.patience = std::stoi(argv[++i]);
+        }
+        else if (option == "--min-delta" && hasValue) {
+            options.minDelta = std::stod(argv[++i]);
+        }
+        else if (option == "--history" && hasValue) {
+            options.history = std::stoi(argv[++i]);
+        }
+        else if (option == "--save-model" && hasValue) {
+            options.saveModel = argv[++i];
+        }
+        else if (option == "--online") {
+            options.online = true;
+        }
+        else if (option == "--classes" && hasValue) {
+            options.classes = std::stoi(argv[++i]);
+        }
+        else if (option == "--load-model" && hasValue) {
+            options.loadModel = argv[++i];
+        }
+        else if (option == "--window" && hasValue) {
+            options.window = std::max<size_t>(1, std::stoul(argv[++i]));
+        }
+        else if (option == "--snapshot-every" && hasValue) {
+            options.snapshotEvery = std::stoul(argv[++i]);
+        }
+        else if (option == "--timing") {
+            options.timing = true;
+        }
+        else if (option == "--profile") {
+            options.profile = true;
+        }
+        else if (option == "--counters") {
+            options.counters = true;
+        }
+        else if (option == "--allocations") {
+            options.allocations = true;
+        }
+        else if (option == "--ensemble" && hasValue) {
+            options.ensemble = std::stoi(argv[++i]);
+            if (options.ensemble < 1) {
+                Log::fatal("--ensemble needs a number of models > 0");
+                exit(1);
+            }
+        }
+        else if (option == "--trace" && hasValue) {
+            options.trace = argv[++i];
+        }
+        else if (option == "--accumulate" && hasValue) {
+            options.accumulate = std::stoi(argv[++i]);
+            if (options.accumulate < 1) {
+                Log::fatal("--accumulate needs a number of minibatches > 0");
+                exit(1);
+            }
+        }
+        else {
+            Log::fatal("unknown or incomplete option: " + option);
+            helpMessage();
+            exit(1);
+        }
+    }
+    return options;
+}
+
+bool isDataSetFile(const std::string& dataSetName) {
+    return dataSetName.size() > 4 && (dataSetName.compare(dataSetName.size() - 4, 4, ".txt") == 0 || dataSetName.compare(dataSetName.size() - 4, 4, ".bin") == 0);
+}
+
+// Uses the normalizer loaded with --load-normalizer if there is one, otherwise the one computed
+// from the training data, and saves it if --save-normalizer was given
+Normalizer chooseNormalizer(const Normalizer& fitted, const Options& options) {
+    try {
+        Normalizer normalizer = options.loadNormalizer.empty() ? fitted : Normalizer::load(options.loadNormalizer);
+
+        Log::info("data set means: ");
+        for (double x : normalizer.getMeans()) {
+            printf("%g ", x);
+        }
+        printf("\n");
+
+        Log::info("data set standard deviations: ");
+        for (double x : normalizer.getStandardDeviations()) {
+            printf("%g ", x);
+        }
+        printf("\n");
+
+        if (!options.saveNormalizer.empty()) {
+            normalizer.save(options.saveNormalizer);
+            Log::info("Saved the normalizer to '" + options.saveNormalizer + "'.");
+        }
+        return normalizer;
+    }
+    catch (const std::runtime_error& e) {
+        Log::fatal("normalization failed: " + (std::string) e.what());
+        exit(1);
+    }
+}
+
+Normalizer normalizeDataset(DataSet& dataSet, const Options& options, ThreadPool& pool) {
+    if (dataSet.isSparse()) {
+        Log::fatal("sparse data sets cannot be normalized, it would fill in all of their zeros");
+        exit(1);
+    }
+    ScopedPhase phase(Phase::NORMALIZATION);
+    Normalizer fitted;
+    if (options.loadNormalizer.empty()) {
+        // Means and variances in one parallel pass over the instances
+        fitted.fit(dataSet.getInstances(), &pool);
+    }
+    Normalizer normalizer = chooseNormalizer(fitted, options);
+    if (normalizer.getNumberInputs() != dataSet.getNumberInputs()) {
+        Log::fatal("the normalizer has " + std::to_string(normalizer.getNumberInputs()) + " inputs but the data set has " + std::to_string(dataSet.getNumberInputs()));
+        exit(1);
+    }
+    dataSet.normalize(normalizer, &pool);
+    return normalizer;
+}
+
+// The normalizer is set to the one applied to the data set, if it was normalized
+DataSet getDataset(std::string dataSetName, const Options& options, ThreadPool& pool, Normalizer& normalizer) {
     if (dataSetName == "and") {
         DataSet dataSet = DataSet("and data", "./datasets/and.txt");
         return dataSet;
@@ -45,50 +311,201 @@ DataSet getDataset(std::string dataSetName) {
     }
     else if (dataSetName == "iris") {
         DataSet dataSet = DataSet("iris data", "./datasets/iris.txt");
-        std::vector<double> means = dataSet.getInputMeans();
-        std::vector<double> stdDevs = dataSet.getInputStandardDeviations();
-
-        Log::info("data set means: ");
-        for (double x : means) {
-            printf("%g ", x);
-        }
-        printf("\n");
-
-        Log::info("data set standard deviations: ");
-        for (double x : stdDevs) {
-            printf("%g ", x);
-        }
-        printf("\n");
-
-        dataSet.normalize(means, stdDevs);
+        normalizer = normalizeDataset(dataSet, options, pool);
         return dataSet;
     }
     else if (dataSetName == "mushroom") {
         DataSet dataSet = DataSet("mushroom data", "./datasets/agaricus-lepiota.txt");
         return dataSet;
     }
+    else if (isDataSetFile(dataSetName)) {
+        DataSet dataSet = DataSet(dataSetName, dataSetName);
+        if (options.normalize) normalizer = normalizeDataset(dataSet, options, pool);
+        return dataSet;
+    }
+    else {
+        Log::fatal("unknown data set : " + dataSetName);
+        exit(1);
+    }
+}
+
+// Opens the data set to be read from disk each epoch rather than loaded into memory
+std::unique_ptr<StreamingDataSet> getStreamingDataset(std::string dataSetName, const Options& options, Normalizer& normalizer) {
+    std::string filename;
+    if (dataSetName == "and") filename = "./datasets/and.txt";
+    else if (dataSetName == "or") filename = "./datasets/or.txt";
+    else if (dataSetName == "xor") filename = "./datasets/xor.txt";
+    else if (dataSetName == "iris") filename = "./datasets/iris.txt";
+    else if (dataSetName == "mushroom") filename = "./datasets/agaricus-lepiota.txt";
+    else if (isDataSetFile(dataSetName)) filename = dataSetName;
     else {
         Log::fatal("unknown data set : " + dataSetName);
         exit(1);
     }
+
+    std::unique_ptr<StreamingDataSet> dataSet(new StreamingDataSet(dataSetName + " data", filename, options.shuffleBufferSize, options.chunkSize));
+    if (dataSetName == "iris" || (isDataSetFile(dataSetName) && options.normalize)) {
+        if (dataSet->isSparse()) {
+            Log::fatal("sparse data sets cannot be normalized, it would fill in all of their zeros");
+            exit(1);
+        }
+        // Unless loaded, the means and standard deviations come from the streaming pre-pass
+        ScopedPhase phase(Phase::NORMALIZATION);
+        normalizer = chooseNormalizer(dataSet->getStatistics(), options);
+        if (normalizer.getNumberInputs() != dataSet->getNumberInputs()) {
+            Log::fatal("the normalizer has " + std::to_string(normalizer.getNumberInputs()) + " inputs but the data set has " + std::to_string(dataSet->getNumberInputs()));
+            exit(1);
+        }
+        dataSet->normalize(normalizer);
+    }
+    return dataSet;
 }
 
-int getOutputLayerSize(std::string dataSetName, DataSet dataSet) {
+// Loads the --validation data set file, normalized the same way as the training data
+DataSet getValidationDataset(const Options& options, const Normalizer& normalizer, ThreadPool& pool, int numberInputs, int numberOutputs) {
+    DataSet dataSet = DataSet("validation data", options.validation);
+    if (dataSet.getNumberInputs() != numberInputs || dataSet.getNumberOutputs() != numberOutputs) {
+        Log::fatal("the validation data set has " + std::to_string(dataSet.getNumberInputs()) + " inputs and " + std::to_string(dataSet.getNumberOutputs())
+            + " outputs but the training data set has " + std::to_string(numberInputs) + " and " + std::to_string(numberOutputs));
+        exit(1);
+    }
+    if (normalizer.getNumberInputs() > 0) dataSet.normalize(normalizer, &pool);
+    return dataSet;
+}
+
+// Starts an epoch of a data set, timed as shuffling
+void startEpoch(InstanceSource& source) {
+    ScopedPhase phase(Phase::SHUFFLING);
+    source.startEpoch();
+}
+
+// Gets the next batch of a data set, timed as batching
+bool getNextBatch(InstanceSource& source, int batchSize, std::vector<Instance>& batch) {
+    ScopedPhase phase(Phase::BATCHING);
+    return source.getNextBatch(batchSize, batch);
+}
+
+// Number of edges between the layers of a fully connected network, each costs a multiply and an add per pass
+double countEdges(const NeuralNetwork& nn) {
+    const std::vector<std::vector<Node>>& layers = nn.getLayers();
+    double edges = 0.0;
+    for (size_t layer = 0; layer + 1 < layers.size(); layer++) {
+        edges += static_cast<double>(layers[layer].size()) * layers[layer + 1].size();
+    }
+    return edges;
+}
+
+// Logs where the time of an epoch went. The gradient GFLOP/s are estimated from the
+// size of the network: 2 floating point operations per edge for the forward pass of
+// an instance and 4 for its backward pass, which are fewer for sparse inputs
+void logPhases(int epoch, double epochSeconds, double edges) {
+    char buffer[128];
+    std::string line = "  epoch " + std::to_string(epoch) + " phases:";
+    double timedSeconds = 0.0;
+    for (Phase phase : { Phase::SHUFFLING, Phase::BATCHING, Phase::GRADIENT, Phase::UPDATE, Phase::EVALUATION }) {
+        double seconds = PhaseTimer::getSeconds(phase);
+        timedSeconds += seconds;
+        snprintf(buffer, sizeof(buffer), " %s %.6fs (%.1f%%),", PhaseTimer::getName(phase).c_str(), seconds, 100.0 * seconds / epochSeconds);
+        line += buffer;
+    }
+    snprintf(buffer, sizeof(buffer), " other %.6fs", std::max(0.0, epochSeconds - timedSeconds));
+    Log::info(line + buffer);
+
+    double gradientSeconds = PhaseTimer::getSeconds(Phase::GRADIENT);
+    uint64_t instances = PhaseTimer::getCount(Phase::FORWARD);
+    double operations = 6.0 * edges * instances;
+    snprintf(buffer, sizeof(buffer), "forward %.6fs and backward %.6fs summed over the threads, %.0f instances/s, %.3f GFLOP/s",
+        PhaseTimer::getSeconds(Phase::FORWARD), PhaseTimer::getSeconds(Phase::BACKWARD),
+        gradientSeconds > 0.0 ? instances / gradientSeconds : 0.0, gradientSeconds > 0.0 ? operations / gradientSeconds / 1e9 : 0.0);
+    Log::info("  epoch " + std::to_string(epoch) + " gradient: " + std::to_string(instances) + " instances, " + buffer);
+
+    // The hardware counters of the main thread, if --counters reads them
+    line = "  epoch " + std::to_string(epoch) + " counters per trained instance:";
+    bool counted = false;
+    for (Phase phase : { Phase::GRADIENT, Phase::UPDATE, Phase::EVALUATION }) {
+        std::vector<double> counts = PhaseTimer::getCounters(phase);
+        if (counts.empty()) continue;
+        counted = true;
+        double perInstance = instances > 0 ? 1.0 / instances : 0.0;
+        snprintf(buffer, sizeof(buffer), " %s IPC %.2f, %.1f L1, %.2f LLC and %.2f branch misses;", PhaseTimer::getName(phase).c_str(),
+            counts[PerfCounters::INSTRUCTIONS] / counts[PerfCounters::CYCLES], counts[PerfCounters::L1_MISSES] * perInstance,
+            counts[PerfCounters::LLC_MISSES] * perInstance, counts[PerfCounters::BRANCH_MISSES] * perInstance);
+        line += buffer;
+    }
+    if (counted) Log::info(line.substr(0, line.size() - 1));
+}
+
+// Logs the heap allocations of an epoch for --allocations, those of training per step and
+// those of evaluating per instance
+void logAllocations(int epoch, const AllocationCount& training, size_t steps, const AllocationCount& evaluation, size_t evaluatedInstances) {
+    char buffer[192];
+    double perStep = steps > 0 ? 1.0 / steps : 0.0;
+    double perInstance = evaluatedInstances > 0 ? 1.0 / evaluatedInstances : 0.0;
+    snprintf(buffer, sizeof(buffer), " %.1f per training step (%.0f bytes) over %zu steps, %.2f per evaluated instance (%.0f bytes)",
+        training.allocations * perStep, training.bytes * perStep, steps, evaluation.allocations * perInstance, evaluation.bytes * perInstance);
+    Log::info("  epoch " + std::to_string(epoch) + " allocations:" + buffer);
+}
+
+// Writes the timeline recorded for --trace, once the threads are done
+void writeTrace(const Options& options) {
+    if (options.trace.empty()) return;
+    try {
+        size_t numberEvents = TraceRecorder::write(options.trace);
+        Log::info("Wrote " + std::to_string(numberEvents) + " trace events to '" + options.trace + "'.");
+        if (TraceRecorder::getNumberDropped() > 0) {
+            Log::warning("Dropped " + std::to_string(TraceRecorder::getNumberDropped()) + " trace events over the limit per thread.");
+        }
+    }
+    catch (const std::runtime_error& e) {
+        Log::fatal(e.what());
+        exit(1);
+    }
+}
+
+// Number of instances read at a time when a streamed data set is evaluated or used for batch gradient descent
+const int STREAMING_BATCH_SIZE = 1000;
+
+// Sums the loss and counts the correct predictions over one pass of a streamed data set
+void evaluate(NeuralNetwork& nn, StreamingDataSet& dataSet, double& error, double& accuracy) {
+    std::vector<Instance> batch;
+    double errorSum = 0.0;
+    double correct = 0.0;
+
+    dataSet.rewind();
+    while (dataSet.getNextBatch(STREAMING_BATCH_SIZE, batch)) {
+        errorSum += nn.forwardPass(batch);
+        correct += nn.calculateAccuracy(batch) * batch.size();
+    }
+    error = errorSum / dataSet.getNumberInstances();
+    accuracy = correct / dataSet.getNumberInstances();
+}
+
+// The weights updated after a batch, which with --lazy are only the ones of the inputs that
+// are nonzero in the batch (and the layers after the input layer), the way lazy Adam works
+std::vector<std::pair<int, int>> getUpdateRanges(const NeuralNetwork& nn, const std::vector<Instance>& batch, const Options& options) {
+    if (options.lazy) return nn.getActiveWeightRanges(batch);
+    return std::vector<std::pair<int, int>>(1, std::make_pair(0, nn.getNumberWeights()));
+}
+
+int getOutputLayerSize(std::string dataSetName, int numberOutputs, int numberClasses) {
     if (dataSetName == "and") {
-        return dataSet.getNumberOutputs();
+        return numberOutputs;
     }
     else if (dataSetName == "or") {
-        return dataSet.getNumberOutputs();
+        return numberOutputs;
     }
     else if (dataSetName == "xor") {
-        return dataSet.getNumberOutputs();
+        return numberOutputs;
     }
     else if (dataSetName == "iris") {
-        return dataSet.getNumberClasses();
+        return numberClasses;
     }
 
     else if (dataSetName == "mushroom") {
-        return dataSet.getNumberClasses();
+        return numberClasses;
+    }
+    else if (isDataSetFile(dataSetName)) {
+        return numberClasses;
     }
     else {
         Log::fatal("unknown data set : " + dataSetName);
@@ -96,6 +513,221 @@ int getOutputLayerSize(std::string dataSetName, DataSet dataSet) {
     }
 }
 
+// Trains on the instances of a stream as they arrive: each instance is first judged by the
+// current network, for the rolling loss and accuracy, and then trained on. Every instance
+// costs one forward and backward pass and, at the end of each minibatch, one optimizer step,
+// so the time per instance stays the same however long the stream runs; snapshots are
+// written on another thread.
+void trainOnline(const std::string& source, const std::string& descentType, int batchSize, LossFunction lossFunction, double bias,
+                 const std::string& adaptiveLearningRate, const OptimizerParameters& parameters, const std::vector<int>& layerSizes, const Options& options) {
+    if (descentType != "stochastic" && descentType != "minibatch") {
+        Log::fatal("online training needs 'stochastic' or 'minibatch' gradient descent, not '" + descentType + "'");
+        exit(1);
+    }
+    int stepSize = descentType == "minibatch" ? std::max(1, batchSize) : 1;
+
+    try {
+        InstanceStream stream(source);
+        Normalizer normalizer;
+        std::unique_ptr<NeuralNetwork> nn;
+        if (!options.loadModel.empty()) {
+            nn.reset(new NeuralNetwork(ModelFile::load(options.loadModel, &normalizer)));
+            stream.setNumberInputs(nn->getLayers()[0].size());
+            Log::info("Continuing from the model in '" + options.loadModel + "'.");
+            if (nn->getLossFunction() != lossFunction) {
+                Log::warning("the model was trained with another loss function, keeping the model's.");
+            }
+        }
+        if (!options.loadNormalizer.empty()) normalizer = Normalizer::load(options.loadNormalizer);
+
+        // A new network takes its number of inputs from the first instance
+        Instance instance({}, {});
+        bool haveInstance = false;
+        if (!nn) {
+            if (options.classes <= 0) {
+                Log::fatal("online training needs the number of classes (--classes) or a model to continue from (--load-model)");
+                exit(1);
+            }
+            haveInstance = stream.next(instance);
+            if (!haveInstance) {
+                Log::info("The stream ended before its first instance.");
+                return;
+            }
+            nn.reset(new NeuralNetwork(stream.getNumberInputs(), layerSizes, options.classes, lossFunction));
+            nn->connectFully();
+            nn->initializeRandomly(bias);
+        }
+        if (normalizer.getNumberInputs() > 0 && normalizer.getNumberInputs() != static_cast<int>(nn->getLayers()[0].size())) {
+            Log::fatal("the normalizer has " + std::to_string(normalizer.getNumberInputs()) + " inputs but the network has " + std::to_string(nn->getLayers()[0].size()));
+            exit(1);
+        }
+        int numberClasses = nn->getLayers().back().size();
+
+        std::unique_ptr<Optimizer> optimizer = Optimizer::create(adaptiveLearningRate, nn->getNumberWeights(), parameters);
+        optimizer->setParameterGroups(nn->getLayerWeightRanges());
+        std::unique_ptr<SnapshotWriter> snapshots;
+        if (!options.saveModel.empty()) {
+            snapshots.reset(new SnapshotWriter(options.saveModel, *nn, normalizer.getNumberInputs() > 0 ? &normalizer : nullptr));
+        }
+
+        Log::info("Training " + descentType + (stepSize > 1 ? "(" + std::to_string(stepSize) + ")" : "") + " on the instances of '" + source + "' as they arrive.");
+        RollingAverage rollingLoss(options.window);
+        RollingAverage rollingAccuracy(options.window);
+        LatencyHistogram updateLatencies;
+        std::vector<double> gradient(nn->getNumberWeights(), 0.0);
+        std::vector<double> newWeights;
+        std::vector<Instance> stepInstances;
+        int instancesInStep = 0;
+        size_t numberInstances = 0;
+
+        while (haveInstance || stream.next(instance)) {
+            haveInstance = false;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            int label = static_cast<int>(instance.expectedOutputs[0]);
+            if (label < 0 || label >= numberClasses) {
+                Log::warning("Skipping an instance of class " + std::to_string(label) + ", the network has " + std::to_string(numberClasses) + " classes.");
+                continue;
+            }
+            if (normalizer.getNumberInputs() > 0) {
+                if (instance.isSparse()) {
+                    Log::fatal("sparse instances cannot be normalized, it would fill in all of their zeros");
+                    exit(1);
+                }
+                normalizer.apply(instance.inputs);
+            }
+
+            // Judged before it is trained on, so the rolling numbers are on unseen instances
+            rollingLoss.add(nn->forwardPass(instance));
+            std::vector<double> outputs = nn->getOutputValues();
+            rollingAccuracy.add(std::max_element(outputs.begin(), outputs.end()) - outputs.begin() == label ? 1.0 : 0.0);
+            nn->backwardPass();
+            nn->addDeltas(gradient);
+            if (options.lazy) stepInstances.push_back(instance);
+            instancesInStep++;
+
+            if (instancesInStep == stepSize) {
+                newWeights = nn->getWeights();
+                optimizer->step(newWeights, gradient, getUpdateRanges(*nn, stepInstances, options));
+                nn->setWeights(newWeights);
+                std::fill(gradient.begin(), gradient.end(), 0.0);
+                stepInstances.clear();
+                instancesInStep = 0;
+            }
+            numberInstances++;
+            updateLatencies.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+            if (numberInstances % options.window == 0) {
+                Log::info("  " + std::to_string(numberInstances) + " instances, loss " + std::to_string(rollingLoss.getAverage()) + ", accuracy "
+                    + std::to_string(rollingAccuracy.getAverage() * 100.0) + " over the last " + std::to_string(rollingLoss.getCount()) + ", update latency " + updateLatencies.getSummary());
+                updateLatencies.reset();
+            }
+            if (snapshots && options.snapshotEvery > 0 && numberInstances % options.snapshotEvery == 0) {
+                snapshots->save(nn->getWeights());
+            }
+        }
+
+        // The last partial minibatch
+        if (instancesInStep > 0) {
+            newWeights = nn->getWeights();
+            optimizer->step(newWeights, gradient, getUpdateRanges(*nn, stepInstances, options));
+            nn->setWeights(newWeights);
+        }
+        Log::info("The stream ended after " + std::to_string(numberInstances) + " instances (" + std::to_string(stream.getNumberSkipped()) + " lines skipped), loss "
+            + std::to_string(rollingLoss.getAverage()) + ", accuracy " + std::to_string(rollingAccuracy.getAverage() * 100.0) + " over the last " + std::to_string(rollingLoss.getCount()) + ".");
+        if (snapshots) {
+            snapshots->save(nn->getWeights());
+            snapshots.reset();
+            Log::info("Saved the model to '" + options.saveModel + "'.");
+        }
+    }
+    catch (const std::runtime_error& e) {
+        Log::fatal("online training failed with exception: " + (std::string) e.what());
+        exit(1);
+    }
+}
+
+// Trains --ensemble networks of the same layers in lockstep on the minibatches of an in-memory
+// data set. Every model starts from its own random weights and is updated by its own optimizer,
+// the learning rate schedule applies to all of them; each epoch logs the loss and accuracy of
+// every model and the accuracy of the ensemble, which averages their outputs.
+void trainEnsemble(DataSet& dataSet, const DataSet* validationDataSet, int batchSize, int epochs, LossFunction lossFunction, double bias,
+                   const std::string& adaptiveLearningRate, const OptimizerParameters& parameters, int outputLayerSize,
+                   const std::vector<int>& layerSizes, const Normalizer& normalizer, const Options& options) {
+    if (options.patience > 0 || options.lazy || options.accumulate > 1 || options.profile || options.allocations) {
+        Log::warning("--patience, --lazy, --accumulate, --profile and --allocations do not apply to an ensemble, ignoring them.");
+    }
+
+    try {
+        std::vector<NeuralNetwork> models;
+        std::vector<std::unique_ptr<Optimizer>> optimizers;
+        for (int m = 0; m < options.ensemble; m++) {
+            models.emplace_back(dataSet.getNumberInputs(), layerSizes, outputLayerSize, lossFunction);
+            models.back().connectFully();
+            models.back().initializeRandomly(bias);
+            optimizers.push_back(Optimizer::create(adaptiveLearningRate, models.back().getNumberWeights(), parameters));
+            optimizers.back()->setParameterGroups(models.back().getLayerWeightRanges());
+        }
+        Ensemble ensemble(models, std::move(optimizers));
+        models.clear();
+        std::unique_ptr<LearningRateSchedule> schedule = LearningRateSchedule::create(options.schedule, parameters.learningRate, epochs, options.warmup);
+        Log::info("Training an ensemble of " + std::to_string(ensemble.getNumberModels()) + " networks of " + std::to_string(ensemble.getNumberWeights())
+            + " weights in lockstep, minibatch(" + std::to_string(batchSize) + ").");
+
+        const std::vector<Instance>& instances = dataSet.getInstances();
+        std::vector<double> losses, accuracies;
+        double ensembleAccuracy;
+        std::chrono::steady_clock::time_point trainingStart = std::chrono::steady_clock::now();
+        for (int epoch = 0; epoch < epochs; epoch++) {
+            std::chrono::steady_clock::time_point epochStart = std::chrono::steady_clock::now();
+            for (int m = 0; m < ensemble.getNumberModels(); m++) {
+                ensemble.getOptimizer(m).setLearningRate(schedule->getLearningRate(epoch));
+            }
+            startEpoch(dataSet);
+            for (size_t begin = 0; begin < instances.size(); begin += batchSize) {
+                ensemble.step(instances, begin, std::min(begin + batchSize, instances.size()));
+            }
+
+            std::chrono::steady_clock::time_point evaluationStart = std::chrono::steady_clock::now();
+            ensemble.evaluate(instances, losses, accuracies, ensembleAccuracy);
+            std::string line = "  epoch " + std::to_string(epoch + 1) + " ensemble " + std::to_string(ensembleAccuracy * 100.0) + ", models";
+            double meanLoss = 0.0;
+            for (int m = 0; m < ensemble.getNumberModels(); m++) {
+                line += " " + std::to_string(losses[m] / instances.size()) + "/" + std::to_string(accuracies[m] * 100.0);
+                meanLoss += losses[m] / instances.size() / ensemble.getNumberModels();
+            }
+            // The schedule goes by the mean loss of the models, on the held-out instances if there are any
+            if (validationDataSet) {
+                ensemble.evaluate(validationDataSet->getInstances(), losses, accuracies, ensembleAccuracy);
+                meanLoss = 0.0;
+                for (double loss : losses) meanLoss += loss / validationDataSet->getNumberInstances() / ensemble.getNumberModels();
+                line += ", held out ensemble " + std::to_string(ensembleAccuracy * 100.0) + " mean loss " + std::to_string(meanLoss);
+            }
+            Log::info(line);
+            if (options.timing) {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                double trainingSeconds = std::chrono::duration<double>(evaluationStart - epochStart).count();
+                Log::info("  epoch " + std::to_string(epoch + 1) + " time: training " + std::to_string(trainingSeconds) + "s, "
+                    + std::to_string(instances.size() * ensemble.getNumberModels() / trainingSeconds) + " model instances/s, evaluating "
+                    + std::to_string(std::chrono::duration<double>(now - evaluationStart).count()) + "s, elapsed "
+                    + std::to_string(std::chrono::duration<double>(now - trainingStart).count()) + "s");
+            }
+            schedule->endEpoch(meanLoss);
+        }
+
+        if (!options.saveModel.empty()) {
+            for (int m = 0; m < ensemble.getNumberModels(); m++) {
+                std::string filename = options.saveModel + "." + std::to_string(m);
+                ModelFile::save(filename, ensemble.toNeuralNetwork(m), normalizer.getNumberInputs() > 0 ? &normalizer : nullptr);
+            }
+            Log::info("Saved the " + std::to_string(ensemble.getNumberModels()) + " models to '" + options.saveModel + ".<m>'.");
+        }
+    }
+    catch (const std::runtime_error& e) {
+        Log::fatal("ensemble training failed with exception: " + (std::string) e.what());
+        exit(1);
+    }
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 15) {
         helpMessage();
@@ -116,13 +748,16 @@ int main(int argc, char* argv[]) {
     double beta1 = std::stod(argv[12]);
     double beta2 = std::stod(argv[13]);
 
-    std::vector<int> layerSizes(argc - 14);
-    for (int i = 14; i < argc; i++) {
-        layerSizes[i - 14] = std::stoi(argv[i]);
+    std::vector<int> layerSizes;
+    int argument = 14;
+    for (; argument < argc && std::string(argv[argument]).compare(0, 2, "--") != 0; argument++) {
+        layerSizes.push_back(std::stoi(argv[argument]));
+    }
+    Options options = parseOptions(argc, argv, argument);
+    if (!options.trace.empty()) {
+        TraceRecorder::start();
+        TraceRecorder::setThreadName("main");
     }
-
-    DataSet dataSet = getDataset(dataSetName);
-    int outputLayerSize = getOutputLayerSize(dataSetName, dataSet);
 
     LossFunction lossFunction = LossFunction::NONE;
     if (lossFunctionName == "svm") {
@@ -138,8 +773,130 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
+    if (options.online) {
+        OptimizerParameters parameters;
+        parameters.learningRate = learningRate;
+        parameters.mu = mu;
+        parameters.decayRate = decayRate;
+        parameters.eps = eps;
+        parameters.beta1 = beta1;
+        parameters.beta2 = beta2;
+        parameters.weightDecay = options.weightDecay;
+        parameters.trustCoefficient = options.trustCoefficient;
+        if (options.profile || options.counters) {
+            Log::warning("--profile and --counters only apply to training in epochs, ignoring them.");
+        }
+        trainOnline(dataSetName, descentType, batchSize, lossFunction, bias, adaptive_l_r, parameters, layerSizes, options);
+        writeTrace(options);
+        return 0;
+    }
+
+    ThreadPool pool(options.threads);
 
-    NeuralNetwork nn(dataSet.getNumberInputs(), layerSizes, outputLayerSize, lossFunction);
+    // Either the whole data set is loaded into memory, or it is streamed from disk each epoch
+    std::unique_ptr<DataSet> loadedDataSet;
+    std::unique_ptr<StreamingDataSet> streamingDataSet;
+    InstanceSource* instanceSource;
+    Normalizer normalizer;
+    int numberInputs, numberOutputs, numberClasses;
+    size_t numberInstances;
+    PhaseTimer::setEnabled(options.profile);
+    // Opened on this thread, which computes the first share of every gradient and all the rest
+    std::unique_ptr<PerfCounters> counters;
+    if (options.counters) {
+        if (!options.profile) {
+            Log::warning("--counters only applies with --profile, ignoring it.");
+        }
+        else {
+            counters.reset(new PerfCounters());
+            if (!counters->isAvailable()) {
+                Log::warning("the hardware counters are not available, profiling without them (" + counters->getUnavailableReason() + ")");
+                counters.reset();
+            }
+            else {
+                if (!counters->getUnavailableReason().empty()) {
+                    Log::warning("some hardware counters are not available and are reported as NaN (" + counters->getUnavailableReason() + ")");
+                }
+                PhaseTimer::setCounters(counters.get());
+            }
+        }
+    }
+    {
+        // Loading the data set includes normalizing it
+        ScopedPhase loading(Phase::LOADING);
+        if (options.stream) {
+            streamingDataSet = getStreamingDataset(dataSetName, options, normalizer);
+            instanceSource = streamingDataSet.get();
+            numberInputs = streamingDataSet->getNumberInputs();
+            numberOutputs = streamingDataSet->getNumberOutputs();
+            numberClasses = streamingDataSet->getNumberClasses();
+            numberInstances = streamingDataSet->getNumberInstances();
+        }
+        else {
+            loadedDataSet.reset(new DataSet(getDataset(dataSetName, options, pool, normalizer)));
+            instanceSource = loadedDataSet.get();
+            numberInputs = loadedDataSet->getNumberInputs();
+            numberOutputs = loadedDataSet->getNumberOutputs();
+            numberClasses = loadedDataSet->getNumberClasses();
+            numberInstances = loadedDataSet->getNumberInstances();
+            if (loadedDataSet->isPacked()) {
+                Log::info("All inputs are 0 or 1, storing the data set bit packed.");
+            }
+            if (loadedDataSet->isSparse()) {
+                Log::info("Storing the data set sparse, only its nonzero inputs are used.");
+            }
+        }
+    }
+    if (options.profile) {
+        Log::info("Loaded the data set in " + std::to_string(PhaseTimer::getSeconds(Phase::LOADING)) + "s, of which normalizing took "
+            + std::to_string(PhaseTimer::getSeconds(Phase::NORMALIZATION)) + "s.");
+    }
+    int outputLayerSize = getOutputLayerSize(dataSetName, numberOutputs, numberClasses);
+
+    // The held-out instances the schedule and early stopping judge each epoch on
+    std::unique_ptr<DataSet> validationDataSet;
+    if (!options.validation.empty()) {
+        validationDataSet.reset(new DataSet(getValidationDataset(options, normalizer, pool, numberInputs, numberOutputs)));
+    }
+    else if (options.validationSplit > 0.0) {
+        if (options.stream) {
+            Log::fatal("--validation-split needs the data set in memory, give a --validation file when streaming");
+            exit(1);
+        }
+        try {
+            validationDataSet.reset(new DataSet(loadedDataSet->splitOff(options.validationSplit)));
+        }
+        catch (const std::runtime_error& e) {
+            Log::fatal(e.what());
+            exit(1);
+        }
+        numberInstances = loadedDataSet->getNumberInstances();
+    }
+    if (validationDataSet) {
+        Log::info("Holding out " + std::to_string(validationDataSet->getNumberInstances()) + " instances to validate on.");
+    }
+
+    if (options.ensemble > 0) {
+        if (descentType != "minibatch" || options.stream) {
+            Log::fatal("--ensemble needs 'minibatch' gradient descent on a data set in memory");
+            exit(1);
+        }
+        OptimizerParameters parameters;
+        parameters.learningRate = learningRate;
+        parameters.mu = mu;
+        parameters.decayRate = decayRate;
+        parameters.eps = eps;
+        parameters.beta1 = beta1;
+        parameters.beta2 = beta2;
+        parameters.weightDecay = options.weightDecay;
+        parameters.trustCoefficient = options.trustCoefficient;
+        trainEnsemble(*loadedDataSet, validationDataSet.get(), batchSize, epochs, lossFunction, bias, adaptive_l_r, parameters, outputLayerSize,
+            layerSizes, normalizer, options);
+        writeTrace(options);
+        return 0;
+    }
+
+    NeuralNetwork nn(numberInputs, layerSizes, outputLayerSize, lossFunction);
 
     try {
         nn.connectFully();
@@ -162,117 +919,203 @@ int main(int argc, char* argv[]) {
 
         nn.initializeRandomly(bias);
 
-        std::vector<double> velocity(nn.getNumberWeights());
-        std::vector<double> velocityPrev(nn.getNumberWeights());
-        std::vector<double> cache(nn.getNumberWeights());
-        std::vector<double> m(nn.getNumberWeights());
+        // The update rule is chosen once here, each step is then a single fused pass over the weights
+        OptimizerParameters parameters;
+        parameters.learningRate = learningRate;
+        parameters.mu = mu;
+        parameters.decayRate = decayRate;
+        parameters.eps = eps;
+        parameters.beta1 = beta1;
+        parameters.beta2 = beta2;
+        parameters.weightDecay = options.weightDecay;
+        parameters.trustCoefficient = options.trustCoefficient;
+        std::unique_ptr<Optimizer> optimizer;
+        try {
+            optimizer = Optimizer::create(adaptive_l_r, nn.getNumberWeights(), parameters);
+            // LARS and LAMB scale the step of each layer by its own trust ratio
+            optimizer->setParameterGroups(nn.getLayerWeightRanges());
+        }
+        catch (const std::runtime_error& e) {
+            Log::fatal(e.what());
+            helpMessage();
+            exit(1);
+        }
+
+        // Replicas of the network for computing the minibatch and batch gradients on every thread
+        ParallelGradient parallelGradient(nn, &pool);
+        if (parallelGradient.getNumberReplicas() > 0 && descentType != "stochastic") {
+            Log::info("Computing the gradients data-parallel on " + std::to_string(parallelGradient.getNumberReplicas()) + " threads.");
+        }
+        if (options.accumulate > 1 && descentType != "minibatch") {
+            Log::warning("--accumulate only applies to minibatch gradient descent, ignoring it.");
+        }
+        // The minibatches of an in-memory data set are trained in place by a session that
+        // does not allocate per step; streaming, lazy updates and accumulating copy the batches
+        std::unique_ptr<TrainingSession> session;
+        if (descentType == "minibatch" && !options.stream && !options.lazy && options.accumulate <= 1) {
+            session.reset(new TrainingSession(nn, *optimizer, &parallelGradient));
+        }
+
+        std::unique_ptr<LearningRateSchedule> schedule;
+        std::unique_ptr<EarlyStopping> earlyStopping;
+        try {
+            schedule = LearningRateSchedule::create(options.schedule, learningRate, epochs, options.warmup);
+            if (options.patience > 0) earlyStopping.reset(new EarlyStopping(options.patience, options.minDelta));
+        }
+        catch (const std::runtime_error& e) {
+            Log::fatal(e.what());
+            helpMessage();
+            exit(1);
+        }
 
-        // implement the RMSprop
-        // per-parameter adaptive learning rate method.
-        // and implement the Adam
-        // per-parameter adaptive learning rate method.
-        // For these, you will need to add a command line flag
-        // to select which method you'll use (nesterov, rmsprop, or adam)
+        // L-BFGS keeps the loss and gradient at the current weights from one iteration to the next
+        std::unique_ptr<LBFGS> lbfgs;
+        LBFGS::Objective objective;
+        std::vector<double> lbfgsWeights, lbfgsGradient;
+        double lbfgsLoss = 0.0;
+        try {
+            if (descentType == "lbfgs") {
+                if (options.stream) {
+                    Log::fatal("lbfgs needs the data set in memory, it evaluates the loss several times per iteration");
+                    exit(1);
+                }
+                lbfgs.reset(new LBFGS(options.history));
+                objective = [&](const std::vector<double>& weights, std::vector<double>& gradient) {
+                    nn.setWeights(weights);
+                    std::fill(gradient.begin(), gradient.end(), 0.0);
+                    {
+                        ScopedPhase phase(Phase::GRADIENT);
+                        parallelGradient.addGradient(nn, loadedDataSet->getInstances(), gradient);
+                    }
+                    return nn.forwardPass(loadedDataSet->getInstances());
+                };
+                lbfgsWeights = nn.getWeights();
+                lbfgsGradient.assign(nn.getNumberWeights(), 0.0);
+                lbfgsLoss = objective(lbfgsWeights, lbfgsGradient);
+            }
+        }
+        catch (const std::runtime_error& e) {
+            Log::fatal(e.what());
+            helpMessage();
+            exit(1);
+        }
 
-        double error = nn.forwardPass(dataSet.getInstances()) / dataSet.getNumberInstances();
+        double error, accuracy;
+        if (options.stream) {
+            evaluate(nn, *streamingDataSet, error, accuracy);
+        }
+        else {
+            error = nn.forwardPass(loadedDataSet->getInstances()) / numberInstances;
+            accuracy = nn.calculateAccuracy(loadedDataSet->getInstances());
+        }
         double bestError = error;
-        double accuracy = nn.calculateAccuracy(dataSet.getInstances());
 
         Log::info("  " + std::to_string(bestError) + " " + std::to_string(error) + " " + std::to_string(accuracy * 100.0));
 
+        bool countAllocations = options.allocations && AllocationCounter::isAvailable();
+        if (options.allocations && !countAllocations) {
+            Log::warning("--allocations needs a build with -DCOUNT_ALLOCATIONS, ignoring it.");
+        }
+        AllocationCounter::setEnabled(countAllocations);
+        std::chrono::steady_clock::time_point trainingStart = std::chrono::steady_clock::now();
         for (int i = 0; i < epochs; i++) {
+            std::chrono::steady_clock::time_point epochStart = std::chrono::steady_clock::now();
+            PhaseTimer::reset();
+            AllocationCount epochAllocations = AllocationCounter::get();
+            size_t steps = 0;
+            optimizer->setLearningRate(schedule->getLearningRate(i));
+
             if (descentType == "stochastic") {
                 // implement one epoch (pass through the
                 // training data) for stochastic gradient descent
-                dataSet.shuffle();
-                for (int ins = 0; ins < dataSet.getNumberInstances(); ins++) {
-                    Instance instance = dataSet.getInstance(ins);
-                    std::vector<double> gradient = nn.getGradient(instance);
-                    std::vector<double> newWeights = nn.getWeights();
-                    for (int j = 0; j < newWeights.size(); j++) {
-                        if (adaptive_l_r == "nesterov") {
-                            velocityPrev[j] = velocity[j];
-                            velocity[j] = mu * velocity[j] - learningRate * gradient[j];
-                            newWeights[j] += (-1 * mu * velocityPrev[j]) + ((1 + mu) * velocity[j]);
-                        }
-                        else if (adaptive_l_r == "rmsprop") {
-                            cache[j] = decayRate * cache[j] + (1 - decayRate) * std::pow(gradient[j], 2);
-                            newWeights[j] -= (learningRate / (std::sqrt(cache[j]) + eps)) * gradient[j];
-                        }
-                        else if (adaptive_l_r == "adam") {
-                            m[j] = beta1 * m[j] + (1 - beta1) * gradient[j];
-                            velocity[j] = beta2 * velocity[j] + (1 - beta2) * std::pow(gradient[j], 2);
-                            newWeights[j] -= learningRate * m[j] / std::sqrt(velocity[j] + eps);
-                        }
-                        else {
-                            Log::fatal("unknown adaptive learning rate type: " + adaptive_l_r);
-                            helpMessage();
-                            exit(1);
-                        }
+                std::vector<Instance> batch;
+                startEpoch(*instanceSource);
+                while (getNextBatch(*instanceSource, 1, batch)) {
+                    std::vector<double> gradient;
+                    {
+                        ScopedPhase phase(Phase::GRADIENT);
+                        gradient = nn.getGradient(batch[0]);
                     }
+                    ScopedPhase phase(Phase::UPDATE);
+                    std::vector<double> newWeights = nn.getWeights();
+                    optimizer->step(newWeights, gradient, getUpdateRanges(nn, batch, options));
                     nn.setWeights(newWeights);
+                    steps++;
+                }
+            }
+            else if (descentType == "minibatch" && session) {
+                // The batches are ranges of the shuffled instances, so a step does not copy them
+                startEpoch(*instanceSource);
+                const std::vector<Instance>& trainingInstances = loadedDataSet->getInstances();
+                for (size_t begin = 0; begin < trainingInstances.size(); begin += batchSize) {
+                    session->step(trainingInstances, begin, std::min(begin + batchSize, trainingInstances.size()));
+                    steps++;
                 }
             }
             else if (descentType == "minibatch") {
                 // implement one epoch (pass through the
-                // training data) for minibatch gradient descent
-                dataSet.shuffle();
-                for (int ins = 0; ins < dataSet.getNumberInstances(); ins += batchSize) {
-                    std::vector<Instance> instances = dataSet.getInstances(ins, batchSize);
-                    std::vector<double> gradient = nn.getGradient(instances);
-                    std::vector<double> newWeights = nn.getWeights();
-                    for (int j = 0; j < newWeights.size(); j++) {
-                        if (adaptive_l_r == "nesterov") {
-                            velocityPrev[j] = velocity[j];
-                            velocity[j] = mu * velocity[j] - learningRate * gradient[j];
-                            newWeights[j] += (-1 * mu * velocityPrev[j]) + ((1 + mu) * velocity[j]);
-                        }
-                        else if (adaptive_l_r == "rmsprop") {
-                            cache[j] = decayRate * cache[j] + (1 - decayRate) * std::pow(gradient[j], 2);
-                            newWeights[j] -= (learningRate / (std::sqrt(cache[j]) + eps)) * gradient[j];
-                        }
-                        else if (adaptive_l_r == "adam") {
-                            m[j] = beta1 * m[j] + (1 - beta1) * gradient[j];
-                            velocity[j] = beta2 * velocity[j] + (1 - beta2) * std::pow(gradient[j], 2);
-                            newWeights[j] -= learningRate * m[j] / std::sqrt(velocity[j] + eps);
-                        }
-                        else {
-                            Log::fatal("unknown adaptive learning rate type: " + adaptive_l_r);
-                            helpMessage();
-                            exit(1);
+                // training data) for minibatch gradient descent, summing the gradients of
+                // --accumulate minibatches into the one buffer before each update so only
+                // one minibatch is ever in flight
+                std::vector<Instance> instances;
+                std::vector<Instance> stepInstances;
+                std::vector<double> gradient(nn.getNumberWeights());
+                startEpoch(*instanceSource);
+                bool moreInstances = true;
+                while (moreInstances) {
+                    std::fill(gradient.begin(), gradient.end(), 0.0);
+                    stepInstances.clear();
+                    int microBatches = 0;
+                    while (microBatches < options.accumulate && (moreInstances = getNextBatch(*instanceSource, batchSize, instances))) {
+                        {
+                            ScopedPhase phase(Phase::GRADIENT);
+                            parallelGradient.addGradient(nn, instances, gradient);
                         }
+                        // Lazy updates need the nonzero inputs of every minibatch of the step
+                        if (options.lazy) stepInstances.insert(stepInstances.end(), instances.begin(), instances.end());
+                        microBatches++;
                     }
+                    if (microBatches == 0) break;
+
+                    ScopedPhase phase(Phase::UPDATE);
+                    std::vector<double> newWeights = nn.getWeights();
+                    optimizer->step(newWeights, gradient, getUpdateRanges(nn, options.lazy ? stepInstances : instances, options));
                     nn.setWeights(newWeights);
+                    steps++;
                 }
             }
             else if (descentType == "batch") {
                 // implement one epoch (pass through the training
                 // instances) for batch gradient descent
-                std::vector<Instance> instances = dataSet.getInstances();
-                std::vector<double> gradient = nn.getGradient(instances);
-                std::vector<double> newWeights = nn.getWeights();
-                for (int ins = 0; ins < newWeights.size(); ins++) {
-                    if (adaptive_l_r == "nesterov") {
-                        velocityPrev[ins] = velocity[ins];
-                        velocity[ins] = mu * velocity[ins] - learningRate * gradient[ins];
-                        newWeights[ins] += (-1 * mu * velocityPrev[ins]) + ((1 + mu) * velocity[ins]);
-                    }
-                    else if (adaptive_l_r == "rmsprop") {
-                        cache[ins] = decayRate * cache[ins] + (1 - decayRate) * std::pow(gradient[ins], 2);
-                        newWeights[ins] -= (learningRate / (std::sqrt(cache[ins]) + eps)) * gradient[ins];
-                    }
-                    else if (adaptive_l_r == "adam") {
-                        m[ins] = beta1 * m[ins] + (1 - beta1) * gradient[ins];
-                        velocity[ins] = beta2 * velocity[ins] + (1 - beta2) * std::pow(gradient[ins], 2);
-                        newWeights[ins] -= learningRate * m[ins] / std::sqrt(velocity[ins] + eps);
-                    }
-                    else {
-                        Log::fatal("unknown adaptive learning rate type: " + adaptive_l_r);
-                        helpMessage();
-                        exit(1);
+                std::vector<double> gradient(nn.getNumberWeights(), 0.0);
+                if (options.stream) {
+                    // Sum the gradient over the whole file a batch at a time
+                    std::vector<Instance> instances;
+                    streamingDataSet->rewind();
+                    while (getNextBatch(*streamingDataSet, STREAMING_BATCH_SIZE, instances)) {
+                        ScopedPhase phase(Phase::GRADIENT);
+                        parallelGradient.addGradient(nn, instances, gradient);
                     }
                 }
+                else {
+                    ScopedPhase phase(Phase::GRADIENT);
+                    parallelGradient.addGradient(nn, loadedDataSet->getInstances(), gradient);
+                }
+                ScopedPhase phase(Phase::UPDATE);
+                std::vector<double> newWeights = nn.getWeights();
+                optimizer->step(newWeights, gradient);
                 nn.setWeights(newWeights);
+                steps++;
+            }
+            else if (descentType == "lbfgs") {
+                // One L-BFGS iteration, with its line search, over the whole data set
+                if (!lbfgs->step(objective, lbfgsWeights, lbfgsLoss, lbfgsGradient)) {
+                    nn.setWeights(lbfgsWeights);
+                    Log::info("L-BFGS cannot decrease the loss any further, stopping after " + std::to_string(lbfgs->getNumberEvaluations()) + " evaluations.");
+                    break;
+                }
+                nn.setWeights(lbfgsWeights);
+                steps++;
             }
             else {
                 Log::fatal("unknown descent type: " + descentType);
@@ -280,13 +1123,66 @@ int main(int argc, char* argv[]) {
                 exit(1);
             }
 
+            std::chrono::steady_clock::time_point evaluationStart = std::chrono::steady_clock::now();
+            AllocationCount evaluationAllocations = AllocationCounter::get();
+
             // At the end of each epoch, calculate the error over the entire
             // set of instances and print it out so we can see if we're decreasing
             // the overall error
-            double err = nn.forwardPass(dataSet.getInstances()) / dataSet.getNumberInstances();
-            double acc = nn.calculateAccuracy(dataSet.getInstances());
+            double err, acc;
+            double monitoredError;
+            std::string validationColumns;
+            {
+                ScopedPhase phase(Phase::EVALUATION);
+                if (options.stream) {
+                    evaluate(nn, *streamingDataSet, err, acc);
+                }
+                else {
+                    err = nn.forwardPass(loadedDataSet->getInstances()) / numberInstances;
+                    acc = nn.calculateAccuracy(loadedDataSet->getInstances());
+                }
+
+                // Without a held-out set the schedule and early stopping go by the training loss
+                monitoredError = err;
+                if (validationDataSet) {
+                    monitoredError = nn.forwardPass(validationDataSet->getInstances()) / validationDataSet->getNumberInstances();
+                    double validationAccuracy = nn.calculateAccuracy(validationDataSet->getInstances());
+                    validationColumns = " " + std::to_string(monitoredError) + " " + std::to_string(validationAccuracy * 100.0);
+                }
+            }
+            AllocationCount evaluationEnd = AllocationCounter::get();
             if (err < bestError) bestError = err;
-            Log::info("  " + std::to_string(bestError) + " " + std::to_string(err) + " " + std::to_string(acc * 100.0));
+            Log::info("  " + std::to_string(bestError) + " " + std::to_string(err) + " " + std::to_string(acc * 100.0) + validationColumns);
+            if (options.timing) {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                double trainingSeconds = std::chrono::duration<double>(evaluationStart - epochStart).count();
+                Log::info("  epoch " + std::to_string(i + 1) + " time: training " + std::to_string(trainingSeconds) + "s, "
+                    + std::to_string(numberInstances / trainingSeconds) + " instances/s, evaluating " + std::to_string(std::chrono::duration<double>(now - evaluationStart).count())
+                    + "s, elapsed " + std::to_string(std::chrono::duration<double>(now - trainingStart).count()) + "s");
+            }
+            if (options.profile) {
+                logPhases(i + 1, std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count(), countEdges(nn));
+            }
+            if (countAllocations) {
+                logAllocations(i + 1, evaluationAllocations - epochAllocations, steps, evaluationEnd - evaluationAllocations,
+                    numberInstances + (validationDataSet ? validationDataSet->getNumberInstances() : 0));
+            }
+
+            schedule->endEpoch(monitoredError);
+            if (earlyStopping && earlyStopping->update(i, monitoredError, nn.getWeights())) {
+                Log::info("No improvement for " + std::to_string(options.patience) + " epochs, stopping after epoch " + std::to_string(i + 1) + ".");
+                break;
+            }
+        }
+
+        if (earlyStopping && earlyStopping->getBestEpoch() >= 0) {
+            nn.setWeights(earlyStopping->getBestWeights());
+            Log::info("Restored the weights of epoch " + std::to_string(earlyStopping->getBestEpoch() + 1) + " with loss " + std::to_string(earlyStopping->getBestLoss()) + ".");
+        }
+
+        if (!options.saveModel.empty()) {
+            ModelFile::save(options.saveModel, nn, normalizer.getNumberInputs() > 0 ? &normalizer : nullptr);
+            Log::info("Saved the model to '" + options.saveModel + "'.");
         }
 
     }
@@ -295,5 +1191,6 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
+    writeTrace(options);
     return 0;
 }
\ No newline at end of file
@@ -60,4 +60,49 @@ int main(int argc, char* argv[]) {
     //numeric gradient multiple times with random
     //starting weights
     testLargeGradientsMultiInstance(xorData,  LossFunction::NONE);
+
+    //this tests the fused optimizer updates against the
+    //per weight update formulas
+    testOptimizers();
+
+    //this tests the per layer trust ratios of the
+    //LARS and LAMB optimizers
+    testLayerWiseOptimizers(xorData,  LossFunction::NONE);
+
+    //this tests the learning rate schedules and early
+    //stopping used to cut the epochs that no longer help
+    testLearningRateSchedules();
+    testEarlyStopping();
+
+    //this tests copying the network, accumulating gradients
+    //over micro-batches and the data-parallel gradient
+    testParallelGradient(xorData,  LossFunction::NONE);
+
+    //this tests the L-BFGS full batch optimizer on the
+    //Rosenbrock function and on a small neural network
+    testLBFGS(xorData,  LossFunction::NONE);
+
+    //this tests saving networks as binary model files and
+    //predicting with the memory mapped models
+    testModelFile(xorData,  LossFunction::NONE);
+
+    //this tests coalescing the requests of several threads
+    //into micro-batches for a memory mapped model
+    testInferenceBatcher(xorData,  LossFunction::NONE);
+
+    //this tests publishing new models to readers that are
+    //predicting with the current one at the same time
+    testModelHandle(xorData,  LossFunction::NONE);
+
+    //this tests saving snapshots of the weights of a network
+    //on another thread while it keeps training online
+    testSnapshotWriter(xorData,  LossFunction::NONE);
+
+    //this tests that the steps of a training session match
+    //those taken by hand and make no heap allocations
+    testTrainingSession(xorData,  LossFunction::NONE);
+
+    //this tests that every model of an ensemble trained in
+    //lockstep matches its own network and optimizer
+    testEnsemble(xorData,  LossFunction::NONE);
 }
\ No newline at end of file
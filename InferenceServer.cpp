@@ -0,0 +1,452 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <csignal>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "./util/Log.h"
+#include "./util/ThreadPool.h"
+#include "./util/LatencyHistogram.h"
+#include "./util/TraceRecorder.h"
+#include "./network/ModelFile.h"
+#include "./network/InferenceBatcher.h"
+#include "./network/ModelHandle.h"
+#include "./data/DataSet.h"
+#include "./data/Instance.h"
+
+// The wire format, in native byte order since both ends are on the same machine:
+//   request:  uint32 number of inputs, uint32 flags, the inputs as doubles
+//   response: int32 predicted class, uint32 number of outputs, the outputs as doubles
+// With the CLASS_ONLY flag the response leaves out the outputs. A request with the wrong
+// number of inputs gets the class -1 and no outputs, and the connection is closed.
+const uint32_t CLASS_ONLY = 1;
+
+// Function to display usage information
+void helpMessage() {
+    Log::info("Usage:");
+    Log::info("\t./InferenceServer serve <model file> <address> [options]");
+    Log::info("\t./InferenceServer load <address> <data set file> [options]");
+    Log::info("\t\tmodel file is a model saved by GradientDescent with --save-model");
+    Log::info("\t\taddress is 'unix:<socket path>' or 'tcp:<port>' (the server only listens on localhost)");
+    Log::info("\t\tdata set file is a '.txt' or '.bin' data set file whose instances are sent as requests");
+    Log::info("\tserve options:");
+    Log::info("\t\t--max-batch <n>          most requests run together in one micro-batch (default 64)");
+    Log::info("\t\t--max-wait <us>          longest a request waits for its micro-batch to fill up, in microseconds (default 200)");
+    Log::info("\t\t--threads <n>            threads each micro-batch is split over (default: one per hardware thread)");
+    Log::info("\t\t--report-interval <s>    seconds between the throughput and latency reports (default 10)");
+    Log::info("\t\t--watch <s>              check the model file this often and switch to a new model saved over it, without dropping requests (default 0: never)");
+    Log::info("\t\t--trace <file>           record a timeline of the requests, micro-batches and pool tasks, written as Chrome trace JSON on shutdown");
+    Log::info("\tload options:");
+    Log::info("\t\t--connections <n>        number of concurrent client connections (default 16)");
+    Log::info("\t\t--requests <n>           total number of requests sent (default 100000)");
+    Log::info("\t\t--class                  only ask for the predicted class instead of the output vector");
+}
+
+struct ServerOptions {
+    size_t maxBatch = 64;
+    int maxWait = 200;
+    int threads = 0;
+    double reportInterval = 10.0;
+    double watch = 0.0;
+    std::string trace;
+};
+
+struct LoadOptions {
+    int connections = 16;
+    size_t requests = 100000;
+    bool classOnly = false;
+};
+
+volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Opens a socket for 'unix:<path>' or 'tcp:<port>', either listening on it or connected to it
+int openSocket(const std::string& address, bool listening) {
+    int socketDescriptor = -1;
+    int result = -1;
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un socketAddress;
+        std::memset(&socketAddress, 0, sizeof(socketAddress));
+        if (path.empty() || path.size() >= sizeof(socketAddress.sun_path)) {
+            throw std::runtime_error("invalid unix socket path '" + path + "'");
+        }
+        socketAddress.sun_family = AF_UNIX;
+        std::strncpy(socketAddress.sun_path, path.c_str(), sizeof(socketAddress.sun_path) - 1);
+
+        socketDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socketDescriptor < 0) throw std::runtime_error("could not create a unix socket");
+        if (listening) {
+            // A socket file left behind by a server that did not shut down cleanly
+            unlink(path.c_str());
+            result = bind(socketDescriptor, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress));
+        }
+        else {
+            result = connect(socketDescriptor, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress));
+        }
+    }
+    else if (address.compare(0, 4, "tcp:") == 0) {
+        sockaddr_in socketAddress;
+        std::memset(&socketAddress, 0, sizeof(socketAddress));
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_port = htons(std::stoi(address.substr(4)));
+        socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+        if (socketDescriptor < 0) throw std::runtime_error("could not create a tcp socket");
+        int enable = 1;
+        if (listening) {
+            setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            result = bind(socketDescriptor, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress));
+        }
+        else {
+            // Requests are small and latency bound, so they should not wait for Nagle's algorithm
+            setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            result = connect(socketDescriptor, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress));
+        }
+    }
+    else {
+        throw std::runtime_error("unknown address '" + address + "', it should be 'unix:<path>' or 'tcp:<port>'");
+    }
+
+    if (result == 0 && listening) result = listen(socketDescriptor, SOMAXCONN);
+    if (result != 0) {
+        std::string error = std::strerror(errno);
+        close(socketDescriptor);
+        throw std::runtime_error("could not " + std::string(listening ? "listen on" : "connect to") + " '" + address + "': " + error);
+    }
+    return socketDescriptor;
+}
+
+bool readFully(int socketDescriptor, void* data, size_t size) {
+    char* position = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = recv(socketDescriptor, position, size, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) continue;
+            return false;
+        }
+        position += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool writeFully(int socketDescriptor, const void* data, size_t size) {
+    const char* position = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = send(socketDescriptor, position, size, 0);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) continue;
+            return false;
+        }
+        position += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+int argmax(const std::vector<double>& values) {
+    return std::max_element(values.begin(), values.end()) - values.begin();
+}
+
+/**
+ * The connections of the server, each served by a thread of its own that
+ * hands its requests to the batcher one at a time. Concurrency comes from
+ * many connections, which is what lets the batcher fill its micro-batches.
+ */
+class Connections {
+private:
+    std::mutex mutex;
+    std::condition_variable allClosed;
+    std::vector<int> open;
+
+public:
+    void serve(int socketDescriptor, int numberInputs, int numberOutputs, InferenceBatcher& batcher) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            open.push_back(socketDescriptor);
+        }
+        std::thread([this, socketDescriptor, numberInputs, numberOutputs, &batcher] {
+            if (TraceRecorder::isEnabled()) TraceRecorder::setThreadName("connection " + std::to_string(socketDescriptor));
+            std::vector<double> inputs(numberInputs);
+            std::vector<double> outputs(numberOutputs);
+            std::vector<char> response(2 * sizeof(uint32_t) + outputs.size() * sizeof(double));
+            uint32_t header[2];
+            while (readFully(socketDescriptor, header, sizeof(header))) {
+                int32_t predictedClass = -1;
+                uint32_t numberOutputs = 0;
+                bool valid = header[0] == inputs.size() && readFully(socketDescriptor, inputs.data(), inputs.size() * sizeof(double));
+                if (valid) {
+                    batcher.predict(inputs.data(), outputs.data());
+                    predictedClass = argmax(outputs);
+                    numberOutputs = (header[1] & CLASS_ONLY) ? 0 : outputs.size();
+                }
+                std::memcpy(response.data(), &predictedClass, sizeof(predictedClass));
+                std::memcpy(response.data() + sizeof(predictedClass), &numberOutputs, sizeof(numberOutputs));
+                std::memcpy(response.data() + 2 * sizeof(uint32_t), outputs.data(), numberOutputs * sizeof(double));
+                if (!writeFully(socketDescriptor, response.data(), 2 * sizeof(uint32_t) + numberOutputs * sizeof(double)) || !valid) break;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            open.erase(std::find(open.begin(), open.end(), socketDescriptor));
+            close(socketDescriptor);
+            if (open.empty()) allClosed.notify_all();
+        }).detach();
+    }
+
+    // Disconnects every client and waits for their threads to finish
+    void closeAll() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (int socketDescriptor : open) {
+            shutdown(socketDescriptor, SHUT_RDWR);
+        }
+        allClosed.wait(lock, [this] { return open.empty(); });
+    }
+};
+
+void logReport(const InferenceBatcher& batcher, uint64_t previousRequests, double seconds) {
+    uint64_t requests = batcher.getNumberRequests();
+    uint64_t batches = batcher.getNumberBatches();
+    double meanBatchSize = batches == 0 ? 0.0 : static_cast<double>(requests) / batches;
+    Log::info(std::to_string(requests) + " requests (" + std::to_string((requests - previousRequests) / seconds) + "/s) in " + std::to_string(batches)
+        + " batches (mean size " + std::to_string(meanBatchSize) + ") since starting, latency " + batcher.getLatencies().getSummary());
+}
+
+// What identifies a version of the model file: a new model is saved under a temporary name and
+// renamed over it, which gives the name a new inode
+std::string getFileVersion(const std::string& filename) {
+    struct stat status;
+    if (stat(filename.c_str(), &status) != 0) return "";
+    return std::to_string(status.st_ino) + ":" + std::to_string(status.st_size) + ":" + std::to_string(status.st_mtime);
+}
+
+// Publishes the model saved over the model file since it was last checked, if it fits the server
+void reloadModel(const std::string& modelFilename, ModelHandle& model, std::string& fileVersion) {
+    std::string latest = getFileVersion(modelFilename);
+    if (latest.empty() || latest == fileVersion) return;
+    fileVersion = latest;
+
+    std::unique_ptr<MappedModel> next;
+    try {
+        next.reset(new MappedModel(modelFilename));
+        ModelHandle::Reader serving = model.read();
+        if (next->getNumberInputs() != serving->getNumberInputs() || next->getNumberOutputs() != serving->getNumberOutputs()) {
+            throw std::runtime_error("it has " + std::to_string(next->getNumberInputs()) + " inputs and " + std::to_string(next->getNumberOutputs())
+                + " outputs instead of " + std::to_string(serving->getNumberInputs()) + " and " + std::to_string(serving->getNumberOutputs()));
+        }
+    }
+    catch (const std::exception& e) {
+        Log::error("not switching to the new model in '" + modelFilename + "': " + (std::string) e.what());
+        return;
+    }
+    model.publish(std::move(next));
+    Log::info("Switched to version " + std::to_string(model.getVersion()) + " of the model in '" + modelFilename + "'.");
+}
+
+int serve(const std::string& modelFilename, const std::string& address, const ServerOptions& options) {
+    if (!options.trace.empty()) {
+        TraceRecorder::start();
+        TraceRecorder::setThreadName("main");
+    }
+    std::string fileVersion = getFileVersion(modelFilename);
+    ModelHandle model(std::unique_ptr<MappedModel>(new MappedModel(modelFilename)));
+    int numberInputs = model.read()->getNumberInputs();
+    int numberOutputs = model.read()->getNumberOutputs();
+    ThreadPool pool(options.threads);
+    InferenceBatcher batcher(model, &pool, options.maxBatch, std::chrono::microseconds(options.maxWait));
+    Connections connections;
+
+    int listener = openSocket(address, true);
+    // The connection threads never wait on the terminal to log
+    Log::setAsynchronous(true);
+    Log::info("Serving '" + modelFilename + "' (" + std::to_string(numberInputs) + " inputs, " + std::to_string(numberOutputs)
+        + " outputs) on '" + address + "' with micro-batches of up to " + std::to_string(options.maxBatch) + " requests and " + std::to_string(options.maxWait) + "us.");
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastWatch = lastReport;
+    uint64_t reportedRequests = 0;
+    while (!stopRequested) {
+        // Waking up regularly to notice the stop signal and to report
+        pollfd listening = {listener, POLLIN, 0};
+        if (poll(&listening, 1, 100) > 0 && (listening.revents & POLLIN)) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client >= 0) {
+                int enable = 1;
+                if (address.compare(0, 4, "tcp:") == 0) setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+                connections.serve(client, numberInputs, numberOutputs, batcher);
+            }
+        }
+
+        if (options.watch > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - lastWatch).count() >= options.watch) {
+            reloadModel(modelFilename, model, fileVersion);
+            // Frees the models replaced earlier once their last batch is done
+            model.reclaim();
+            lastWatch = std::chrono::steady_clock::now();
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count();
+        if (seconds >= options.reportInterval) {
+            logReport(batcher, reportedRequests, seconds);
+            reportedRequests = batcher.getNumberRequests();
+            lastReport = std::chrono::steady_clock::now();
+        }
+    }
+
+    close(listener);
+    if (address.compare(0, 5, "unix:") == 0) unlink(address.substr(5).c_str());
+    connections.closeAll();
+    Log::info("Shutting down after serving:");
+    logReport(batcher, reportedRequests, std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count());
+    if (!options.trace.empty()) {
+        size_t numberEvents = TraceRecorder::write(options.trace);
+        Log::info("Wrote " + std::to_string(numberEvents) + " trace events to '" + options.trace + "'.");
+    }
+    return 0;
+}
+
+int generateLoad(const std::string& address, const std::string& dataSetFilename, const LoadOptions& options) {
+    DataSet dataSet("load data", dataSetFilename);
+    const std::vector<Instance>& instances = dataSet.getInstances();
+    if (instances.empty()) throw std::runtime_error("the data set '" + dataSetFilename + "' has no instances");
+    std::vector<std::vector<double>> rows;
+    for (const Instance& instance : instances) {
+        rows.push_back(instance.getInputs());
+    }
+
+    LatencyHistogram latencies;
+    std::atomic<uint64_t> correct(0);
+    std::atomic<uint64_t> failed(0);
+    std::vector<std::thread> clients;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int connection = 0; connection < options.connections; connection++) {
+        clients.push_back(std::thread([&, connection] {
+            try {
+                int socketDescriptor = openSocket(address, false);
+                std::vector<char> request(2 * sizeof(uint32_t) + rows[0].size() * sizeof(double));
+                std::vector<double> outputs;
+                uint32_t header[2] = {static_cast<uint32_t>(rows[0].size()), options.classOnly ? CLASS_ONLY : 0};
+                std::memcpy(request.data(), header, sizeof(header));
+
+                // The connections take turns over the requests, and over the instances
+                for (size_t r = connection; r < options.requests; r += options.connections) {
+                    const std::vector<double>& row = rows[r % rows.size()];
+                    std::memcpy(request.data() + sizeof(header), row.data(), row.size() * sizeof(double));
+
+                    std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+                    int32_t predictedClass;
+                    uint32_t numberOutputs;
+                    if (!writeFully(socketDescriptor, request.data(), request.size())
+                        || !readFully(socketDescriptor, &predictedClass, sizeof(predictedClass))
+                        || !readFully(socketDescriptor, &numberOutputs, sizeof(numberOutputs))) {
+                        throw std::runtime_error("the server closed the connection");
+                    }
+                    outputs.resize(numberOutputs);
+                    if (!readFully(socketDescriptor, outputs.data(), numberOutputs * sizeof(double))) {
+                        throw std::runtime_error("the server closed the connection");
+                    }
+                    latencies.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+                    if (predictedClass < 0) throw std::runtime_error("the server rejected a request of " + std::to_string(row.size()) + " inputs");
+
+                    const Instance& instance = instances[r % rows.size()];
+                    if (!instance.expectedOutputs.empty() && static_cast<int>(instance.expectedOutputs[0]) == predictedClass) correct++;
+                }
+                close(socketDescriptor);
+            }
+            catch (const std::exception& e) {
+                Log::error("connection " + std::to_string(connection) + " failed: " + (std::string) e.what());
+                failed++;
+            }
+        }));
+    }
+    for (std::thread& client : clients) {
+        client.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t completed = latencies.getCount();
+    Log::info("Completed " + std::to_string(completed) + " requests over " + std::to_string(options.connections) + " connections in "
+        + std::to_string(seconds) + "s, " + std::to_string(completed / seconds) + " requests/s.");
+    Log::info("Round trip latency " + latencies.getSummary());
+    Log::info("Accuracy of the predicted classes: " + std::to_string(completed == 0 ? 0.0 : 100.0 * correct / completed) + "%");
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        helpMessage();
+        return 1;
+    }
+
+    std::string mode = argv[1];
+    try {
+        if (mode == "serve") {
+            ServerOptions options;
+            for (int i = 4; i < argc; i++) {
+                std::string option = argv[i];
+                bool hasValue = i + 1 < argc;
+                if (option == "--max-batch" && hasValue) options.maxBatch = std::stoul(argv[++i]);
+                else if (option == "--max-wait" && hasValue) options.maxWait = std::stoi(argv[++i]);
+                else if (option == "--threads" && hasValue) options.threads = std::stoi(argv[++i]);
+                else if (option == "--report-interval" && hasValue) options.reportInterval = std::stod(argv[++i]);
+                else if (option == "--watch" && hasValue) options.watch = std::stod(argv[++i]);
+                else if (option == "--trace" && hasValue) options.trace = argv[++i];
+                else {
+                    Log::fatal("unknown or incomplete option: " + option);
+                    helpMessage();
+                    return 1;
+                }
+            }
+            return serve(argv[2], argv[3], options);
+        }
+        else if (mode == "load") {
+            LoadOptions options;
+            for (int i = 4; i < argc; i++) {
+                std::string option = argv[i];
+                bool hasValue = i + 1 < argc;
+                if (option == "--connections" && hasValue) options.connections = std::max(1, std::stoi(argv[++i]));
+                else if (option == "--requests" && hasValue) options.requests = std::stoul(argv[++i]);
+                else if (option == "--class") options.classOnly = true;
+                else {
+                    Log::fatal("unknown or incomplete option: " + option);
+                    helpMessage();
+                    return 1;
+                }
+            }
+            return generateLoad(argv[2], argv[3], options);
+        }
+        else {
+            Log::fatal("unknown mode: " + mode);
+            helpMessage();
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        Log::fatal("inference server failed: " + (std::string) e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,226 @@
+"""
+Runs complete GradientDescent trainings and reports how fast they train.
+
+For every configuration it records the instances trained per second of each
+epoch (from the --timing lines of GradientDescent) and the time it took to
+first reach a target accuracy, then prints tables of:
+  - strong scaling: the same training on more threads
+  - weak scaling: the batch size grown with the number of threads, so every
+    thread has the same amount of work
+  - width: the throughput as the hidden layers get wider
+The --tensorflow mode instead trains the configurations of benchmark_iris.py
+and benchmark_mushroom.py and compares them with the TensorFlow runs logged in
+tensorflownn_iris.txt and tensorflownn_mushroom.txt.
+
+Only the standard library is needed. Compile GradientDescent first with
+./compile_gd.sh and run from the repository root, e.g.:
+
+    python3 benchmark_training.py --data-set mushroom --threads 1,2,4,8 --epochs 5
+    python3 benchmark_training.py --tensorflow
+"""
+
+import argparse
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+
+EPOCH_PATTERN = re.compile(r"^\[INFO   \]   (\S+) (\S+) (\S+)(?: (\S+) (\S+))?$")
+TIMING_PATTERN = re.compile(r"epoch (\d+) time: training (\S+)s, (\S+) instances/s, evaluating (\S+)s, elapsed (\S+)s")
+
+# The configurations of benchmark_iris.py and benchmark_mushroom.py: two hidden layers of
+# 10 nodes, Adam with a learning rate of 0.01, minibatches of 20 and 100 epochs
+TENSORFLOW_CONFIGURATIONS = {
+    "iris": {"log": "tensorflownn_iris.txt", "batch_size": 20, "epochs": 100, "learning_rate": 0.01, "layers": [10, 10]},
+    "mushroom": {"log": "tensorflownn_mushroom.txt", "batch_size": 20, "epochs": 100, "learning_rate": 0.01, "layers": [10, 10]},
+}
+
+
+def run_training(args, data_set, threads, batch_size, layers, epochs, learning_rate=None, optimizer=None):
+    """Runs one training and returns the accuracy and timing of every epoch."""
+    command = [args.binary, data_set, args.descent, str(batch_size), args.loss, str(epochs), "0.1",
+               str(learning_rate if learning_rate is not None else args.learning_rate), "0.9",
+               optimizer or args.optimizer, "0.96", "0.0000001", "0.9", "0.999"]
+    command += [str(size) for size in layers]
+    command += ["--threads", str(threads), "--timing"] + args.extra
+    output = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if output.returncode != 0:
+        sys.exit("training failed: " + " ".join(command) + "\n" + output.stdout[-2000:])
+
+    accuracies = []
+    epochs_run = []
+    for line in output.stdout.splitlines():
+        timing = TIMING_PATTERN.search(line)
+        if timing:
+            epochs_run.append({
+                "epoch": int(timing.group(1)),
+                "training_seconds": float(timing.group(2)),
+                "instances_per_second": float(timing.group(3)),
+                "evaluation_seconds": float(timing.group(4)),
+                "elapsed_seconds": float(timing.group(5)),
+                "accuracy": accuracies[-1] if accuracies else None,
+            })
+            continue
+        epoch = EPOCH_PATTERN.match(line)
+        if epoch:
+            try:
+                accuracies.append(float(epoch.group(3)))
+            except ValueError:
+                pass
+    if not epochs_run:
+        sys.exit("no --timing lines in the output of: " + " ".join(command))
+
+    throughputs = [epoch["instances_per_second"] for epoch in epochs_run]
+    # The first epoch warms up the caches and the thread pool, so it is left out when there are others
+    steady = throughputs[1:] if len(throughputs) > 1 else throughputs
+    result = {
+        "data_set": data_set, "threads": threads, "batch_size": batch_size, "layers": layers,
+        "epochs": epochs_run,
+        "instances_per_second": statistics.median(steady),
+        "final_accuracy": epochs_run[-1]["accuracy"],
+        "time_to_target": None, "epochs_to_target": None,
+    }
+    for epoch in epochs_run:
+        if epoch["accuracy"] is not None and epoch["accuracy"] >= args.target:
+            result["time_to_target"] = epoch["elapsed_seconds"]
+            result["epochs_to_target"] = epoch["epoch"]
+            break
+    return result
+
+
+def best_of(args, *configuration, **keywords):
+    """Runs a configuration --runs times and keeps the run with the highest throughput."""
+    runs = [run_training(args, *configuration, **keywords) for _ in range(args.runs)]
+    return max(runs, key=lambda run: run["instances_per_second"])
+
+
+def format_optional(value, format_string):
+    return format_string.format(value) if value is not None else "-"
+
+
+def print_table(title, header, rows):
+    print()
+    print(title)
+    widths = [max(len(str(cell)) for cell in column) for column in zip(header, *rows)]
+    for row in [header] + rows:
+        print("  " + "  ".join(str(cell).rjust(width) for cell, width in zip(row, widths)))
+
+
+def scaling_rows(results):
+    base = results[0]
+    rows = []
+    for result in results:
+        speedup = result["instances_per_second"] / base["instances_per_second"]
+        # Either way perfect scaling keeps the throughput of each thread, so it grows with the threads
+        efficiency = speedup / (result["threads"] / base["threads"])
+        rows.append([result["threads"], result["batch_size"], "{:.0f}".format(result["instances_per_second"]), "{:.2f}".format(speedup),
+                     "{:.0%}".format(efficiency), format_optional(result["final_accuracy"], "{:.2f}"),
+                     format_optional(result["time_to_target"], "{:.3f}")])
+    return rows
+
+
+def sweep(args):
+    threads = [int(t) for t in args.threads.split(",")]
+    batch_sizes = [int(b) for b in args.batch_sizes.split(",")]
+    widths = [int(w) for w in args.widths.split(",")] if args.widths else []
+    layers = [int(size) for size in args.layers.split(",")] if args.layers else []
+    header = ["threads", "batch", "inst/s", "speedup", "efficiency", "accuracy", "to target (s)"]
+    report = {"strong_scaling": {}, "weak_scaling": [], "width": []}
+
+    for batch_size in batch_sizes:
+        results = [best_of(args, args.data_set, t, batch_size, layers, args.epochs) for t in threads]
+        report["strong_scaling"][str(batch_size)] = results
+        print_table("Strong scaling, {} minibatch({})".format(args.data_set, batch_size), header, scaling_rows(results))
+
+    if len(threads) > 1:
+        base_batch = batch_sizes[0]
+        results = [best_of(args, args.data_set, t, base_batch * t // threads[0], layers, args.epochs) for t in threads]
+        report["weak_scaling"] = results
+        print_table("Weak scaling, {} minibatch({}) per {} thread(s)".format(args.data_set, base_batch, threads[0]), header, scaling_rows(results))
+
+    if widths:
+        rows = []
+        for width in widths:
+            result = best_of(args, args.data_set, threads[-1], batch_sizes[0], [width] * max(1, len(layers)), args.epochs)
+            report["width"].append(result)
+            rows.append([width, "{:.0f}".format(result["instances_per_second"]), format_optional(result["final_accuracy"], "{:.2f}"),
+                         format_optional(result["time_to_target"], "{:.3f}")])
+        print_table("Width, {} minibatch({}) on {} thread(s)".format(args.data_set, batch_sizes[0], threads[-1]),
+                    ["width", "inst/s", "accuracy", "to target (s)"], rows)
+    return report
+
+
+def read_tensorflow_log(filename):
+    """The accuracy and seconds of every epoch of a Keras log, from its 'ms/step' lines."""
+    epochs = []
+    steps_pattern = re.compile(r"^\s*(\d+)/(\d+) \[=+\] - \S+ (\d+)(ms|s)/step - loss: \S+ - accuracy: (\S+)")
+    with open(filename, encoding="utf-8", errors="replace") as log:
+        for line in log:
+            match = steps_pattern.match(line)
+            if match and match.group(1) == match.group(2) and "val_loss" in line:
+                seconds = int(match.group(2)) * int(match.group(3)) / (1000.0 if match.group(4) == "ms" else 1.0)
+                epochs.append({"seconds": seconds, "accuracy": float(match.group(5)) * 100.0})
+    return epochs
+
+
+def compare_tensorflow(args):
+    header = ["", "epochs", "s/epoch", "final accuracy", "epochs to target", "to target (s)"]
+    report = {}
+    for data_set, configuration in TENSORFLOW_CONFIGURATIONS.items():
+        ours = best_of(args, data_set, int(args.threads.split(",")[-1]), configuration["batch_size"], configuration["layers"],
+                       configuration["epochs"], learning_rate=configuration["learning_rate"], optimizer="adam")
+        ours_seconds = statistics.median(epoch["training_seconds"] + epoch["evaluation_seconds"] for epoch in ours["epochs"])
+        rows = [["ours", len(ours["epochs"]), "{:.4f}".format(ours_seconds), format_optional(ours["final_accuracy"], "{:.2f}"),
+                 format_optional(ours["epochs_to_target"], "{}"), format_optional(ours["time_to_target"], "{:.3f}")]]
+        report[data_set] = {"ours": ours}
+
+        if os.path.exists(configuration["log"]):
+            theirs = read_tensorflow_log(configuration["log"])
+            if theirs:
+                elapsed = 0.0
+                to_target = None
+                for number, epoch in enumerate(theirs, 1):
+                    elapsed += epoch["seconds"]
+                    if to_target is None and epoch["accuracy"] >= args.target:
+                        to_target = (number, elapsed)
+                rows.append(["tensorflow", len(theirs), "{:.4f}".format(statistics.median(epoch["seconds"] for epoch in theirs)),
+                             "{:.2f}".format(theirs[-1]["accuracy"]), format_optional(to_target and to_target[0], "{}"),
+                             format_optional(to_target and to_target[1], "{:.3f}")])
+                report[data_set]["tensorflow"] = theirs
+        print_table("{} against {} (target accuracy {}%)".format(data_set, configuration["log"], args.target), header, rows)
+    print("\nThe TensorFlow times are those logged by Keras on the machine the log was made on, "
+          "and its accuracy is on the 80% of the data it trains on.")
+    return report
+
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end training throughput and scaling benchmarks of GradientDescent.")
+    parser.add_argument("--binary", default="./GradientDescent", help="the GradientDescent binary (default ./GradientDescent)")
+    parser.add_argument("--data-set", default="mushroom", help="data set name or file passed to GradientDescent (default mushroom)")
+    parser.add_argument("--descent", default="minibatch", help="gradient descent type (default minibatch)")
+    parser.add_argument("--loss", default="softmax", help="loss function (default softmax)")
+    parser.add_argument("--optimizer", default="adam", help="optimizer (default adam)")
+    parser.add_argument("--learning-rate", type=float, default=0.01, help="learning rate (default 0.01)")
+    parser.add_argument("--epochs", type=int, default=5, help="epochs of every training (default 5)")
+    parser.add_argument("--layers", default="10,10", help="comma separated hidden layer sizes (default 10,10)")
+    parser.add_argument("--threads", default="1,2,4,8", help="comma separated thread counts (default 1,2,4,8)")
+    parser.add_argument("--batch-sizes", default="100", help="comma separated batch sizes of the strong scaling tables (default 100)")
+    parser.add_argument("--widths", default="", help="comma separated widths of the hidden layers to sweep, e.g. 10,100,1000")
+    parser.add_argument("--target", type=float, default=95.0, help="accuracy in percent the time to target is measured to (default 95)")
+    parser.add_argument("--runs", type=int, default=1, help="runs of each configuration, the fastest is kept (default 1)")
+    parser.add_argument("--tensorflow", action="store_true", help="compare with the TensorFlow logs instead of sweeping")
+    parser.add_argument("--output", help="file to write every run as JSON")
+    parser.add_argument("extra", nargs="*", help="further GradientDescent options, after --")
+    args = parser.parse_args()
+
+    report = compare_tensorflow(args) if args.tensorflow else sweep(args)
+    if args.output:
+        with open(args.output, "w") as output:
+            json.dump(report, output, indent=2)
+        print("\nWrote the runs to '{}'.".format(args.output))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,150 @@
+"""
+Compares two result files of the Benchmark tool and flags regressions.
+
+The benchmarks of the baseline and the candidate are matched by topology and
+name. For each pair a Welch t-test on the repetition samples tells whether the
+difference of the means is significant, and a benchmark regresses when the
+candidate is significantly slower by more than the threshold. The tool prints
+a table of the changes and exits with 1 if anything regressed, so it can gate
+a merge:
+
+    ./Benchmark --output baseline.json           # on the base commit
+    ./Benchmark --output candidate.json          # on the change
+    python3 compare_benchmarks.py baseline.json candidate.json --threshold 5
+
+Only the standard library is needed.
+"""
+
+import argparse
+import json
+import math
+import sys
+
+
+def mean_and_variance(samples):
+    mean = sum(samples) / len(samples)
+    variance = sum((x - mean) ** 2 for x in samples) / (len(samples) - 1) if len(samples) > 1 else 0.0
+    return mean, variance
+
+
+def incomplete_beta_fraction(a, b, x):
+    """The continued fraction of the regularized incomplete beta function (Numerical Recipes' betacf)."""
+    tiny = 1e-300
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 300):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def regularized_incomplete_beta(a, b, x):
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    front = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) + a * math.log(x) + b * math.log(1.0 - x))
+    # The continued fraction converges quickly on one side of the mean of the distribution
+    if x < (a + 1.0) / (a + b + 2.0):
+        return front * incomplete_beta_fraction(a, b, x) / a
+    return 1.0 - front * incomplete_beta_fraction(b, a, 1.0 - x) / b
+
+
+def welch_test(baseline, candidate):
+    """The two-sided p-value of Welch's t-test that the two samples have the same mean."""
+    if len(baseline) < 2 or len(candidate) < 2:
+        return None
+    mean1, variance1 = mean_and_variance(baseline)
+    mean2, variance2 = mean_and_variance(candidate)
+    se1, se2 = variance1 / len(baseline), variance2 / len(candidate)
+    if se1 + se2 == 0.0:
+        return 1.0 if mean1 == mean2 else 0.0
+    t = (mean2 - mean1) / math.sqrt(se1 + se2)
+    # The Welch-Satterthwaite degrees of freedom
+    freedom = (se1 + se2) ** 2 / ((se1 ** 2 / (len(baseline) - 1) if se1 else 0.0) + (se2 ** 2 / (len(candidate) - 1) if se2 else 0.0))
+    return regularized_incomplete_beta(freedom / 2.0, 0.5, freedom / (freedom + t * t))
+
+
+def load(filename):
+    with open(filename) as results:
+        data = json.load(results)
+    return {(benchmark["topology"], benchmark["name"]): benchmark for benchmark in data["benchmarks"]}, data.get("context", {})
+
+
+def format_time(nanoseconds):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if abs(nanoseconds) >= scale:
+            return "{:.2f} {}".format(nanoseconds / scale, unit)
+    return "{:.1f} ns".format(nanoseconds)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compares a candidate Benchmark result file with a baseline and flags regressions.")
+    parser.add_argument("baseline", help="JSON results of the baseline")
+    parser.add_argument("candidate", help="JSON results of the candidate")
+    parser.add_argument("--threshold", type=float, default=5.0, help="slowdown in percent of the mean that counts as a regression (default 5)")
+    parser.add_argument("--alpha", type=float, default=0.01, help="significance level of the Welch t-test (default 0.01)")
+    parser.add_argument("--filter", default="", help="only compare the benchmarks whose topology or name contains the text")
+    parser.add_argument("--all", action="store_true", help="also list the benchmarks that did not change significantly")
+    args = parser.parse_args()
+
+    baseline, baseline_context = load(args.baseline)
+    candidate, candidate_context = load(args.candidate)
+    for key in ("compiler", "repetitions", "min_time_ms", "batch_size", "wide", "deep"):
+        if baseline_context.get(key) != candidate_context.get(key):
+            print("warning: the runs differ in {}: {} against {}".format(key, baseline_context.get(key), candidate_context.get(key)))
+
+    rows = []
+    regressions = []
+    for key in sorted(set(baseline) & set(candidate)):
+        if args.filter and args.filter not in key[0] and args.filter not in key[1]:
+            continue
+        old, new = baseline[key], candidate[key]
+        change = 100.0 * (new["mean"] - old["mean"]) / old["mean"] if old["mean"] else 0.0
+        p = welch_test(old["samples"], new["samples"])
+        significant = p is not None and p < args.alpha
+        if significant and change > args.threshold:
+            verdict = "REGRESSION"
+            regressions.append(key)
+        elif significant and change < -args.threshold:
+            verdict = "faster"
+        elif significant:
+            verdict = "changed"
+        else:
+            verdict = ""
+        if args.all or verdict:
+            rows.append([key[0], key[1], format_time(old["mean"]), format_time(new["mean"]), "{:+.1f}%".format(change),
+                         "-" if p is None else "{:.3g}".format(p), verdict])
+
+    header = ["topology", "benchmark", "baseline", "candidate", "change", "p", ""]
+    if rows:
+        widths = [max(len(str(cell)) for cell in column) for column in zip(header, *rows)]
+        for row in [header] + rows:
+            print("  ".join(str(cell).ljust(width) if i < 2 else str(cell).rjust(width) for i, (cell, width) in enumerate(zip(row, widths))).rstrip())
+    missing = sorted(set(baseline) ^ set(candidate))
+    if missing:
+        print("\nOnly in one of the files: " + ", ".join(topology + " " + name for topology, name in missing))
+
+    compared = len(set(baseline) & set(candidate))
+    print("\nCompared {} benchmarks: {} regressed by more than {}% (p < {}).".format(compared, len(regressions), args.threshold, args.alpha))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
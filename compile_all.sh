@@ -1,4 +1,9 @@
-g++ data/DataSet.cpp data/Instance.cpp network/*.cpp util/*.cpp BasicTests.cpp -o BasicTests -std=c++11
-g++ data/DataSet.cpp data/Instance.cpp network/*.cpp util/*.cpp NNTests.cpp -o NNTests -std=c++11
-g++ data/DataSet.cpp data/Instance.cpp network/*.cpp util/*.cpp GradientTests.cpp -o GradientTests -std=c++11
-g++ data/DataSet.cpp data/Instance.cpp network/*.cpp util/*.cpp GradientDescent.cpp -o GradientDescent -std=c++11
\ No newline at end of file
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp BasicTests.cpp -o BasicTests -std=c++11 -O3 -fno-math-errno -pthread
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp NNTests.cpp -o NNTests -std=c++11 -O3 -fno-math-errno -pthread
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp GradientTests.cpp -o GradientTests -std=c++11 -O3 -fno-math-errno -pthread -DCOUNT_ALLOCATIONS
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp GradientDescent.cpp -o GradientDescent -std=c++11 -O3 -fno-math-errno -pthread
+g++ data/DataSetFile.cpp util/ThreadPool.cpp util/TraceRecorder.cpp util/Log.cpp data/ConvertCsv.cpp -o ConvertCsv -std=c++11 -O3 -fno-math-errno -pthread
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp InferenceServer.cpp -o InferenceServer -std=c++11 -O3 -fno-math-errno -pthread
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp BulkScore.cpp -o BulkScore -std=c++11 -O3 -fno-math-errno -pthread
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp Benchmark.cpp -o Benchmark -std=c++11 -O3 -fno-math-errno -pthread -DCOUNT_ALLOCATIONS
+g++ data/DataSetFile.cpp util/ThreadPool.cpp util/TraceRecorder.cpp util/Log.cpp GenerateDataSet.cpp -o GenerateDataSet -std=c++11 -O3 -fno-math-errno -pthread
\ No newline at end of file
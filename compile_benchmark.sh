@@ -0,0 +1 @@
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp Benchmark.cpp -o Benchmark -std=c++11 -O3 -fno-math-errno -pthread -DCOUNT_ALLOCATIONS
\ No newline at end of file
@@ -0,0 +1 @@
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp BulkScore.cpp -o BulkScore -std=c++11 -O3 -fno-math-errno -pthread
\ No newline at end of file
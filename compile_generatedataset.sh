@@ -0,0 +1 @@
+g++ data/DataSetFile.cpp util/ThreadPool.cpp util/TraceRecorder.cpp util/Log.cpp GenerateDataSet.cpp -o GenerateDataSet -std=c++11 -O3 -fno-math-errno -pthread
\ No newline at end of file
@@ -1 +1 @@
-g++ data/DataSet.cpp data/Instance.cpp network/*.cpp util/*.cpp NNTests.cpp -o NNTests -std=c++11
\ No newline at end of file
+g++ data/DataSet.cpp data/DataSetFile.cpp data/StreamingDataSet.cpp data/Normalizer.cpp data/Instance.cpp data/InstanceStream.cpp network/*.cpp util/*.cpp NNTests.cpp -o NNTests -std=c++11 -O3 -fno-math-errno -pthread
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "ConvertCsv.h"
+#include "DataSetFile.h"
+#include "../util/Log.h"
+#include "../util/ThreadPool.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::pair<const char*, size_t> Field;
+
+// Splits a line into its (whitespace trimmed) fields without copying them
+void splitFields(const std::string& line, char delimiter, std::vector<Field>& fields) {
+    fields.clear();
+    const char* position = line.c_str();
+    const char* end = position + line.size();
+    while (true) {
+        const char* separator = static_cast<const char*>(std::memchr(position, delimiter, end - position));
+        const char* fieldEnd = separator ? separator : end;
+
+        const char* fieldBegin = position;
+        while (fieldBegin < fieldEnd && (*fieldBegin == ' ' || *fieldBegin == '\t')) fieldBegin++;
+        while (fieldEnd > fieldBegin && (fieldEnd[-1] == ' ' || fieldEnd[-1] == '\t' || fieldEnd[-1] == '\r')) fieldEnd--;
+        fields.push_back(Field(fieldBegin, fieldEnd - fieldBegin));
+
+        if (separator == nullptr) break;
+        position = separator + 1;
+    }
+}
+
+bool isSkipped(const std::string& line) {
+    return line.empty() || line[0] == '#' || line == "\r";
+}
+
+bool parseNumber(const std::string& text, double& value) {
+    if (text.empty()) return false;
+    char* parsedEnd = nullptr;
+    value = std::strtod(text.c_str(), &parsedEnd);
+    return *parsedEnd == '\0';
+}
+
+// What the first pass learns about one column from its share of the rows
+struct ColumnStatistics {
+    bool numeric = true;
+    bool overflow = false;
+    std::set<std::string> values;
+};
+
+const char* typeName(CsvColumnType type) {
+    switch (type) {
+    case CsvColumnType::NUMERIC: return "numeric";
+    case CsvColumnType::CATEGORICAL: return "categorical";
+    case CsvColumnType::LABEL: return "label";
+    default: return "ignore";
+    }
+}
+
+} // namespace
+
+ConvertCsv::ConvertCsv(const std::string& inputFilename, const std::string& outputFilename)
+    : inputFilename(inputFilename), outputFilename(outputFilename), delimiter(','), hasHeader(false), labelColumn(-1), numberThreads(0), maxCategories(1000), sparse(false) {}
+
+void ConvertCsv::setDelimiter(char newDelimiter) {
+    delimiter = newDelimiter;
+}
+
+void ConvertCsv::setHeader(bool newHasHeader) {
+    hasHeader = newHasHeader;
+}
+
+void ConvertCsv::setLabelColumn(int newLabelColumn) {
+    labelColumn = newLabelColumn;
+}
+
+void ConvertCsv::setNumberThreads(int newNumberThreads) {
+    numberThreads = newNumberThreads;
+}
+
+void ConvertCsv::setMaxCategories(size_t newMaxCategories) {
+    maxCategories = newMaxCategories;
+}
+
+void ConvertCsv::setSparse(bool newSparse) {
+    sparse = newSparse;
+}
+
+bool ConvertCsv::hasSchema() const {
+    return !columns.empty();
+}
+
+int ConvertCsv::getNumberInputs() const {
+    int numberInputs = 0;
+    for (const CsvColumn& column : columns) {
+        if (column.type == CsvColumnType::NUMERIC) numberInputs++;
+        else if (column.type == CsvColumnType::CATEGORICAL) numberInputs += column.categories.size();
+    }
+    return numberInputs;
+}
+
+void ConvertCsv::loadSchema(const std::string& schemaFilename) {
+    std::ifstream file(schemaFilename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open schema file '" + schemaFilename + "'.");
+    }
+
+    columns.clear();
+    std::string line;
+    int lineCount = 0;
+    while (std::getline(file, line)) {
+        lineCount++;
+        if (isSkipped(line)) continue;
+
+        std::istringstream lineStream(line);
+        std::string type, categories;
+        lineStream >> type >> categories;
+
+        CsvColumn column;
+        if (type == "numeric") column.type = CsvColumnType::NUMERIC;
+        else if (type == "categorical") column.type = CsvColumnType::CATEGORICAL;
+        else if (type == "label") column.type = CsvColumnType::LABEL;
+        else if (type == "ignore") column.type = CsvColumnType::IGNORE;
+        else {
+            throw std::runtime_error("Line " + std::to_string(lineCount) + " of schema file '" + schemaFilename + "' has unknown column type '" + type + "'.");
+        }
+
+        std::istringstream categoryStream(categories);
+        std::string category;
+        while (std::getline(categoryStream, category, ',')) {
+            column.categoryIndices[category] = column.categories.size();
+            column.categories.push_back(category);
+        }
+        if (column.type == CsvColumnType::CATEGORICAL && column.categories.empty()) {
+            throw std::runtime_error("Line " + std::to_string(lineCount) + " of schema file '" + schemaFilename + "' is a categorical column without categories.");
+        }
+        columns.push_back(column);
+    }
+
+    int numberLabels = 0;
+    for (const CsvColumn& column : columns) {
+        if (column.type == CsvColumnType::LABEL) numberLabels++;
+    }
+    if (numberLabels != 1) {
+        throw std::runtime_error("Schema file '" + schemaFilename + "' must have exactly one label column.");
+    }
+}
+
+void ConvertCsv::saveSchema(const std::string& schemaFilename) const {
+    std::ofstream file(schemaFilename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open schema file '" + schemaFilename + "' for writing.");
+    }
+
+    file << "# one line per CSV column: numeric, categorical <categories>, label [categories] or ignore\n";
+    for (const CsvColumn& column : columns) {
+        file << typeName(column.type);
+        for (size_t i = 0; i < column.categories.size(); ++i) {
+            file << (i == 0 ? " " : ",") << column.categories[i];
+        }
+        file << "\n";
+    }
+}
+
+void ConvertCsv::inferSchema() {
+    std::ifstream sizeFile(inputFilename, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!sizeFile.is_open()) {
+        throw std::runtime_error("Could not open CSV file '" + inputFilename + "'.");
+    }
+    size_t fileSize = static_cast<size_t>(sizeFile.tellg());
+
+    // Every thread scans the lines that start in its own byte range of the file
+    ThreadPool pool(numberThreads);
+    int threads = pool.getNumberThreads();
+    std::vector<std::vector<ColumnStatistics>> partials(threads);
+    std::vector<size_t> rowCounts(threads, 0);
+
+    pool.run([&](int thread) {
+        size_t begin = fileSize * thread / threads;
+        size_t end = fileSize * (thread + 1) / threads;
+        if (begin == end) return;
+
+        std::ifstream file(inputFilename, std::ios::in | std::ios::binary);
+        std::string line;
+        size_t position = begin;
+        if (begin > 0) {
+            // Skip the line that started in the previous thread's range
+            file.seekg(begin - 1);
+            std::getline(file, line);
+            position = begin - 1 + line.size() + 1;
+        }
+        else if (hasHeader) {
+            std::getline(file, line);
+            position = line.size() + 1;
+        }
+
+        std::vector<ColumnStatistics>& statistics = partials[thread];
+        std::vector<Field> fields;
+        std::string value;
+        double number;
+        while (position < end && std::getline(file, line)) {
+            position += line.size() + 1;
+            if (isSkipped(line)) continue;
+
+            splitFields(line, delimiter, fields);
+            if (statistics.empty()) statistics.resize(fields.size());
+            if (fields.size() != statistics.size()) {
+                throw std::runtime_error("Row '" + line + "' has " + std::to_string(fields.size()) + " columns instead of " + std::to_string(statistics.size()) + ".");
+            }
+
+            for (size_t i = 0; i < fields.size(); ++i) {
+                ColumnStatistics& column = statistics[i];
+                value.assign(fields[i].first, fields[i].second);
+                if (column.numeric && !parseNumber(value, number)) column.numeric = false;
+                if (!column.overflow) {
+                    column.values.insert(value);
+                    if (column.values.size() > maxCategories) {
+                        column.overflow = true;
+                        column.values.clear();
+                    }
+                }
+            }
+            rowCounts[thread]++;
+        }
+    });
+
+    // Merge the statistics of all the threads
+    std::vector<ColumnStatistics> merged;
+    size_t numberRows = 0;
+    for (int thread = 0; thread < threads; ++thread) {
+        numberRows += rowCounts[thread];
+        std::vector<ColumnStatistics>& statistics = partials[thread];
+        if (statistics.empty()) continue;
+        if (merged.empty()) merged.resize(statistics.size());
+        if (statistics.size() != merged.size()) {
+            throw std::runtime_error("CSV file '" + inputFilename + "' has rows with " + std::to_string(merged.size()) + " and with " + std::to_string(statistics.size()) + " columns.");
+        }
+        for (size_t i = 0; i < merged.size(); ++i) {
+            merged[i].numeric = merged[i].numeric && statistics[i].numeric;
+            merged[i].overflow = merged[i].overflow || statistics[i].overflow;
+            if (!merged[i].overflow) {
+                merged[i].values.insert(statistics[i].values.begin(), statistics[i].values.end());
+                if (merged[i].values.size() > maxCategories) merged[i].overflow = true;
+            }
+        }
+    }
+    if (merged.empty()) {
+        throw std::runtime_error("CSV file '" + inputFilename + "' has no rows.");
+    }
+
+    int label = labelColumn < 0 ? static_cast<int>(merged.size()) + labelColumn : labelColumn;
+    if (label < 0 || label >= static_cast<int>(merged.size())) {
+        throw std::runtime_error("Label column " + std::to_string(labelColumn) + " is not one of the " + std::to_string(merged.size()) + " columns.");
+    }
+
+    columns.assign(merged.size(), CsvColumn());
+    for (size_t i = 0; i < merged.size(); ++i) {
+        CsvColumn& column = columns[i];
+        if (static_cast<int>(i) == label) {
+            column.type = CsvColumnType::LABEL;
+            if (merged[i].numeric) continue; // numeric labels are used as they are
+        }
+        else if (merged[i].numeric) {
+            column.type = CsvColumnType::NUMERIC;
+            continue;
+        }
+        else {
+            column.type = CsvColumnType::CATEGORICAL;
+        }
+
+        if (merged[i].overflow) {
+            throw std::runtime_error("Column " + std::to_string(i) + " has more than " + std::to_string(maxCategories)
+                + " categories, give a schema file to ignore it or raise the limit with --max-categories.");
+        }
+        for (const std::string& category : merged[i].values) {
+            column.categoryIndices[category] = column.categories.size();
+            column.categories.push_back(category);
+        }
+    }
+
+    Log::info("Inferred the schema of " + std::to_string(columns.size()) + " columns from " + std::to_string(numberRows) + " rows using "
+        + std::to_string(threads) + " threads.");
+}
+
+void ConvertCsv::writeDataSet() {
+    std::ifstream file(inputFilename, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open CSV file '" + inputFilename + "'.");
+    }
+
+    bool binary = outputFilename.size() < 4 || outputFilename.compare(outputFilename.size() - 4, 4, ".txt") != 0;
+    int numberInputs = getNumberInputs();
+    DataSetWriter writer(outputFilename, 1, numberInputs, binary, sparse ? DataSetFormat::SPARSE : DataSetFormat::DENSE);
+
+    // One row is encoded at a time so memory use does not depend on the size of the file
+    std::vector<double> outputs(1);
+    std::vector<double> inputs(sparse ? 0 : numberInputs);
+    std::vector<int> indices;
+    double number;
+    std::vector<Field> fields;
+    std::string line;
+    std::string value;
+    size_t lineCount = 0;
+    size_t numberRows = 0;
+    size_t unknownCategories = 0;
+
+    if (hasHeader && std::getline(file, line)) lineCount++;
+    while (std::getline(file, line)) {
+        lineCount++;
+        if (isSkipped(line)) continue;
+
+        splitFields(line, delimiter, fields);
+        if (fields.size() != columns.size()) {
+            throw std::runtime_error("Line " + std::to_string(lineCount) + " has " + std::to_string(fields.size()) + " columns instead of " + std::to_string(columns.size()) + ".");
+        }
+
+        // Sparse rows only collect the nonzero inputs, in increasing order
+        if (sparse) {
+            indices.clear();
+            inputs.clear();
+        }
+        else {
+            std::fill(inputs.begin(), inputs.end(), 0.0);
+        }
+        int input = 0;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            const CsvColumn& column = columns[i];
+            if (column.type == CsvColumnType::IGNORE) continue;
+            value.assign(fields[i].first, fields[i].second);
+
+            if (column.type == CsvColumnType::NUMERIC) {
+                if (!parseNumber(value, number)) {
+                    throw std::runtime_error("Line " + std::to_string(lineCount) + " has a non numeric value '" + value + "' in numeric column " + std::to_string(i) + ".");
+                }
+                if (!sparse) inputs[input] = number;
+                else if (number != 0.0) {
+                    indices.push_back(input);
+                    inputs.push_back(number);
+                }
+                input++;
+            }
+            else if (column.type == CsvColumnType::CATEGORICAL) {
+                std::unordered_map<std::string, int>::const_iterator category = column.categoryIndices.find(value);
+                if (category == column.categoryIndices.end()) unknownCategories++;
+                else if (!sparse) inputs[input + category->second] = 1.0;
+                else {
+                    indices.push_back(input + category->second);
+                    inputs.push_back(1.0);
+                }
+                input += column.categories.size();
+            }
+            else if (column.categories.empty()) {
+                if (!parseNumber(value, outputs[0])) {
+                    throw std::runtime_error("Line " + std::to_string(lineCount) + " has a non numeric label '" + value + "'.");
+                }
+            }
+            else {
+                std::unordered_map<std::string, int>::const_iterator category = column.categoryIndices.find(value);
+                if (category == column.categoryIndices.end()) {
+                    throw std::runtime_error("Line " + std::to_string(lineCount) + " has an unknown label '" + value + "'.");
+                }
+                outputs[0] = category->second;
+            }
+        }
+
+        if (sparse) writer.write(outputs, indices, inputs);
+        else writer.write(outputs, inputs);
+        numberRows++;
+    }
+    writer.close();
+
+    if (unknownCategories > 0) {
+        Log::warning(std::to_string(unknownCategories) + " values were not in the categories of their column and were encoded as all zeros.");
+    }
+    Log::info("Wrote " + std::to_string(numberRows) + " instances with " + std::to_string(numberInputs) + " inputs to "
+        + (binary ? "binary " : "text ") + (sparse ? "sparse " : "") + "data set file '" + outputFilename + "'.");
+}
+
+void ConvertCsv::run() {
+    if (!hasSchema()) {
+        inferSchema();
+        saveSchema(outputFilename + ".schema");
+        Log::info("Saved the inferred schema to '" + outputFilename + ".schema', pass it with --schema to convert other files the same way.");
+    }
+    writeDataSet();
+}
+
+void helpMessage() {
+    Log::info("Usage:");
+    Log::info("\t./ConvertCsv <csv file> <data set file> [options]");
+    Log::info("\t\tthe data set file is written in the text format if it ends in '.txt', otherwise in the binary format");
+    Log::info("\toptions:");
+    Log::info("\t\t--schema <file>          use the column types and categories in this file instead of inferring them");
+    Log::info("\t\t--label <column>         column of the label when inferring the schema, negative counts from the end (default -1)");
+    Log::info("\t\t--header                 the first line holds the column names");
+    Log::info("\t\t--delimiter <character>  character between the columns (default ',')");
+    Log::info("\t\t--threads <n>            threads used to infer the schema (default: one per hardware thread)");
+    Log::info("\t\t--max-categories <n>     most categories a column may have when inferring the schema (default 1000)");
+    Log::info("\t\t--sparse                 only write the nonzero inputs, in the index:value sparse format");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        helpMessage();
+        return 1;
+    }
+
+    try {
+        ConvertCsv converter(argv[1], argv[2]);
+        for (int i = 3; i < argc; i++) {
+            std::string option = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (option == "--schema" && hasValue) converter.loadSchema(argv[++i]);
+            else if (option == "--label" && hasValue) converter.setLabelColumn(std::stoi(argv[++i]));
+            else if (option == "--header") converter.setHeader(true);
+            else if (option == "--delimiter" && hasValue) converter.setDelimiter(argv[++i][0]);
+            else if (option == "--threads" && hasValue) converter.setNumberThreads(std::stoi(argv[++i]));
+            else if (option == "--max-categories" && hasValue) converter.setMaxCategories(std::stoul(argv[++i]));
+            else if (option == "--sparse") converter.setSparse(true);
+            else {
+                Log::fatal("unknown or incomplete option: " + option);
+                helpMessage();
+                return 1;
+            }
+        }
+        converter.run();
+    }
+    catch (const std::exception& e) {
+        Log::fatal("conversion failed: " + (std::string) e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// ConvertCsv.h
+#ifndef CONVERT_CSV_H
+#define CONVERT_CSV_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class CsvColumnType {
+    NUMERIC,
+    CATEGORICAL,
+    LABEL,
+    IGNORE
+};
+
+struct CsvColumn {
+    CsvColumnType type;
+    // For categorical and label columns, the values in one-hot (or class number) order
+    std::vector<std::string> categories;
+    std::unordered_map<std::string, int> categoryIndices;
+};
+
+/**
+ * Converts a CSV file with numeric and categorical columns into a data set
+ * file. The schema (which columns are numeric, categorical, the label or
+ * ignored, and the categories of each) is either given in a schema file or
+ * inferred by a parallel first pass over the CSV. A second pass then streams
+ * the rows through the one-hot encoding straight into the binary (or text)
+ * data set format, so memory use does not grow with the size of the file.
+ */
+class ConvertCsv {
+private:
+    std::string inputFilename;
+    std::string outputFilename;
+    std::vector<CsvColumn> columns;
+    char delimiter;
+    bool hasHeader;
+    int labelColumn;
+    int numberThreads;
+    size_t maxCategories;
+    bool sparse;
+
+    void inferSchema();
+    void writeDataSet();
+    int getNumberInputs() const;
+
+public:
+    ConvertCsv(const std::string& inputFilename, const std::string& outputFilename);
+
+    void setDelimiter(char delimiter);
+    void setHeader(bool hasHeader);
+    // Used when inferring the schema, negative values count back from the last column
+    void setLabelColumn(int labelColumn);
+    void setNumberThreads(int numberThreads);
+    void setMaxCategories(size_t maxCategories);
+    // Writes only the nonzero inputs of each row, for wide one-hot encodings
+    void setSparse(bool sparse);
+
+    void loadSchema(const std::string& schemaFilename);
+    void saveSchema(const std::string& schemaFilename) const;
+    bool hasSchema() const;
+
+    void run();
+};
+
+#endif // CONVERT_CSV_H
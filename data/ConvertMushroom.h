@@ -1,16 +0,0 @@
-// ConvertMushroom.h
-#ifndef CONVERT_MUSHROOM_H
-#define CONVERT_MUSHROOM_H
-
-#include <vector>
-#include <string>
-
-class ConvertMushroom {
-private:
-    std::vector<std::vector<std::string>> columns;
-
-public:
-    void run();
-};
-
-#endif // CONVERT_MUSHROOM_H
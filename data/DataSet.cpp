@@ -1,115 +1,95 @@
 #include "DataSet.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <set>
-#include <cmath>
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
 #include "Instance.h"
+#include "DataSetFile.h"
 
 
-DataSet::DataSet(const std::string& name, const std::string& filename) : name(name), filename(filename), numberOutputs(-1), numberInputs(-1), numberClasses(0) {
+DataSet::DataSet(const std::string& name, const std::string& filename) : name(name), filename(filename), numberOutputs(-1), numberInputs(-1), numberClasses(0), epochPosition(0), packed(true), sparse(false) {
     std::set<double> potentialOutputs;
-    std::ifstream file(filename);
-    std::string line;
-    int lineCount = 0;
+    DataSetReader reader(filename);
 
-    if (!file.is_open()) {
+    if (!reader.isOpen()) {
         std::cerr << "ERROR opening DataSet file: '" << filename << "'" << std::endl;
         exit(1);
     }
 
-    while (getline(file, line)) {
-        lineCount++;
-        if (line.empty() || line[0] == '#') continue; // Skip empty lines and comments
-
-        size_t colonPos = line.find(':');
-        if (colonPos == std::string::npos) {
-            throw std::runtime_error("Line " + std::to_string(lineCount) + " is not properly formatted.");
-        }
-
-        std::string outputPart = line.substr(0, colonPos);
-        std::string inputPart = line.substr(colonPos + 1);
-
-        std::vector<double> outputs;
-        std::vector<double> inputs;
-
-        std::istringstream osstream(outputPart);
-        std::istringstream isstream(inputPart);
-        std::string value;
-
-        while (getline(osstream, value, ',')) {
-            outputs.push_back(std::stod(value));
+    std::vector<double> outputs;
+    std::vector<double> inputs;
+    std::vector<int> indices;
+    while (reader.read(outputs, inputs, indices)) {
+        for (double output : outputs) {
+            potentialOutputs.insert(output);
         }
 
-        while (getline(isstream, value, ',')) {
-            inputs.push_back(std::stod(value));
+        if (reader.isSparse()) {
+            // Sparse files keep only the nonzero inputs, in the CSR style indices and values
+            instances.emplace_back(outputs, indices, inputs, 0);
+            packed = false;
+            continue;
         }
+        instances.emplace_back(outputs, inputs);
 
-        if (numberOutputs == -1) {
-            numberOutputs = outputs.size();
-        }
-        else if (outputs.size() != static_cast<size_t>(numberOutputs)) {
-            throw std::runtime_error("Inconsistent number of outputs on line " + std::to_string(lineCount));
+        // Data sets with only 0/1 inputs (like one-hot encoded ones) are bit packed as they
+        // are read, until an instance turns up that is not
+        if (packed && !instances.back().pack()) {
+            packed = false;
+            for (Instance& instance : instances) {
+                instance.unpack();
+            }
         }
+    }
+    packed = packed && !instances.empty();
 
-        if (numberInputs == -1) {
-            numberInputs = inputs.size();
-        }
-        else if (inputs.size() != static_cast<size_t>(numberInputs)) {
-            throw std::runtime_error("Inconsistent number of inputs on line " + std::to_string(lineCount));
-        }
+    numberOutputs = reader.getNumberOutputs();
+    numberInputs = reader.getNumberInputs();
+    numberClasses = potentialOutputs.size();
+    sparse = reader.isSparse();
 
-        for (double output : outputs) {
-            potentialOutputs.insert(output);
+    // The number of inputs of a sparse text file is only known once all of it has been read
+    if (sparse) {
+        for (Instance& instance : instances) {
+            instance.numberInputs = numberInputs;
         }
-
-        instances.emplace_back(outputs, inputs);
     }
-
-    numberClasses = potentialOutputs.size();
 }
 
 std::vector<double> DataSet::getInputMeans() {
-    std::vector<double> inputMeans(numberInputs, 0.0);
-    for (const auto& instance : instances) {
-        for (size_t i = 0; i < instance.inputs.size(); ++i) {
-            inputMeans[i] += instance.inputs[i];
-        }
-    }
-    for (double& mean : inputMeans) {
-        mean /= instances.size();
-    }
-    return inputMeans;
+    Normalizer normalizer;
+    normalizer.fit(instances);
+    return normalizer.getMeans();
 }
 
 std::vector<double> DataSet::getInputStandardDeviations() {
-    std::vector<double> inputMeans = getInputMeans();
-    std::vector<double> inputVariances(numberInputs, 0.0);
-
-    for (const auto& instance : instances) {
-        for (size_t i = 0; i < instance.inputs.size(); ++i) {
-            inputVariances[i] += std::pow(instance.inputs[i] - inputMeans[i], 2);
-        }
-    }
-
-    for (size_t i = 0; i < inputVariances.size(); ++i) {
-        inputVariances[i] = sqrt(inputVariances[i] / (instances.size() - 1));
-    }
-
-    return inputVariances;
+    // A single Welford pass instead of a pass for the means and another for the variances
+    Normalizer normalizer;
+    normalizer.fit(instances);
+    return normalizer.getStandardDeviations();
 }
 
 void DataSet::normalize(const std::vector<double>& inputMeans, const std::vector<double>& inputStandardDeviations) {
+    packed = false;
+    sparse = false;
     for (Instance& instance : instances) {
+        instance.unpack();
         for (size_t i = 0; i < instance.inputs.size(); ++i) {
             instance.inputs[i] = (instance.inputs[i] - inputMeans[i]) / inputStandardDeviations[i];
         }
     }
 }
 
+void DataSet::normalize(const Normalizer& normalizer, ThreadPool* pool) {
+    // Normalized inputs are no longer 0/1 or mostly 0, so the Normalizer unpacks them
+    packed = false;
+    sparse = false;
+    normalizer.apply(instances, pool);
+}
+
 std::string DataSet::getName() const {
     return name;
 }
@@ -130,6 +110,14 @@ int DataSet::getNumberClasses() const {
     return numberClasses;
 }
 
+bool DataSet::isPacked() const {
+    return packed;
+}
+
+bool DataSet::isSparse() const {
+    return sparse;
+}
+
 void DataSet::shuffle() {
     std::random_shuffle(instances.begin(), instances.end());
 }
@@ -146,3 +134,36 @@ std::vector<Instance> DataSet::getInstances(int position, int numberOfInstances)
 const std::vector<Instance>& DataSet::getInstances() const {
     return instances;
 }
+
+DataSet DataSet::splitOff(double fraction) {
+    if (fraction <= 0.0 || fraction >= 1.0) {
+        throw std::runtime_error("The fraction of a data set to split off must be between 0 and 1, not " + std::to_string(fraction) + ".");
+    }
+    size_t numberSplit = static_cast<size_t>(std::round(fraction * instances.size()));
+    if (numberSplit == 0 || numberSplit == instances.size()) {
+        throw std::runtime_error("Splitting off " + std::to_string(fraction) + " of the " + std::to_string(instances.size()) + " instances of '" + name + "' would leave one part empty.");
+    }
+
+    shuffle();
+    DataSet split = *this;
+    split.name = name + " (held out)";
+    split.instances.assign(instances.end() - numberSplit, instances.end());
+    split.epochPosition = 0;
+    instances.erase(instances.end() - numberSplit, instances.end());
+    epochPosition = 0;
+    return split;
+}
+
+void DataSet::startEpoch() {
+    shuffle();
+    epochPosition = 0;
+}
+
+bool DataSet::getNextBatch(int batchSize, std::vector<Instance>& batch) {
+    if (epochPosition >= instances.size()) return false;
+
+    size_t endPosition = std::min(epochPosition + static_cast<size_t>(batchSize), instances.size());
+    batch.assign(instances.begin() + epochPosition, instances.begin() + endPosition);
+    epochPosition = endPosition;
+    return true;
+}
@@ -3,10 +3,12 @@
 #define DATASET_H
 
 #include "Instance.h"
+#include "InstanceSource.h"
+#include "Normalizer.h"
 #include <string>
 #include <vector>
 
-class DataSet {
+class DataSet : public InstanceSource {
 private:
     std::string name;
     std::string filename;
@@ -14,6 +16,9 @@ private:
     int numberOutputs;
     int numberInputs;
     int numberClasses;
+    size_t epochPosition;
+    bool packed;
+    bool sparse;
 
 public:
     // Constructor declaration
@@ -23,6 +28,7 @@ public:
     std::vector<double> getInputMeans();
     std::vector<double> getInputStandardDeviations();
     void normalize(const std::vector<double>& inputMeans, const std::vector<double>& inputStandardDeviations);
+    void normalize(const Normalizer& normalizer, ThreadPool* pool = nullptr);
 
     // Accessors
     std::string getName() const;
@@ -30,12 +36,23 @@ public:
     int getNumberInputs() const;
     int getNumberOutputs() const;
     int getNumberClasses() const;
+    // True when every instance stores its inputs bit packed
+    bool isPacked() const;
+    // True when the instances only store their nonzero inputs
+    bool isSparse() const;
 
     // Other functionalities
     void shuffle();
     Instance getInstance(int position) const;
     std::vector<Instance> getInstances(int position, int numberOfInstances) const;
     const std::vector<Instance>& getInstances() const;
+
+    // Shuffles the instances and moves the given fraction of them into a new data set, for a held-out split
+    DataSet splitOff(double fraction);
+
+    // InstanceSource: shuffles the instances and hands them out in order
+    void startEpoch();
+    bool getNextBatch(int batchSize, std::vector<Instance>& batch);
 };
 
 #endif // DATASET_H
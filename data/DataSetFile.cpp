@@ -0,0 +1,434 @@
+#include "DataSetFile.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+DataSetReader::DataSetReader(const std::string& filename, size_t chunkSize)
+    : filename(filename), file(filename, std::ios::in | std::ios::binary), buffer(chunkSize), bufferPosition(0), bufferEnd(0),
+    binary(false), sparse(false), numberOutputs(-1), numberInputs(-1), lineCount(0) {
+    if (chunkSize == 0) {
+        throw std::runtime_error("The chunk size for reading '" + filename + "' must be > 0.");
+    }
+    if (file.is_open()) {
+        readHeader();
+    }
+}
+
+void DataSetReader::readHeader() {
+    // The binary files start with a magic number, anything else is read as text
+    DataSetFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.gcount() == sizeof(header) && std::memcmp(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic)) == 0) {
+        if (header.version != DATASET_FILE_VERSION) {
+            throw std::runtime_error("Unsupported version " + std::to_string(header.version) + " of the binary data set file '" + filename + "'.");
+        }
+        if (header.format != static_cast<uint32_t>(DataSetFormat::DENSE) && header.format != static_cast<uint32_t>(DataSetFormat::SPARSE)) {
+            throw std::runtime_error("Unsupported format " + std::to_string(header.format) + " of the binary data set file '" + filename + "'.");
+        }
+        binary = true;
+        sparse = header.format == static_cast<uint32_t>(DataSetFormat::SPARSE);
+        numberOutputs = header.numberOutputs;
+        numberInputs = header.numberInputs;
+    }
+    else {
+        file.clear();
+        file.seekg(0);
+    }
+}
+
+bool DataSetReader::isOpen() const {
+    return file.is_open();
+}
+
+bool DataSetReader::isBinary() const {
+    return binary;
+}
+
+bool DataSetReader::isSparse() const {
+    return sparse;
+}
+
+int DataSetReader::getNumberOutputs() const {
+    return numberOutputs;
+}
+
+int DataSetReader::getNumberInputs() const {
+    return numberInputs;
+}
+
+void DataSetReader::rewind() {
+    file.clear();
+    file.seekg(binary ? sizeof(DataSetFileHeader) : 0);
+    bufferPosition = 0;
+    bufferEnd = 0;
+    lineCount = 0;
+}
+
+bool DataSetReader::fillBuffer() {
+    file.read(buffer.data(), buffer.size());
+    bufferPosition = 0;
+    bufferEnd = static_cast<size_t>(file.gcount());
+    return bufferEnd > 0;
+}
+
+bool DataSetReader::readLine(std::string& line) {
+    line.clear();
+    while (true) {
+        if (bufferPosition >= bufferEnd && !fillBuffer()) {
+            return !line.empty();
+        }
+
+        const char* start = buffer.data() + bufferPosition;
+        size_t available = bufferEnd - bufferPosition;
+        const char* newline = static_cast<const char*>(std::memchr(start, '\n', available));
+        if (newline == nullptr) {
+            // The line continues in the next chunk
+            line.append(start, available);
+            bufferPosition = bufferEnd;
+            continue;
+        }
+
+        line.append(start, newline - start);
+        bufferPosition += (newline - start) + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    }
+}
+
+bool DataSetReader::readBytes(char* destination, size_t numberBytes) {
+    size_t copied = 0;
+    while (copied < numberBytes) {
+        if (bufferPosition >= bufferEnd && !fillBuffer()) {
+            if (copied == 0) return false;
+            throw std::runtime_error("The binary data set file '" + filename + "' ends in the middle of an instance.");
+        }
+        size_t count = std::min(numberBytes - copied, bufferEnd - bufferPosition);
+        std::memcpy(destination + copied, buffer.data() + bufferPosition, count);
+        bufferPosition += count;
+        copied += count;
+    }
+    return true;
+}
+
+bool DataSetReader::read(std::vector<double>& outputs, std::vector<double>& inputs, std::vector<int>& indices) {
+    if (binary) {
+        outputs.resize(numberOutputs);
+        if (!readBytes(reinterpret_cast<char*>(outputs.data()), numberOutputs * sizeof(double))) return false;
+
+        bool complete = true;
+        if (sparse) {
+            uint32_t numberNonzero = 0;
+            complete = readBytes(reinterpret_cast<char*>(&numberNonzero), sizeof(numberNonzero));
+            if (complete && numberNonzero > static_cast<uint32_t>(numberInputs)) {
+                throw std::runtime_error("The binary data set file '" + filename + "' has an instance with more nonzero inputs than inputs.");
+            }
+            binaryIndices.resize(complete ? numberNonzero : 0);
+            inputs.resize(binaryIndices.size());
+            complete = complete && readBytes(reinterpret_cast<char*>(binaryIndices.data()), binaryIndices.size() * sizeof(uint32_t))
+                && readBytes(reinterpret_cast<char*>(inputs.data()), inputs.size() * sizeof(double));
+            // Checked before the conversion to int, an index past INT_MAX would turn negative
+            indices.resize(binaryIndices.size());
+            for (size_t i = 0; complete && i < binaryIndices.size(); ++i) {
+                if (binaryIndices[i] >= static_cast<uint32_t>(numberInputs)) {
+                    throw std::runtime_error("The binary data set file '" + filename + "' has an input index past its " + std::to_string(numberInputs) + " inputs.");
+                }
+                if (i > 0 && binaryIndices[i] <= binaryIndices[i - 1]) {
+                    throw std::runtime_error("The binary data set file '" + filename + "' has sparse input indices that are not increasing.");
+                }
+                indices[i] = static_cast<int>(binaryIndices[i]);
+            }
+        }
+        else {
+            indices.clear();
+            inputs.resize(numberInputs);
+            complete = readBytes(reinterpret_cast<char*>(inputs.data()), numberInputs * sizeof(double));
+        }
+        if (!complete) {
+            throw std::runtime_error("The binary data set file '" + filename + "' ends in the middle of an instance.");
+        }
+        return true;
+    }
+
+    while (readLine(line)) {
+        lineCount++;
+        bool sparseLine = false;
+        if (!parseLine(line, lineCount, outputs, inputs, indices, sparseLine)) continue;
+
+        if (numberOutputs == -1) {
+            numberOutputs = outputs.size();
+            sparse = sparseLine;
+            if (sparse) numberInputs = 0;
+        }
+        else if (outputs.size() != static_cast<size_t>(numberOutputs)) {
+            throw std::runtime_error("Inconsistent number of outputs on line " + std::to_string(lineCount));
+        }
+
+        if (sparse) {
+            // A line without any inputs is a sparse instance with no nonzero inputs
+            if (!sparseLine && !inputs.empty()) {
+                throw std::runtime_error("Line " + std::to_string(lineCount) + " has dense inputs in a sparse data set file.");
+            }
+            if (!indices.empty()) numberInputs = std::max(numberInputs, indices.back() + 1);
+        }
+        else if (sparseLine) {
+            throw std::runtime_error("Line " + std::to_string(lineCount) + " has sparse inputs in a dense data set file.");
+        }
+        else if (numberInputs == -1) {
+            numberInputs = inputs.size();
+        }
+        else if (inputs.size() != static_cast<size_t>(numberInputs)) {
+            throw std::runtime_error("Inconsistent number of inputs on line " + std::to_string(lineCount));
+        }
+        return true;
+    }
+    return false;
+}
+
+bool DataSetReader::read(std::vector<double>& outputs, std::vector<double>& inputs) {
+    std::vector<int> indices;
+    if (!read(outputs, inputs, indices)) return false;
+    if (sparse) {
+        throw std::runtime_error("'" + filename + "' is a sparse data set file, which has to be read together with the indices of the inputs.");
+    }
+    return true;
+}
+
+// Parses the comma separated values in [begin, end) into values. The line is
+// null terminated, so strtod always stops at the next ',', ':' or the end.
+static void parseValues(const char* begin, const char* end, int lineNumber, std::vector<double>& values) {
+    values.clear();
+    if (begin == end) return;
+
+    const char* position = begin;
+    while (true) {
+        const char* separator = static_cast<const char*>(std::memchr(position, ',', end - position));
+        const char* valueEnd = separator ? separator : end;
+
+        char* parsedEnd = nullptr;
+        double value = std::strtod(position, &parsedEnd);
+        while (parsedEnd < valueEnd && (*parsedEnd == ' ' || *parsedEnd == '\t')) parsedEnd++;
+        if (parsedEnd == position || parsedEnd != valueEnd) {
+            throw std::runtime_error("Line " + std::to_string(lineNumber) + " has an invalid value: '" + std::string(position, valueEnd) + "'.");
+        }
+        values.push_back(value);
+
+        if (separator == nullptr) break;
+        position = separator + 1;
+    }
+}
+
+// Parses the comma separated index:value pairs in [begin, end) of a sparse line
+static void parseSparseValues(const char* begin, const char* end, int lineNumber, std::vector<int>& indices, std::vector<double>& values) {
+    indices.clear();
+    values.clear();
+    if (begin == end) return;
+
+    const char* position = begin;
+    while (true) {
+        const char* separator = static_cast<const char*>(std::memchr(position, ',', end - position));
+        const char* valueEnd = separator ? separator : end;
+
+        char* parsedEnd = nullptr;
+        long index = std::strtol(position, &parsedEnd, 10);
+        bool valid = parsedEnd != position && parsedEnd < valueEnd && *parsedEnd == ':' && index >= 0 && index < INT_MAX;
+        double value = 0.0;
+        if (valid) {
+            const char* valueBegin = parsedEnd + 1;
+            value = std::strtod(valueBegin, &parsedEnd);
+            while (parsedEnd < valueEnd && (*parsedEnd == ' ' || *parsedEnd == '\t')) parsedEnd++;
+            valid = parsedEnd != valueBegin && parsedEnd == valueEnd;
+        }
+        if (!valid) {
+            throw std::runtime_error("Line " + std::to_string(lineNumber) + " has an invalid sparse input: '" + std::string(position, valueEnd) + "'.");
+        }
+        if (!indices.empty() && index <= indices.back()) {
+            throw std::runtime_error("Line " + std::to_string(lineNumber) + " has sparse input indices that are not increasing.");
+        }
+        indices.push_back(static_cast<int>(index));
+        values.push_back(value);
+
+        if (separator == nullptr) break;
+        position = separator + 1;
+    }
+}
+
+bool DataSetReader::parseLine(const std::string& line, int lineNumber, std::vector<double>& outputs, std::vector<double>& inputs,
+    std::vector<int>& indices, bool& sparse) {
+    if (line.empty() || line[0] == '#') return false; // Skip empty lines and comments
+
+    size_t colonPos = line.find(':');
+    if (colonPos == std::string::npos) {
+        throw std::runtime_error("Line " + std::to_string(lineNumber) + " is not properly formatted.");
+    }
+
+    const char* text = line.c_str();
+    parseValues(text, text + colonPos, lineNumber, outputs);
+
+    // Another ':' after the outputs means the inputs are index:value pairs
+    sparse = line.find(':', colonPos + 1) != std::string::npos;
+    if (sparse) {
+        parseSparseValues(text + colonPos + 1, text + line.size(), lineNumber, indices, inputs);
+    }
+    else {
+        indices.clear();
+        parseValues(text + colonPos + 1, text + line.size(), lineNumber, inputs);
+    }
+    return true;
+}
+
+DataSetWriter::DataSetWriter(const std::string& filename, int numberOutputs, int numberInputs, bool binary, DataSetFormat format)
+    : file(filename, std::ios::out | std::ios::binary | std::ios::trunc), binary(binary), format(format), numberOutputs(numberOutputs), numberInputs(numberInputs) {
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open data set file '" + filename + "' for writing.");
+    }
+
+    if (binary) {
+        DataSetFileHeader header;
+        std::memcpy(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic));
+        header.version = DATASET_FILE_VERSION;
+        header.format = static_cast<uint32_t>(format);
+        header.numberOutputs = numberOutputs;
+        header.numberInputs = numberInputs;
+        header.reserved = 0;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+}
+
+int DataSetWriter::formatValue(double value, char* text, size_t size) {
+    // Use the shortest representation that still reads back as the same double
+    int length = std::snprintf(text, size, "%.15g", value);
+    if (std::strtod(text, nullptr) != value) {
+        length = std::snprintf(text, size, "%.17g", value);
+    }
+    return length;
+}
+
+// Appends the raw bytes of values to records
+template <typename T>
+static void appendBinary(std::string& records, const T* values, size_t count) {
+    records.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+void DataSetWriter::encodeOutputs(const std::vector<double>& outputs, std::string& records) const {
+    if (outputs.size() != static_cast<size_t>(numberOutputs)) {
+        throw std::runtime_error("Cannot write an instance with " + std::to_string(outputs.size()) + " outputs to a data set with "
+            + std::to_string(numberOutputs) + " outputs.");
+    }
+
+    if (binary) {
+        appendBinary(records, outputs.data(), outputs.size());
+        return;
+    }
+
+    char value[32];
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (i > 0) records.push_back(',');
+        records.append(value, formatValue(outputs[i], value, sizeof(value)));
+    }
+    records.push_back(':');
+}
+
+void DataSetWriter::encode(const std::vector<double>& outputs, const std::vector<double>& inputs, std::string& records) const {
+    if (outputs.size() != static_cast<size_t>(numberOutputs) || inputs.size() != static_cast<size_t>(numberInputs)) {
+        throw std::runtime_error("Cannot write an instance with " + std::to_string(outputs.size()) + " outputs and " + std::to_string(inputs.size())
+            + " inputs to a data set with " + std::to_string(numberOutputs) + " outputs and " + std::to_string(numberInputs) + " inputs.");
+    }
+
+    if (format == DataSetFormat::SPARSE) {
+        std::vector<int> indices;
+        std::vector<double> values;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (inputs[i] != 0.0) {
+                indices.push_back(i);
+                values.push_back(inputs[i]);
+            }
+        }
+        encode(outputs, indices, values, records);
+        return;
+    }
+
+    encodeOutputs(outputs, records);
+    if (binary) {
+        appendBinary(records, inputs.data(), inputs.size());
+        return;
+    }
+
+    char value[32];
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (i > 0) records.push_back(',');
+        records.append(value, formatValue(inputs[i], value, sizeof(value)));
+    }
+    records.push_back('\n');
+}
+
+void DataSetWriter::encode(const std::vector<double>& outputs, const std::vector<int>& indices, const std::vector<double>& values, std::string& records) const {
+    if (indices.size() != values.size()) {
+        throw std::runtime_error("Cannot write a sparse instance with " + std::to_string(indices.size()) + " indices and " + std::to_string(values.size()) + " values.");
+    }
+    for (size_t i = 0; i < indices.size(); ++i) {
+        if (indices[i] < 0 || indices[i] >= numberInputs || (i > 0 && indices[i] <= indices[i - 1])) {
+            throw std::runtime_error("Cannot write a sparse instance with input index " + std::to_string(indices[i]) + " to a data set with "
+                + std::to_string(numberInputs) + " inputs, the indices have to be increasing.");
+        }
+    }
+
+    if (format == DataSetFormat::DENSE) {
+        std::vector<double> inputs(numberInputs, 0.0);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            inputs[indices[i]] = values[i];
+        }
+        encode(outputs, inputs, records);
+        return;
+    }
+
+    encodeOutputs(outputs, records);
+    if (binary) {
+        uint32_t numberNonzero = indices.size();
+        appendBinary(records, &numberNonzero, 1);
+        for (int index : indices) {
+            uint32_t binaryIndex = index;
+            appendBinary(records, &binaryIndex, 1);
+        }
+        appendBinary(records, values.data(), values.size());
+        return;
+    }
+
+    char value[32];
+    for (size_t i = 0; i < indices.size(); ++i) {
+        if (i > 0) records.push_back(',');
+        records.append(value, snprintf(value, sizeof(value), "%d:", indices[i]));
+        records.append(value, formatValue(values[i], value, sizeof(value)));
+    }
+    // The last input is always listed so the number of inputs survives reading the file back
+    if (numberInputs > 0 && (indices.empty() || indices.back() != numberInputs - 1)) {
+        if (!indices.empty()) records.push_back(',');
+        records.append(value, snprintf(value, sizeof(value), "%d:0", numberInputs - 1));
+    }
+    records.push_back('\n');
+}
+
+void DataSetWriter::write(const std::vector<double>& outputs, const std::vector<double>& inputs) {
+    record.clear();
+    encode(outputs, inputs, record);
+    file.write(record.data(), record.size());
+}
+
+void DataSetWriter::write(const std::vector<double>& outputs, const std::vector<int>& indices, const std::vector<double>& values) {
+    record.clear();
+    encode(outputs, indices, values, record);
+    file.write(record.data(), record.size());
+}
+
+void DataSetWriter::writeEncoded(const std::string& records) {
+    file.write(records.data(), records.size());
+    if (!file) throw std::runtime_error("Failed writing to the data set file.");
+}
+
+void DataSetWriter::close() {
+    file.close();
+}
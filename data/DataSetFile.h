@@ -0,0 +1,125 @@
+// DataSetFile.h
+#ifndef DATASET_FILE_H
+#define DATASET_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Layout of the binary data set files. A binary file starts with this
+ * header and is followed by one record per instance: numberOutputs
+ * doubles (the expected outputs) followed by numberInputs doubles
+ * (the inputs), in native byte order. In the sparse format the outputs
+ * are followed by the number of nonzero inputs as a uint32_t, their
+ * indices as uint32_ts and then their values as doubles.
+ */
+struct DataSetFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t numberOutputs;
+    uint32_t numberInputs;
+    uint32_t reserved;
+};
+
+enum class DataSetFormat {
+    DENSE = 0,
+    SPARSE = 1
+};
+
+const char DATASET_FILE_MAGIC[4] = { 'N', 'N', 'D', 'S' };
+const uint32_t DATASET_FILE_VERSION = 1;
+const size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+/**
+ * Reads instances one at a time from a data set file, either in the text
+ * format ("output1,...:input1,...", or "output1,...:index:value,index:value,..."
+ * listing only the nonzero inputs of sparse data) or in the binary format
+ * above. The file is read in fixed size chunks so only chunkSize bytes are
+ * held in memory regardless of the size of the file. The number of inputs of
+ * a sparse text file is one more than the highest index in it.
+ */
+class DataSetReader {
+private:
+    std::string filename;
+    std::ifstream file;
+    std::vector<char> buffer;
+    size_t bufferPosition;
+    size_t bufferEnd;
+    bool binary;
+    bool sparse;
+    int numberOutputs;
+    int numberInputs;
+    int lineCount;
+    std::string line;
+    std::vector<uint32_t> binaryIndices;
+
+    bool fillBuffer();
+    bool readLine(std::string& line);
+    bool readBytes(char* destination, size_t numberBytes);
+    void readHeader();
+
+public:
+    DataSetReader(const std::string& filename, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    bool isOpen() const;
+    bool isBinary() const;
+    // Known from the header of binary files and from the first instance of text files
+    bool isSparse() const;
+    int getNumberOutputs() const;
+    int getNumberInputs() const;
+
+    // Starts reading again from the first instance in the file
+    void rewind();
+
+    // Reads the next instance, returns false once the end of the file is reached. For
+    // sparse files inputs holds the nonzero values and indices their positions.
+    bool read(std::vector<double>& outputs, std::vector<double>& inputs, std::vector<int>& indices);
+
+    // Reads the next instance of a dense file
+    bool read(std::vector<double>& outputs, std::vector<double>& inputs);
+
+    // Parses one line of the text format, returns false for empty lines and comments. Sets
+    // sparse when the inputs are given as index:value pairs, which are put in indices and inputs.
+    static bool parseLine(const std::string& line, int lineNumber, std::vector<double>& outputs, std::vector<double>& inputs,
+        std::vector<int>& indices, bool& sparse);
+};
+
+/**
+ * Writes instances to a data set file in either the text or the binary format,
+ * dense or sparse. Sparse text files always list the last input, even when it
+ * is 0, so the number of inputs is the same when the file is read back.
+ */
+class DataSetWriter {
+private:
+    std::ofstream file;
+    bool binary;
+    DataSetFormat format;
+    int numberOutputs;
+    int numberInputs;
+    std::string record;
+
+    void encodeOutputs(const std::vector<double>& outputs, std::string& records) const;
+
+public:
+    // Writes value in the text format into text, returns the number of characters
+    static int formatValue(double value, char* text, size_t size);
+
+    DataSetWriter(const std::string& filename, int numberOutputs, int numberInputs, bool binary, DataSetFormat format = DataSetFormat::DENSE);
+
+    // Writes an instance given by all of its inputs, only the nonzero ones go to a sparse file
+    void write(const std::vector<double>& outputs, const std::vector<double>& inputs);
+    // Writes an instance given by the increasing indices and values of its nonzero inputs
+    void write(const std::vector<double>& outputs, const std::vector<int>& indices, const std::vector<double>& values);
+
+    // Append the bytes write would write for an instance to records instead, so several threads
+    // can encode the instances of one file that is then written in order with writeEncoded
+    void encode(const std::vector<double>& outputs, const std::vector<double>& inputs, std::string& records) const;
+    void encode(const std::vector<double>& outputs, const std::vector<int>& indices, const std::vector<double>& values, std::string& records) const;
+    void writeEncoded(const std::string& records);
+    void close();
+};
+
+#endif // DATASET_FILE_H
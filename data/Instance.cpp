@@ -1,22 +1,109 @@
 #include "Instance.h"
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <sstream>
 
 // Constructor that takes vectors for inputs and expected outputs
 Instance::Instance(const std::vector<double>& expectedOutputs, const std::vector<double>& inputs)
-    : expectedOutputs(expectedOutputs), inputs(inputs) {}
+    : expectedOutputs(expectedOutputs), inputs(inputs), storage(InputStorage::DENSE), numberInputs(0) {}
+
+// Constructor for a sparse instance, given by the indices and values of its nonzero inputs
+Instance::Instance(const std::vector<double>& expectedOutputs, const std::vector<int>& sparseIndices, const std::vector<double>& sparseValues, int numberInputs)
+    : expectedOutputs(expectedOutputs), sparseIndices(sparseIndices), sparseValues(sparseValues), storage(InputStorage::SPARSE), numberInputs(numberInputs) {}
+
+// Switches to bit packed storage if every input is 0 or 1, returns whether it did
+bool Instance::pack() {
+    if (storage != InputStorage::DENSE) return isPacked();
+    if (!isBinary(inputs)) return false;
+
+    numberInputs = inputs.size();
+    packedInputs.assign((inputs.size() + 63) / 64, 0);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i] != 0.0) packedInputs[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    // Release the dense storage rather than only clearing it
+    std::vector<double>().swap(inputs);
+    storage = InputStorage::PACKED;
+    return true;
+}
+
+bool Instance::isPacked() const {
+    return storage == InputStorage::PACKED;
+}
+
+bool Instance::isBinary(const std::vector<double>& inputs) {
+    for (double input : inputs) {
+        if (input != 0.0 && input != 1.0) return false;
+    }
+    return !inputs.empty();
+}
+
+bool Instance::isSparse() const {
+    return storage == InputStorage::SPARSE;
+}
+
+void Instance::unpack() {
+    if (storage == InputStorage::DENSE) return;
+    inputs = getInputs();
+    std::vector<uint64_t>().swap(packedInputs);
+    std::vector<int>().swap(sparseIndices);
+    std::vector<double>().swap(sparseValues);
+    storage = InputStorage::DENSE;
+    numberInputs = 0;
+}
+
+int Instance::getNumberInputs() const {
+    return storage == InputStorage::DENSE ? inputs.size() : numberInputs;
+}
+
+double Instance::getInput(int position) const {
+    switch (storage) {
+    case InputStorage::PACKED:
+        return (packedInputs[position / 64] >> (position % 64)) & 1 ? 1.0 : 0.0;
+    case InputStorage::SPARSE: {
+        std::vector<int>::const_iterator index = std::lower_bound(sparseIndices.begin(), sparseIndices.end(), position);
+        return index != sparseIndices.end() && *index == position ? sparseValues[index - sparseIndices.begin()] : 0.0;
+    }
+    default:
+        return inputs[position];
+    }
+}
+
+std::vector<double> Instance::getInputs() const {
+    if (storage == InputStorage::DENSE) return inputs;
+
+    std::vector<double> denseInputs(numberInputs, 0.0);
+    if (storage == InputStorage::SPARSE) {
+        for (size_t i = 0; i < sparseIndices.size(); ++i) {
+            denseInputs[sparseIndices[i]] = sparseValues[i];
+        }
+        return denseInputs;
+    }
+    for (int i = 0; i < numberInputs; ++i) {
+        denseInputs[i] = getInput(i);
+    }
+    return denseInputs;
+}
 
 // Compares the expected outputs and inputs of this Instance to another set
 bool Instance::equals(const std::vector<double>& otherExpectedOutputs, const std::vector<double>& otherInputs) const {
     if (expectedOutputs != otherExpectedOutputs) return false;
-    if (inputs != otherInputs) return false;
+    if (storage == InputStorage::DENSE ? inputs != otherInputs : getInputs() != otherInputs) return false;
     return true;
 }
 
 // Compares this Instance to another Instance
 bool Instance::equals(const Instance& other) const {
-    return equals(other.expectedOutputs, other.inputs);
+    if (storage == InputStorage::PACKED && other.storage == InputStorage::PACKED) {
+        return expectedOutputs == other.expectedOutputs && numberInputs == other.numberInputs && packedInputs == other.packedInputs;
+    }
+    if (storage == InputStorage::SPARSE && other.storage == InputStorage::SPARSE) {
+        return expectedOutputs == other.expectedOutputs && numberInputs == other.numberInputs
+            && sparseIndices == other.sparseIndices && sparseValues == other.sparseValues;
+    }
+    return equals(other.expectedOutputs, other.getInputs());
 }
 
 // Generates a readable string representation of this Instance
@@ -31,11 +118,20 @@ std::string Instance::toString() const {
 
     oss << " : ";
 
-    for (size_t i = 0; i < inputs.size(); ++i) {
-        if (i > 0) oss << ",";
-        oss << inputs[i];
+    if (storage == InputStorage::SPARSE) {
+        // Only the nonzero inputs, in the index:value form of the sparse text format
+        for (size_t i = 0; i < sparseIndices.size(); ++i) {
+            if (i > 0) oss << ",";
+            oss << sparseIndices[i] << ":" << sparseValues[i];
+        }
+    }
+    else {
+        for (int i = 0; i < getNumberInputs(); ++i) {
+            if (i > 0) oss << ",";
+            oss << getInput(i);
+        }
     }
 
     oss << "]";
     return oss.str();
-}
\ No newline at end of file
+}
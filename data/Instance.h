@@ -1,16 +1,48 @@
 #ifndef INSTANCE_H
 #define INSTANCE_H
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
+enum class InputStorage {
+    DENSE,
+    PACKED,
+    SPARSE
+};
+
 class Instance {
 public:
     std::vector<double> expectedOutputs;
+    // Empty unless the inputs are stored densely
     std::vector<double> inputs;
+    // PACKED: 0/1 inputs stored 64 to a word, input i is bit i % 64 of word i / 64
+    std::vector<uint64_t> packedInputs;
+    // SPARSE: the increasing indices of the nonzero inputs and their values
+    std::vector<int> sparseIndices;
+    std::vector<double> sparseValues;
+    InputStorage storage;
+    // The number of inputs when they are not stored densely
+    int numberInputs;
 
     // Constructor declaration
     Instance(const std::vector<double>& expectedOutputs, const std::vector<double>& inputs);
+    Instance(const std::vector<double>& expectedOutputs, const std::vector<int>& sparseIndices, const std::vector<double>& sparseValues, int numberInputs);
+
+    // Bit packed storage, which is used when every input is 0 or 1
+    bool pack();
+    bool isPacked() const;
+    static bool isBinary(const std::vector<double>& inputs);
+
+    bool isSparse() const;
+
+    // Switches back to storing every input as a double
+    void unpack();
+
+    // Work with any storage
+    int getNumberInputs() const;
+    double getInput(int position) const;
+    std::vector<double> getInputs() const;
 
     // Method declarations
     bool equals(const std::vector<double>& otherExpectedOutputs, const std::vector<double>& otherInputs) const;
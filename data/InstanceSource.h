@@ -0,0 +1,24 @@
+// InstanceSource.h
+#ifndef INSTANCE_SOURCE_H
+#define INSTANCE_SOURCE_H
+
+#include "Instance.h"
+#include <vector>
+
+/**
+ * A source of training instances that hands them out in batches, one pass
+ * (epoch) at a time. This lets the gradient descent loops train from a
+ * DataSet held in memory or from a StreamingDataSet read from disk.
+ */
+class InstanceSource {
+public:
+    virtual ~InstanceSource() {}
+
+    // Starts a new (shuffled) pass through the instances
+    virtual void startEpoch() = 0;
+
+    // Fills batch with up to batchSize instances, returns false once the pass is over
+    virtual bool getNextBatch(int batchSize, std::vector<Instance>& batch) = 0;
+};
+
+#endif // INSTANCE_SOURCE_H
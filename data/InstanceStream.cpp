@@ -0,0 +1,65 @@
+#include "InstanceStream.h"
+#include "DataSetFile.h"
+#include "../util/Log.h"
+#include <iostream>
+#include <stdexcept>
+
+InstanceStream::InstanceStream(const std::string& filename)
+    : filename(filename), input(&std::cin), numberInputs(-1), lineNumber(0), numberSkipped(0) {
+    if (filename != "-") {
+        // Opening a named pipe waits here until a writer opens it
+        file.open(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open the instance stream '" + filename + "'.");
+        }
+        input = &file;
+    }
+}
+
+void InstanceStream::setNumberInputs(int numberInputs) {
+    this->numberInputs = numberInputs;
+}
+
+int InstanceStream::getNumberInputs() const {
+    return numberInputs;
+}
+
+size_t InstanceStream::getNumberSkipped() const {
+    return numberSkipped;
+}
+
+bool InstanceStream::next(Instance& instance) {
+    while (std::getline(*input, line)) {
+        lineNumber++;
+        try {
+            bool sparse = false;
+            if (!DataSetReader::parseLine(line, lineNumber, outputs, inputs, indices, sparse)) continue;
+            if (outputs.empty()) {
+                throw std::runtime_error("Line " + std::to_string(lineNumber) + " has no class.");
+            }
+
+            if (sparse) {
+                if (numberInputs == -1) {
+                    throw std::runtime_error("Line " + std::to_string(lineNumber) + " has sparse inputs but the number of inputs is not known yet.");
+                }
+                if (!indices.empty() && indices.back() >= numberInputs) {
+                    throw std::runtime_error("Line " + std::to_string(lineNumber) + " has input " + std::to_string(indices.back()) + " of only " + std::to_string(numberInputs) + ".");
+                }
+                instance = Instance(outputs, indices, inputs, numberInputs);
+                return true;
+            }
+            if (numberInputs == -1) numberInputs = inputs.size();
+            if (inputs.size() != static_cast<size_t>(numberInputs)) {
+                throw std::runtime_error("Line " + std::to_string(lineNumber) + " has " + std::to_string(inputs.size()) + " inputs instead of " + std::to_string(numberInputs) + ".");
+            }
+            instance = Instance(outputs, inputs);
+            return true;
+        }
+        catch (const std::runtime_error& e) {
+            // One bad line should not stop a long running stream
+            numberSkipped++;
+            Log::warning("Skipping a line of '" + filename + "': " + (std::string) e.what());
+        }
+    }
+    return false;
+}
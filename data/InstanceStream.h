@@ -0,0 +1,47 @@
+// InstanceStream.h
+#ifndef INSTANCE_STREAM_H
+#define INSTANCE_STREAM_H
+
+#include "Instance.h"
+#include <fstream>
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * Reads labeled instances in the text data set format one line at a time,
+ * as they arrive, from standard input or a file or named pipe (FIFO).
+ * Unlike DataSetReader it does not read ahead in chunks, so each instance
+ * is handed out as soon as its line is complete, which is what online
+ * training needs. Lines that cannot be used are skipped with a warning
+ * rather than ending the stream.
+ */
+class InstanceStream {
+private:
+    std::string filename;
+    std::ifstream file;
+    std::istream* input;
+    int numberInputs;
+    int lineNumber;
+    size_t numberSkipped;
+    std::string line;
+    std::vector<double> outputs;
+    std::vector<double> inputs;
+    std::vector<int> indices;
+
+public:
+    // "-" reads standard input
+    explicit InstanceStream(const std::string& filename);
+
+    // Fixes the number of inputs, otherwise it is taken from the first dense instance.
+    // Sparse lines can only be read once it is known.
+    void setNumberInputs(int numberInputs);
+    // -1 until known
+    int getNumberInputs() const;
+    size_t getNumberSkipped() const;
+
+    // Waits for the next instance, returns false once the stream is closed
+    bool next(Instance& instance);
+};
+
+#endif // INSTANCE_STREAM_H
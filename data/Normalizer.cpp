@@ -0,0 +1,206 @@
+#include "Normalizer.h"
+#include "../util/ThreadPool.h"
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+Normalizer::Normalizer() : count(0) {}
+
+Normalizer::Normalizer(const std::vector<double>& means, const std::vector<double>& standardDeviations)
+    : count(0), means(means), standardDeviations(standardDeviations) {
+    if (means.size() != standardDeviations.size()) {
+        throw std::runtime_error("A Normalizer needs as many standard deviations (" + std::to_string(standardDeviations.size())
+            + ") as means (" + std::to_string(means.size()) + ").");
+    }
+    scales.resize(means.size());
+    for (size_t i = 0; i < scales.size(); ++i) {
+        // Constant inputs are only centered rather than divided by zero
+        scales[i] = standardDeviations[i] > 0.0 ? 1.0 / standardDeviations[i] : 1.0;
+    }
+}
+
+void Normalizer::update(const std::vector<double>& inputs) {
+    if (count == 0) {
+        means.assign(inputs.size(), 0.0);
+        sumSquaredDifferences.assign(inputs.size(), 0.0);
+    }
+    else if (inputs.size() != means.size()) {
+        throw std::runtime_error("Cannot add an instance with " + std::to_string(inputs.size()) + " inputs to a Normalizer of "
+            + std::to_string(means.size()) + " inputs.");
+    }
+
+    count++;
+    double inverseCount = 1.0 / count;
+    double* mean = means.data();
+    double* m2 = sumSquaredDifferences.data();
+    const double* x = inputs.data();
+    size_t n = inputs.size();
+    for (size_t i = 0; i < n; ++i) {
+        double difference = x[i] - mean[i];
+        mean[i] += difference * inverseCount;
+        m2[i] += difference * (x[i] - mean[i]);
+    }
+    standardDeviations.clear();
+}
+
+void Normalizer::merge(const Normalizer& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        count = other.count;
+        means = other.means;
+        sumSquaredDifferences = other.sumSquaredDifferences;
+        standardDeviations.clear();
+        return;
+    }
+    if (other.means.size() != means.size()) {
+        throw std::runtime_error("Cannot merge Normalizers of " + std::to_string(means.size()) + " and " + std::to_string(other.means.size()) + " inputs.");
+    }
+
+    double total = static_cast<double>(count + other.count);
+    double otherWeight = other.count / total;
+    double crossWeight = (static_cast<double>(count) * other.count) / total;
+    for (size_t i = 0; i < means.size(); ++i) {
+        double delta = other.means[i] - means[i];
+        means[i] += delta * otherWeight;
+        sumSquaredDifferences[i] += other.sumSquaredDifferences[i] + delta * delta * crossWeight;
+    }
+    count += other.count;
+    standardDeviations.clear();
+}
+
+void Normalizer::fit(const std::vector<Instance>& instances, ThreadPool* pool) {
+    *this = Normalizer();
+    if (pool == nullptr || pool->getNumberThreads() == 1) {
+        for (const Instance& instance : instances) {
+            if (instance.storage != InputStorage::DENSE) update(instance.getInputs());
+            else update(instance.inputs);
+        }
+        finish();
+        return;
+    }
+
+    // Each thread gathers the statistics of its own slice, which are then merged in order
+    std::vector<Normalizer> partials(pool->getNumberThreads());
+    pool->parallelFor(instances.size(), [&](size_t begin, size_t end, int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            if (instances[i].storage != InputStorage::DENSE) partials[thread].update(instances[i].getInputs());
+            else partials[thread].update(instances[i].inputs);
+        }
+    });
+    for (const Normalizer& partial : partials) {
+        merge(partial);
+    }
+    finish();
+}
+
+void Normalizer::finish() const {
+    if (sumSquaredDifferences.size() != means.size()) return;
+
+    standardDeviations.assign(means.size(), 0.0);
+    scales.assign(means.size(), 1.0);
+    for (size_t i = 0; i < means.size(); ++i) {
+        standardDeviations[i] = count > 1 ? std::sqrt(sumSquaredDifferences[i] / (count - 1)) : 0.0;
+        scales[i] = standardDeviations[i] > 0.0 ? 1.0 / standardDeviations[i] : 1.0;
+    }
+}
+
+size_t Normalizer::getCount() const {
+    return count;
+}
+
+int Normalizer::getNumberInputs() const {
+    return means.size();
+}
+
+const std::vector<double>& Normalizer::getMeans() const {
+    return means;
+}
+
+const std::vector<double>& Normalizer::getStandardDeviations() const {
+    if (standardDeviations.size() != means.size()) finish();
+    return standardDeviations;
+}
+
+void Normalizer::apply(double* inputs) const {
+    if (standardDeviations.size() != means.size()) finish();
+
+    // A single multiply-add per input over contiguous arrays, which the compiler vectorizes
+    const double* mean = means.data();
+    const double* scale = scales.data();
+    size_t n = means.size();
+    for (size_t i = 0; i < n; ++i) {
+        inputs[i] = (inputs[i] - mean[i]) * scale[i];
+    }
+}
+
+void Normalizer::apply(std::vector<double>& inputs) const {
+    if (inputs.size() != means.size()) {
+        throw std::runtime_error("Cannot normalize " + std::to_string(inputs.size()) + " inputs with a Normalizer of " + std::to_string(means.size()) + " inputs.");
+    }
+    apply(inputs.data());
+}
+
+void Normalizer::apply(std::vector<Instance>& instances, ThreadPool* pool) const {
+    getStandardDeviations();
+    if (pool == nullptr) {
+        for (Instance& instance : instances) {
+            instance.unpack();
+            apply(instance.inputs);
+        }
+        return;
+    }
+
+    pool->parallelFor(instances.size(), [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            instances[i].unpack();
+            apply(instances[i].inputs);
+        }
+    });
+}
+
+void Normalizer::save(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open normalizer file '" + filename + "' for writing.");
+    }
+
+    const std::vector<double>& deviations = getStandardDeviations();
+    file.precision(std::numeric_limits<double>::max_digits10);
+    file << "# normalizer: number of inputs, then the mean and standard deviation of each input\n";
+    file << means.size() << "\n";
+    for (size_t i = 0; i < means.size(); ++i) {
+        file << means[i] << " " << deviations[i] << "\n";
+    }
+    if (!file) {
+        throw std::runtime_error("Failed writing normalizer file '" + filename + "'.");
+    }
+}
+
+Normalizer Normalizer::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open normalizer file '" + filename + "'.");
+    }
+
+    std::string line;
+    while (std::getline(file, line) && (line.empty() || line[0] == '#')) {}
+
+    size_t numberInputs = 0;
+    std::istringstream header(line);
+    if (!(header >> numberInputs)) {
+        throw std::runtime_error("Normalizer file '" + filename + "' does not start with the number of inputs.");
+    }
+
+    std::vector<double> fileMeans(numberInputs);
+    std::vector<double> fileDeviations(numberInputs);
+    for (size_t i = 0; i < numberInputs; ++i) {
+        if (!(file >> fileMeans[i] >> fileDeviations[i])) {
+            throw std::runtime_error("Normalizer file '" + filename + "' is missing the parameters of input " + std::to_string(i) + ".");
+        }
+    }
+    return Normalizer(fileMeans, fileDeviations);
+}
@@ -0,0 +1,58 @@
+// Normalizer.h
+#ifndef NORMALIZER_H
+#define NORMALIZER_H
+
+#include "Instance.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Computes the per input means and standard deviations of a data set and
+ * applies the (x - mean) / standardDeviation transform. The statistics are
+ * gathered in a single pass with Welford's algorithm, with the partial
+ * results of each thread merged using Chan et al.'s pairwise update. The
+ * parameters can be saved and loaded so validation, test and inference data
+ * get exactly the same transform as the training data.
+ */
+class Normalizer {
+private:
+    size_t count;
+    std::vector<double> means;
+    std::vector<double> sumSquaredDifferences;
+    // Derived from sumSquaredDifferences when first needed after an update
+    mutable std::vector<double> standardDeviations;
+    mutable std::vector<double> scales;
+
+    void finish() const;
+
+public:
+    Normalizer();
+    Normalizer(const std::vector<double>& means, const std::vector<double>& standardDeviations);
+
+    // Gathers the statistics of all the instances in one (parallel) pass
+    void fit(const std::vector<Instance>& instances, ThreadPool* pool = nullptr);
+
+    // Adds one more instance to the statistics, for streaming pre-passes
+    void update(const std::vector<double>& inputs);
+
+    // Combines the statistics of another Normalizer into this one
+    void merge(const Normalizer& other);
+
+    size_t getCount() const;
+    int getNumberInputs() const;
+    const std::vector<double>& getMeans() const;
+    const std::vector<double>& getStandardDeviations() const;
+
+    // Normalizes the inputs in place
+    void apply(double* inputs) const;
+    void apply(std::vector<double>& inputs) const;
+    void apply(std::vector<Instance>& instances, ThreadPool* pool = nullptr) const;
+
+    void save(const std::string& filename) const;
+    static Normalizer load(const std::string& filename);
+};
+
+#endif // NORMALIZER_H
@@ -0,0 +1,157 @@
+#include "StreamingDataSet.h"
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../util/Log.h"
+
+StreamingDataSet::StreamingDataSet(const std::string& name, const std::string& filename, size_t shuffleBufferSize, size_t chunkSize)
+    : name(name), filename(filename), reader(filename, chunkSize), shuffleBufferSize(shuffleBufferSize), generator(std::random_device{}()),
+    shuffling(false), endOfFile(true), numberInstances(0), numberOutputs(-1), numberInputs(-1), numberClasses(0), normalizing(false), sparse(false) {
+    if (!reader.isOpen()) {
+        std::cerr << "ERROR opening DataSet file: '" << filename << "'" << std::endl;
+        exit(1);
+    }
+    if (shuffleBufferSize == 0) {
+        throw std::runtime_error("The shuffle buffer size of a streaming data set must be > 0.");
+    }
+
+    scanStatistics();
+    shuffleBuffer.reserve(shuffleBufferSize);
+}
+
+void StreamingDataSet::scanStatistics() {
+    // One pass over the file collecting the shape of the data set and the input statistics
+    std::set<double> potentialOutputs;
+
+    reader.rewind();
+    numberInstances = 0;
+    while (reader.read(outputs, inputs, indices)) {
+        // Sparse data sets are not normalized, which would fill in all of their zeros
+        if (!reader.isSparse()) statistics.update(inputs);
+        for (double output : outputs) {
+            potentialOutputs.insert(output);
+        }
+        numberInstances++;
+    }
+
+    numberOutputs = reader.getNumberOutputs();
+    numberInputs = reader.getNumberInputs();
+    numberClasses = potentialOutputs.size();
+    sparse = reader.isSparse();
+
+    Log::info("Scanned streaming data set '" + filename + "': " + std::to_string(numberInstances) + " instances, "
+        + std::to_string(numberInputs) + " inputs, " + std::to_string(numberOutputs) + " outputs.");
+}
+
+const Normalizer& StreamingDataSet::getStatistics() const {
+    return statistics;
+}
+
+std::vector<double> StreamingDataSet::getInputMeans() const {
+    return statistics.getMeans();
+}
+
+std::vector<double> StreamingDataSet::getInputStandardDeviations() const {
+    return statistics.getStandardDeviations();
+}
+
+void StreamingDataSet::normalize(const Normalizer& normalizer) {
+    if (sparse) {
+        throw std::runtime_error("The sparse streaming data set '" + filename + "' cannot be normalized.");
+    }
+    normalization = normalizer;
+    normalizing = true;
+}
+
+std::string StreamingDataSet::getName() const {
+    return name;
+}
+
+size_t StreamingDataSet::getNumberInstances() const {
+    return numberInstances;
+}
+
+int StreamingDataSet::getNumberInputs() const {
+    return numberInputs;
+}
+
+int StreamingDataSet::getNumberOutputs() const {
+    return numberOutputs;
+}
+
+int StreamingDataSet::getNumberClasses() const {
+    return numberClasses;
+}
+
+bool StreamingDataSet::isSparse() const {
+    return sparse;
+}
+
+bool StreamingDataSet::readInstance() {
+    if (endOfFile || !reader.read(outputs, inputs, indices)) {
+        endOfFile = true;
+        return false;
+    }
+
+    if (normalizing) {
+        normalization.apply(inputs);
+    }
+    return true;
+}
+
+Instance StreamingDataSet::makeInstance() const {
+    if (sparse) return Instance(outputs, indices, inputs, numberInputs);
+    return Instance(outputs, inputs);
+}
+
+void StreamingDataSet::fillShuffleBuffer() {
+    while (shuffleBuffer.size() < shuffleBufferSize && readInstance()) {
+        shuffleBuffer.push_back(makeInstance());
+    }
+}
+
+void StreamingDataSet::rewind() {
+    reader.rewind();
+    shuffleBuffer.clear();
+    shuffling = false;
+    endOfFile = false;
+}
+
+void StreamingDataSet::startEpoch() {
+    rewind();
+    shuffling = true;
+    fillShuffleBuffer();
+}
+
+bool StreamingDataSet::getNextBatch(int batchSize, std::vector<Instance>& batch) {
+    batch.clear();
+
+    if (!shuffling) {
+        while (static_cast<int>(batch.size()) < batchSize && readInstance()) {
+            batch.push_back(makeInstance());
+        }
+        return !batch.empty();
+    }
+
+    // Draw random instances from the shuffle buffer, replacing each one
+    // with the next instance from the file while there are any left
+    while (static_cast<int>(batch.size()) < batchSize && !shuffleBuffer.empty()) {
+        std::uniform_int_distribution<size_t> distribution(0, shuffleBuffer.size() - 1);
+        size_t position = distribution(generator);
+        batch.push_back(std::move(shuffleBuffer[position]));
+
+        if (readInstance()) {
+            shuffleBuffer[position] = makeInstance();
+        }
+        else {
+            if (position != shuffleBuffer.size() - 1) {
+                shuffleBuffer[position] = std::move(shuffleBuffer.back());
+            }
+            shuffleBuffer.pop_back();
+        }
+    }
+    return !batch.empty();
+}
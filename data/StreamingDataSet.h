@@ -0,0 +1,74 @@
+// StreamingDataSet.h
+#ifndef STREAMING_DATASET_H
+#define STREAMING_DATASET_H
+
+#include "Instance.h"
+#include "InstanceSource.h"
+#include "DataSetFile.h"
+#include "Normalizer.h"
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * A data set that is read from disk in fixed size chunks instead of being
+ * loaded into memory, for data sets that are larger than RAM. Each epoch
+ * re-scans the file, randomizing the order of the instances with a shuffle
+ * buffer of shuffleBufferSize instances.
+ */
+class StreamingDataSet : public InstanceSource {
+private:
+    std::string name;
+    std::string filename;
+    DataSetReader reader;
+    size_t shuffleBufferSize;
+    std::vector<Instance> shuffleBuffer;
+    std::default_random_engine generator;
+    bool shuffling;
+    bool endOfFile;
+    size_t numberInstances;
+    int numberOutputs;
+    int numberInputs;
+    int numberClasses;
+    Normalizer statistics;
+    Normalizer normalization;
+    bool normalizing;
+    bool sparse;
+    std::vector<double> outputs;
+    std::vector<double> inputs;
+    std::vector<int> indices;
+
+    void scanStatistics();
+    bool readInstance();
+    Instance makeInstance() const;
+    void fillShuffleBuffer();
+
+public:
+    StreamingDataSet(const std::string& name, const std::string& filename, size_t shuffleBufferSize, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    // Computed by a streaming pre-pass over the file when the data set is opened
+    const Normalizer& getStatistics() const;
+    std::vector<double> getInputMeans() const;
+    std::vector<double> getInputStandardDeviations() const;
+
+    // Every instance read after this is normalized as it comes off the disk, which
+    // sparse data sets do not support
+    void normalize(const Normalizer& normalizer);
+
+    // Accessors
+    std::string getName() const;
+    size_t getNumberInstances() const;
+    int getNumberInputs() const;
+    int getNumberOutputs() const;
+    int getNumberClasses() const;
+    bool isSparse() const;
+
+    // Starts a pass through the file in file order, without shuffling
+    void rewind();
+
+    // InstanceSource: re-scans the file, shuffling through the shuffle buffer
+    void startEpoch();
+    bool getNextBatch(int batchSize, std::vector<Instance>& batch);
+};
+
+#endif // STREAMING_DATASET_H
@@ -0,0 +1,36 @@
+#include "EarlyStopping.h"
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+EarlyStopping::EarlyStopping(int patience, double minimumDelta)
+    : patience(patience), minimumDelta(minimumDelta), bestLoss(std::numeric_limits<double>::infinity()), bestEpoch(-1), epochsWithoutImprovement(0) {
+    if (patience <= 0) {
+        throw std::runtime_error("the patience of early stopping must be > 0");
+    }
+}
+
+bool EarlyStopping::update(int epoch, double loss, const std::vector<double>& weights) {
+    if (loss < bestLoss - minimumDelta) {
+        bestLoss = loss;
+        bestEpoch = epoch;
+        bestWeights = weights;
+        epochsWithoutImprovement = 0;
+        return false;
+    }
+
+    epochsWithoutImprovement++;
+    return epochsWithoutImprovement >= patience;
+}
+
+double EarlyStopping::getBestLoss() const {
+    return bestLoss;
+}
+
+int EarlyStopping::getBestEpoch() const {
+    return bestEpoch;
+}
+
+const std::vector<double>& EarlyStopping::getBestWeights() const {
+    return bestWeights;
+}
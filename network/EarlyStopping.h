@@ -0,0 +1,33 @@
+// EarlyStopping.h
+#ifndef EARLY_STOPPING_H
+#define EARLY_STOPPING_H
+
+#include <vector>
+
+/**
+ * Tracks the (held-out) loss at the end of each epoch and says when
+ * training should stop because the loss has not improved by more than
+ * minimumDelta for patience epochs. The weights of the best epoch are kept
+ * so they can be restored once training stops.
+ */
+class EarlyStopping {
+private:
+    int patience;
+    double minimumDelta;
+    double bestLoss;
+    int bestEpoch;
+    int epochsWithoutImprovement;
+    std::vector<double> bestWeights;
+
+public:
+    EarlyStopping(int patience, double minimumDelta = 0.0);
+
+    // Records the loss and weights after the epoch, returns true when training should stop
+    bool update(int epoch, double loss, const std::vector<double>& weights);
+
+    double getBestLoss() const;
+    int getBestEpoch() const;
+    const std::vector<double>& getBestWeights() const;
+};
+
+#endif // EARLY_STOPPING_H
@@ -3,7 +3,7 @@
 #include <iostream>
 
 Edge::Edge(Node* inputNode, Node* outputNode) : weight(0), weightDelta(0), inputNode(inputNode), outputNode(outputNode) {
-    Log::debug("Created a new edge with input " + inputNode->toString() + " and output " + outputNode->toString());
+    LOG_DEBUG("Created a new edge with input " + inputNode->toString() + " and output " + outputNode->toString());
 }
 
 void Edge::propagateBackward(double delta) {
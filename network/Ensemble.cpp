@@ -0,0 +1,414 @@
+#include "Ensemble.h"
+#include "Edge.h"
+#include "Node.h"
+#include "../util/PhaseTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool isFullyConnected(const NeuralNetwork& nn) {
+    const std::vector<std::vector<Node>>& layers = nn.getLayers();
+    for (size_t layer = 0; layer + 1 < layers.size(); ++layer) {
+        for (const Node& node : layers[layer]) {
+            const std::vector<std::shared_ptr<Edge>>& edges = node.getOutputEdges();
+            if (edges.size() != layers[layer + 1].size()) return false;
+            for (size_t i = 0; i < edges.size(); ++i) {
+                if (edges[i]->outputNode->layer != static_cast<int>(layer) + 1 || edges[i]->outputNode->number != static_cast<int>(i)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The index of the largest output, compared the way NeuralNetwork::calculateAccuracy does
+int getLargest(const double* outputs, int numberOutputs, int stride) {
+    double maxOutput = std::numeric_limits<double>::min();
+    int predictedIndex = -1;
+    for (int i = 0; i < numberOutputs; ++i) {
+        if (outputs[i * stride] > maxOutput) {
+            maxOutput = outputs[i * stride];
+            predictedIndex = i;
+        }
+    }
+    return predictedIndex;
+}
+
+} // namespace
+
+Ensemble::Ensemble(const std::vector<NeuralNetwork>& models, std::vector<std::unique_ptr<Optimizer>> optimizers)
+    : numberModels(models.size()), optimizers(std::move(optimizers)) {
+    if (models.empty()) {
+        throw std::runtime_error("An ensemble needs at least one model.");
+    }
+    if (this->optimizers.size() != models.size()) {
+        throw std::runtime_error("An ensemble of " + std::to_string(models.size()) + " models was given " + std::to_string(this->optimizers.size()) + " optimizers.");
+    }
+    lossFunction = models[0].getLossFunction();
+    for (const std::vector<Node>& layer : models[0].getLayers()) {
+        layerSizes.push_back(layer.size());
+    }
+    for (const NeuralNetwork& model : models) {
+        if (model.getLossFunction() != lossFunction || model.getLayers().size() != layerSizes.size()) {
+            throw std::runtime_error("The models of an ensemble must have the same layers and loss function.");
+        }
+        for (size_t layer = 0; layer < layerSizes.size(); ++layer) {
+            if (model.getLayers()[layer].size() != static_cast<size_t>(layerSizes[layer])) {
+                throw std::runtime_error("The models of an ensemble must have the same layers and loss function.");
+            }
+        }
+        if (!isFullyConnected(model)) {
+            throw std::runtime_error("The models of an ensemble must be fully connected.");
+        }
+    }
+
+    // Each input node has a weight per node of the next layer, each hidden node its bias first
+    int numberLayers = layerSizes.size();
+    layerStarts.assign(1, 0);
+    weightStarts.assign(1, 0);
+    for (int layer = 0; layer < numberLayers; ++layer) {
+        layerStarts.push_back(layerStarts.back() + layerSizes[layer]);
+        size_t rowSize = 0;
+        if (layer + 1 < numberLayers) rowSize = layerSizes[layer + 1] + (layer > 0 ? 1 : 0);
+        weightStarts.push_back(weightStarts.back() + layerSizes[layer] * rowSize);
+    }
+    size_t numberWeights = weightStarts.back();
+    if (numberWeights != static_cast<size_t>(models[0].getNumberWeights())) {
+        throw std::runtime_error("The weights of the ensemble do not line up with those of its models.");
+    }
+
+    weights.assign(numberWeights * numberModels, 0.0);
+    gradient.assign(numberWeights * numberModels, 0.0);
+    outputBiases.assign(static_cast<size_t>(layerSizes.back()) * numberModels, 0.0);
+    inputs.assign(layerSizes[0], 0.0);
+    values.assign(static_cast<size_t>(layerStarts.back()) * numberModels, 0.0);
+    deltas.assign(values.size(), 0.0);
+    modelWeights.assign(numberWeights, 0.0);
+    modelGradient.assign(numberWeights, 0.0);
+    for (int model = 0; model < numberModels; ++model) {
+        setWeights(model, models[model].getWeights());
+        setOutputBiases(model, models[model].getOutputBiases());
+    }
+}
+
+int Ensemble::getNumberModels() const {
+    return numberModels;
+}
+
+size_t Ensemble::getNumberWeights() const {
+    return weightStarts.back();
+}
+
+Optimizer& Ensemble::getOptimizer(int model) {
+    return *optimizers[model];
+}
+
+void Ensemble::setInputs(const Instance& instance) {
+    if (instance.getNumberInputs() != layerSizes[0]) {
+        throw std::runtime_error("Mismatch between ensemble input layer size and instance input size.");
+    }
+    if (instance.isPacked()) {
+        std::fill(inputs.begin(), inputs.end(), 0.0);
+        for (size_t word = 0; word < instance.packedInputs.size(); ++word) {
+            uint64_t bits = instance.packedInputs[word];
+            while (bits != 0) {
+                inputs[word * 64 + __builtin_ctzll(bits)] = 1.0;
+                bits &= bits - 1;
+            }
+        }
+    }
+    else if (instance.isSparse()) {
+        std::fill(inputs.begin(), inputs.end(), 0.0);
+        for (size_t i = 0; i < instance.sparseIndices.size(); ++i) {
+            inputs[instance.sparseIndices[i]] = instance.sparseValues[i];
+        }
+    }
+    else {
+        std::copy(instance.inputs.begin(), instance.inputs.end(), inputs.begin());
+    }
+}
+
+void Ensemble::forwardPass(const Instance& instance, double* losses) {
+    const int N = numberModels;
+    int numberLayers = layerSizes.size();
+    setInputs(instance);
+    std::fill(values.begin(), values.end(), 0.0);
+
+    // The inputs scatter their weighted values into the first layer they lead to, rows of
+    // inputs that are 0 are skipped. The models of a node are summed in the order of its
+    // incoming edges, so each model gives exactly the outputs of its network.
+    size_t nextSize = static_cast<size_t>(layerSizes[1]) * N;
+    double* next = values.data() + static_cast<size_t>(layerStarts[1]) * N;
+    const double* row = weights.data();
+    for (int input = 0; input < layerSizes[0]; ++input, row += nextSize) {
+        double value = inputs[input];
+        if (value == 0.0) continue;
+        for (size_t i = 0; i < nextSize; ++i) {
+            next[i] += value * row[i];
+        }
+    }
+
+    for (int layer = 1; layer < numberLayers; ++layer) {
+        double* current = values.data() + static_cast<size_t>(layerStarts[layer]) * N;
+        if (layer + 1 == numberLayers) {
+            for (size_t i = 0; i < static_cast<size_t>(layerSizes[layer]) * N; ++i) {
+                current[i] = 1.0 / (1.0 + exp(-(current[i] + outputBiases[i])));
+            }
+            break;
+        }
+
+        next = values.data() + static_cast<size_t>(layerStarts[layer + 1]) * N;
+        int nextNodes = layerSizes[layer + 1];
+        row = weights.data() + weightStarts[layer] * N;
+        for (int node = 0; node < layerSizes[layer]; ++node, row += static_cast<size_t>(1 + nextNodes) * N) {
+            double* value = current + static_cast<size_t>(node) * N;
+            for (int m = 0; m < N; ++m) {
+                value[m] = tanh(value[m] + row[m]);
+            }
+            for (int target = 0; target < nextNodes; ++target) {
+                const double* w = row + static_cast<size_t>(1 + target) * N;
+                double* sum = next + static_cast<size_t>(target) * N;
+                for (int m = 0; m < N; ++m) {
+                    sum[m] += value[m] * w[m];
+                }
+            }
+        }
+    }
+
+    // The deltas of the outputs, the derivatives of the losses, as NeuralNetwork::forwardPass sets them
+    int numberOutputs = layerSizes.back();
+    const double* outputs = values.data() + static_cast<size_t>(layerStarts[numberLayers - 1]) * N;
+    double* outputDeltas = deltas.data() + static_cast<size_t>(layerStarts[numberLayers - 1]) * N;
+    for (int m = 0; m < N; ++m) {
+        double loss = 0.0;
+        if (lossFunction == LossFunction::NONE) {
+            for (int i = 0; i < numberOutputs; ++i) {
+                loss += outputs[i * N + m];
+                outputDeltas[i * N + m] = 1;
+            }
+        }
+        else if (lossFunction == LossFunction::SVM) {
+            int expectedIndex = static_cast<int>(instance.expectedOutputs[0]);
+            double expectedOutput = outputs[expectedIndex * N + m];
+            double deltaSum = 0.0;
+            for (int i = 0; i < numberOutputs; ++i) {
+                if (i == expectedIndex) continue;
+                double hingeLoss = std::max(0.0, outputs[i * N + m] - expectedOutput + 1);
+                loss += hingeLoss;
+                outputDeltas[i * N + m] = hingeLoss > 0 ? 1 : 0;
+                deltaSum += outputDeltas[i * N + m];
+            }
+            outputDeltas[expectedIndex * N + m] = -deltaSum;
+        }
+        else if (lossFunction == LossFunction::SOFTMAX) {
+            int expectedIndex = static_cast<int>(instance.expectedOutputs[0]);
+            double expectedExp = std::exp(outputs[expectedIndex * N + m]);
+            double totalExpSum = 0.0;
+            for (int i = 0; i < numberOutputs; ++i) {
+                totalExpSum += std::exp(outputs[i * N + m]);
+            }
+            for (int i = 0; i < numberOutputs; ++i) {
+                double softmaxProb = std::exp(outputs[i * N + m]) / totalExpSum;
+                outputDeltas[i * N + m] = (i == expectedIndex) ? (softmaxProb - 1) : softmaxProb;
+            }
+            loss = -std::log(expectedExp / totalExpSum);
+        }
+        else {
+            throw std::runtime_error("Unsupported loss function in forward pass.");
+        }
+        if (losses != nullptr) losses[m] += loss;
+    }
+}
+
+void Ensemble::backwardPass() {
+    const int N = numberModels;
+    int numberLayers = layerSizes.size();
+    std::fill(deltas.begin() + static_cast<size_t>(layerStarts[1]) * N, deltas.begin() + static_cast<size_t>(layerStarts[numberLayers - 1]) * N, 0.0);
+
+    for (int layer = numberLayers - 1; layer >= 1; --layer) {
+        // The deltas become the deltas times the derivatives of the activations
+        double* current = deltas.data() + static_cast<size_t>(layerStarts[layer]) * N;
+        const double* value = values.data() + static_cast<size_t>(layerStarts[layer]) * N;
+        size_t size = static_cast<size_t>(layerSizes[layer]) * N;
+        if (layer + 1 == numberLayers) {
+            for (size_t i = 0; i < size; ++i) current[i] *= value[i] * (1 - value[i]);
+        }
+        else {
+            for (size_t i = 0; i < size; ++i) current[i] *= 1 - value[i] * value[i];
+        }
+
+        // Each node of the previous layer gets the gradient of its row of weights and its delta
+        int previous = layer - 1;
+        size_t rowSize = static_cast<size_t>(layerSizes[layer] + (previous > 0 ? 1 : 0)) * N;
+        const double* row = weights.data() + weightStarts[previous] * N;
+        double* rowGradient = gradient.data() + weightStarts[previous] * N;
+        for (int node = 0; node < layerSizes[previous]; ++node, row += rowSize, rowGradient += rowSize) {
+            const double* w = row;
+            double* g = rowGradient;
+            if (previous == 0) {
+                double input = inputs[node];
+                if (input == 0.0) continue;
+                for (size_t i = 0; i < rowSize; ++i) {
+                    g[i] += current[i] * input;
+                }
+                continue;
+            }
+
+            double* nodeDelta = deltas.data() + static_cast<size_t>(layerStarts[previous] + node) * N;
+            const double* nodeValue = values.data() + static_cast<size_t>(layerStarts[previous] + node) * N;
+            // The bias of the node comes first in its row, its gradient is added once its delta is complete
+            w += N;
+            g += N;
+            for (int target = 0; target < layerSizes[layer]; ++target, w += N, g += N) {
+                const double* targetDelta = current + static_cast<size_t>(target) * N;
+                for (int m = 0; m < N; ++m) {
+                    g[m] += targetDelta[m] * nodeValue[m];
+                    nodeDelta[m] += w[m] * targetDelta[m];
+                }
+            }
+        }
+
+        // The biases of this layer, for a hidden layer
+        if (layer + 1 < numberLayers) {
+            double* biasGradient = gradient.data() + weightStarts[layer] * N;
+            size_t nextRowSize = static_cast<size_t>(layerSizes[layer + 1] + 1) * N;
+            for (int node = 0; node < layerSizes[layer]; ++node, biasGradient += nextRowSize) {
+                for (int m = 0; m < N; ++m) {
+                    biasGradient[m] += current[static_cast<size_t>(node) * N + m];
+                }
+            }
+        }
+    }
+}
+
+void Ensemble::step(const std::vector<Instance>& instances, size_t begin, size_t end) {
+    std::fill(gradient.begin(), gradient.end(), 0.0);
+    {
+        ScopedPhase phase(Phase::GRADIENT);
+        for (size_t i = begin; i < end; ++i) {
+            forwardPass(instances[i], nullptr);
+            backwardPass();
+        }
+    }
+
+    // Each model is stepped by its own optimizer on its own weights and gradient
+    ScopedPhase phase(Phase::UPDATE);
+    const int N = numberModels;
+    size_t numberWeights = getNumberWeights();
+    for (int m = 0; m < N; ++m) {
+        for (size_t i = 0; i < numberWeights; ++i) {
+            modelWeights[i] = weights[i * N + m];
+            modelGradient[i] = gradient[i * N + m];
+        }
+        optimizers[m]->step(modelWeights, modelGradient);
+        for (size_t i = 0; i < numberWeights; ++i) {
+            weights[i * N + m] = modelWeights[i];
+        }
+    }
+}
+
+const std::vector<double>& Ensemble::getGradient() const {
+    return gradient;
+}
+
+void Ensemble::evaluate(const std::vector<Instance>& instances, std::vector<double>& losses, std::vector<double>& accuracies, double& ensembleAccuracy) {
+    const int N = numberModels;
+    int numberOutputs = layerSizes.back();
+    losses.assign(N, 0.0);
+    accuracies.assign(N, 0.0);
+    std::vector<double> averages(numberOutputs);
+    size_t ensembleCorrect = 0;
+    for (const Instance& instance : instances) {
+        forwardPass(instance, losses.data());
+        const double* outputs = values.data() + static_cast<size_t>(layerStarts[layerSizes.size() - 1]) * N;
+        int expectedIndex = instance.expectedOutputs.empty() ? -1 : static_cast<int>(instance.expectedOutputs[0]);
+        for (int m = 0; m < N; ++m) {
+            if (getLargest(outputs + m, numberOutputs, N) == expectedIndex) accuracies[m]++;
+        }
+        for (int i = 0; i < numberOutputs; ++i) {
+            double sum = 0.0;
+            for (int m = 0; m < N; ++m) sum += outputs[i * N + m];
+            averages[i] = sum / N;
+        }
+        if (getLargest(averages.data(), numberOutputs, 1) == expectedIndex) ensembleCorrect++;
+    }
+    for (double& accuracy : accuracies) accuracy /= instances.size();
+    ensembleAccuracy = static_cast<double>(ensembleCorrect) / instances.size();
+}
+
+void Ensemble::predict(const Instance& instance, std::vector<double>& outputs) {
+    const int N = numberModels;
+    forwardPass(instance, nullptr);
+    int numberOutputs = layerSizes.back();
+    const double* modelOutputs = values.data() + static_cast<size_t>(layerStarts[layerSizes.size() - 1]) * N;
+    outputs.resize(numberOutputs);
+    for (int i = 0; i < numberOutputs; ++i) {
+        double sum = 0.0;
+        for (int m = 0; m < N; ++m) sum += modelOutputs[i * N + m];
+        outputs[i] = sum / N;
+    }
+}
+
+std::vector<double> Ensemble::predict(const Instance& instance) {
+    std::vector<double> outputs;
+    predict(instance, outputs);
+    return outputs;
+}
+
+int Ensemble::predictClass(const Instance& instance) {
+    std::vector<double> outputs = predict(instance);
+    return getLargest(outputs.data(), outputs.size(), 1);
+}
+
+void Ensemble::getWeights(int model, std::vector<double>& modelWeights) const {
+    size_t numberWeights = getNumberWeights();
+    modelWeights.resize(numberWeights);
+    for (size_t i = 0; i < numberWeights; ++i) {
+        modelWeights[i] = weights[i * numberModels + model];
+    }
+}
+
+void Ensemble::setWeights(int model, const std::vector<double>& modelWeights) {
+    size_t numberWeights = getNumberWeights();
+    if (modelWeights.size() != numberWeights) {
+        throw std::runtime_error("Cannot set " + std::to_string(modelWeights.size()) + " weights of a model of " + std::to_string(numberWeights) + " weights.");
+    }
+    for (size_t i = 0; i < numberWeights; ++i) {
+        weights[i * numberModels + model] = modelWeights[i];
+    }
+}
+
+void Ensemble::getOutputBiases(int model, std::vector<double>& modelBiases) const {
+    int numberOutputs = layerSizes.back();
+    modelBiases.resize(numberOutputs);
+    for (int i = 0; i < numberOutputs; ++i) {
+        modelBiases[i] = outputBiases[static_cast<size_t>(i) * numberModels + model];
+    }
+}
+
+void Ensemble::setOutputBiases(int model, const std::vector<double>& modelBiases) {
+    int numberOutputs = layerSizes.back();
+    if (modelBiases.size() != static_cast<size_t>(numberOutputs)) {
+        throw std::runtime_error("Cannot set " + std::to_string(modelBiases.size()) + " output biases of a model of " + std::to_string(numberOutputs) + " outputs.");
+    }
+    for (int i = 0; i < numberOutputs; ++i) {
+        outputBiases[static_cast<size_t>(i) * numberModels + model] = modelBiases[i];
+    }
+}
+
+NeuralNetwork Ensemble::toNeuralNetwork(int model) const {
+    std::vector<int> hiddenLayerSizes(layerSizes.begin() + 1, layerSizes.end() - 1);
+    NeuralNetwork nn(layerSizes[0], hiddenLayerSizes, layerSizes.back(), lossFunction);
+    nn.connectFully();
+    std::vector<double> modelWeights;
+    getWeights(model, modelWeights);
+    nn.setWeights(modelWeights);
+    std::vector<double> modelBiases;
+    getOutputBiases(model, modelBiases);
+    nn.setOutputBiases(modelBiases);
+    return nn;
+}
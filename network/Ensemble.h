@@ -0,0 +1,95 @@
+// Ensemble.h
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "NeuralNetwork.h"
+#include "LossFunction.h"
+#include "Optimizer.h"
+#include "../data/Instance.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Trains several fully connected networks of the same topology in
+ * lockstep, e.g. from different random weights or with different
+ * optimizer settings. Their weights are stored interleaved, weight i of
+ * model m at i * numberModels + m, so one pass over an instance evaluates
+ * and backpropagates every model at once, with the models of each weight
+ * side by side for the compiler to vectorize. A tiny network alone cannot
+ * keep a core busy; a few dozen of them this way can. Every model has its
+ * own optimizer and its own loss and accuracy, and the ensemble predicts
+ * with the outputs averaged over the models.
+ *
+ * The layers are those of NeuralNetwork: linear inputs, tanh hidden layers
+ * with biases and sigmoid outputs with biases. The output biases are not
+ * among the weights of a NeuralNetwork, so they are kept beside them and,
+ * as in a NeuralNetwork, not changed by the optimizers.
+ */
+class Ensemble {
+private:
+    int numberModels;
+    LossFunction lossFunction;
+    std::vector<int> layerSizes;
+    // The number of the first node of each layer, with the total at the end
+    std::vector<int> layerStarts;
+    // Where the weights of each layer start in the weights of one model, with the total at the end
+    std::vector<size_t> weightStarts;
+    // Interleaved as above, the gradient is summed over the instances of a step
+    std::vector<double> weights;
+    std::vector<double> gradient;
+    // Interleaved like the activations, output node i of model m at i * numberModels + m
+    std::vector<double> outputBiases;
+    // The inputs are the same for every model, the activations and deltas of the other
+    // layers are interleaved like the weights, node n of model m at n * numberModels + m
+    std::vector<double> inputs;
+    std::vector<double> values;
+    std::vector<double> deltas;
+    std::vector<std::unique_ptr<Optimizer>> optimizers;
+    // One model's weights and gradient, gathered for its optimizer
+    std::vector<double> modelWeights;
+    std::vector<double> modelGradient;
+
+    void setInputs(const Instance& instance);
+    // The outputs of every model for the inputs, the loss of each added to losses if not null
+    void forwardPass(const Instance& instance, double* losses);
+    // Adds the gradient of the last forward pass to the gradient
+    void backwardPass();
+
+public:
+    // The models must be fully connected and have the same layers and loss function, each
+    // optimizer is made for the number of weights of one model
+    Ensemble(const std::vector<NeuralNetwork>& models, std::vector<std::unique_ptr<Optimizer>> optimizers);
+
+    Ensemble(const Ensemble&) = delete;
+    Ensemble& operator=(const Ensemble&) = delete;
+
+    int getNumberModels() const;
+    // The number of weights of one model
+    size_t getNumberWeights() const;
+    Optimizer& getOptimizer(int model);
+
+    // Updates every model with its own optimizer and the summed gradient of the instances in [begin, end)
+    void step(const std::vector<Instance>& instances, size_t begin, size_t end);
+    // The gradient of the last step, interleaved like the weights
+    const std::vector<double>& getGradient() const;
+
+    // The summed loss and the accuracy of every model on the instances, and the accuracy of the ensemble
+    void evaluate(const std::vector<Instance>& instances, std::vector<double>& losses, std::vector<double>& accuracies, double& ensembleAccuracy);
+
+    // The outputs averaged over the models, and the index of the largest of them
+    void predict(const Instance& instance, std::vector<double>& outputs);
+    std::vector<double> predict(const Instance& instance);
+    int predictClass(const Instance& instance);
+
+    // The weights of one model in NeuralNetwork::getWeights() order
+    void getWeights(int model, std::vector<double>& modelWeights) const;
+    void setWeights(int model, const std::vector<double>& modelWeights);
+    // The biases of the output nodes of one model, as NeuralNetwork::getOutputBiases() gives them
+    void getOutputBiases(int model, std::vector<double>& modelBiases) const;
+    void setOutputBiases(int model, const std::vector<double>& modelBiases);
+    // A NeuralNetwork with the weights and output biases of one model, e.g. to save it as a model file
+    NeuralNetwork toNeuralNetwork(int model) const;
+};
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,99 @@
+#include "InferenceBatcher.h"
+#include "../util/ThreadPool.h"
+#include "../util/TraceRecorder.h"
+#include <algorithm>
+
+InferenceBatcher::InferenceBatcher(ModelHandle& model, ThreadPool* pool, size_t maxBatchSize, std::chrono::microseconds maxWait)
+    : model(model), pool(pool), maxBatchSize(std::max<size_t>(1, maxBatchSize)), maxWait(maxWait), stopping(false),
+      workspaces(pool != nullptr ? pool->getNumberThreads() : 1), numberBatches(0), numberRequests(0) {
+    worker = std::thread(&InferenceBatcher::run, this);
+}
+
+InferenceBatcher::~InferenceBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    requestAvailable.notify_one();
+    worker.join();
+}
+
+void InferenceBatcher::predict(const double* inputs, double* outputs) {
+    Request request;
+    request.inputs = inputs;
+    request.outputs = outputs;
+    request.arrival = std::chrono::steady_clock::now();
+    request.done = false;
+    // From queueing the request to its outputs being ready
+    ScopedTrace trace("request", "inference");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.push_back(&request);
+    // The batching thread only needs waking for the first request or a full batch
+    if (queue.size() == 1 || queue.size() >= maxBatchSize) requestAvailable.notify_one();
+    batchFinished.wait(lock, [&request] { return request.done; });
+}
+
+void InferenceBatcher::run() {
+    if (TraceRecorder::isEnabled()) TraceRecorder::setThreadName("batcher");
+    std::vector<Request*> batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        requestAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+
+        // Give the batch until its oldest request has waited maxWait to fill up
+        std::chrono::steady_clock::time_point deadline = queue.front()->arrival + maxWait;
+        requestAvailable.wait_until(lock, deadline, [this] { return stopping || queue.size() >= maxBatchSize; });
+
+        size_t batchSize = std::min(queue.size(), maxBatchSize);
+        batch.assign(queue.begin(), queue.begin() + batchSize);
+        queue.erase(queue.begin(), queue.begin() + batchSize);
+
+        lock.unlock();
+        runBatch(batch);
+        lock.lock();
+
+        for (Request* request : batch) {
+            request->done = true;
+        }
+        batchFinished.notify_all();
+    }
+}
+
+void InferenceBatcher::runBatch(const std::vector<Request*>& batch) {
+    int64_t begin = TraceRecorder::isEnabled() ? TraceRecorder::now() : 0;
+    ModelHandle::Reader current = model.read();
+    if (pool == nullptr || batch.size() == 1) {
+        for (Request* request : batch) {
+            current->predict(request->inputs, request->outputs, workspaces[0]);
+        }
+    }
+    else {
+        pool->parallelFor(batch.size(), [&](size_t begin, size_t end, int thread) {
+            for (size_t i = begin; i < end; ++i) {
+                current->predict(batch[i]->inputs, batch[i]->outputs, workspaces[thread]);
+            }
+        });
+    }
+
+    std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+    for (Request* request : batch) {
+        latencies.record(std::chrono::duration<double, std::micro>(finished - request->arrival).count());
+    }
+    numberBatches.fetch_add(1, std::memory_order_relaxed);
+    numberRequests.fetch_add(batch.size(), std::memory_order_relaxed);
+    if (TraceRecorder::isEnabled()) TraceRecorder::record("batch", "inference", begin, TraceRecorder::now(), "requests", batch.size());
+}
+
+const LatencyHistogram& InferenceBatcher::getLatencies() const {
+    return latencies;
+}
+
+uint64_t InferenceBatcher::getNumberBatches() const {
+    return numberBatches.load(std::memory_order_relaxed);
+}
+
+uint64_t InferenceBatcher::getNumberRequests() const {
+    return numberRequests.load(std::memory_order_relaxed);
+}
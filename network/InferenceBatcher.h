@@ -0,0 +1,77 @@
+// InferenceBatcher.h
+#ifndef INFERENCE_BATCHER_H
+#define INFERENCE_BATCHER_H
+
+#include "ModelHandle.h"
+#include "../util/LatencyHistogram.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Coalesces the prediction requests of many threads into micro-batches for
+ * the current model of a ModelHandle. A batch is run as soon as it has
+ * maxBatchSize requests or its oldest request has waited maxWait, whichever
+ * comes first, and its rows are split over the thread pool. Every batch
+ * reads the current model once, so a model published in the meantime is
+ * picked up by the next batch. predict blocks the calling
+ * thread until its outputs are filled in, so a server can simply call it
+ * from the thread of each connection.
+ */
+class InferenceBatcher {
+private:
+    struct Request {
+        const double* inputs;
+        double* outputs;
+        std::chrono::steady_clock::time_point arrival;
+        bool done;
+    };
+
+    ModelHandle& model;
+    ThreadPool* pool;
+    size_t maxBatchSize;
+    std::chrono::microseconds maxWait;
+
+    std::mutex mutex;
+    std::condition_variable requestAvailable;
+    std::condition_variable batchFinished;
+    std::deque<Request*> queue;
+    bool stopping;
+
+    std::vector<std::vector<double>> workspaces;
+    LatencyHistogram latencies;
+    std::atomic<uint64_t> numberBatches;
+    std::atomic<uint64_t> numberRequests;
+    std::thread worker;
+
+    void run();
+    void runBatch(const std::vector<Request*>& batch);
+
+public:
+    // A null pool runs every batch on the batching thread
+    InferenceBatcher(ModelHandle& model, ThreadPool* pool, size_t maxBatchSize, std::chrono::microseconds maxWait);
+    // Finishes the requests already queued before returning
+    ~InferenceBatcher();
+
+    InferenceBatcher(const InferenceBatcher&) = delete;
+    InferenceBatcher& operator=(const InferenceBatcher&) = delete;
+
+    // Fills in the current model's outputs for the (unnormalized) inputs, waiting for the batch
+    // it is put in. Every model published to the handle must have the same inputs and outputs.
+    void predict(const double* inputs, double* outputs);
+
+    // The time from each request being queued to its outputs being filled in
+    const LatencyHistogram& getLatencies() const;
+    uint64_t getNumberBatches() const;
+    uint64_t getNumberRequests() const;
+};
+
+#endif // INFERENCE_BATCHER_H
@@ -0,0 +1,244 @@
+#include "LBFGS.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// The minimizer of the cubic through both points with their slopes, or the midpoint
+// when that is not well defined or too close to either end of the interval
+double interpolate(double step1, double loss1, double slope1, double step2, double loss2, double slope2) {
+    double d1 = slope1 + slope2 - 3.0 * (loss1 - loss2) / (step1 - step2);
+    double square = d1 * d1 - slope1 * slope2;
+    double midpoint = 0.5 * (step1 + step2);
+    if (square < 0.0) return midpoint;
+
+    double d2 = (step2 > step1 ? 1.0 : -1.0) * std::sqrt(square);
+    double denominator = slope2 - slope1 + 2.0 * d2;
+    if (denominator == 0.0) return midpoint;
+    double step = step2 - (step2 - step1) * (slope2 + d2 - d1) / denominator;
+
+    double low = std::min(step1, step2);
+    double high = std::max(step1, step2);
+    double margin = 0.1 * (high - low);
+    if (!std::isfinite(step) || step < low + margin || step > high - margin) return midpoint;
+    return step;
+}
+
+}
+
+LBFGS::LBFGS(int historySize, int maximumEvaluations)
+    : historySize(historySize), maximumEvaluations(maximumEvaluations), c1(1e-4), c2(0.9), numberEvaluations(0) {
+    if (historySize <= 0) {
+        throw std::runtime_error("the history size of L-BFGS must be > 0, not " + std::to_string(historySize));
+    }
+}
+
+void LBFGS::clearHistory() {
+    weightChanges.clear();
+    gradientChanges.clear();
+    inverseCurvatures.clear();
+}
+
+int LBFGS::getNumberEvaluations() const {
+    return numberEvaluations;
+}
+
+std::vector<double> LBFGS::getDirection(const std::vector<double>& gradient) const {
+    // The two loop recursion computes -H * gradient without forming the inverse Hessian H
+    std::vector<double> direction(gradient.size());
+    for (size_t i = 0; i < gradient.size(); ++i) {
+        direction[i] = -gradient[i];
+    }
+
+    std::vector<double> alphas(weightChanges.size());
+    for (int k = static_cast<int>(weightChanges.size()) - 1; k >= 0; --k) {
+        alphas[k] = inverseCurvatures[k] * dot(weightChanges[k], direction);
+        const std::vector<double>& y = gradientChanges[k];
+        for (size_t i = 0; i < direction.size(); ++i) {
+            direction[i] -= alphas[k] * y[i];
+        }
+    }
+
+    // The initial inverse Hessian is scaled by the curvature of the most recent change
+    if (!weightChanges.empty()) {
+        const std::vector<double>& y = gradientChanges.back();
+        double scale = 1.0 / (inverseCurvatures.back() * dot(y, y));
+        for (double& d : direction) {
+            d *= scale;
+        }
+    }
+
+    for (size_t k = 0; k < weightChanges.size(); ++k) {
+        double beta = inverseCurvatures[k] * dot(gradientChanges[k], direction);
+        const std::vector<double>& s = weightChanges[k];
+        for (size_t i = 0; i < direction.size(); ++i) {
+            direction[i] += (alphas[k] - beta) * s[i];
+        }
+    }
+    return direction;
+}
+
+bool LBFGS::lineSearch(const Objective& objective, const std::vector<double>& weights, double loss, const std::vector<double>& direction,
+    double slope, double step, std::vector<double>& newWeights, double& newLoss, std::vector<double>& newGradient) {
+    std::vector<double> trialWeights(weights.size());
+    std::vector<double> trialGradient(weights.size());
+    auto evaluate = [&](double trialStep, double& trialSlope) {
+        for (size_t i = 0; i < weights.size(); ++i) {
+            trialWeights[i] = weights[i] + trialStep * direction[i];
+        }
+        numberEvaluations++;
+        double trialLoss = objective(trialWeights, trialGradient);
+        trialSlope = dot(trialGradient, direction);
+        return trialLoss;
+    };
+    auto accept = [&](double trialLoss) {
+        newWeights = trialWeights;
+        newLoss = trialLoss;
+        newGradient = trialGradient;
+        return true;
+    };
+
+    // The best point so far that satisfies the sufficient decrease condition, the fallback
+    // if the evaluations run out before the curvature condition is met
+    double lowStep = 0.0, lowLoss = loss, lowSlope = slope;
+    std::vector<double> lowWeights, lowGradient;
+    double highStep = 0.0, highLoss = 0.0, highSlope = 0.0;
+    bool bracketed = false;
+
+    int evaluations = 0;
+    double previousLoss = loss;
+    while (evaluations < maximumEvaluations) {
+        double trialSlope;
+        double trialLoss = evaluate(step, trialSlope);
+        evaluations++;
+
+        bool sufficientDecrease = std::isfinite(trialLoss) && trialLoss <= loss + c1 * step * slope;
+        if (!bracketed) {
+            if (!sufficientDecrease || (evaluations > 1 && trialLoss >= previousLoss)) {
+                highStep = step;
+                highLoss = trialLoss;
+                highSlope = trialSlope;
+                bracketed = true;
+            }
+            else if (std::fabs(trialSlope) <= -c2 * slope) {
+                return accept(trialLoss);
+            }
+            else if (trialSlope >= 0.0) {
+                highStep = lowStep;
+                highLoss = lowLoss;
+                highSlope = lowSlope;
+                lowStep = step;
+                lowLoss = trialLoss;
+                lowSlope = trialSlope;
+                lowWeights = trialWeights;
+                lowGradient = trialGradient;
+                bracketed = true;
+            }
+            else {
+                lowStep = step;
+                lowLoss = trialLoss;
+                lowSlope = trialSlope;
+                lowWeights = trialWeights;
+                lowGradient = trialGradient;
+                previousLoss = trialLoss;
+                step *= 2.0;
+                continue;
+            }
+        }
+        else {
+            // Zooming in on the bracketed interval
+            if (!sufficientDecrease || trialLoss >= lowLoss) {
+                highStep = step;
+                highLoss = trialLoss;
+                highSlope = trialSlope;
+            }
+            else {
+                if (std::fabs(trialSlope) <= -c2 * slope) {
+                    return accept(trialLoss);
+                }
+                if (trialSlope * (highStep - lowStep) >= 0.0) {
+                    highStep = lowStep;
+                    highLoss = lowLoss;
+                    highSlope = lowSlope;
+                }
+                lowStep = step;
+                lowLoss = trialLoss;
+                lowSlope = trialSlope;
+                lowWeights = trialWeights;
+                lowGradient = trialGradient;
+            }
+        }
+
+        if (!std::isfinite(highLoss)) {
+            step = 0.5 * (lowStep + highStep);
+        }
+        else {
+            step = interpolate(lowStep, lowLoss, lowSlope, highStep, highLoss, highSlope);
+        }
+        if (std::fabs(highStep - lowStep) <= 1e-12 * std::max(1.0, std::fabs(lowStep))) break;
+    }
+
+    if (lowStep > 0.0) {
+        newWeights = lowWeights;
+        newLoss = lowLoss;
+        newGradient = lowGradient;
+        return true;
+    }
+    return false;
+}
+
+bool LBFGS::step(const Objective& objective, std::vector<double>& weights, double& loss, std::vector<double>& gradient) {
+    std::vector<double> direction = getDirection(gradient);
+    double slope = dot(direction, gradient);
+    if (!(slope < 0.0)) {
+        // The curvature history no longer gives a descent direction, so start over from the gradient
+        clearHistory();
+        direction = getDirection(gradient);
+        slope = dot(direction, gradient);
+    }
+    if (!(slope < 0.0)) return false;
+
+    // The first step along the plain gradient is scaled to a unit length
+    double step = weightChanges.empty() ? std::min(1.0, 1.0 / std::sqrt(-slope)) : 1.0;
+    std::vector<double> newWeights, newGradient;
+    double newLoss;
+    if (!lineSearch(objective, weights, loss, direction, slope, step, newWeights, newLoss, newGradient)) {
+        clearHistory();
+        return false;
+    }
+
+    std::vector<double> weightChange(weights.size());
+    std::vector<double> gradientChange(weights.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weightChange[i] = newWeights[i] - weights[i];
+        gradientChange[i] = newGradient[i] - gradient[i];
+    }
+    // Only pairs with positive curvature keep the approximation positive definite
+    double curvature = dot(weightChange, gradientChange);
+    if (curvature > 1e-10 * dot(gradientChange, gradientChange)) {
+        if (static_cast<int>(weightChanges.size()) == historySize) {
+            weightChanges.pop_front();
+            gradientChanges.pop_front();
+            inverseCurvatures.pop_front();
+        }
+        weightChanges.push_back(weightChange);
+        gradientChanges.push_back(gradientChange);
+        inverseCurvatures.push_back(1.0 / curvature);
+    }
+
+    weights = newWeights;
+    loss = newLoss;
+    gradient = newGradient;
+    return true;
+}
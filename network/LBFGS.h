@@ -0,0 +1,52 @@
+// LBFGS.h
+#ifndef LBFGS_H
+#define LBFGS_H
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * The limited memory BFGS quasi-Newton method for full batch training of
+ * small data sets. The inverse Hessian is approximated from the last
+ * historySize weight and gradient changes (the two loop recursion), and
+ * each iteration runs a line search for a step length that satisfies the
+ * strong Wolfe conditions, so one iteration does the work of many first
+ * order steps.
+ */
+class LBFGS {
+public:
+    // Returns the loss at the weights and fills in its gradient
+    typedef std::function<double(const std::vector<double>& weights, std::vector<double>& gradient)> Objective;
+
+private:
+    int historySize;
+    int maximumEvaluations;
+    // The sufficient decrease and curvature constants of the strong Wolfe conditions
+    double c1;
+    double c2;
+    std::deque<std::vector<double>> weightChanges;
+    std::deque<std::vector<double>> gradientChanges;
+    std::deque<double> inverseCurvatures;
+    int numberEvaluations;
+
+    std::vector<double> getDirection(const std::vector<double>& gradient) const;
+    bool lineSearch(const Objective& objective, const std::vector<double>& weights, double loss, const std::vector<double>& direction,
+        double slope, double step, std::vector<double>& newWeights, double& newLoss, std::vector<double>& newGradient);
+
+public:
+    LBFGS(int historySize = 10, int maximumEvaluations = 20);
+
+    // Takes one iteration from weights, where loss and gradient have to be the loss and gradient
+    // at weights, replacing all three with the values at the new weights. Returns false, leaving
+    // them as they were, when no step decreases the loss (e.g. once it has converged).
+    bool step(const Objective& objective, std::vector<double>& weights, double& loss, std::vector<double>& gradient);
+
+    // Forgets the curvature history, for when the objective changes
+    void clearHistory();
+
+    // The number of loss and gradient evaluations made so far
+    int getNumberEvaluations() const;
+};
+
+#endif // LBFGS_H
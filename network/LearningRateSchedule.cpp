@@ -0,0 +1,130 @@
+#include "LearningRateSchedule.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+LearningRateSchedule::LearningRateSchedule(double baseLearningRate) : baseLearningRate(baseLearningRate) {}
+
+LearningRateSchedule::~LearningRateSchedule() {}
+
+void LearningRateSchedule::endEpoch(double /* loss */) {}
+
+std::unique_ptr<LearningRateSchedule> LearningRateSchedule::create(const std::string& description, double baseLearningRate, int epochs, int warmupEpochs) {
+    std::vector<std::string> fields;
+    std::istringstream stream(description);
+    std::string field;
+    while (std::getline(stream, field, ':')) {
+        fields.push_back(field);
+    }
+    if (fields.empty()) {
+        throw std::runtime_error("empty learning rate schedule");
+    }
+
+    std::unique_ptr<LearningRateSchedule> schedule;
+    const std::string& name = fields[0];
+    try {
+        if (name == "constant" && fields.size() == 1) {
+            schedule.reset(new ConstantSchedule(baseLearningRate));
+        }
+        else if (name == "step" && fields.size() == 3) {
+            schedule.reset(new StepSchedule(baseLearningRate, std::stoi(fields[1]), std::stod(fields[2])));
+        }
+        else if (name == "exponential" && fields.size() == 2) {
+            schedule.reset(new ExponentialSchedule(baseLearningRate, std::stod(fields[1])));
+        }
+        else if (name == "cosine" && fields.size() <= 2) {
+            schedule.reset(new CosineSchedule(baseLearningRate, epochs - warmupEpochs, fields.size() == 2 ? std::stod(fields[1]) : 0.0));
+        }
+        else if (name == "plateau" && (fields.size() == 3 || fields.size() == 4)) {
+            schedule.reset(new PlateauSchedule(baseLearningRate, std::stoi(fields[1]), std::stod(fields[2]), fields.size() == 4 ? std::stod(fields[3]) : 0.0));
+        }
+    }
+    catch (const std::logic_error& e) {
+        // std::stoi and std::stod throw invalid_argument or out_of_range
+        throw std::runtime_error("malformed learning rate schedule: " + description);
+    }
+    if (!schedule) {
+        throw std::runtime_error("unknown learning rate schedule: " + description);
+    }
+
+    if (warmupEpochs > 0) {
+        schedule.reset(new WarmupSchedule(warmupEpochs, std::move(schedule)));
+    }
+    return schedule;
+}
+
+ConstantSchedule::ConstantSchedule(double baseLearningRate) : LearningRateSchedule(baseLearningRate) {}
+
+double ConstantSchedule::getLearningRate(int /* epoch */) const {
+    return baseLearningRate;
+}
+
+StepSchedule::StepSchedule(double baseLearningRate, int stepSize, double factor)
+    : LearningRateSchedule(baseLearningRate), stepSize(stepSize), factor(factor) {
+    if (stepSize <= 0) {
+        throw std::runtime_error("the step size of a step schedule must be > 0");
+    }
+}
+
+double StepSchedule::getLearningRate(int epoch) const {
+    return baseLearningRate * std::pow(factor, epoch / stepSize);
+}
+
+ExponentialSchedule::ExponentialSchedule(double baseLearningRate, double factor)
+    : LearningRateSchedule(baseLearningRate), factor(factor) {}
+
+double ExponentialSchedule::getLearningRate(int epoch) const {
+    return baseLearningRate * std::pow(factor, epoch);
+}
+
+CosineSchedule::CosineSchedule(double baseLearningRate, int epochs, double minimumLearningRate)
+    : LearningRateSchedule(baseLearningRate), epochs(std::max(epochs, 1)), minimumLearningRate(minimumLearningRate) {}
+
+double CosineSchedule::getLearningRate(int epoch) const {
+    double progress = std::min(static_cast<double>(epoch) / epochs, 1.0);
+    return minimumLearningRate + 0.5 * (baseLearningRate - minimumLearningRate) * (1.0 + std::cos(M_PI * progress));
+}
+
+PlateauSchedule::PlateauSchedule(double baseLearningRate, int patience, double factor, double minimumLearningRate)
+    : LearningRateSchedule(baseLearningRate), patience(patience), factor(factor), minimumLearningRate(minimumLearningRate),
+      learningRate(baseLearningRate), bestLoss(std::numeric_limits<double>::infinity()), epochsWithoutImprovement(0) {
+    if (patience <= 0) {
+        throw std::runtime_error("the patience of a plateau schedule must be > 0");
+    }
+}
+
+double PlateauSchedule::getLearningRate(int /* epoch */) const {
+    return learningRate;
+}
+
+void PlateauSchedule::endEpoch(double loss) {
+    if (loss < bestLoss) {
+        bestLoss = loss;
+        epochsWithoutImprovement = 0;
+        return;
+    }
+
+    epochsWithoutImprovement++;
+    if (epochsWithoutImprovement >= patience) {
+        learningRate = std::max(learningRate * factor, minimumLearningRate);
+        epochsWithoutImprovement = 0;
+    }
+}
+
+WarmupSchedule::WarmupSchedule(int warmupEpochs, std::unique_ptr<LearningRateSchedule> schedule)
+    : LearningRateSchedule(schedule->getLearningRate(0)), warmupEpochs(warmupEpochs), schedule(std::move(schedule)) {}
+
+double WarmupSchedule::getLearningRate(int epoch) const {
+    if (epoch < warmupEpochs) {
+        return baseLearningRate * (epoch + 1) / (warmupEpochs + 1);
+    }
+    return schedule->getLearningRate(epoch - warmupEpochs);
+}
+
+void WarmupSchedule::endEpoch(double loss) {
+    schedule->endEpoch(loss);
+}
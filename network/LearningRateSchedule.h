@@ -0,0 +1,101 @@
+// LearningRateSchedule.h
+#ifndef LEARNING_RATE_SCHEDULE_H
+#define LEARNING_RATE_SCHEDULE_H
+
+#include <memory>
+#include <string>
+
+/**
+ * Gives the learning rate to train each epoch with. The schedules either
+ * depend only on the epoch (step, exponential, cosine) or react to the loss
+ * reported at the end of every epoch (reduce on plateau). Any of them can be
+ * wrapped in a linear warmup over the first epochs.
+ */
+class LearningRateSchedule {
+protected:
+    double baseLearningRate;
+
+public:
+    explicit LearningRateSchedule(double baseLearningRate);
+    virtual ~LearningRateSchedule();
+
+    // The learning rate for the (0 based) epoch
+    virtual double getLearningRate(int epoch) const = 0;
+
+    // Called at the end of each epoch with the loss it is judged on
+    virtual void endEpoch(double loss);
+
+    // Creates a schedule from a description of the form 'constant', 'step:<epochs>:<factor>',
+    // 'exponential:<factor>', 'cosine[:<minimum learning rate>]' or
+    // 'plateau:<patience>:<factor>[:<minimum learning rate>]', throwing a runtime_error
+    // if it is malformed. warmupEpochs > 0 wraps it in a linear warmup.
+    static std::unique_ptr<LearningRateSchedule> create(const std::string& description, double baseLearningRate, int epochs, int warmupEpochs = 0);
+};
+
+class ConstantSchedule : public LearningRateSchedule {
+public:
+    explicit ConstantSchedule(double baseLearningRate);
+    double getLearningRate(int epoch) const;
+};
+
+// Multiplies the learning rate by factor every stepSize epochs
+class StepSchedule : public LearningRateSchedule {
+private:
+    int stepSize;
+    double factor;
+
+public:
+    StepSchedule(double baseLearningRate, int stepSize, double factor);
+    double getLearningRate(int epoch) const;
+};
+
+// Multiplies the learning rate by factor every epoch
+class ExponentialSchedule : public LearningRateSchedule {
+private:
+    double factor;
+
+public:
+    ExponentialSchedule(double baseLearningRate, double factor);
+    double getLearningRate(int epoch) const;
+};
+
+// Anneals from the base learning rate down to minimumLearningRate over the epochs along half a cosine
+class CosineSchedule : public LearningRateSchedule {
+private:
+    int epochs;
+    double minimumLearningRate;
+
+public:
+    CosineSchedule(double baseLearningRate, int epochs, double minimumLearningRate);
+    double getLearningRate(int epoch) const;
+};
+
+// Multiplies the learning rate by factor whenever the loss has not improved for patience epochs
+class PlateauSchedule : public LearningRateSchedule {
+private:
+    int patience;
+    double factor;
+    double minimumLearningRate;
+    double learningRate;
+    double bestLoss;
+    int epochsWithoutImprovement;
+
+public:
+    PlateauSchedule(double baseLearningRate, int patience, double factor, double minimumLearningRate);
+    double getLearningRate(int epoch) const;
+    void endEpoch(double loss);
+};
+
+// Ramps the learning rate up linearly over the first warmupEpochs, then follows the wrapped schedule
+class WarmupSchedule : public LearningRateSchedule {
+private:
+    int warmupEpochs;
+    std::unique_ptr<LearningRateSchedule> schedule;
+
+public:
+    WarmupSchedule(int warmupEpochs, std::unique_ptr<LearningRateSchedule> schedule);
+    double getLearningRate(int epoch) const;
+    void endEpoch(double loss);
+};
+
+#endif // LEARNING_RATE_SCHEDULE_H
@@ -0,0 +1,466 @@
+#include "ModelFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+uint64_t align(uint64_t offset) {
+    return (offset + MODEL_FILE_ALIGNMENT - 1) / MODEL_FILE_ALIGNMENT * MODEL_FILE_ALIGNMENT;
+}
+
+double activate(double value, ActivationType activationType) {
+    // The same expressions as Node, so a mapped model gives exactly the outputs of the network
+    switch (activationType) {
+    case ActivationType::SIGMOID:
+        return 1.0 / (1.0 + exp(-value));
+    case ActivationType::TANH:
+        return tanh(value);
+    default:
+        return value;
+    }
+}
+
+}
+
+void ModelFile::save(const std::string& filename, const NeuralNetwork& nn, const Normalizer* normalizer) {
+    const std::vector<std::vector<Node>>& layers = nn.getLayers();
+    if (normalizer != nullptr && normalizer->getNumberInputs() > 0 && normalizer->getNumberInputs() != static_cast<int>(layers[0].size())) {
+        throw std::runtime_error("Cannot save a model of " + std::to_string(layers[0].size()) + " inputs with a normalizer of " + std::to_string(normalizer->getNumberInputs()) + " inputs.");
+    }
+
+    std::vector<uint32_t> layerSizes;
+    std::vector<uint32_t> activationTypes;
+    std::vector<uint64_t> layerStarts(1, 0);
+    for (const std::vector<Node>& layer : layers) {
+        layerSizes.push_back(layer.size());
+        activationTypes.push_back(layer.empty() ? ActivationType::LINEAR : layer[0].getActivationType());
+        layerStarts.push_back(layerStarts.back() + layer.size());
+    }
+
+    // The edge list is only needed if some node is not connected to exactly every node of the next layer, in order
+    bool fullyConnected = true;
+    std::vector<uint64_t> nodeOffsets;
+    std::vector<uint32_t> weightTargets(nn.getNumberWeights(), 0);
+    uint64_t position = 0;
+    for (size_t layer = 0; layer < layers.size(); ++layer) {
+        for (const Node& node : layers[layer]) {
+            nodeOffsets.push_back(position);
+            if (node.getNodeType() == NodeType::HIDDEN) {
+                weightTargets[position++] = layerStarts[layer] + node.number;
+            }
+            const std::vector<std::shared_ptr<Edge>>& edges = node.getOutputEdges();
+            if (layer + 1 < layers.size() && edges.size() != layers[layer + 1].size()) fullyConnected = false;
+            for (size_t i = 0; i < edges.size(); ++i) {
+                const Node* target = edges[i]->outputNode;
+                if (target->layer != static_cast<int>(layer) + 1 || target->number != static_cast<int>(i)) fullyConnected = false;
+                weightTargets[position++] = layerStarts[target->layer] + target->number;
+            }
+        }
+    }
+    nodeOffsets.push_back(position);
+    if (position != static_cast<uint64_t>(nn.getNumberWeights())) {
+        throw std::runtime_error("The nodes of the network have " + std::to_string(position) + " weights instead of " + std::to_string(nn.getNumberWeights()) + ".");
+    }
+    std::vector<double> weights = nn.getWeights();
+    std::vector<double> outputBiases = nn.getOutputBiases();
+
+    ModelFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_FILE_VERSION;
+    header.lossFunction = static_cast<uint32_t>(nn.getLossFunction());
+    header.numberLayers = layers.size();
+    header.fullyConnected = fullyConnected ? 1 : 0;
+    header.numberNodes = layerStarts.back();
+    header.numberWeights = weights.size();
+    header.numberNormalizerInputs = normalizer != nullptr ? normalizer->getNumberInputs() : 0;
+
+    uint64_t offset = align(sizeof(header));
+    header.layerSizesOffset = offset;
+    offset = align(offset + layerSizes.size() * sizeof(uint32_t));
+    header.activationTypesOffset = offset;
+    offset = align(offset + activationTypes.size() * sizeof(uint32_t));
+    if (!fullyConnected) {
+        header.nodeOffsetsOffset = offset;
+        offset = align(offset + nodeOffsets.size() * sizeof(uint64_t));
+        header.weightTargetsOffset = offset;
+        offset = align(offset + weightTargets.size() * sizeof(uint32_t));
+    }
+    if (header.numberNormalizerInputs > 0) {
+        header.normalizerOffset = offset;
+        offset = align(offset + 2 * header.numberNormalizerInputs * sizeof(double));
+    }
+    header.outputBiasesOffset = offset;
+    offset = align(offset + outputBiases.size() * sizeof(double));
+    header.weightsOffset = offset;
+    header.fileSize = offset + weights.size() * sizeof(double);
+
+    // Written next to the file and renamed over it, so a process that has the old file mapped
+    // keeps reading the old model and a reader never sees a half written one
+    std::string temporaryFilename = filename + ".tmp";
+    std::ofstream file(temporaryFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open model file '" + temporaryFilename + "' for writing.");
+    }
+    uint64_t written = 0;
+    auto write = [&](uint64_t sectionOffset, const void* data, size_t numberBytes) {
+        static const char padding[MODEL_FILE_ALIGNMENT] = {};
+        file.write(padding, sectionOffset - written);
+        file.write(static_cast<const char*>(data), numberBytes);
+        written = sectionOffset + numberBytes;
+    };
+    write(0, &header, sizeof(header));
+    write(header.layerSizesOffset, layerSizes.data(), layerSizes.size() * sizeof(uint32_t));
+    write(header.activationTypesOffset, activationTypes.data(), activationTypes.size() * sizeof(uint32_t));
+    if (!fullyConnected) {
+        write(header.nodeOffsetsOffset, nodeOffsets.data(), nodeOffsets.size() * sizeof(uint64_t));
+        write(header.weightTargetsOffset, weightTargets.data(), weightTargets.size() * sizeof(uint32_t));
+    }
+    if (header.numberNormalizerInputs > 0) {
+        std::vector<double> parameters = normalizer->getMeans();
+        const std::vector<double>& standardDeviations = normalizer->getStandardDeviations();
+        parameters.insert(parameters.end(), standardDeviations.begin(), standardDeviations.end());
+        write(header.normalizerOffset, parameters.data(), parameters.size() * sizeof(double));
+    }
+    write(header.outputBiasesOffset, outputBiases.data(), outputBiases.size() * sizeof(double));
+    write(header.weightsOffset, weights.data(), weights.size() * sizeof(double));
+    file.close();
+    if (!file) {
+        std::remove(temporaryFilename.c_str());
+        throw std::runtime_error("Failed writing model file '" + temporaryFilename + "'.");
+    }
+#ifdef _WIN32
+    bool renamed = MoveFileExA(temporaryFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = std::rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+#endif
+    if (!renamed) {
+        std::remove(temporaryFilename.c_str());
+        throw std::runtime_error("Could not replace model file '" + filename + "'.");
+    }
+}
+
+NeuralNetwork ModelFile::load(const std::string& filename, Normalizer* normalizer) {
+    MappedModel model(filename);
+    if (normalizer != nullptr && model.hasNormalizer()) {
+        *normalizer = model.getNormalizer();
+    }
+    return model.toNeuralNetwork();
+}
+
+MappedModel::MappedModel(const std::string& filename)
+    : filename(filename), mapping(nullptr), mappingSize(0), header(nullptr), layerSizes(nullptr), activationTypes(nullptr),
+      nodeOffsets(nullptr), weightTargets(nullptr), outputBiases(nullptr), weights(nullptr) {
+    map();
+    try {
+        validate();
+    }
+    catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+MappedModel::~MappedModel() {
+    unmap();
+}
+
+#ifdef _WIN32
+void MappedModel::map() {
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open model file '" + filename + "'.");
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(fileHandle, &size);
+    mappingSize = static_cast<size_t>(size.QuadPart);
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    mapping = mappingHandle != nullptr ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (mapping == nullptr) {
+        if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Could not map model file '" + filename + "'.");
+    }
+}
+
+void MappedModel::unmap() {
+    if (mapping == nullptr) return;
+    UnmapViewOfFile(mapping);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mapping = nullptr;
+}
+#else
+void MappedModel::map() {
+    int fileDescriptor = open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        throw std::runtime_error("Could not open model file '" + filename + "'.");
+    }
+    struct stat status;
+    if (fstat(fileDescriptor, &status) != 0 || status.st_size == 0) {
+        close(fileDescriptor);
+        throw std::runtime_error("Model file '" + filename + "' is empty.");
+    }
+    mappingSize = status.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    // The mapping stays valid after the file is closed
+    close(fileDescriptor);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("Could not map model file '" + filename + "'.");
+    }
+}
+
+void MappedModel::unmap() {
+    if (mapping == nullptr) return;
+    munmap(mapping, mappingSize);
+    mapping = nullptr;
+}
+#endif
+
+template <typename T>
+const T* MappedModel::section(uint64_t offset, uint64_t count) const {
+    if (offset % MODEL_FILE_ALIGNMENT != 0 || offset > mappingSize || count > (mappingSize - offset) / sizeof(T)) {
+        throw std::runtime_error("Model file '" + filename + "' is truncated or corrupt.");
+    }
+    return reinterpret_cast<const T*>(static_cast<const char*>(mapping) + offset);
+}
+
+void MappedModel::validate() {
+    if (mappingSize < sizeof(ModelFileHeader)) {
+        throw std::runtime_error("Model file '" + filename + "' is too short to be a model file.");
+    }
+    header = static_cast<const ModelFileHeader*>(mapping);
+    if (std::memcmp(header->magic, MODEL_FILE_MAGIC, sizeof(header->magic)) != 0) {
+        throw std::runtime_error("'" + filename + "' is not a model file.");
+    }
+    if (header->version != MODEL_FILE_VERSION) {
+        throw std::runtime_error("Unsupported version " + std::to_string(header->version) + " of the model file '" + filename + "'.");
+    }
+    if (header->fileSize != mappingSize || header->numberLayers < 2 || header->lossFunction > static_cast<uint32_t>(LossFunction::SOFTMAX)) {
+        throw std::runtime_error("Model file '" + filename + "' is truncated or corrupt.");
+    }
+
+    layerSizes = section<uint32_t>(header->layerSizesOffset, header->numberLayers);
+    activationTypes = section<uint32_t>(header->activationTypesOffset, header->numberLayers);
+    outputBiases = section<double>(header->outputBiasesOffset, layerSizes[header->numberLayers - 1]);
+    weights = section<double>(header->weightsOffset, header->numberWeights);
+
+    // The only derived state: where each layer's nodes start, and the checks that keep
+    // inference inside the workspace and the weights
+    layerStarts.assign(1, 0);
+    uint64_t expectedWeights = 0;
+    for (uint32_t layer = 0; layer < header->numberLayers; ++layer) {
+        if (activationTypes[layer] > ActivationType::TANH) {
+            throw std::runtime_error("Model file '" + filename + "' has an unknown activation type.");
+        }
+        layerStarts.push_back(layerStarts.back() + layerSizes[layer]);
+        bool hidden = layer > 0 && layer + 1 < header->numberLayers;
+        if (hidden) expectedWeights += layerSizes[layer];
+        if (layer + 1 < header->numberLayers) expectedWeights += static_cast<uint64_t>(layerSizes[layer]) * layerSizes[layer + 1];
+    }
+    if (layerStarts.back() != header->numberNodes) {
+        throw std::runtime_error("Model file '" + filename + "' is truncated or corrupt.");
+    }
+
+    if (header->fullyConnected) {
+        if (expectedWeights != header->numberWeights) {
+            throw std::runtime_error("Model file '" + filename + "' has " + std::to_string(header->numberWeights) + " weights but a fully connected network of its layers has " + std::to_string(expectedWeights) + ".");
+        }
+    }
+    else {
+        nodeOffsets = section<uint64_t>(header->nodeOffsetsOffset, header->numberNodes + 1);
+        weightTargets = section<uint32_t>(header->weightTargetsOffset, header->numberWeights);
+        if (nodeOffsets[0] != 0 || nodeOffsets[header->numberNodes] != header->numberWeights) {
+            throw std::runtime_error("Model file '" + filename + "' is truncated or corrupt.");
+        }
+        for (uint32_t layer = 0; layer < header->numberLayers; ++layer) {
+            bool hidden = layer > 0 && layer + 1 < header->numberLayers;
+            for (uint64_t node = layerStarts[layer]; node < layerStarts[layer + 1]; ++node) {
+                uint64_t first = nodeOffsets[node] + (hidden ? 1 : 0);
+                if (first > nodeOffsets[node + 1] || nodeOffsets[node + 1] > header->numberWeights) {
+                    throw std::runtime_error("Model file '" + filename + "' is truncated or corrupt.");
+                }
+                // Edges may only lead to later layers, which have not been computed yet
+                for (uint64_t position = first; position < nodeOffsets[node + 1]; ++position) {
+                    if (weightTargets[position] < layerStarts[layer + 1] || weightTargets[position] >= header->numberNodes) {
+                        throw std::runtime_error("Model file '" + filename + "' has an edge that does not lead to a later layer.");
+                    }
+                }
+            }
+        }
+    }
+
+    if (header->numberNormalizerInputs > 0) {
+        if (header->numberNormalizerInputs != layerSizes[0]) {
+            throw std::runtime_error("Model file '" + filename + "' has a normalizer for the wrong number of inputs.");
+        }
+        const double* parameters = section<double>(header->normalizerOffset, 2 * header->numberNormalizerInputs);
+        size_t numberInputs = header->numberNormalizerInputs;
+        normalizer = Normalizer(std::vector<double>(parameters, parameters + numberInputs), std::vector<double>(parameters + numberInputs, parameters + 2 * numberInputs));
+    }
+}
+
+int MappedModel::getNumberInputs() const {
+    return layerSizes[0];
+}
+
+int MappedModel::getNumberOutputs() const {
+    return layerSizes[header->numberLayers - 1];
+}
+
+int MappedModel::getNumberLayers() const {
+    return header->numberLayers;
+}
+
+int MappedModel::getLayerSize(int layer) const {
+    return layerSizes[layer];
+}
+
+ActivationType MappedModel::getActivationType(int layer) const {
+    return static_cast<ActivationType>(activationTypes[layer]);
+}
+
+LossFunction MappedModel::getLossFunction() const {
+    return static_cast<LossFunction>(header->lossFunction);
+}
+
+bool MappedModel::isFullyConnected() const {
+    return header->fullyConnected != 0;
+}
+
+size_t MappedModel::getNumberWeights() const {
+    return header->numberWeights;
+}
+
+const double* MappedModel::getWeights() const {
+    return weights;
+}
+
+bool MappedModel::hasNormalizer() const {
+    return header->numberNormalizerInputs > 0;
+}
+
+const Normalizer& MappedModel::getNormalizer() const {
+    return normalizer;
+}
+
+void MappedModel::predict(const double* inputs, double* outputs, std::vector<double>& workspace) const {
+    // Each node's value starts as the sum its incoming edges scattered into it, the same
+    // order the network sums them in, and is replaced by its activation once it is reached
+    workspace.assign(header->numberNodes, 0.0);
+    double* values = workspace.data();
+    std::copy(inputs, inputs + layerSizes[0], values);
+    if (hasNormalizer()) normalizer.apply(values);
+
+    uint32_t numberLayers = header->numberLayers;
+    uint64_t position = 0;
+    for (uint32_t layer = 0; layer < numberLayers; ++layer) {
+        bool hidden = layer > 0 && layer + 1 < numberLayers;
+        bool output = layer + 1 == numberLayers;
+        ActivationType activationType = static_cast<ActivationType>(activationTypes[layer]);
+        uint64_t nextSize = layer + 1 < numberLayers ? layerSizes[layer + 1] : 0;
+        double* next = values + layerStarts[layer + 1];
+
+        for (uint64_t node = layerStarts[layer]; node < layerStarts[layer + 1]; ++node) {
+            if (!header->fullyConnected) position = nodeOffsets[node];
+            double value = values[node];
+            if (hidden) value += weights[position++];
+            if (output) value += outputBiases[node - layerStarts[layer]];
+            value = activate(value, activationType);
+            values[node] = value;
+
+            if (header->fullyConnected) {
+                // A row of the weight matrix, added to the whole next layer at once
+                const double* row = weights + position;
+                if (value != 0.0) {
+                    for (uint64_t i = 0; i < nextSize; ++i) {
+                        next[i] += value * row[i];
+                    }
+                }
+                position += nextSize;
+            }
+            else if (value != 0.0) {
+                for (uint64_t i = position; i < nodeOffsets[node + 1]; ++i) {
+                    values[weightTargets[i]] += value * weights[i];
+                }
+            }
+        }
+    }
+
+    const double* outputLayer = values + layerStarts[numberLayers - 1];
+    std::copy(outputLayer, outputLayer + getNumberOutputs(), outputs);
+}
+
+std::vector<double> MappedModel::predict(const std::vector<double>& inputs) const {
+    if (inputs.size() != static_cast<size_t>(getNumberInputs())) {
+        throw std::runtime_error("Cannot predict " + std::to_string(inputs.size()) + " inputs with a model of " + std::to_string(getNumberInputs()) + " inputs.");
+    }
+    std::vector<double> workspace;
+    std::vector<double> outputs(getNumberOutputs());
+    predict(inputs.data(), outputs.data(), workspace);
+    return outputs;
+}
+
+void MappedModel::predict(const double* inputs, size_t numberRows, double* outputs, std::vector<double>& workspace) const {
+    size_t numberInputs = getNumberInputs();
+    size_t numberOutputs = getNumberOutputs();
+    for (size_t row = 0; row < numberRows; ++row) {
+        predict(inputs + row * numberInputs, outputs + row * numberOutputs, workspace);
+    }
+}
+
+int MappedModel::predictClass(const std::vector<double>& inputs) const {
+    std::vector<double> outputs = predict(inputs);
+    return std::max_element(outputs.begin(), outputs.end()) - outputs.begin();
+}
+
+NeuralNetwork MappedModel::toNeuralNetwork() const {
+    uint32_t numberLayers = header->numberLayers;
+    std::vector<int> hiddenLayerSizes(layerSizes + 1, layerSizes + numberLayers - 1);
+    NeuralNetwork nn(layerSizes[0], hiddenLayerSizes, layerSizes[numberLayers - 1], getLossFunction());
+
+    // The network always builds its layers with the same activation types
+    const std::vector<std::vector<Node>>& layers = nn.getLayers();
+    for (uint32_t layer = 0; layer < numberLayers; ++layer) {
+        if (!layers[layer].empty() && layers[layer][0].getActivationType() != getActivationType(layer)) {
+            throw std::runtime_error("Model file '" + filename + "' has activation types a NeuralNetwork cannot be built with.");
+        }
+    }
+
+    if (header->fullyConnected) {
+        nn.connectFully();
+    }
+    else {
+        // Connecting the edges in weight order gives every node its outgoing edges in the order of the file
+        for (uint32_t layer = 0; layer < numberLayers; ++layer) {
+            bool hidden = layer > 0 && layer + 1 < numberLayers;
+            for (uint64_t node = layerStarts[layer]; node < layerStarts[layer + 1]; ++node) {
+                for (uint64_t position = nodeOffsets[node] + (hidden ? 1 : 0); position < nodeOffsets[node + 1]; ++position) {
+                    uint64_t target = weightTargets[position];
+                    int targetLayer = std::upper_bound(layerStarts.begin(), layerStarts.end(), target) - layerStarts.begin() - 1;
+                    nn.connectNodes(layer, node - layerStarts[layer], targetLayer, target - layerStarts[targetLayer]);
+                }
+            }
+        }
+    }
+
+    nn.setWeights(std::vector<double>(weights, weights + header->numberWeights));
+    nn.setOutputBiases(std::vector<double>(outputBiases, outputBiases + getNumberOutputs()));
+    return nn;
+}
@@ -0,0 +1,133 @@
+// ModelFile.h
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include "NeuralNetwork.h"
+#include "LossFunction.h"
+#include "ActivationType.h"
+#include "../data/Normalizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Layout of the binary model files. A model file starts with this header,
+ * followed by sections at the offsets it gives, each aligned to
+ * MODEL_FILE_ALIGNMENT bytes so they can be used in place once the file is
+ * memory mapped, in native byte order:
+ *  - layerSizes: a uint32_t per layer
+ *  - activationTypes: a uint32_t (ActivationType) per layer
+ *  - nodeOffsets: a uint64_t per node plus one, where each node's weights
+ *    start in the weights (only when the network is not fully connected)
+ *  - weightTargets: a uint32_t per weight, the node (numbered across all of
+ *    the layers) its edge leads to, unused for biases (only when the
+ *    network is not fully connected)
+ *  - normalizer: the input means followed by the input standard deviations
+ *    as doubles (only when numberNormalizerInputs > 0)
+ *  - outputBiases: a double per output node, the biases that are not among
+ *    the weights of a NeuralNetwork
+ *  - weights: the doubles of NeuralNetwork::getWeights()
+ * A fully connected network needs no edge list, its weights are in
+ * NeuralNetwork::getWeights() order: per node the bias (hidden nodes only)
+ * and then one weight per node of the next layer.
+ */
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t lossFunction;
+    uint32_t numberLayers;
+    uint32_t fullyConnected;
+    uint64_t numberNodes;
+    uint64_t numberWeights;
+    uint64_t numberNormalizerInputs;
+    uint64_t layerSizesOffset;
+    uint64_t activationTypesOffset;
+    uint64_t nodeOffsetsOffset;
+    uint64_t weightTargetsOffset;
+    uint64_t normalizerOffset;
+    uint64_t outputBiasesOffset;
+    uint64_t weightsOffset;
+    uint64_t fileSize;
+};
+
+const char MODEL_FILE_MAGIC[8] = { 'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0' };
+const uint32_t MODEL_FILE_VERSION = 1;
+const size_t MODEL_FILE_ALIGNMENT = 64;
+
+/**
+ * A model file mapped into memory. Opening one only maps the file and checks
+ * its header, inference then runs straight off the mapped weights without
+ * parsing or copying them, so even large models are ready almost instantly
+ * and the operating system shares their pages between processes. A
+ * MappedModel is immutable, so any number of threads can predict with it
+ * at once as long as each has its own workspace.
+ */
+class MappedModel {
+private:
+    std::string filename;
+    void* mapping;
+    size_t mappingSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+    const ModelFileHeader* header;
+    const uint32_t* layerSizes;
+    const uint32_t* activationTypes;
+    const uint64_t* nodeOffsets;
+    const uint32_t* weightTargets;
+    const double* outputBiases;
+    const double* weights;
+    // The number of the first node of each layer, with the total at the end
+    std::vector<uint64_t> layerStarts;
+    Normalizer normalizer;
+
+    void map();
+    void unmap();
+    void validate();
+    template <typename T>
+    const T* section(uint64_t offset, uint64_t count) const;
+
+public:
+    explicit MappedModel(const std::string& filename);
+    ~MappedModel();
+
+    MappedModel(const MappedModel&) = delete;
+    MappedModel& operator=(const MappedModel&) = delete;
+
+    int getNumberInputs() const;
+    int getNumberOutputs() const;
+    int getNumberLayers() const;
+    int getLayerSize(int layer) const;
+    ActivationType getActivationType(int layer) const;
+    LossFunction getLossFunction() const;
+    bool isFullyConnected() const;
+    size_t getNumberWeights() const;
+    const double* getWeights() const;
+    bool hasNormalizer() const;
+    const Normalizer& getNormalizer() const;
+
+    // Computes the output layer for the inputs, normalizing them first if the model has a
+    // normalizer. workspace is scratch space that can be reused between calls of one thread.
+    void predict(const double* inputs, double* outputs, std::vector<double>& workspace) const;
+    std::vector<double> predict(const std::vector<double>& inputs) const;
+    // The same for numberRows rows of inputs stored one after another, filling in their outputs the same way
+    void predict(const double* inputs, size_t numberRows, double* outputs, std::vector<double>& workspace) const;
+    // The index of the largest output
+    int predictClass(const std::vector<double>& inputs) const;
+
+    // Builds a NeuralNetwork with the topology and weights of the model, e.g. to train it further
+    NeuralNetwork toNeuralNetwork() const;
+};
+
+class ModelFile {
+public:
+    // Writes the network, and the normalizer its inputs need if there is one
+    static void save(const std::string& filename, const NeuralNetwork& nn, const Normalizer* normalizer = nullptr);
+
+    // Loads a model file into a NeuralNetwork, filling in its normalizer if given one
+    static NeuralNetwork load(const std::string& filename, Normalizer* normalizer = nullptr);
+};
+
+#endif // MODEL_FILE_H
@@ -0,0 +1,120 @@
+#include "ModelHandle.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+ModelHandle::ModelHandle(std::unique_ptr<MappedModel> model, size_t numberSlots)
+    : current(model.release()), slots(new HazardSlot[std::max<size_t>(1, numberSlots)]), numberSlots(std::max<size_t>(1, numberSlots)), version(0) {
+    if (current.load() == nullptr) {
+        throw std::runtime_error("A ModelHandle needs a model to start with.");
+    }
+    for (size_t i = 0; i < this->numberSlots; ++i) {
+        slots[i].model.store(nullptr);
+        slots[i].inUse.store(false);
+    }
+}
+
+ModelHandle::~ModelHandle() {
+    delete current.load();
+    for (const MappedModel* model : retired) {
+        delete model;
+    }
+}
+
+ModelHandle::HazardSlot& ModelHandle::acquireSlot() {
+    // Each thread starts looking where it found a free slot the last time, which is
+    // normally still free, so readers on different threads do not contend for slots
+    static thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (size_t attempt = 0;; ++attempt) {
+        size_t index = (hint + attempt) % numberSlots;
+        HazardSlot& slot = slots[index];
+        bool expected = false;
+        if (!slot.inUse.load(std::memory_order_relaxed) && slot.inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            hint = index;
+            return slot;
+        }
+        // Every slot is taken, more readers than slots are holding models
+        if (attempt > 0 && attempt % numberSlots == 0) std::this_thread::yield();
+    }
+}
+
+ModelHandle::Reader ModelHandle::read() {
+    HazardSlot& slot = acquireSlot();
+    // The model is only safe once the hazard pointer to it is visible and it is still current:
+    // after that a writer that swaps it out will see the hazard pointer and not free it
+    const MappedModel* model = current.load();
+    while (true) {
+        slot.model.store(model);
+        const MappedModel* check = current.load();
+        if (check == model) break;
+        model = check;
+    }
+    return Reader(&slot, model);
+}
+
+void ModelHandle::publish(std::unique_ptr<MappedModel> model) {
+    if (!model) {
+        throw std::runtime_error("Cannot publish an empty model.");
+    }
+    std::lock_guard<std::mutex> lock(writerMutex);
+    retired.push_back(current.exchange(model.release()));
+    version.fetch_add(1);
+    reclaimRetired();
+}
+
+size_t ModelHandle::reclaim() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    return reclaimRetired();
+}
+
+size_t ModelHandle::reclaimRetired() {
+    std::vector<const MappedModel*> hazards;
+    for (size_t i = 0; i < numberSlots; ++i) {
+        const MappedModel* model = slots[i].model.load();
+        if (model != nullptr) hazards.push_back(model);
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    std::vector<const MappedModel*> stillRead;
+    for (const MappedModel* model : retired) {
+        if (std::binary_search(hazards.begin(), hazards.end(), model)) {
+            stillRead.push_back(model);
+        }
+        else {
+            delete model;
+        }
+    }
+    retired.swap(stillRead);
+    return retired.size();
+}
+
+uint64_t ModelHandle::getVersion() const {
+    return version.load();
+}
+
+ModelHandle::Reader::Reader(HazardSlot* slot, const MappedModel* model) : slot(slot), model(model) {
+}
+
+ModelHandle::Reader::Reader(Reader&& other) : slot(other.slot), model(other.model) {
+    other.slot = nullptr;
+    other.model = nullptr;
+}
+
+ModelHandle::Reader::~Reader() {
+    if (slot == nullptr) return;
+    slot->model.store(nullptr, std::memory_order_release);
+    slot->inUse.store(false, std::memory_order_release);
+}
+
+const MappedModel& ModelHandle::Reader::operator*() const {
+    return *model;
+}
+
+const MappedModel* ModelHandle::Reader::operator->() const {
+    return model;
+}
+
+const MappedModel* ModelHandle::Reader::get() const {
+    return model;
+}
@@ -0,0 +1,92 @@
+// ModelHandle.h
+#ifndef MODEL_HANDLE_H
+#define MODEL_HANDLE_H
+
+#include "ModelFile.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Shares the current model between any number of reader threads and lets a
+ * writer publish a newly trained one at any time, without restarting. The
+ * current model is an atomic pointer: readers protect the model they use
+ * with a hazard pointer, which takes a few atomic operations and never
+ * waits on a lock or on the writer. publish swaps the pointer and frees the
+ * old models no reader has a hazard pointer to; a model still in use is
+ * kept and freed by a later publish or reclaim once its last reader is
+ * done. Freeing (unmapping) therefore always happens on the writer's
+ * thread, never in the middle of a reader's request.
+ */
+class ModelHandle {
+private:
+    // Padded to a cache line so readers on different slots do not slow each other down
+    struct HazardSlot {
+        std::atomic<const MappedModel*> model;
+        std::atomic<bool> inUse;
+        char padding[64 - sizeof(std::atomic<const MappedModel*>) - sizeof(std::atomic<bool>)];
+    };
+
+    std::atomic<const MappedModel*> current;
+    std::unique_ptr<HazardSlot[]> slots;
+    size_t numberSlots;
+    std::atomic<uint64_t> version;
+
+    // Only the writers take the mutex, to publish and to free the retired models
+    std::mutex writerMutex;
+    std::vector<const MappedModel*> retired;
+
+    HazardSlot& acquireSlot();
+    size_t reclaimRetired();
+
+public:
+    /**
+     * The model a reader got from read(), which stays valid (and is not
+     * freed) until the Reader is destroyed, even if a newer model is
+     * published in the meantime.
+     */
+    class Reader {
+    private:
+        HazardSlot* slot;
+        const MappedModel* model;
+
+        friend class ModelHandle;
+        Reader(HazardSlot* slot, const MappedModel* model);
+
+    public:
+        Reader(Reader&& other);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        Reader& operator=(Reader&&) = delete;
+
+        const MappedModel& operator*() const;
+        const MappedModel* operator->() const;
+        const MappedModel* get() const;
+    };
+
+    // numberSlots is the most readers that can hold a model at the same time, more wait for a free slot
+    explicit ModelHandle(std::unique_ptr<MappedModel> model, size_t numberSlots = 256);
+    // No Reader may outlive the handle
+    ~ModelHandle();
+
+    ModelHandle(const ModelHandle&) = delete;
+    ModelHandle& operator=(const ModelHandle&) = delete;
+
+    // The current model, for as long as the Reader lives
+    Reader read();
+
+    // Makes the model the current one and frees the old models that are no longer read
+    void publish(std::unique_ptr<MappedModel> model);
+    // Frees the old models whose last reader is done, returns how many are still being read
+    size_t reclaim();
+
+    // The number of models published since the handle was created
+    uint64_t getVersion() const;
+};
+
+#endif // MODEL_HANDLE_H
@@ -1,6 +1,8 @@
 #include "NeuralNetwork.h"
 #include "Node.h"  
 #include "../util/Log.h"
+#include "../util/PhaseTimer.h"
+#include "../util/TraceRecorder.h"
 #include "../data/Instance.h"
 #include "LossFunction.h"
 #include <vector>
@@ -9,9 +11,13 @@
 #include <random>
 #include <exception>
 #include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
 
 NeuralNetwork::NeuralNetwork(int inputLayerSize, const std::vector<int>& hiddenLayerSizes, int outputLayerSize, LossFunction lossFunc)
-    : lossFunction(lossFunc), numberWeights(0) {
+    : lossFunction(lossFunc), numberWeights(0), sparseForwardPass(false) {
     // The number of layers in the neural network is 2 plus the number of hidden layers
     int totalLayers = hiddenLayerSizes.size() + 2;
 
@@ -52,11 +58,72 @@ NeuralNetwork::NeuralNetwork(int inputLayerSize, const std::vector<int>& hiddenL
     }
 }
 
+NeuralNetwork::NeuralNetwork(const NeuralNetwork& other)
+    : lossFunction(other.lossFunction), numberWeights(other.numberWeights), layers(other.layers), sparseForwardPass(false) {
+    // The copied nodes still point at the edges of other, so each edge is recreated between
+    // the new nodes, keeping the order of the incoming and outgoing edges of every node
+    std::unordered_map<const Edge*, std::shared_ptr<Edge>> copies;
+    for (std::vector<Node>& layer : layers) {
+        for (Node& node : layer) {
+            node.clearEdges();
+        }
+    }
+    for (size_t layer = 0; layer < layers.size(); ++layer) {
+        for (size_t number = 0; number < layers[layer].size(); ++number) {
+            for (const std::shared_ptr<Edge>& edge : other.layers[layer][number].getOutputEdges()) {
+                Node* inputNode = &layers[layer][number];
+                Node* outputNode = &layers[edge->outputNode->layer][edge->outputNode->number];
+                std::shared_ptr<Edge> copy = std::make_shared<Edge>(inputNode, outputNode);
+                copy->weight = edge->weight;
+                inputNode->addOutgoingEdge(copy);
+                copies[edge.get()] = copy;
+            }
+        }
+    }
+    for (size_t layer = 0; layer < layers.size(); ++layer) {
+        for (size_t number = 0; number < layers[layer].size(); ++number) {
+            for (const std::shared_ptr<Edge>& edge : other.layers[layer][number].getInputEdges()) {
+                layers[layer][number].addIncomingEdge(copies[edge.get()]);
+            }
+        }
+    }
+}
+
+NeuralNetwork& NeuralNetwork::operator=(const NeuralNetwork& other) {
+    if (this != &other) {
+        *this = NeuralNetwork(other);
+    }
+    return *this;
+}
+
 int NeuralNetwork::getNumberWeights() const {
     return numberWeights;
 }
 
+LossFunction NeuralNetwork::getLossFunction() const {
+    return lossFunction;
+}
+
+const std::vector<std::vector<Node>>& NeuralNetwork::getLayers() const {
+    return layers;
+}
+
 void NeuralNetwork::reset() {
+    if (sparseForwardPass) {
+        // A sparse pass only touched the input nodes that were nonzero and the weight deltas
+        // of their edges, so the rest of the input layer is still clear
+        for (int input : activeInputs) {
+            layers[0][input].resetSparse();
+        }
+        for (size_t i = 1; i < layers.size(); ++i) {
+            for (auto& node : layers[i]) {
+                node.reset(true);
+            }
+        }
+        sparseForwardPass = false;
+        return;
+    }
+
     for (auto& layer : layers) {
         for (auto& node : layer) {
             node.reset();
@@ -66,6 +133,14 @@ void NeuralNetwork::reset() {
 
 std::vector<double> NeuralNetwork::getWeights() const {
     std::vector<double> weights(numberWeights);
+    getWeights(weights);
+    return weights;
+}
+
+void NeuralNetwork::getWeights(std::vector<double>& weights) const {
+    if (weights.size() != static_cast<size_t>(numberWeights)) {
+        throw std::runtime_error("Cannot get the " + std::to_string(numberWeights) + " weights into a buffer of " + std::to_string(weights.size()) + ".");
+    }
     int position = 0;
     for (size_t i = 0; i < layers.size(); ++i) {
         for (size_t j = 0; j < layers[i].size(); ++j) {
@@ -77,11 +152,10 @@ std::vector<double> NeuralNetwork::getWeights() const {
             }
         }
     }
-    return weights;
 }
 
-void NeuralNetwork::setWeights(std::vector<double>& newWeights) {
-    if (numberWeights != newWeights.size()) {
+void NeuralNetwork::setWeights(const std::vector<double>& newWeights) {
+    if (static_cast<size_t>(numberWeights) != newWeights.size()) {
         throw std::runtime_error("Could not setWeights because the number of new weights: " + std::to_string(newWeights.size()) + " was not equal to the number of weights in the NeuralNetwork: " + std::to_string(numberWeights));
     }
     int position = 0;
@@ -96,12 +170,29 @@ void NeuralNetwork::setWeights(std::vector<double>& newWeights) {
     }
 }
 
+std::vector<double> NeuralNetwork::getOutputBiases() const {
+    std::vector<double> biases;
+    for (const Node& node : layers.back()) {
+        biases.push_back(node.getBias());
+    }
+    return biases;
+}
+
+void NeuralNetwork::setOutputBiases(const std::vector<double>& biases) {
+    if (biases.size() != layers.back().size()) {
+        throw std::runtime_error("Could not setOutputBiases because the number of biases: " + std::to_string(biases.size()) + " was not equal to the number of output nodes: " + std::to_string(layers.back().size()));
+    }
+    for (size_t i = 0; i < biases.size(); ++i) {
+        layers.back()[i].setBias(biases[i]);
+    }
+}
+
 std::vector<double> NeuralNetwork::getDeltas() const {
     std::vector<double> deltas(numberWeights, 0.0);  // Initialize all deltas to zero.
 
     int position = 0;
     for (const auto& layer : layers) {
-        for (Node node : layer) {
+        for (const Node& node : layer) {
             int nDeltas = node.getDeltas(position, deltas);
             position += nDeltas;
 
@@ -114,7 +205,94 @@ std::vector<double> NeuralNetwork::getDeltas() const {
     return deltas;
 }
 
+void NeuralNetwork::addDeltas(std::vector<double>& gradient) const {
+    const std::vector<int>& rowOffsets = getInputRowOffsets();
+    if (sparseForwardPass) {
+        for (int input : activeInputs) {
+            layers[0][input].addDeltas(rowOffsets[input], gradient);
+        }
+    }
+    else {
+        for (size_t i = 0; i < layers[0].size(); ++i) {
+            layers[0][i].addDeltas(rowOffsets[i], gradient);
+        }
+    }
+
+    int position = rowOffsets.back();
+    for (size_t i = 1; i < layers.size(); ++i) {
+        for (const Node& node : layers[i]) {
+            position += node.addDeltas(position, gradient);
+        }
+    }
+}
+
+const std::vector<int>& NeuralNetwork::getInputRowOffsets() const {
+    // The input nodes come first in the weights, each with the weights of its outgoing edges
+    if (inputRowOffsets.empty()) {
+        inputRowOffsets.assign(1, 0);
+        for (const Node& node : layers[0]) {
+            inputRowOffsets.push_back(inputRowOffsets.back() + node.getNumberWeights());
+        }
+    }
+    return inputRowOffsets;
+}
+
+std::vector<std::pair<int, int>> NeuralNetwork::getLayerWeightRanges() const {
+    std::vector<std::pair<int, int>> ranges;
+    int position = 0;
+    for (const std::vector<Node>& layer : layers) {
+        int begin = position;
+        for (const Node& node : layer) {
+            position += node.getNumberWeights();
+        }
+        ranges.push_back(std::make_pair(begin, position));
+    }
+    return ranges;
+}
+
+std::vector<std::pair<int, int>> NeuralNetwork::getActiveWeightRanges(const std::vector<Instance>& instances) const {
+    const std::vector<int>& rowOffsets = getInputRowOffsets();
+    std::vector<int> inputs;
+    for (const Instance& instance : instances) {
+        if (instance.isSparse()) {
+            inputs.insert(inputs.end(), instance.sparseIndices.begin(), instance.sparseIndices.end());
+        }
+        else if (instance.isPacked()) {
+            for (size_t word = 0; word < instance.packedInputs.size(); ++word) {
+                for (uint64_t bits = instance.packedInputs[word]; bits != 0; bits &= bits - 1) {
+                    inputs.push_back(word * 64 + __builtin_ctzll(bits));
+                }
+            }
+        }
+        else {
+            // Any input of a dense instance can be nonzero
+            return std::vector<std::pair<int, int>>(1, std::make_pair(0, numberWeights));
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+    // Neighbouring rows are merged into one range
+    std::vector<std::pair<int, int>> ranges;
+    for (int input : inputs) {
+        if (!ranges.empty() && ranges.back().second == rowOffsets[input]) {
+            ranges.back().second = rowOffsets[input + 1];
+        }
+        else {
+            ranges.push_back(std::make_pair(rowOffsets[input], rowOffsets[input + 1]));
+        }
+    }
+    if (!ranges.empty() && ranges.back().second == rowOffsets.back()) {
+        ranges.back().second = numberWeights;
+    }
+    else {
+        ranges.push_back(std::make_pair(rowOffsets.back(), numberWeights));
+    }
+    return ranges;
+}
+
 void NeuralNetwork::connectFully() {
+    inputRowOffsets.clear();
     for (size_t layer = 0; layer < layers.size() - 1; ++layer) {
         for (Node& inputNode : layers[layer]) {
             for (Node& outputNode : layers[layer + 1]) {
@@ -122,7 +300,7 @@ void NeuralNetwork::connectFully() {
                 inputNode.addOutgoingEdge(newEdge);
                 outputNode.addIncomingEdge(newEdge);
                 numberWeights++;
-                Log::trace("Number of weights now: " + std::to_string(numberWeights));
+                LOG_TRACE("Number of weights now: " + std::to_string(numberWeights));
             }
         }
     }
@@ -142,15 +320,16 @@ void NeuralNetwork::connectNodes(int inputLayer, int inputNumber, int outputLaye
     inputNode->addOutgoingEdge(newEdge);
     outputNode->addIncomingEdge(newEdge);
     ++numberWeights;
-    Log::trace("Number of weights now: " + std::to_string(numberWeights));
+    inputRowOffsets.clear();
+    LOG_TRACE("Number of weights now: " + std::to_string(numberWeights));
 }
 
 void NeuralNetwork::initializeRandomly(double bias) {
     std::default_random_engine generator(std::random_device{}());
     std::normal_distribution<double> distribution(0.0, 1.0);
 
-    for (auto& layer : layers) {
-        for (Node& node : layer) {
+    for (size_t layer = 0; layer < layers.size(); ++layer) {
+        for (Node& node : layers[layer]) {
             double fanIn = node.getInputEdges().size();
             double variance = fanIn > 0 ? 1.0 / std::sqrt(fanIn) : 1.0;
 
@@ -159,7 +338,9 @@ void NeuralNetwork::initializeRandomly(double bias) {
                 
             }
 
-            node.setBias(bias);
+            // Input nodes pass their values through unchanged, which the bit packed
+            // forward pass relies on for the inputs that are 0
+            if (layer > 0) node.setBias(bias);
         }
     }
 }
@@ -168,25 +349,52 @@ double NeuralNetwork::forwardPass(const Instance& instance) {
     reset();  // Reset the network before the forward pass
 
     // 1. Set input values to the neural network
-    if (layers[0].size() != instance.inputs.size()) {
+    if (layers[0].size() != static_cast<size_t>(instance.getNumberInputs())) {
         throw std::runtime_error("Mismatch between network input layer size and instance input size.");
     }
-    for (size_t i = 0; i < layers[0].size(); ++i) {
-        // Directly assign the input values to the preActivationValue of input nodes
-        layers[0][i].preActivationValue = instance.inputs[i];
+    if (instance.isPacked()) {
+        // Only the set bits are visited, popping the lowest one off each word at a time
+        activeInputs.clear();
+        for (size_t word = 0; word < instance.packedInputs.size(); ++word) {
+            uint64_t bits = instance.packedInputs[word];
+            while (bits != 0) {
+                activeInputs.push_back(word * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+        for (int input : activeInputs) {
+            layers[0][input].propagateForwardSparse(1.0);
+        }
+    }
+    else if (instance.isSparse()) {
+        activeInputs = instance.sparseIndices;
+        for (size_t i = 0; i < activeInputs.size(); ++i) {
+            layers[0][activeInputs[i]].propagateForwardSparse(instance.sparseValues[i]);
+        }
+    }
+    else {
+        for (size_t i = 0; i < layers[0].size(); ++i) {
+            // Directly assign the input values to the preActivationValue of input nodes
+            layers[0][i].preActivationValue = instance.inputs[i];
+        }
     }
 
-    // 2. Call forward propagation on each node
-    for (size_t i = 0; i < layers.size(); ++i) {
+    // 2. Call forward propagation on each node, the input layer was already scattered
+    // into the next layers for sparse and bit packed instances
+    sparseForwardPass = instance.storage != InputStorage::DENSE;
+    bool tracing = TraceRecorder::isEnabled();
+    for (size_t i = sparseForwardPass ? 1 : 0; i < layers.size(); ++i) {
+        int64_t begin = tracing ? TraceRecorder::now() : 0;
         for (size_t j = 0; j < layers[i].size(); ++j) {
-            layers[i][j].propagateForward();
+            layers[i][j].propagateForward(sparseForwardPass);
         }
+        if (tracing) TraceRecorder::record("forward layer", "network", begin, TraceRecorder::now(), "layer", i);
     }
 
 
     // The output layer calculations
     int outputLayerIndex = layers.size() - 1;
-    const std::vector<double> expectedOutputs = instance.expectedOutputs;
+    const std::vector<double>& expectedOutputs = instance.expectedOutputs;
 
     double outputSum = 0;
     if (lossFunction == LossFunction::NONE) {
@@ -198,7 +406,7 @@ double NeuralNetwork::forwardPass(const Instance& instance) {
     }
     else if (lossFunction == LossFunction::SVM) {
         // Implement SVM loss
-        int expectedIndex = static_cast<int>(expectedOutputs[0]);
+        size_t expectedIndex = static_cast<size_t>(expectedOutputs[0]);
         double expectedOutput = layers[outputLayerIndex][expectedIndex].postActivationValue;
         double deltaSum = 0.0;
         double hingeLossSum = 0.0;
@@ -224,7 +432,7 @@ double NeuralNetwork::forwardPass(const Instance& instance) {
     }
     else if (lossFunction == LossFunction::SOFTMAX) {
         // Implement Softmax loss
-        int expectedIndex = static_cast<int>(instance.expectedOutputs[0]);
+        size_t expectedIndex = static_cast<size_t>(instance.expectedOutputs[0]);
         double expectedOutput = layers[outputLayerIndex][expectedIndex].postActivationValue;
         double expectedExp = std::exp(expectedOutput);
         double totalExpSum = 0.0;
@@ -235,7 +443,7 @@ double NeuralNetwork::forwardPass(const Instance& instance) {
         }
 
         // Calculate softmax loss and delta for each output node
-        for (int i = 0; i < layers[outputLayerIndex].size(); ++i) {
+        for (size_t i = 0; i < layers[outputLayerIndex].size(); ++i) {
             double softmaxProb = std::exp(layers[outputLayerIndex][i].postActivationValue) / totalExpSum;
             layers[outputLayerIndex][i].delta = (i == expectedIndex) ? (softmaxProb - 1) : softmaxProb;
         }
@@ -267,14 +475,15 @@ double NeuralNetwork::calculateAccuracy(const std::vector<Instance>& instances)
 
     for (const Instance& instance : instances) {
         forwardPass(instance);
-        std::vector<double> output = getOutputValues();
 
+        // Straight from the output nodes, so evaluating an instance does not allocate
+        const std::vector<Node>& outputLayer = layers.back();
         double maxOutput = std::numeric_limits<double>::min();
         int predictedIndex = -1;
-        for (int i = 0; i < output.size(); ++i) {
-            if (output[i] > maxOutput) {
-                maxOutput = output[i];
-                predictedIndex = i;
+        for (size_t i = 0; i < outputLayer.size(); ++i) {
+            if (outputLayer[i].postActivationValue > maxOutput) {
+                maxOutput = outputLayer[i].postActivationValue;
+                predictedIndex = static_cast<int>(i);
             }
         }
 
@@ -372,16 +581,33 @@ std::vector<double> NeuralNetwork::getNumericGradient(const std::vector<Instance
 
 void NeuralNetwork::backwardPass() {
     // Propagate backward starting from the output layer to the input layer
-    for (int i = layers.size() - 1; i >= 0; --i) {
+    int lastLayer = sparseForwardPass ? 1 : 0;
+    bool tracing = TraceRecorder::isEnabled();
+    for (int i = layers.size() - 1; i >= lastLayer; --i) {
+        int64_t begin = tracing ? TraceRecorder::now() : 0;
         for (Node& node : layers[i]) {
-            node.propagateBackward();
+            node.propagateBackward(sparseForwardPass);
+        }
+        if (tracing) TraceRecorder::record("backward layer", "network", begin, TraceRecorder::now(), "layer", i);
+    }
+
+    // Only the edges of the nonzero inputs of a sparse instance have a weight delta
+    if (sparseForwardPass) {
+        int64_t begin = tracing ? TraceRecorder::now() : 0;
+        for (int input : activeInputs) {
+            layers[0][input].propagateBackwardSparse();
         }
+        if (tracing) TraceRecorder::record("backward layer", "network", begin, TraceRecorder::now(), "layer", 0);
     }
 }
 
 // Gets the gradient of the neural network at its current weights for a given instance.
 std::vector<double> NeuralNetwork::getGradient(const Instance& instance) {
-    forwardPass(instance);
+    {
+        ScopedPhase phase(Phase::FORWARD);
+        forwardPass(instance);
+    }
+    ScopedPhase phase(Phase::BACKWARD);
     backwardPass();
     return getDeltas();
 }
@@ -389,14 +615,42 @@ std::vector<double> NeuralNetwork::getGradient(const Instance& instance) {
 // Gets the gradient of the neural network for a list of instances.
 std::vector<double> NeuralNetwork::getGradient(const std::vector<Instance>& instances) {
     std::vector<double> gradientSum(numberWeights, 0.0);
+    addGradient(instances, gradientSum);
+    return gradientSum;
+}
 
-    // Accumulate the gradients for each instance
-    for (const auto& instance : instances) {
-        std::vector<double> singleGradient = getGradient(instance);
-        for (size_t i = 0; i < numberWeights; ++i) {
-            gradientSum[i] += singleGradient[i];
+void NeuralNetwork::addGradient(const std::vector<Instance>& instances, std::vector<double>& gradient) {
+    addGradient(instances, 0, instances.size(), gradient);
+}
+
+void NeuralNetwork::addGradient(const std::vector<Instance>& instances, size_t begin, size_t end, std::vector<double>& gradient) {
+    if (gradient.size() != static_cast<size_t>(numberWeights)) {
+        throw std::runtime_error("Cannot add the gradient of " + std::to_string(numberWeights) + " weights to a buffer of " + std::to_string(gradient.size()) + ".");
+    }
+
+    // Accumulate the gradients for each instance, sparse instances only add to the
+    // weights of their nonzero inputs and the layers after the input layer
+    if (!PhaseTimer::isEnabled()) {
+        for (size_t i = begin; i < end; ++i) {
+            forwardPass(instances[i]);
+            backwardPass();
+            addDeltas(gradient);
         }
+        return;
     }
 
-    return gradientSum;
+    // The same, timing the passes of the range and adding them to the phases once
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration forward(0), backward(0);
+    for (size_t i = begin; i < end; ++i) {
+        Clock::time_point start = Clock::now();
+        forwardPass(instances[i]);
+        Clock::time_point middle = Clock::now();
+        backwardPass();
+        addDeltas(gradient);
+        forward += middle - start;
+        backward += Clock::now() - middle;
+    }
+    PhaseTimer::add(Phase::FORWARD, std::chrono::duration_cast<std::chrono::nanoseconds>(forward).count(), end - begin);
+    PhaseTimer::add(Phase::BACKWARD, std::chrono::duration_cast<std::chrono::nanoseconds>(backward).count(), end - begin);
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #ifndef NEURAL_NETWORK_H
 #define NEURAL_NETWORK_H
 
+#include <cstddef>
 #include <vector>
 #include <string>
+#include <utility>
 #include "Node.h"  // Make sure this path is correct
 #include "Edge.h"  // Make sure this path is correct
 #include "LossFunction.h"  // Enum or class needs to be defined
@@ -13,16 +15,45 @@ private:
     LossFunction lossFunction;
     int numberWeights;
     std::vector<std::vector<Node>> layers;
+    // The nonzero inputs of the last forward pass when its instance was sparse or bit packed
+    bool sparseForwardPass;
+    std::vector<int> activeInputs;
+    // Where the weights of each input node start in the weights, with the total at the end
+    mutable std::vector<int> inputRowOffsets;
 
 public:
     NeuralNetwork(int inputLayerSize, const std::vector<int>& hiddenLayerSizes, int outputLayerSize, LossFunction lossFunc);
+    // Copies get edges of their own with the same weights, so a copy can be trained or
+    // evaluated on another thread without touching the original
+    NeuralNetwork(const NeuralNetwork& other);
+    NeuralNetwork(NeuralNetwork&& other) = default;
+    NeuralNetwork& operator=(const NeuralNetwork& other);
+    NeuralNetwork& operator=(NeuralNetwork&& other) = default;
    
 
     int getNumberWeights() const;
+    LossFunction getLossFunction() const;
+    const std::vector<std::vector<Node>>& getLayers() const;
     void reset();
     std::vector<double> getWeights() const;
-    void setWeights(std::vector<double>& newWeights);
+    // The same into a buffer of the right size, without allocating
+    void getWeights(std::vector<double>& weights) const;
+    void setWeights(const std::vector<double>& newWeights);
+    // The biases of the output nodes, which initializeRandomly sets but which are not among
+    // the weights, so training leaves them as they are
+    std::vector<double> getOutputBiases() const;
+    void setOutputBiases(const std::vector<double>& biases);
     std::vector<double> getDeltas() const;
+    // Adds the gradient of the last backward pass to gradient, only touching the weights of
+    // the nonzero inputs for a sparse instance
+    void addDeltas(std::vector<double>& gradient) const;
+    const std::vector<int>& getInputRowOffsets() const;
+    // The [begin, end) range of the weights of each layer, in layer order: the biases of its
+    // nodes and the weights of their outgoing edges, so the output layer's range is empty
+    std::vector<std::pair<int, int>> getLayerWeightRanges() const;
+    // The [begin, end) ranges of the weights that can have a nonzero gradient for these
+    // instances: the rows of their nonzero inputs and every weight past the input layer
+    std::vector<std::pair<int, int>> getActiveWeightRanges(const std::vector<Instance>& instances) const;
     void connectFully();
     void connectNodes(int inputLayer, int inputNumber, int outputLayer, int outputNumber);
     void initializeRandomly(double bias);
@@ -35,6 +66,11 @@ public:
     void backwardPass();
     std::vector<double> getGradient(const Instance& instance);
     std::vector<double> getGradient(const std::vector<Instance>& instances);
+    // Adds the summed gradient of the instances to gradient, so the gradients of several
+    // (micro) batches can be accumulated into one buffer
+    void addGradient(const std::vector<Instance>& instances, std::vector<double>& gradient);
+    // The same for only the instances in [begin, end)
+    void addGradient(const std::vector<Instance>& instances, size_t begin, size_t end, std::vector<double>& gradient);
 };
 
 #endif // NEURAL_NETWORK_H
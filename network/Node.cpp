@@ -14,35 +14,66 @@
 Node::Node(int layerValue, int numberValue, NodeType type, ActivationType actType)
     : layer(layerValue), number(numberValue), nodeType(type), activationType(actType),
     preActivationValue(0), postActivationValue(0), delta(0), activationDerivative(0),
-    bias(0), biasDelta(0) {}
+    bias(0), biasDelta(0), numberInputLayerEdges(0) {}
 
-void Node::reset() {
+void Node::reset(bool skipInputLayerEdges) {
     preActivationValue = 0;
     postActivationValue = 0;
     activationDerivative = 0;
     delta = 0;
     biasDelta = 0;
-    for (std::shared_ptr<Edge>& edge : inputEdges) {
+    size_t firstEdge = skipInputLayerEdges ? numberInputLayerEdges : 0;
+    for (size_t i = firstEdge; i < inputEdges.size(); ++i) {
+        inputEdges[i]->weightDelta = 0;
+    }
+}
+
+void Node::resetSparse() {
+    reset();
+    for (std::shared_ptr<Edge>& edge : outputEdges) {
         edge->weightDelta = 0;
     }
 }
 
 void Node::addOutgoingEdge(std::shared_ptr<Edge> outgoingEdge) {
     outputEdges.push_back(outgoingEdge);
-    Log::trace("Node " + toString() + " added outgoing edge to Node " + outgoingEdge->outputNode->toString());
+    LOG_TRACE("Node " + toString() + " added outgoing edge to Node " + outgoingEdge->outputNode->toString());
 }
 
 void Node::addIncomingEdge(std::shared_ptr<Edge> incomingEdge) {
-    inputEdges.push_back(incomingEdge);
-    Log::trace("Node " + toString() + " added incoming edge to Node " + incomingEdge->outputNode->toString());
+    if (incomingEdge->inputNode->layer == 0) {
+        inputEdges.insert(inputEdges.begin() + numberInputLayerEdges, incomingEdge);
+        numberInputLayerEdges++;
+    }
+    else {
+        inputEdges.push_back(incomingEdge);
+    }
+    LOG_TRACE("Node " + toString() + " added incoming edge to Node " + incomingEdge->outputNode->toString());
 }
 
-void Node::propagateForward() {
-    for (size_t i = 0; i < inputEdges.size(); ++i) {
+void Node::propagateForward(bool skipInputLayerEdges) {
+    size_t firstEdge = skipInputLayerEdges ? numberInputLayerEdges : 0;
+    for (size_t i = firstEdge; i < inputEdges.size(); ++i) {
         preActivationValue += inputEdges[i]->weight * inputEdges[i]->inputNode->postActivationValue;
     }
     preActivationValue += bias;
 
+    applyActivation();
+}
+
+// Rather than every node of the next layer multiplying all of its inputs, each
+// nonzero input scatters its weighted value to the nodes it leads to and the
+// inputs that are 0 are never touched
+void Node::propagateForwardSparse(double value) {
+    preActivationValue = value;
+    applyActivation();
+
+    for (std::shared_ptr<Edge>& edge : outputEdges) {
+        edge->outputNode->preActivationValue += edge->weight * postActivationValue;
+    }
+}
+
+void Node::applyActivation() {
     switch (activationType) {
     case ActivationType::LINEAR:
         applyLinear();
@@ -90,7 +121,7 @@ int Node::getWeights(int position, std::vector<double>& weights) const {
     return weightCount;
 }
 
-int Node::getDeltas(int position, std::vector<double>& deltas) {
+int Node::getDeltas(int position, std::vector<double>& deltas) const {
     int deltaCount = 0;
 
     // The first delta set will be the bias if it is a hidden node
@@ -99,14 +130,34 @@ int Node::getDeltas(int position, std::vector<double>& deltas) {
         deltaCount = 1;
     }
 
-    for (std::shared_ptr<Edge>& edge : outputEdges) {
+    for (const std::shared_ptr<Edge>& edge : outputEdges) {
         deltas[position + deltaCount] = edge->weightDelta;
         deltaCount++;
     }
     return deltaCount;
 }
 
-int Node::setWeights(int position, std::vector<double>& weights) {
+int Node::addDeltas(int position, std::vector<double>& deltas) const {
+    int deltaCount = 0;
+
+    // Same order as getDeltas, the bias first if it is a hidden node
+    if (nodeType == NodeType::HIDDEN) {
+        deltas[position] += biasDelta;
+        deltaCount = 1;
+    }
+
+    for (const std::shared_ptr<Edge>& edge : outputEdges) {
+        deltas[position + deltaCount] += edge->weightDelta;
+        deltaCount++;
+    }
+    return deltaCount;
+}
+
+int Node::getNumberWeights() const {
+    return (nodeType == NodeType::HIDDEN ? 1 : 0) + outputEdges.size();
+}
+
+int Node::setWeights(int position, const std::vector<double>& weights) {
     int weightCount = 0;
 
     // The first weight set will be the bias if it is a hidden node
@@ -134,14 +185,23 @@ void Node::applyDerivativeTanh() {
     activationDerivative = 1 - std::pow(postActivationValue, 2);
 }
 
-void Node::propagateBackward() {
+void Node::propagateBackward(bool skipInputLayerEdges) {
     double deltaPushBack = delta * activationDerivative;
     // Set the biasDelta to delta. Because it's an addition
     biasDelta += deltaPushBack;
 
     // Call propagateBackward for all incomingEdges
-    for (std::shared_ptr<Edge>& edge : inputEdges) {
-        edge->propagateBackward(deltaPushBack);
+    size_t firstEdge = skipInputLayerEdges ? numberInputLayerEdges : 0;
+    for (size_t i = firstEdge; i < inputEdges.size(); ++i) {
+        inputEdges[i]->propagateBackward(deltaPushBack);
+    }
+}
+
+// Must run after the nodes this one leads to have propagated backward. The weight
+// deltas of the edges from inputs that are 0 stay at the 0 they were reset to.
+void Node::propagateBackwardSparse() {
+    for (std::shared_ptr<Edge>& edge : outputEdges) {
+        edge->propagateBackward(edge->outputNode->delta * edge->outputNode->activationDerivative);
     }
 }
 
@@ -156,14 +216,40 @@ void Node::initializeWeightsAndBias(double newBias) {
     }
 }
 
+NodeType Node::getNodeType() const {
+    return nodeType;
+}
+
+ActivationType Node::getActivationType() const {
+    return activationType;
+}
+
 std::vector<std::shared_ptr<Edge>> Node::getInputEdges() {
     return inputEdges;
 }
 
+const std::vector<std::shared_ptr<Edge>>& Node::getInputEdges() const {
+    return inputEdges;
+}
+
+const std::vector<std::shared_ptr<Edge>>& Node::getOutputEdges() const {
+    return outputEdges;
+}
+
+void Node::clearEdges() {
+    inputEdges.clear();
+    outputEdges.clear();
+    numberInputLayerEdges = 0;
+}
+
 void Node::setBias(double new_bias){
     bias = new_bias;
 }
 
+double Node::getBias() const {
+    return bias;
+}
+
 std::string Node::toString() const {
     std::string ss = "[Node - layer: " + std::to_string(layer) + ", number: " + std::to_string(number) + ", type: "
         + std::to_string(static_cast<int>(nodeType)) + "]";
@@ -25,8 +25,11 @@ private:
     double biasDelta;
     std::vector<std::shared_ptr<Edge>> inputEdges;
     std::vector<std::shared_ptr<Edge>> outputEdges;
+    // The incoming edges from the input layer are kept at the front of inputEdges
+    size_t numberInputLayerEdges;
 
     // Helper methods for activation functions
+    void applyActivation();
     void applyLinear();
     void applySigmoid();
     void applyTanh();
@@ -38,24 +41,42 @@ public:
     // Constructor and destructor
     Node(int layerValue, int numberValue, NodeType type, ActivationType actType);
 
-    // Method to reset node state
-    void reset();
+    // Method to reset node state, leaving the weight deltas of the edges from the
+    // input layer alone if asked to
+    void reset(bool skipInputLayerEdges = false);
+    // Resets an input node along with the weight deltas of its outgoing edges
+    void resetSparse();
 
     // Edge management
     void addOutgoingEdge(std::shared_ptr<Edge> outgoingEdge);
     void addIncomingEdge(std::shared_ptr<Edge> incomingEdge);
 
-    // Propagation methods
-    void propagateForward();
-    void propagateBackward();
+    // Propagation methods, which can leave out the edges from the input layer when
+    // those were already handled by the sparse input methods below
+    void propagateForward(bool skipInputLayerEdges = false);
+    void propagateBackward(bool skipInputLayerEdges = false);
+
+    // Propagation for an input node that is nonzero in a sparse or bit packed instance
+    void propagateForwardSparse(double value);
+    void propagateBackwardSparse();
 
     // Weights and deltas management
     int getWeights(int position, std::vector<double>& weights) const;
-    int getDeltas(int position, std::vector<double>& deltas);
-    int setWeights(int position, std::vector<double>& weights);
+    int getDeltas(int position, std::vector<double>& deltas) const;
+    int addDeltas(int position, std::vector<double>& deltas) const;
+    int getNumberWeights() const;
+    int setWeights(int position, const std::vector<double>& weights);
     void setBias(double bias);
+    double getBias() const;
+
+    NodeType getNodeType() const;
+    ActivationType getActivationType() const;
 
     std::vector<std::shared_ptr<Edge>> getInputEdges(); 
+    const std::vector<std::shared_ptr<Edge>>& getInputEdges() const;
+    const std::vector<std::shared_ptr<Edge>>& getOutputEdges() const;
+    // Drops all of the edges, for copies of a node that get edges of their own
+    void clearEdges();
 
     // Initialization of weights and bias
     void initializeWeightsAndBias(double newBias);
@@ -0,0 +1,359 @@
+#include "Optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+Optimizer::Optimizer(const OptimizerParameters& parameters) : parameters(parameters) {}
+
+Optimizer::~Optimizer() {}
+
+void Optimizer::beginStep() {}
+
+void Optimizer::stepRanges(double* weights, const double* gradient, size_t, size_t, const std::vector<std::pair<int, int>>& ranges) {
+    for (const std::pair<int, int>& range : ranges) {
+        step(weights, gradient, range.first, range.second);
+    }
+}
+
+void Optimizer::step(std::vector<double>& weights, const std::vector<double>& gradient) {
+    if (weights.size() != gradient.size()) {
+        throw std::runtime_error("Cannot update " + std::to_string(weights.size()) + " weights with a gradient of " + std::to_string(gradient.size()) + ".");
+    }
+    beginStep();
+    if (groups.empty()) {
+        step(weights.data(), gradient.data(), 0, weights.size());
+        return;
+    }
+    for (const std::pair<int, int>& group : groups) {
+        if (group.first < group.second) step(weights.data(), gradient.data(), group.first, group.second);
+    }
+}
+
+void Optimizer::step(std::vector<double>& weights, const std::vector<double>& gradient, const std::vector<std::pair<int, int>>& ranges) {
+    if (weights.size() != gradient.size()) {
+        throw std::runtime_error("Cannot update " + std::to_string(weights.size()) + " weights with a gradient of " + std::to_string(gradient.size()) + ".");
+    }
+    beginStep();
+    if (groups.empty()) {
+        for (const std::pair<int, int>& range : ranges) {
+            step(weights.data(), gradient.data(), range.first, range.second);
+        }
+        return;
+    }
+    // Each group is stepped once with all of its ranges, so a layer-wise optimizer still
+    // takes its trust ratio over the whole layer
+    for (const std::pair<int, int>& group : groups) {
+        groupRanges.clear();
+        for (const std::pair<int, int>& range : ranges) {
+            int begin = std::max(range.first, group.first);
+            int end = std::min(range.second, group.second);
+            if (begin < end) groupRanges.push_back(std::make_pair(begin, end));
+        }
+        if (!groupRanges.empty()) stepRanges(weights.data(), gradient.data(), group.first, group.second, groupRanges);
+    }
+}
+
+void Optimizer::setParameterGroups(const std::vector<std::pair<int, int>>& groups) {
+    this->groups = groups;
+}
+
+double Optimizer::getLearningRate() const {
+    return parameters.learningRate;
+}
+
+void Optimizer::setLearningRate(double learningRate) {
+    parameters.learningRate = learningRate;
+}
+
+std::unique_ptr<Optimizer> Optimizer::create(const std::string& name, size_t numberWeights, const OptimizerParameters& parameters) {
+    if (name == "sgd") return std::unique_ptr<Optimizer>(new SGDOptimizer(parameters));
+    if (name == "nesterov") return std::unique_ptr<Optimizer>(new NesterovOptimizer(numberWeights, parameters));
+    if (name == "rmsprop") return std::unique_ptr<Optimizer>(new RMSpropOptimizer(numberWeights, parameters));
+    if (name == "adam") return std::unique_ptr<Optimizer>(new AdamOptimizer(numberWeights, parameters));
+    if (name == "adamw") return std::unique_ptr<Optimizer>(new AdamWOptimizer(numberWeights, parameters));
+    if (name == "lars") return std::unique_ptr<Optimizer>(new LARSOptimizer(numberWeights, parameters));
+    if (name == "lamb") return std::unique_ptr<Optimizer>(new LAMBOptimizer(numberWeights, parameters));
+    throw std::runtime_error("unknown adaptive learning rate type: " + name);
+}
+
+// The loops below copy the hyperparameters into locals and use restrict pointers so the
+// compiler knows nothing aliases, which lets it keep them in registers and vectorize.
+
+SGDOptimizer::SGDOptimizer(const OptimizerParameters& parameters) : Optimizer(parameters) {}
+
+std::string SGDOptimizer::getName() const {
+    return "sgd";
+}
+
+void SGDOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    const double learningRate = parameters.learningRate;
+    for (size_t i = begin; i < end; ++i) {
+        w[i] -= learningRate * g[i];
+    }
+}
+
+NesterovOptimizer::NesterovOptimizer(size_t numberWeights, const OptimizerParameters& parameters)
+    : Optimizer(parameters), velocity(numberWeights, 0.0) {}
+
+std::string NesterovOptimizer::getName() const {
+    return "nesterov";
+}
+
+void NesterovOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    double* __restrict__ velocities = velocity.data();
+    const double learningRate = parameters.learningRate;
+    const double mu = parameters.mu;
+    for (size_t i = begin; i < end; ++i) {
+        double previous = velocities[i];
+        double next = mu * previous - learningRate * g[i];
+        velocities[i] = next;
+        w[i] += (-1 * mu * previous) + ((1 + mu) * next);
+    }
+}
+
+RMSpropOptimizer::RMSpropOptimizer(size_t numberWeights, const OptimizerParameters& parameters)
+    : Optimizer(parameters), cache(numberWeights, 0.0) {}
+
+std::string RMSpropOptimizer::getName() const {
+    return "rmsprop";
+}
+
+void RMSpropOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    double* __restrict__ caches = cache.data();
+    const double learningRate = parameters.learningRate;
+    const double decayRate = parameters.decayRate;
+    const double eps = parameters.eps;
+    for (size_t i = begin; i < end; ++i) {
+        double c = decayRate * caches[i] + (1 - decayRate) * (g[i] * g[i]);
+        caches[i] = c;
+        w[i] -= (learningRate / (std::sqrt(c) + eps)) * g[i];
+    }
+}
+
+AdamOptimizer::AdamOptimizer(size_t numberWeights, const OptimizerParameters& parameters)
+    : Optimizer(parameters), m(numberWeights, 0.0), v(numberWeights, 0.0) {}
+
+std::string AdamOptimizer::getName() const {
+    return "adam";
+}
+
+void AdamOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    double* __restrict__ firstMoments = m.data();
+    double* __restrict__ secondMoments = v.data();
+    const double learningRate = parameters.learningRate;
+    const double beta1 = parameters.beta1;
+    const double beta2 = parameters.beta2;
+    const double eps = parameters.eps;
+    for (size_t i = begin; i < end; ++i) {
+        double first = beta1 * firstMoments[i] + (1 - beta1) * g[i];
+        double second = beta2 * secondMoments[i] + (1 - beta2) * (g[i] * g[i]);
+        firstMoments[i] = first;
+        secondMoments[i] = second;
+        w[i] -= learningRate * first / std::sqrt(second + eps);
+    }
+}
+
+AdamWOptimizer::AdamWOptimizer(size_t numberWeights, const OptimizerParameters& parameters)
+    : AdamOptimizer(numberWeights, parameters) {}
+
+std::string AdamWOptimizer::getName() const {
+    return "adamw";
+}
+
+void AdamWOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    double* __restrict__ firstMoments = m.data();
+    double* __restrict__ secondMoments = v.data();
+    const double learningRate = parameters.learningRate;
+    const double beta1 = parameters.beta1;
+    const double beta2 = parameters.beta2;
+    const double eps = parameters.eps;
+    const double weightDecay = parameters.weightDecay;
+    for (size_t i = begin; i < end; ++i) {
+        double first = beta1 * firstMoments[i] + (1 - beta1) * g[i];
+        double second = beta2 * secondMoments[i] + (1 - beta2) * (g[i] * g[i]);
+        firstMoments[i] = first;
+        secondMoments[i] = second;
+        w[i] -= learningRate * (first / std::sqrt(second + eps) + weightDecay * w[i]);
+    }
+}
+
+// The layer-wise optimizers need the norms of a whole group before they can update any of
+// its weights, so they make one pass for the norms and a second fused pass for the update.
+
+LARSOptimizer::LARSOptimizer(size_t numberWeights, const OptimizerParameters& parameters)
+    : Optimizer(parameters), velocity(numberWeights, 0.0) {}
+
+std::string LARSOptimizer::getName() const {
+    return "lars";
+}
+
+void LARSOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    update(weights, gradient, begin, end, getTrustRatio(weights, gradient, begin, end));
+}
+
+// A lazy step leaves out rows whose gradient is zero, so the norms over the whole group
+// are those of a full step
+void LARSOptimizer::stepRanges(double* weights, const double* gradient, size_t begin, size_t end, const std::vector<std::pair<int, int>>& ranges) {
+    double trustRatio = getTrustRatio(weights, gradient, begin, end);
+    for (const std::pair<int, int>& range : ranges) {
+        update(weights, gradient, range.first, range.second, trustRatio);
+    }
+}
+
+double LARSOptimizer::getTrustRatio(const double* weights, const double* gradient, size_t begin, size_t end) const {
+    const double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    const double weightDecay = parameters.weightDecay;
+
+    double weightSquares = 0.0;
+    double gradientSquares = 0.0;
+    for (size_t i = begin; i < end; ++i) {
+        weightSquares += w[i] * w[i];
+        gradientSquares += g[i] * g[i];
+    }
+    double weightNorm = std::sqrt(weightSquares);
+    double gradientNorm = std::sqrt(gradientSquares);
+    // Groups that are all zero (e.g. before initialization) fall back to the global learning rate
+    double trustRatio = 1.0;
+    if (weightNorm > 0.0 && gradientNorm > 0.0) {
+        trustRatio = parameters.trustCoefficient * weightNorm / (gradientNorm + weightDecay * weightNorm);
+    }
+    return trustRatio;
+}
+
+void LARSOptimizer::update(double* weights, const double* gradient, size_t begin, size_t end, double trustRatio) {
+    double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    double* __restrict__ velocities = velocity.data();
+    const double learningRate = parameters.learningRate;
+    const double mu = parameters.mu;
+    const double weightDecay = parameters.weightDecay;
+
+    const double localLearningRate = learningRate * trustRatio;
+    for (size_t i = begin; i < end; ++i) {
+        double next = mu * velocities[i] + localLearningRate * (g[i] + weightDecay * w[i]);
+        velocities[i] = next;
+        w[i] -= next;
+    }
+}
+
+LAMBOptimizer::LAMBOptimizer(size_t numberWeights, const OptimizerParameters& parameters)
+    : Optimizer(parameters), m(numberWeights, 0.0), v(numberWeights, 0.0), updates(numberWeights, 0.0),
+      stepNumber(0), firstCorrection(1.0), secondCorrection(1.0) {}
+
+std::string LAMBOptimizer::getName() const {
+    return "lamb";
+}
+
+void LAMBOptimizer::beginStep() {
+    stepNumber++;
+    firstCorrection = 1.0 / (1.0 - std::pow(parameters.beta1, stepNumber));
+    secondCorrection = 1.0 / (1.0 - std::pow(parameters.beta2, stepNumber));
+}
+
+void LAMBOptimizer::step(double* weights, const double* gradient, size_t begin, size_t end) {
+    double weightSquares = 0.0;
+    double updateSquares = 0.0;
+    computeUpdates(weights, gradient, begin, end, weightSquares, updateSquares);
+
+    double* __restrict__ w = weights;
+    const double* __restrict__ update = updates.data();
+    const double stepSize = parameters.learningRate * getTrustRatio(weightSquares, updateSquares);
+    for (size_t i = begin; i < end; ++i) {
+        w[i] -= stepSize * update[i];
+    }
+}
+
+// The weights between the ranges of a lazy step have a zero gradient, their updates are
+// added to the norm as a full step would compute them, in the same order, but not applied
+void LAMBOptimizer::stepRanges(double* weights, const double* gradient, size_t begin, size_t end, const std::vector<std::pair<int, int>>& ranges) {
+    double weightSquares = 0.0;
+    double updateSquares = 0.0;
+    size_t position = begin;
+    for (const std::pair<int, int>& range : ranges) {
+        addIdleUpdates(weights, position, range.first, weightSquares, updateSquares);
+        computeUpdates(weights, gradient, range.first, range.second, weightSquares, updateSquares);
+        position = range.second;
+    }
+    addIdleUpdates(weights, position, end, weightSquares, updateSquares);
+
+    double* __restrict__ w = weights;
+    const double* __restrict__ update = updates.data();
+    const double stepSize = parameters.learningRate * getTrustRatio(weightSquares, updateSquares);
+    for (const std::pair<int, int>& range : ranges) {
+        for (size_t i = range.first; i < static_cast<size_t>(range.second); ++i) {
+            w[i] -= stepSize * update[i];
+        }
+    }
+}
+
+void LAMBOptimizer::computeUpdates(const double* weights, const double* gradient, size_t begin, size_t end, double& weightSquares, double& updateSquares) {
+    const double* __restrict__ w = weights;
+    const double* __restrict__ g = gradient;
+    double* __restrict__ firstMoments = m.data();
+    double* __restrict__ secondMoments = v.data();
+    double* __restrict__ update = updates.data();
+    const double beta1 = parameters.beta1;
+    const double beta2 = parameters.beta2;
+    const double eps = parameters.eps;
+    const double weightDecay = parameters.weightDecay;
+    const double first = firstCorrection;
+    const double second = secondCorrection;
+
+    double weightSum = weightSquares;
+    double updateSum = updateSquares;
+    for (size_t i = begin; i < end; ++i) {
+        double mi = beta1 * firstMoments[i] + (1 - beta1) * g[i];
+        double vi = beta2 * secondMoments[i] + (1 - beta2) * (g[i] * g[i]);
+        firstMoments[i] = mi;
+        secondMoments[i] = vi;
+        double u = (mi * first) / (std::sqrt(vi * second) + eps) + weightDecay * w[i];
+        update[i] = u;
+        weightSum += w[i] * w[i];
+        updateSum += u * u;
+    }
+    weightSquares = weightSum;
+    updateSquares = updateSum;
+}
+
+void LAMBOptimizer::addIdleUpdates(const double* weights, size_t begin, size_t end, double& weightSquares, double& updateSquares) const {
+    const double* __restrict__ w = weights;
+    const double* __restrict__ firstMoments = m.data();
+    const double* __restrict__ secondMoments = v.data();
+    const double beta1 = parameters.beta1;
+    const double beta2 = parameters.beta2;
+    const double eps = parameters.eps;
+    const double weightDecay = parameters.weightDecay;
+    const double first = firstCorrection;
+    const double second = secondCorrection;
+
+    double weightSum = weightSquares;
+    double updateSum = updateSquares;
+    for (size_t i = begin; i < end; ++i) {
+        double mi = beta1 * firstMoments[i] + (1 - beta1) * 0.0;
+        double vi = beta2 * secondMoments[i] + (1 - beta2) * 0.0;
+        double u = (mi * first) / (std::sqrt(vi * second) + eps) + weightDecay * w[i];
+        weightSum += w[i] * w[i];
+        updateSum += u * u;
+    }
+    weightSquares = weightSum;
+    updateSquares = updateSum;
+}
+
+double LAMBOptimizer::getTrustRatio(double weightSquares, double updateSquares) const {
+    double weightNorm = std::sqrt(weightSquares);
+    double updateNorm = std::sqrt(updateSquares);
+    return (weightNorm > 0.0 && updateNorm > 0.0) ? weightNorm / updateNorm : 1.0;
+}
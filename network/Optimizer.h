@@ -0,0 +1,174 @@
+// Optimizer.h
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Hyperparameters of the optimizers, each one only reads the ones it uses
+struct OptimizerParameters {
+    double learningRate = 0.01;
+    double mu = 0.9;
+    double decayRate = 0.9;
+    double eps = 1e-8;
+    double beta1 = 0.9;
+    double beta2 = 0.999;
+    double weightDecay = 0.01;
+    // The trust coefficient (eta) of LARS
+    double trustCoefficient = 0.001;
+};
+
+/**
+ * Updates the flat weight vector of a NeuralNetwork from its gradient. Each
+ * optimizer owns its state buffers (one entry per weight) and applies its
+ * whole update in a single fused pass over contiguous arrays, with no
+ * branches in the loop so the compiler can vectorize it. The optimizer is
+ * chosen once with create() rather than per weight. Layer-wise optimizers
+ * (LARS and LAMB) compute a trust ratio over every group of weights each
+ * step, where the groups are set to the layers of the network. Lazy steps
+ * over ranges of the weights still take those ratios over whole groups.
+ */
+class Optimizer {
+protected:
+    OptimizerParameters parameters;
+    std::vector<std::pair<int, int>> groups;
+    // The ranges of a lazy step that fall in the group being stepped
+    std::vector<std::pair<int, int>> groupRanges;
+
+    explicit Optimizer(const OptimizerParameters& parameters);
+
+    // Called once at the start of every step, before the step over each group or range
+    virtual void beginStep();
+    // Updates the weights in the ranges, which lie in the group [begin, end), one range at a
+    // time; layer-wise optimizers override it to compute their trust ratio over the group
+    virtual void stepRanges(double* weights, const double* gradient, size_t begin, size_t end, const std::vector<std::pair<int, int>>& ranges);
+
+public:
+    virtual ~Optimizer();
+
+    virtual std::string getName() const = 0;
+
+    // Updates weights[begin, end) from gradient[begin, end) in place, a layer-wise optimizer
+    // treating the range as one group
+    virtual void step(double* weights, const double* gradient, size_t begin, size_t end) = 0;
+
+    // Updates all of the weights, one group at a time
+    void step(std::vector<double>& weights, const std::vector<double>& gradient);
+    // Updates only the weights in the given [begin, end) ranges, for lazy updates, splitting
+    // the ranges at the group boundaries. The ranges are sorted and do not overlap, as
+    // NeuralNetwork::getActiveWeightRanges gives them
+    void step(std::vector<double>& weights, const std::vector<double>& gradient, const std::vector<std::pair<int, int>>& ranges);
+
+    // Sets the [begin, end) groups of weights (NeuralNetwork::getLayerWeightRanges) that
+    // layer-wise optimizers compute their trust ratios over, which makes no difference to
+    // the others
+    void setParameterGroups(const std::vector<std::pair<int, int>>& groups);
+
+    double getLearningRate() const;
+    void setLearningRate(double learningRate);
+
+    // Returns the optimizer called name ('sgd', 'nesterov', 'rmsprop', 'adam', 'adamw', 'lars' or 'lamb'), or
+    // throws a runtime_error for an unknown name
+    static std::unique_ptr<Optimizer> create(const std::string& name, size_t numberWeights, const OptimizerParameters& parameters);
+};
+
+// weight -= learningRate * gradient
+class SGDOptimizer : public Optimizer {
+public:
+    SGDOptimizer(const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+// Nesterov momentum in the form that only keeps the velocity
+class NesterovOptimizer : public Optimizer {
+private:
+    std::vector<double> velocity;
+
+public:
+    NesterovOptimizer(size_t numberWeights, const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+class RMSpropOptimizer : public Optimizer {
+private:
+    std::vector<double> cache;
+
+public:
+    RMSpropOptimizer(size_t numberWeights, const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+// Adam as it has always been used here, without bias correction of the moments
+class AdamOptimizer : public Optimizer {
+protected:
+    std::vector<double> m;
+    std::vector<double> v;
+
+public:
+    AdamOptimizer(size_t numberWeights, const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+// Adam with weight decay applied to the weights directly instead of through the gradient
+class AdamWOptimizer : public AdamOptimizer {
+public:
+    AdamWOptimizer(size_t numberWeights, const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+// Layer-wise Adaptive Rate Scaling: momentum SGD where each group's step is scaled by
+// trustCoefficient * |w| / (|g| + weightDecay * |w|)
+class LARSOptimizer : public Optimizer {
+private:
+    std::vector<double> velocity;
+
+    double getTrustRatio(const double* weights, const double* gradient, size_t begin, size_t end) const;
+    void update(double* weights, const double* gradient, size_t begin, size_t end, double trustRatio);
+
+protected:
+    void stepRanges(double* weights, const double* gradient, size_t begin, size_t end, const std::vector<std::pair<int, int>>& ranges);
+
+public:
+    LARSOptimizer(size_t numberWeights, const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+// Layer-wise Adaptive Moments: the bias corrected Adam update plus weight decay, with each
+// group's step scaled by |w| / |update|
+class LAMBOptimizer : public Optimizer {
+private:
+    std::vector<double> m;
+    std::vector<double> v;
+    std::vector<double> updates;
+    int stepNumber;
+    double firstCorrection;
+    double secondCorrection;
+
+    // Updates the moments of the weights in [begin, end) and stores their updates, adding
+    // the squares of the weights and updates to the sums
+    void computeUpdates(const double* weights, const double* gradient, size_t begin, size_t end, double& weightSquares, double& updateSquares);
+    // Adds the squares of the weights in [begin, end) and of the updates a zero gradient would
+    // give them, without changing their moments
+    void addIdleUpdates(const double* weights, size_t begin, size_t end, double& weightSquares, double& updateSquares) const;
+    double getTrustRatio(double weightSquares, double updateSquares) const;
+
+protected:
+    void beginStep();
+    void stepRanges(double* weights, const double* gradient, size_t begin, size_t end, const std::vector<std::pair<int, int>>& ranges);
+
+public:
+    LAMBOptimizer(size_t numberWeights, const OptimizerParameters& parameters);
+    std::string getName() const;
+    void step(double* weights, const double* gradient, size_t begin, size_t end);
+};
+
+#endif // OPTIMIZER_H
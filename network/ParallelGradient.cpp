@@ -0,0 +1,71 @@
+#include "ParallelGradient.h"
+#include "../util/ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+ParallelGradient::ParallelGradient(const NeuralNetwork& nn, ThreadPool* pool, size_t minimumInstancesPerThread)
+    : pool(pool), minimumInstancesPerThread(std::max<size_t>(minimumInstancesPerThread, 1)) {
+    if (pool == nullptr || pool->getNumberThreads() == 1) return;
+
+    replicas.reserve(pool->getNumberThreads());
+    for (int thread = 0; thread < pool->getNumberThreads(); ++thread) {
+        replicas.push_back(nn);
+    }
+    partialGradients.assign(replicas.size(), std::vector<double>(nn.getNumberWeights(), 0.0));
+    weights.assign(nn.getNumberWeights(), 0.0);
+}
+
+void ParallelGradient::addGradient(NeuralNetwork& nn, const std::vector<Instance>& instances, std::vector<double>& gradient) {
+    addGradient(nn, instances, 0, instances.size(), gradient);
+}
+
+void ParallelGradient::addGradient(NeuralNetwork& nn, const std::vector<Instance>& instances, size_t begin, size_t end, std::vector<double>& gradient) {
+    if (replicas.empty() || end - begin < minimumInstancesPerThread * 2) {
+        nn.addGradient(instances, begin, end, gradient);
+        return;
+    }
+    if (gradient.size() != static_cast<size_t>(nn.getNumberWeights())) {
+        throw std::runtime_error("Cannot add the gradient of " + std::to_string(nn.getNumberWeights()) + " weights to a buffer of " + std::to_string(gradient.size()) + ".");
+    }
+
+    // Only as many replicas as there are full slices of the batch take part, and no more than
+    // the slices of that size need, so none of them is given an empty slice. The tasks capture
+    // the call through one reference so their std::function does not allocate
+    struct Call {
+        const std::vector<Instance>& instances;
+        size_t begin;
+        size_t end;
+        size_t numberReplicas;
+        size_t sliceSize;
+        std::vector<double>& gradient;
+    } call = { instances, begin, end, std::min(replicas.size(), (end - begin) / minimumInstancesPerThread), 0, gradient };
+    call.sliceSize = (end - begin + call.numberReplicas - 1) / call.numberReplicas;
+    call.numberReplicas = (end - begin + call.sliceSize - 1) / call.sliceSize;
+    nn.getWeights(weights);
+    pool->run([this, &call](int thread) {
+        if (static_cast<size_t>(thread) >= call.numberReplicas) return;
+        size_t sliceBegin = call.begin + thread * call.sliceSize;
+        size_t sliceEnd = std::min(sliceBegin + call.sliceSize, call.end);
+        std::vector<double>& partial = partialGradients[thread];
+        std::fill(partial.begin(), partial.end(), 0.0);
+        replicas[thread].setWeights(weights);
+        replicas[thread].addGradient(call.instances, sliceBegin, sliceEnd, partial);
+    });
+
+    // The partial gradients are always added in thread order, so the sum only depends on the number of threads
+    pool->parallelFor(gradient.size(), [this, &call](size_t begin, size_t end, int /*thread*/) {
+        double* gradient = call.gradient.data();
+        for (size_t replica = 0; replica < call.numberReplicas; ++replica) {
+            const double* partial = partialGradients[replica].data();
+            for (size_t i = begin; i < end; ++i) {
+                gradient[i] += partial[i];
+            }
+        }
+    });
+}
+
+int ParallelGradient::getNumberReplicas() const {
+    return replicas.size();
+}
@@ -0,0 +1,42 @@
+// ParallelGradient.h
+#ifndef PARALLEL_GRADIENT_H
+#define PARALLEL_GRADIENT_H
+
+#include "NeuralNetwork.h"
+#include "../data/Instance.h"
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Computes the gradient of a batch data-parallel: every thread of the pool
+ * has its own replica of the neural network, runs the forward and backward
+ * passes of its slice of the batch into its own gradient buffer, and the
+ * buffers are then summed (in parallel over the weights). The replicas are
+ * synced to the weights of the trained network on every call. Batches too
+ * small to be worth splitting are run by the network itself. Once the
+ * buffers exist a call makes no heap allocations.
+ */
+class ParallelGradient {
+private:
+    ThreadPool* pool;
+    size_t minimumInstancesPerThread;
+    std::vector<NeuralNetwork> replicas;
+    std::vector<std::vector<double>> partialGradients;
+    // The weights the replicas are synced to, kept so a call does not allocate
+    std::vector<double> weights;
+
+public:
+    // A null pool or a pool of one thread always runs the network itself
+    ParallelGradient(const NeuralNetwork& nn, ThreadPool* pool, size_t minimumInstancesPerThread = 32);
+
+    // Adds the summed gradient of the instances for the current weights of nn to gradient
+    void addGradient(NeuralNetwork& nn, const std::vector<Instance>& instances, std::vector<double>& gradient);
+    // The same for only the instances in [begin, end)
+    void addGradient(NeuralNetwork& nn, const std::vector<Instance>& instances, size_t begin, size_t end, std::vector<double>& gradient);
+
+    int getNumberReplicas() const;
+};
+
+#endif // PARALLEL_GRADIENT_H
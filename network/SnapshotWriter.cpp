@@ -0,0 +1,59 @@
+#include "SnapshotWriter.h"
+#include "ModelFile.h"
+#include "../util/Log.h"
+#include <stdexcept>
+
+SnapshotWriter::SnapshotWriter(const std::string& filename, const NeuralNetwork& nn, const Normalizer* normalizer)
+    : filename(filename), nn(nn), hasNormalizer(normalizer != nullptr && normalizer->getNumberInputs() > 0),
+      hasPending(false), stopping(false), numberSaved(0) {
+    if (hasNormalizer) this->normalizer = *normalizer;
+    worker = std::thread(&SnapshotWriter::run, this);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    snapshotAvailable.notify_one();
+    worker.join();
+}
+
+void SnapshotWriter::save(const std::vector<double>& weights) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = weights;
+        hasPending = true;
+    }
+    snapshotAvailable.notify_one();
+}
+
+size_t SnapshotWriter::getNumberSaved() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numberSaved;
+}
+
+void SnapshotWriter::run() {
+    std::vector<double> weights;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        snapshotAvailable.wait(lock, [this] { return stopping || hasPending; });
+        if (!hasPending) return;
+        weights.swap(pending);
+        hasPending = false;
+        lock.unlock();
+
+        bool saved = true;
+        try {
+            nn.setWeights(weights);
+            ModelFile::save(filename, nn, hasNormalizer ? &normalizer : nullptr);
+        }
+        catch (const std::exception& e) {
+            Log::error("Could not save a snapshot to '" + filename + "': " + (std::string) e.what());
+            saved = false;
+        }
+
+        lock.lock();
+        if (saved) numberSaved++;
+    }
+}
@@ -0,0 +1,52 @@
+// SnapshotWriter.h
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include "NeuralNetwork.h"
+#include "../data/Normalizer.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Saves snapshots of the weights of a network as model files on a thread
+ * of its own, so training does not stall while a file is written. Taking a
+ * snapshot only copies the weights. If the previous snapshot is still being
+ * written, a newer one replaces the one waiting, so only the latest weights
+ * are saved. Model files are saved with a rename, so readers of the file
+ * always see a complete snapshot.
+ */
+class SnapshotWriter {
+private:
+    std::string filename;
+    NeuralNetwork nn;
+    Normalizer normalizer;
+    bool hasNormalizer;
+
+    std::mutex mutex;
+    std::condition_variable snapshotAvailable;
+    std::vector<double> pending;
+    bool hasPending;
+    bool stopping;
+    size_t numberSaved;
+    std::thread worker;
+
+    void run();
+
+public:
+    // nn gives the topology of the snapshots, normalizer is saved with them if given
+    SnapshotWriter(const std::string& filename, const NeuralNetwork& nn, const Normalizer* normalizer = nullptr);
+    // Saves the snapshot still waiting before returning
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void save(const std::vector<double>& weights);
+    size_t getNumberSaved();
+};
+
+#endif // SNAPSHOT_WRITER_H
@@ -0,0 +1,26 @@
+#include "TrainingSession.h"
+#include "ParallelGradient.h"
+#include "../util/PhaseTimer.h"
+#include <algorithm>
+#include <vector>
+
+TrainingSession::TrainingSession(NeuralNetwork& nn, Optimizer& optimizer, ParallelGradient* parallelGradient)
+    : nn(nn), optimizer(optimizer), parallelGradient(parallelGradient), gradient(nn.getNumberWeights(), 0.0), weights(nn.getNumberWeights(), 0.0) {
+}
+
+void TrainingSession::step(const std::vector<Instance>& instances, size_t begin, size_t end) {
+    std::fill(gradient.begin(), gradient.end(), 0.0);
+    {
+        ScopedPhase phase(Phase::GRADIENT);
+        if (parallelGradient != nullptr) parallelGradient->addGradient(nn, instances, begin, end, gradient);
+        else nn.addGradient(instances, begin, end, gradient);
+    }
+    ScopedPhase phase(Phase::UPDATE);
+    nn.getWeights(weights);
+    optimizer.step(weights, gradient);
+    nn.setWeights(weights);
+}
+
+const std::vector<double>& TrainingSession::getGradient() const {
+    return gradient;
+}
@@ -0,0 +1,40 @@
+// TrainingSession.h
+#ifndef TRAINING_SESSION_H
+#define TRAINING_SESSION_H
+
+#include "NeuralNetwork.h"
+#include "Optimizer.h"
+#include "../data/Instance.h"
+#include <cstddef>
+#include <vector>
+
+class ParallelGradient;
+
+/**
+ * Trains a network one minibatch step after another with every buffer
+ * allocated up front: the batches are ranges of the instances rather than
+ * copies, the gradient and the weights go into the session's own buffers,
+ * and the data-parallel gradient and the optimizers reuse theirs. Once the
+ * first step has sized everything a step makes no heap allocations, so the
+ * threads of a step never wait on the allocator.
+ */
+class TrainingSession {
+private:
+    NeuralNetwork& nn;
+    Optimizer& optimizer;
+    ParallelGradient* parallelGradient;
+    std::vector<double> gradient;
+    std::vector<double> weights;
+
+public:
+    // Without a parallel gradient the network computes the gradients itself
+    TrainingSession(NeuralNetwork& nn, Optimizer& optimizer, ParallelGradient* parallelGradient = nullptr);
+
+    // Updates the weights of the network with the summed gradient of the instances in [begin, end)
+    void step(const std::vector<Instance>& instances, size_t begin, size_t end);
+
+    // The gradient of the last step
+    const std::vector<double>& getGradient() const;
+};
+
+#endif // TRAINING_SESSION_H
@@ -0,0 +1,93 @@
+// AllocationCounter.cpp
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+std::atomic<bool> AllocationCounter::enabled(false);
+std::atomic<uint64_t> AllocationCounter::allocations(0);
+std::atomic<uint64_t> AllocationCounter::bytes(0);
+
+bool AllocationCounter::isAvailable() {
+#ifdef COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationCounter::setEnabled(bool enabled) {
+    AllocationCounter::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+AllocationCount AllocationCounter::get() {
+    return AllocationCount{ allocations.load(std::memory_order_relaxed), bytes.load(std::memory_order_relaxed) };
+}
+
+#ifdef COUNT_ALLOCATIONS
+
+namespace {
+
+void* allocate(size_t size) {
+    if (AllocationCounter::isEnabled()) AllocationCounter::add(size);
+    if (size == 0) size = 1;
+    void* pointer;
+    while ((pointer = std::malloc(size)) == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) return nullptr;
+        handler();
+    }
+    return pointer;
+}
+
+} // namespace
+
+// The replacements of the global allocation functions, which every new expression and std::allocator call, so every heap allocation is counted
+
+void* operator new(size_t size) {
+    void* pointer = allocate(size);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    void* pointer = allocate(size);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    // A new handler can only report failure by throwing
+    try {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+#endif // COUNT_ALLOCATIONS
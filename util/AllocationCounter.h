@@ -0,0 +1,54 @@
+// AllocationCounter.h
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A number of heap allocations and the bytes they asked for
+struct AllocationCount {
+    uint64_t allocations;
+    uint64_t bytes;
+
+    AllocationCount operator-(const AllocationCount& other) const {
+        return AllocationCount{ allocations - other.allocations, bytes - other.bytes };
+    }
+};
+
+/**
+ * Counts the heap allocations of every thread, through the replacement of
+ * the global operator new in AllocationCounter.cpp, for the allocations per
+ * training step and per call of --allocations and the benchmarks. The
+ * replacement is only compiled in with -DCOUNT_ALLOCATIONS, which the tests
+ * and benchmarks are built with; the other binaries keep the allocator of
+ * the standard library and count nothing. While counting is disabled an
+ * allocation costs one predictable branch more; while it is enabled, two
+ * relaxed atomic adds that every allocating thread contends on, so it is
+ * only meant for measuring.
+ */
+class AllocationCounter {
+private:
+    // Read by the operator new of every thread, so it is atomic even though the order does not matter
+    static std::atomic<bool> enabled;
+    static std::atomic<uint64_t> allocations;
+    static std::atomic<uint64_t> bytes;
+
+public:
+    // Whether the replacement operator new is compiled in, without it nothing is counted
+    static bool isAvailable();
+    static void setEnabled(bool enabled);
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static void add(size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    // The allocations counted so far, subtract two counts for those in between
+    static AllocationCount get();
+};
+
+#endif // ALLOCATION_COUNTER_H
@@ -5,6 +5,20 @@
 #include <string>
 #include <iostream>
 #include "../data/DataSet.h"
+#include "../data/DataSetFile.h"
+#include "../data/StreamingDataSet.h"
+#include "../data/Normalizer.h"
+#include "ThreadPool.h"
+#include "BoundedQueue.h"
+#include "RollingAverage.h"
+#include "BenchmarkRunner.h"
+#include "PhaseTimer.h"
+#include "PerfCounters.h"
+#include "TraceRecorder.h"
+#include "../data/InstanceStream.h"
+#include <fstream>
+#include <thread>
+#include <cstdio>
 #include "../data/Instance.h"
 #include "../network/NeuralNetwork.h"
 #include "../network/LossFunction.h"
@@ -35,19 +49,19 @@ bool gradientsCloseEnough(std::vector<double> g1, std::vector<double> g2) {
     } else if (relativeError >= 1e-5) {
         Log::warning("relativeError probably bad: " + std::to_string(relativeError));
         for (int i = 0; i < g1.size(); ++i) {
-            Log::trace("\tg1[" + std::to_string(i) + "]: " + std::to_string(g1[i]) + ", g2[" + std::to_string(i) + "]: " + std::to_string(g2[i]) + ", difference: " + std::to_string(fabs(g1[i] - g2[i])));
+            LOG_TRACE("\tg1[" + std::to_string(i) + "]: " + std::to_string(g1[i]) + ", g2[" + std::to_string(i) + "]: " + std::to_string(g2[i]) + ", difference: " + std::to_string(fabs(g1[i] - g2[i])));
         }
     } else if (relativeError >= 1e-7) {
-        Log::debug("relativeError might be bad: " + std::to_string(relativeError));
+        LOG_DEBUG("relativeError might be bad: " + std::to_string(relativeError));
         for (int i = 0; i < g1.size(); ++i) {
-            Log::trace("\tg1[" + std::to_string(i) + "]: " + std::to_string(g1[i]) + ", g2[" + std::to_string(i) + "]: " + std::to_string(g2[i]) + ", difference: " + std::to_string(fabs(g1[i] - g2[i])));
+            LOG_TRACE("\tg1[" + std::to_string(i) + "]: " + std::to_string(g1[i]) + ", g2[" + std::to_string(i) + "]: " + std::to_string(g2[i]) + ", difference: " + std::to_string(fabs(g1[i] - g2[i])));
         }
     }
     return relativeError <= 1e-5;
 }
 
 void checkGetSetWeights(NeuralNetwork network, std::string networkName) {
-    Log::debug("Testing get/set weights on neural network '" + networkName + "'");
+    LOG_DEBUG("Testing get/set weights on neural network '" + networkName + "'");
     int numberWeights = network.getNumberWeights();
     std::vector<double> testWeights(numberWeights);
     for (int i = 0; i < numberWeights; ++i) {
@@ -57,7 +71,7 @@ void checkGetSetWeights(NeuralNetwork network, std::string networkName) {
     std::vector<double> testWeights2 = network.getWeights();
     bool passed = true;
     for (int i = 0; i < numberWeights; ++i) {
-        Log::trace("testWeights[" + std::to_string(i) + "]: " + std::to_string(testWeights[i]) 
+        LOG_TRACE("testWeights[" + std::to_string(i) + "]: " + std::to_string(testWeights[i]) 
             + ", testWeights2[" + std::to_string(i) + "]: " + std::to_string(testWeights2[i]));
         if (testWeights[i] != testWeights2[i]) {
             throw std::runtime_error("Failed getSetWeights test on " + networkName + ", testWeights[" + std::to_string(i) + "] was " 
@@ -80,7 +94,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [0 : 0, 0]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstance 0.");
+            LOG_TRACE("testLoadingXOR passed getInstance 0.");
         }
 
         Instance i1 = xorData.getInstance(1);
@@ -90,7 +104,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [1 : 1, 0]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstance 1.");
+            LOG_TRACE("testLoadingXOR passed getInstance 1.");
         }
 
         Instance i2 = xorData.getInstance(2);
@@ -100,7 +114,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [1 : 0, 1]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstance 2.");
+            LOG_TRACE("testLoadingXOR passed getInstance 2.");
         }
 
         Instance i3 = xorData.getInstance(3);
@@ -110,7 +124,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [0 : 1, 1]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstance 3.");
+            LOG_TRACE("testLoadingXOR passed getInstance 3.");
         }
 
         //Gets all instances as once to test the getInstances Method
@@ -121,7 +135,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [0 : 0, 0]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstances 0.");
+            LOG_TRACE("testLoadingXOR passed getInstances 0.");
         }
 
         if (!is[1].equals(std::vector<double>{1}, std::vector<double>{1, 0})) {
@@ -130,7 +144,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [0 : 1 , 0]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstances 1.");
+            LOG_TRACE("testLoadingXOR passed getInstances 1.");
         }
 
         if (!is[2].equals(std::vector<double>{1}, std::vector<double>{0, 1})) {
@@ -139,7 +153,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [1 : 0, 1]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstances 2.");
+            LOG_TRACE("testLoadingXOR passed getInstances 2.");
            }
 
         if (!is[3].equals(std::vector<double>{0}, std::vector<double>{1, 1})) {
@@ -148,7 +162,7 @@ void testLoadingXOR() {
             Log::error("\tshould have been: [0 : 1, 1]");
             passed = false;
         } else {
-            Log::trace("testLoadingXOR passed getInstances 3.");
+            LOG_TRACE("testLoadingXOR passed getInstances 3.");
         }
     } catch (const std::exception& e) {
         Log::fatal("Exception occurred in testLoadingXOR: " + (std::string) e.what());
@@ -162,6 +176,287 @@ void testLoadingXOR() {
     }
 }
 
+void testLoadingStreamingXOR() {
+    bool passed = true;
+    Log::info("Streaming the xor data set from a binary file.");
+    const std::string binaryFilename = "./xor_test.bin";
+    try {
+        //write the xor data set out in the binary format
+        DataSet xorData = DataSet("xor data", "./datasets/xor.txt");
+        DataSetWriter writer(binaryFilename, xorData.getNumberOutputs(), xorData.getNumberInputs(), true);
+        for (const Instance& instance : xorData.getInstances()) {
+            writer.write(instance.expectedOutputs, instance.getInputs());
+        }
+        writer.close();
+
+        //loading the binary file should give back the same instances
+        DataSet binaryData = DataSet("xor data", binaryFilename);
+        if (binaryData.getNumberInstances() != 4 || binaryData.getNumberInputs() != 2 || binaryData.getNumberOutputs() != 1) {
+            throw std::runtime_error("binary xor data set had the wrong shape.");
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (!binaryData.getInstance(i).equals(xorData.getInstance(i))) {
+                throw std::runtime_error("binary instance " + std::to_string(i) + " was " + binaryData.getInstance(i).toString()
+                    + " but should have been " + xorData.getInstance(i).toString());
+            }
+        }
+
+        //streaming it with a tiny chunk and shuffle buffer should still hand out
+        //every instance exactly once per epoch
+        StreamingDataSet streamingData = StreamingDataSet("xor data", binaryFilename, 2, 5);
+        if (streamingData.getNumberInstances() != 4 || streamingData.getNumberClasses() != 2
+            || !closeEnough(streamingData.getInputMeans()[0], 0.5) || !closeEnough(streamingData.getInputStandardDeviations()[1], std::sqrt(1.0 / 3.0))) {
+            throw std::runtime_error("streaming xor data set had the wrong shape or statistics.");
+        }
+        for (int epoch = 0; epoch < 3; ++epoch) {
+            std::vector<Instance> batch;
+            std::vector<int> seen(4, 0);
+            streamingData.startEpoch();
+            while (streamingData.getNextBatch(3, batch)) {
+                for (const Instance& instance : batch) {
+                    for (int i = 0; i < 4; ++i) {
+                        if (instance.equals(xorData.getInstance(i))) seen[i]++;
+                    }
+                }
+            }
+            if (seen != std::vector<int>{1, 1, 1, 1}) {
+                throw std::runtime_error("streaming epoch " + std::to_string(epoch) + " did not return each instance exactly once.");
+            }
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testLoadingStreamingXOR: " + (std::string) e.what());
+        passed = false;
+    }
+    std::remove(binaryFilename.c_str());
+
+    if (passed) {
+        Log::info("Passed testLoadingStreamingXOR.");
+    } else {
+        Log::fatal("FAILED testLoadingStreamingXOR!");
+    }
+}
+
+void testNormalizer() {
+    bool passed = true;
+    Log::info("Testing the Normalizer on the iris data set.");
+    const std::string normalizerFilename = "./normalizer_test.txt";
+    try {
+        DataSet irisData = DataSet("iris data", "./datasets/iris.txt");
+
+        //the statistics gathered by 4 threads and merged should be the
+        //same as the ones gathered by a single thread
+        Normalizer serial;
+        serial.fit(irisData.getInstances());
+        ThreadPool pool(4);
+        Normalizer parallel;
+        parallel.fit(irisData.getInstances(), &pool);
+
+        std::vector<double> expectedMeans{5.843333333333334, 3.054, 3.758666666666667, 1.198666666666667};
+        std::vector<double> expectedDeviations{0.828066127977863, 0.433594311362174, 1.764420419952262, 0.763160741700841};
+        if (!vectorsCloseEnough(serial.getMeans(), expectedMeans) || !vectorsCloseEnough(serial.getStandardDeviations(), expectedDeviations)) {
+            throw std::runtime_error("serial Normalizer statistics were wrong.");
+        }
+        if (!vectorsCloseEnough(parallel.getMeans(), expectedMeans) || !vectorsCloseEnough(parallel.getStandardDeviations(), expectedDeviations)) {
+            throw std::runtime_error("parallel Normalizer statistics were wrong.");
+        }
+
+        //a saved and loaded Normalizer should apply exactly the same transform
+        parallel.save(normalizerFilename);
+        Normalizer loaded = Normalizer::load(normalizerFilename);
+        DataSet normalizedData = DataSet("iris data", "./datasets/iris.txt");
+        DataSet loadedData = DataSet("iris data", "./datasets/iris.txt");
+        normalizedData.normalize(parallel, &pool);
+        loadedData.normalize(loaded);
+        for (size_t i = 0; i < normalizedData.getNumberInstances(); ++i) {
+            if (!normalizedData.getInstance(i).equals(loadedData.getInstance(i))) {
+                throw std::runtime_error("loaded Normalizer gave a different transform on instance " + std::to_string(i));
+            }
+        }
+
+        //the normalized data should have a mean of 0 and a standard deviation of 1
+        Normalizer check;
+        check.fit(normalizedData.getInstances());
+        if (!vectorsCloseEnough(check.getMeans(), std::vector<double>(4, 0.0)) || !vectorsCloseEnough(check.getStandardDeviations(), std::vector<double>(4, 1.0))) {
+            throw std::runtime_error("normalized data did not have mean 0 and standard deviation 1.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testNormalizer: " + (std::string) e.what());
+        passed = false;
+    }
+    std::remove(normalizerFilename.c_str());
+
+    if (passed) {
+        Log::info("Passed testNormalizer.");
+    } else {
+        Log::fatal("FAILED testNormalizer!");
+    }
+}
+
+void testPackedInstances() {
+    bool passed = true;
+    Log::info("Testing bit packed instances on the mushroom data set.");
+    try {
+        //the one-hot encoded mushroom data set only has 0/1 inputs so it
+        //should be bit packed, the iris data set should not
+        DataSet mushroomData = DataSet("mushroom data", "./datasets/agaricus-lepiota.txt");
+        DataSet irisData = DataSet("iris data", "./datasets/iris.txt");
+        if (!mushroomData.isPacked() || irisData.isPacked() || irisData.getInstance(0).isPacked()) {
+            throw std::runtime_error("only the mushroom data set should have been bit packed.");
+        }
+
+        NeuralNetwork network = NeuralNetwork(mushroomData.getNumberInputs(), std::vector<int>{10, 5}, mushroomData.getNumberClasses(), LossFunction::SOFTMAX);
+        network.connectFully();
+        network.initializeRandomly(0.1);
+
+        //a packed instance should hold the same inputs and give exactly the
+        //same loss and gradient as the same instance stored densely
+        for (size_t i = 0; i < 50; ++i) {
+            Instance packedInstance = mushroomData.getInstance(i * 100);
+            Instance denseInstance = packedInstance;
+            denseInstance.unpack();
+            if (!packedInstance.isPacked() || denseInstance.isPacked() || !packedInstance.equals(denseInstance)
+                || denseInstance.inputs.size() != 126 || packedInstance.packedInputs.size() != 2) {
+                throw std::runtime_error("unpacking instance " + std::to_string(i * 100) + " gave " + denseInstance.toString());
+            }
+
+            double packedLoss = network.forwardPass(packedInstance);
+            double denseLoss = network.forwardPass(denseInstance);
+            if (packedLoss != denseLoss) {
+                throw std::runtime_error("packed loss " + std::to_string(packedLoss) + " was not the dense loss " + std::to_string(denseLoss));
+            }
+            if (network.getGradient(packedInstance) != network.getGradient(denseInstance)) {
+                throw std::runtime_error("packed gradient was not the dense gradient on instance " + std::to_string(i * 100));
+            }
+        }
+
+        //normalizing has to unpack the instances
+        mushroomData.normalize(Normalizer(std::vector<double>(126, 0.5), std::vector<double>(126, 0.5)));
+        if (mushroomData.isPacked() || mushroomData.getInstance(0).isPacked() || mushroomData.getInstance(0).inputs.size() != 126) {
+            throw std::runtime_error("normalized mushroom data set was still bit packed.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testPackedInstances: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testPackedInstances.");
+    } else {
+        Log::fatal("FAILED testPackedInstances!");
+    }
+}
+
+void testSparseInstances() {
+    bool passed = true;
+    Log::info("Testing sparse instances on the mushroom data set.");
+    const std::string textFilename = "./mushroom_sparse_test.txt";
+    const std::string binaryFilename = "./mushroom_sparse_test.bin";
+    try {
+        //write the mushroom data set out in the sparse text and binary formats
+        DataSet mushroomData = DataSet("mushroom data", "./datasets/agaricus-lepiota.txt");
+        DataSetWriter textWriter(textFilename, 1, mushroomData.getNumberInputs(), false, DataSetFormat::SPARSE);
+        DataSetWriter binaryWriter(binaryFilename, 1, mushroomData.getNumberInputs(), true, DataSetFormat::SPARSE);
+        for (const Instance& instance : mushroomData.getInstances()) {
+            textWriter.write(instance.expectedOutputs, instance.getInputs());
+            binaryWriter.write(instance.expectedOutputs, instance.getInputs());
+        }
+        textWriter.close();
+        binaryWriter.close();
+
+        //both should load as sparse data sets holding the same instances
+        DataSet textData = DataSet("sparse mushroom data", textFilename);
+        DataSet binaryData = DataSet("sparse mushroom data", binaryFilename);
+        if (!textData.isSparse() || !binaryData.isSparse() || textData.getNumberInputs() != 126 || binaryData.getNumberInputs() != 126
+            || textData.getNumberInstances() != mushroomData.getNumberInstances()) {
+            throw std::runtime_error("sparse mushroom data sets had the wrong shape.");
+        }
+        for (size_t i = 0; i < mushroomData.getNumberInstances(); ++i) {
+            if (!textData.getInstance(i).equals(mushroomData.getInstance(i)) || !binaryData.getInstance(i).equals(mushroomData.getInstance(i))) {
+                throw std::runtime_error("sparse instance " + std::to_string(i) + " was " + binaryData.getInstance(i).toString()
+                    + " but should have been " + mushroomData.getInstance(i).toString());
+            }
+        }
+
+        //sparse and dense batches should give exactly the same gradient, which
+        //is 0 outside of the weight ranges a lazy update touches
+        NeuralNetwork network = NeuralNetwork(126, std::vector<int>{10, 5}, 2, LossFunction::SOFTMAX);
+        network.connectFully();
+        network.initializeRandomly(0.1);
+        for (size_t position = 0; position < 1000; position += 20) {
+            std::vector<Instance> sparseBatch = binaryData.getInstances(position, 20);
+            std::vector<Instance> denseBatch = sparseBatch;
+            for (Instance& instance : denseBatch) {
+                instance.unpack();
+            }
+
+            std::vector<double> sparseGradient = network.getGradient(sparseBatch);
+            std::vector<double> denseGradient = network.getGradient(denseBatch);
+            if (sparseGradient != denseGradient || network.forwardPass(sparseBatch) != network.forwardPass(denseBatch)) {
+                throw std::runtime_error("sparse gradient was not the dense gradient on the batch at " + std::to_string(position));
+            }
+
+            std::vector<bool> active(network.getNumberWeights(), false);
+            for (const std::pair<int, int>& range : network.getActiveWeightRanges(sparseBatch)) {
+                for (int i = range.first; i < range.second; ++i) active[i] = true;
+            }
+            for (int i = 0; i < network.getNumberWeights(); ++i) {
+                if (!active[i] && sparseGradient[i] != 0.0) {
+                    throw std::runtime_error("weight " + std::to_string(i) + " had a gradient but was not in the active weight ranges.");
+                }
+            }
+        }
+
+        //streaming the sparse file should hand out every instance once per epoch
+        StreamingDataSet streamingData = StreamingDataSet("sparse mushroom data", binaryFilename, 100);
+        std::vector<Instance> batch;
+        size_t count = 0;
+        streamingData.startEpoch();
+        while (streamingData.getNextBatch(64, batch)) {
+            for (const Instance& instance : batch) {
+                if (!instance.isSparse() || instance.getNumberInputs() != 126) {
+                    throw std::runtime_error("streamed instance was not sparse with 126 inputs.");
+                }
+            }
+            count += batch.size();
+        }
+        if (!streamingData.isSparse() || count != mushroomData.getNumberInstances()) {
+            throw std::runtime_error("streaming the sparse data set returned " + std::to_string(count) + " instances.");
+        }
+
+        //binary files with indices past the inputs, past INT_MAX or not increasing should not load
+        const std::vector<std::vector<uint32_t>> corruptIndices = { { 7, 1 }, { 99999, 3 }, { 3, 10 }, { 3, 0x80000000u } };
+        for (const std::vector<uint32_t>& corrupt : corruptIndices) {
+            DataSetWriter corruptWriter(binaryFilename, 1, 10, true, DataSetFormat::SPARSE);
+            corruptWriter.write(std::vector<double>{ 1.0 }, std::vector<int>{ 1, 2 }, std::vector<double>{ 0.5, 0.5 });
+            corruptWriter.close();
+            std::fstream file(binaryFilename, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(sizeof(DataSetFileHeader) + sizeof(double) + sizeof(uint32_t));
+            file.write(reinterpret_cast<const char*>(corrupt.data()), corrupt.size() * sizeof(uint32_t));
+            file.close();
+            bool rejected = false;
+            try {
+                DataSet corruptData = DataSet("corrupt sparse data", binaryFilename);
+            } catch (const std::runtime_error& e) {
+                rejected = true;
+            }
+            if (!rejected) {
+                throw std::runtime_error("a binary sparse file with the indices " + std::to_string(corrupt[0]) + ", " + std::to_string(corrupt[1]) + " was not rejected.");
+            }
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testSparseInstances: " + (std::string) e.what());
+        passed = false;
+    }
+    std::remove(textFilename.c_str());
+    std::remove(binaryFilename.c_str());
+
+    if (passed) {
+        Log::info("Passed testSparseInstances.");
+    } else {
+        Log::fatal("FAILED testSparseInstances!");
+    }
+}
+
 void testXORNeuralNetwork() {
     bool passed = true;
 
@@ -260,3 +555,361 @@ void testXORNeuralNetwork() {
         Log::fatal("FAILED testXORNeuralNetwork!");
     }
 }
+
+void testBoundedQueue() {
+    bool passed = true;
+    Log::info("Testing the BoundedQueue between a producer and a consumer thread.");
+    try {
+        //a queue of 3 between threads should hand over every item
+        //in order, and the producer can never get more than 3 ahead
+        BoundedQueue<int> queue(3);
+        const int numberItems = 10000;
+        std::thread producer([&queue] {
+            for (int i = 0; i < numberItems; i++) {
+                queue.push(i);
+            }
+            queue.close();
+        });
+        int item;
+        int expected = 0;
+        while (queue.pop(item)) {
+            if (item != expected) {
+                producer.join();
+                throw std::runtime_error("popped item " + std::to_string(item) + " where item " + std::to_string(expected) + " was expected.");
+            }
+            expected++;
+        }
+        producer.join();
+        if (expected != numberItems) {
+            throw std::runtime_error("popped " + std::to_string(expected) + " items instead of " + std::to_string(numberItems) + ".");
+        }
+
+        //a closed queue drains what it holds but takes nothing new
+        BoundedQueue<int> closing(2);
+        closing.push(1);
+        closing.close();
+        if (closing.push(2) || !closing.pop(item) || item != 1 || closing.pop(item)) {
+            throw std::runtime_error("a closed queue did not drain its items and then stop.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testBoundedQueue: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testBoundedQueue.");
+    } else {
+        Log::fatal("FAILED testBoundedQueue!");
+    }
+}
+
+void testRollingAverage() {
+    bool passed = true;
+    Log::info("Testing the RollingAverage over a window of the last values.");
+    try {
+        RollingAverage average(4);
+        if (average.getAverage() != 0.0 || average.getCount() != 0) {
+            throw std::runtime_error("an empty average was not 0.");
+        }
+        average.add(1.0);
+        average.add(2.0);
+        if (!closeEnough(average.getAverage(), 1.5) || average.getCount() != 2) {
+            throw std::runtime_error("the average of a partly filled window was " + std::to_string(average.getAverage()) + " instead of 1.5.");
+        }
+        //once the window is full the oldest values drop out
+        for (int i = 3; i <= 10; i++) {
+            average.add(i);
+        }
+        if (!closeEnough(average.getAverage(), 8.5) || average.getCount() != 4) {
+            throw std::runtime_error("the average of the last 4 values was " + std::to_string(average.getAverage()) + " instead of 8.5.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testRollingAverage: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testRollingAverage.");
+    } else {
+        Log::fatal("FAILED testRollingAverage!");
+    }
+}
+
+void testInstanceStream() {
+    bool passed = true;
+    Log::info("Testing reading the instances of a stream one line at a time.");
+    const std::string filename = "test_instance_stream.txt";
+    try {
+        {
+            std::ofstream file(filename);
+            file << "1:0.5,1.5\n";
+            file << "not an instance\n";
+            file << "0:2,3\n";
+            file << "1:0:1.0,1:2.0\n";
+        }
+        InstanceStream stream(filename);
+        Instance instance({}, {});
+        std::vector<std::vector<double>> expectedInputs = { {0.5, 1.5}, {2.0, 3.0}, {1.0, 2.0} };
+        std::vector<double> expectedClasses = { 1.0, 0.0, 1.0 };
+        size_t numberRead = 0;
+        while (stream.next(instance)) {
+            if (numberRead >= expectedInputs.size()) {
+                throw std::runtime_error("read more instances than the stream has.");
+            }
+            if (instance.expectedOutputs[0] != expectedClasses[numberRead] || !vectorsCloseEnough(instance.getInputs(), expectedInputs[numberRead])) {
+                throw std::runtime_error("instance " + std::to_string(numberRead) + " was not read correctly.");
+            }
+            numberRead++;
+        }
+        if (numberRead != expectedInputs.size() || stream.getNumberSkipped() != 1 || stream.getNumberInputs() != 2) {
+            throw std::runtime_error("read " + std::to_string(numberRead) + " instances and skipped " + std::to_string(stream.getNumberSkipped())
+                + " lines instead of reading 3 and skipping 1.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testInstanceStream: " + (std::string) e.what());
+        passed = false;
+    }
+    remove(filename.c_str());
+
+    if (passed) {
+        Log::info("Passed testInstanceStream.");
+    } else {
+        Log::fatal("FAILED testInstanceStream!");
+    }
+}
+
+void testBenchmarkRunner() {
+    bool passed = true;
+    Log::info("Testing the statistics and timing of the BenchmarkRunner.");
+    try {
+        BenchmarkResult result;
+        result.samples = { 4.0, 1.0, 3.0, 2.0 };
+        result.summarize();
+        if (!closeEnough(result.mean, 2.5) || !closeEnough(result.median, 2.5) || result.minimum != 1.0 || result.maximum != 4.0
+                || !closeEnough(result.standardDeviation, std::sqrt(5.0 / 3.0))) {
+            throw std::runtime_error("the summary of the samples 1 to 4 was wrong.");
+        }
+
+        //every repetition should time enough iterations to last the minimum time
+        BenchmarkRunner runner(1, 3, 0.001);
+        long calls = 0;
+        const BenchmarkResult& timed = runner.run("increment", "none", 0, [&calls] { calls++; });
+        if (timed.samples.size() != 3 || timed.iterations < 2 || calls < static_cast<long>(timed.iterations * 4) || timed.mean <= 0.0) {
+            throw std::runtime_error("the runner did not time 3 repetitions of at least the minimum time.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testBenchmarkRunner: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testBenchmarkRunner.");
+    } else {
+        Log::fatal("FAILED testBenchmarkRunner!");
+    }
+}
+
+void testPhaseTimer() {
+    bool passed = true;
+    Log::info("Testing that the PhaseTimer only times phases while enabled.");
+    try {
+        PhaseTimer::reset();
+        {
+            ScopedPhase phase(Phase::UPDATE);
+        }
+        if (PhaseTimer::getCount(Phase::UPDATE) != 0 || PhaseTimer::getSeconds(Phase::UPDATE) != 0.0) {
+            throw std::runtime_error("a phase was timed while the timer was disabled.");
+        }
+
+        //the forward passes of several threads add up
+        PhaseTimer::setEnabled(true);
+        {
+            ScopedPhase phase(Phase::UPDATE);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([] { PhaseTimer::add(Phase::FORWARD, 1000000, 10); });
+        }
+        for (std::thread& thread : threads) thread.join();
+        PhaseTimer::setEnabled(false);
+
+        if (PhaseTimer::getCount(Phase::UPDATE) != 1 || PhaseTimer::getSeconds(Phase::UPDATE) < 0.002) {
+            throw std::runtime_error("the scoped phase was not timed.");
+        }
+        if (PhaseTimer::getCount(Phase::FORWARD) != 40 || !closeEnough(PhaseTimer::getSeconds(Phase::FORWARD), 0.004)) {
+            throw std::runtime_error("the times added by the threads were lost.");
+        }
+        if (PhaseTimer::getName(Phase::BACKWARD) != "backward") {
+            throw std::runtime_error("the backward phase was misnamed.");
+        }
+        PhaseTimer::reset();
+        if (PhaseTimer::getCount(Phase::FORWARD) != 0 || PhaseTimer::getSeconds(Phase::UPDATE) != 0.0) {
+            throw std::runtime_error("reset did not clear the phases.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testPhaseTimer: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testPhaseTimer.");
+    } else {
+        Log::fatal("FAILED testPhaseTimer!");
+    }
+}
+
+void testTraceRecorder() {
+    bool passed = true;
+    Log::info("Testing that the TraceRecorder writes the events of every thread as Chrome trace JSON.");
+    std::string filename = "./test_trace.json";
+    try {
+        TraceRecorder::start(3);
+        TraceRecorder::setThreadName("main");
+        {
+            ScopedTrace trace("outer", "test");
+            ScopedPhase phase(Phase::SHUFFLING);
+        }
+        //the worker keeps its first 3 events and drops the other 2
+        std::thread worker([] {
+            TraceRecorder::setThreadName("worker");
+            for (int i = 0; i < 5; i++) {
+                int64_t begin = TraceRecorder::now();
+                TraceRecorder::record("step", "test", begin, TraceRecorder::now(), "index", i);
+            }
+        });
+        worker.join();
+        TraceRecorder::stop();
+        {
+            ScopedTrace trace("stopped", "test");
+        }
+
+        size_t numberEvents = TraceRecorder::write(filename);
+        if (numberEvents != 5 || TraceRecorder::getNumberDropped() != 2) {
+            throw std::runtime_error("wrote " + std::to_string(numberEvents) + " events and dropped " + std::to_string(TraceRecorder::getNumberDropped())
+                + " instead of 5 and 2.");
+        }
+
+        std::ifstream file(filename);
+        std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        for (const char* expected : { "\"traceEvents\"", "\"name\": \"worker\"", "\"name\": \"shuffling\", \"cat\": \"phase\", \"ph\": \"X\"",
+                "\"args\": {\"index\": 2}" }) {
+            if (json.find(expected) == std::string::npos) {
+                throw std::runtime_error("the trace has no " + std::string(expected) + ".");
+            }
+        }
+        if (json.find("\"index\": 3") != std::string::npos || json.compare(json.size() - 4, 4, "\n]}\n") != 0) {
+            throw std::runtime_error("the trace kept a dropped event or was not closed.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testTraceRecorder: " + (std::string) e.what());
+        passed = false;
+    }
+    remove(filename.c_str());
+
+    if (passed) {
+        Log::info("Passed testTraceRecorder.");
+    } else {
+        Log::fatal("FAILED testTraceRecorder!");
+    }
+}
+
+void testLogMacros() {
+    bool passed = true;
+    Log::info("Testing that the log macros only build the messages of enabled levels.");
+    try {
+        int built = 0;
+        auto message = [&built](const std::string& text) {
+            built++;
+            return text;
+        };
+        //the default level is INFO
+        LOG_TRACE(message("not built"));
+        LOG_DEBUG(message("not built"));
+        if (built != 0 || Log::isEnabled(Log::DEBUG) || !Log::isEnabled(Log::INFO)) {
+            throw std::runtime_error("a message of a disabled level was built.");
+        }
+        LOG_INFO(message("the log macros built this message"));
+        if (built != 1) {
+            throw std::runtime_error("the message of an enabled level was not built.");
+        }
+
+        //the asynchronous sink writes out everything before it stops
+        Log::setAsynchronous(true);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([i] { LOG_INFO("asynchronous message from thread " + std::to_string(i)); });
+        }
+        for (std::thread& thread : threads) thread.join();
+        Log::flush();
+        Log::setAsynchronous(false);
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testLogMacros: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testLogMacros.");
+    } else {
+        Log::fatal("FAILED testLogMacros!");
+    }
+}
+
+void testPerfCounters() {
+    bool passed = true;
+    Log::info("Testing that the PerfCounters read the available counters and NaN for the others.");
+    try {
+        //the sandboxes and virtual machines the tests run in often have no counters, which must not fail
+        PerfCounters counters;
+        if (!counters.isAvailable()) {
+            Log::info("The hardware counters are not available: " + counters.getUnavailableReason());
+        }
+        std::vector<double> before = counters.read();
+        double sum = 0.0;
+        for (int i = 1; i <= 1000000; i++) sum += 1.0 / i;
+        BenchmarkRunner::keep(sum);
+        std::vector<double> after = counters.read();
+        if (before.size() != PerfCounters::NUMBER_COUNTERS || after.size() != PerfCounters::NUMBER_COUNTERS) {
+            throw std::runtime_error("a read did not return every counter.");
+        }
+        for (int i = 0; i < PerfCounters::NUMBER_COUNTERS; i++) {
+            PerfCounters::Counter counter = static_cast<PerfCounters::Counter>(i);
+            if (!counters.isAvailable(counter) && !std::isnan(after[i])) {
+                throw std::runtime_error("the unavailable counter " + PerfCounters::getName(counter) + " was not NaN.");
+            }
+        }
+        if (counters.isAvailable(PerfCounters::INSTRUCTIONS) && !(after[PerfCounters::INSTRUCTIONS] > before[PerfCounters::INSTRUCTIONS] + 1000000)) {
+            throw std::runtime_error("the instructions of a million additions were not counted.");
+        }
+        if (!counters.countsThisThread()) {
+            throw std::runtime_error("the counters do not count the thread that opened them.");
+        }
+
+        //the phase timer adds up the counters of the phases on the counted thread
+        PhaseTimer::reset();
+        PhaseTimer::setEnabled(true);
+        PhaseTimer::setCounters(&counters);
+        {
+            ScopedPhase phase(Phase::UPDATE);
+        }
+        std::vector<double> phaseCounts = PhaseTimer::getCounters(Phase::UPDATE);
+        PhaseTimer::setCounters(nullptr);
+        PhaseTimer::setEnabled(false);
+        if (phaseCounts.size() != PerfCounters::NUMBER_COUNTERS) {
+            throw std::runtime_error("the phase did not read the counters.");
+        }
+        PhaseTimer::reset();
+        if (!PhaseTimer::getCounters(Phase::UPDATE).empty()) {
+            throw std::runtime_error("reset did not clear the counters of the phases.");
+        }
+    } catch (const std::exception& e) {
+        Log::fatal("Exception occurred in testPerfCounters: " + (std::string) e.what());
+        passed = false;
+    }
+
+    if (passed) {
+        Log::info("Passed testPerfCounters.");
+    } else {
+        Log::fatal("FAILED testPerfCounters!");
+    }
+}
\ No newline at end of file
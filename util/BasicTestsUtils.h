@@ -10,6 +10,18 @@ bool vectorsCloseEnough(std::vector<double> v1, std::vector<double> v2);
 bool gradientsCloseEnough(std::vector<double> g1, std::vector<double> g2);
 void checkGetSetWeights(NeuralNetwork network, std::string networkName);
 void testLoadingXOR();
+void testLoadingStreamingXOR();
+void testNormalizer();
+void testPackedInstances();
+void testSparseInstances();
 void testXORNeuralNetwork();
+void testBoundedQueue();
+void testRollingAverage();
+void testInstanceStream();
+void testBenchmarkRunner();
+void testPhaseTimer();
+void testTraceRecorder();
+void testLogMacros();
+void testPerfCounters();
 
 #endif
\ No newline at end of file
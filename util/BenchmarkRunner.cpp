@@ -0,0 +1,161 @@
+// BenchmarkRunner.cpp
+#include "BenchmarkRunner.h"
+#include "PerfCounters.h"
+#include "AllocationCounter.h"
+#include "Json.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+
+// Written by keep, volatile so the compiler cannot drop the results it is given
+volatile double benchmarkSink;
+
+} // namespace
+
+void BenchmarkResult::summarize() {
+    if (samples.empty()) return;
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    minimum = sorted.front();
+    maximum = sorted.back();
+    median = n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+    mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / n;
+    double sumSquares = 0.0;
+    for (double sample : sorted) {
+        sumSquares += (sample - mean) * (sample - mean);
+    }
+    // The sample standard deviation, so it estimates the spread of the timings rather than of these samples
+    standardDeviation = n > 1 ? std::sqrt(sumSquares / (n - 1)) : 0.0;
+}
+
+BenchmarkRunner::BenchmarkRunner(int warmup, int repetitions, double minimumSeconds)
+    : warmup(std::max(0, warmup)), repetitions(std::max(1, repetitions)), minimumSeconds(minimumSeconds), counters(nullptr) {
+}
+
+void BenchmarkRunner::setCounters(const PerfCounters* counters) {
+    this->counters = counters;
+}
+
+double BenchmarkRunner::time(const std::function<void()>& body, size_t iterations) const {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        body();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const BenchmarkResult& BenchmarkRunner::run(const std::string& name, const std::string& topology, size_t numberWeights, const std::function<void()>& body) {
+    BenchmarkResult result;
+    result.name = name;
+    result.topology = topology;
+    result.numberWeights = numberWeights;
+
+    // Doubles the iterations until a repetition takes the minimum time, then scales them up to
+    // it, the calibration runs doubling as a first warmup
+    size_t iterations = 1;
+    double seconds = time(body, iterations);
+    while (seconds < minimumSeconds / 2.0 && iterations < (static_cast<size_t>(1) << 40)) {
+        iterations *= 2;
+        seconds = time(body, iterations);
+    }
+    if (seconds < minimumSeconds) {
+        iterations = static_cast<size_t>(std::ceil(iterations * minimumSeconds / std::max(seconds, 1e-9)));
+    }
+    result.iterations = iterations;
+
+    for (int i = 0; i < warmup; i++) {
+        time(body, iterations);
+    }
+    std::vector<double> before;
+    if (counters != nullptr) before = counters->read();
+    for (int i = 0; i < repetitions; i++) {
+        result.samples.push_back(time(body, iterations) * 1e9 / iterations);
+    }
+    if (counters != nullptr) {
+        result.counters = counters->read();
+        for (size_t i = 0; i < result.counters.size(); i++) {
+            result.counters[i] = (result.counters[i] - before[i]) / (static_cast<double>(iterations) * repetitions);
+        }
+    }
+
+    // Counting allocations slows them down, so they are counted on a call of their own
+    if (AllocationCounter::isAvailable()) {
+        bool counting = AllocationCounter::isEnabled();
+        AllocationCounter::setEnabled(true);
+        AllocationCount start = AllocationCounter::get();
+        body();
+        AllocationCount allocated = AllocationCounter::get() - start;
+        AllocationCounter::setEnabled(counting);
+        result.allocations = allocated.allocations;
+        result.allocatedBytes = allocated.bytes;
+    }
+    result.summarize();
+    results.push_back(result);
+    return results.back();
+}
+
+void BenchmarkRunner::add(const BenchmarkResult& result) {
+    results.push_back(result);
+}
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::getResults() const {
+    return results;
+}
+
+static std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) return "null";
+    char text[32];
+    snprintf(text, sizeof(text), "%.6g", value);
+    return text;
+}
+
+void BenchmarkRunner::writeJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context) const {
+    out << "{\n  \"context\": {";
+    for (size_t i = 0; i < context.size(); i++) {
+        out << (i > 0 ? ",\n    " : "\n    ") << jsonString(context[i].first) << ": " << jsonString(context[i].second);
+    }
+    out << "\n  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        out << (i > 0 ? ",\n    {" : "\n    {")
+            << "\"name\": " << jsonString(result.name)
+            << ", \"topology\": " << jsonString(result.topology)
+            << ", \"weights\": " << result.numberWeights
+            << ", \"unit\": \"ns\""
+            << ", \"iterations\": " << result.iterations
+            << ", \"repetitions\": " << result.samples.size()
+            << ", \"derived\": " << (result.derived ? "true" : "false")
+            << ", \"mean\": " << jsonNumber(result.mean)
+            << ", \"stddev\": " << jsonNumber(result.standardDeviation)
+            << ", \"median\": " << jsonNumber(result.median)
+            << ", \"min\": " << jsonNumber(result.minimum)
+            << ", \"max\": " << jsonNumber(result.maximum);
+        if (AllocationCounter::isAvailable()) {
+            out << ", \"allocations\": " << result.allocations
+                << ", \"allocated_bytes\": " << result.allocatedBytes;
+        }
+        out << ", \"samples\": [";
+        for (size_t j = 0; j < result.samples.size(); j++) {
+            out << (j > 0 ? ", " : "") << jsonNumber(result.samples[j]);
+        }
+        out << "]";
+        if (!result.counters.empty()) {
+            out << ", \"counters\": {";
+            for (size_t j = 0; j < result.counters.size(); j++) {
+                out << (j > 0 ? ", " : "") << jsonString(PerfCounters::getName(static_cast<PerfCounters::Counter>(j))) << ": " << jsonNumber(result.counters[j]);
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void BenchmarkRunner::keep(double value) {
+    benchmarkSink = value;
+}
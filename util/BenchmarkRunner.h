@@ -0,0 +1,80 @@
+// BenchmarkRunner.h
+#ifndef BENCHMARK_RUNNER_H
+#define BENCHMARK_RUNNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class PerfCounters;
+
+// The timings of one benchmark, in nanoseconds per operation
+struct BenchmarkResult {
+    std::string name;
+    std::string topology;
+    size_t numberWeights = 0;
+    // Operations timed together in each repetition
+    size_t iterations = 0;
+    // The nanoseconds per operation of every repetition
+    std::vector<double> samples;
+    double mean = 0.0;
+    double standardDeviation = 0.0;
+    double median = 0.0;
+    double minimum = 0.0;
+    double maximum = 0.0;
+    // Set for results computed from other results rather than timed themselves
+    bool derived = false;
+    // The hardware counts per operation over the timed repetitions, in the order of PerfCounters::Counter,
+    // NaN for the counters that are not available; empty unless the runner has counters
+    std::vector<double> counters;
+    // The heap allocations and bytes of one more call after the timed ones, with the body warmed up
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+
+    // Fills in the summary statistics from the samples
+    void summarize();
+};
+
+/**
+ * Times small pieces of code. Each benchmark first finds how many
+ * iterations of its body take at least the minimum time, so even
+ * operations of a few nanoseconds are timed over many calls, then runs a
+ * number of warmup repetitions that are thrown away and the repetitions
+ * that are kept, one sample per repetition. The results can be written as
+ * JSON for comparing runs.
+ */
+class BenchmarkRunner {
+private:
+    int warmup;
+    int repetitions;
+    double minimumSeconds;
+    const PerfCounters* counters;
+    std::vector<BenchmarkResult> results;
+
+    // Seconds taken by the given number of iterations of the body
+    double time(const std::function<void()>& body, size_t iterations) const;
+
+public:
+    BenchmarkRunner(int warmup, int repetitions, double minimumSeconds);
+
+    // Also reads the hardware counters around the timed repetitions, which must count the thread benchmarking
+    void setCounters(const PerfCounters* counters);
+
+    // Times the body and keeps the result
+    const BenchmarkResult& run(const std::string& name, const std::string& topology, size_t numberWeights, const std::function<void()>& body);
+    // Keeps a result that was not timed by run, such as one derived from two timed results
+    void add(const BenchmarkResult& result);
+
+    const std::vector<BenchmarkResult>& getResults() const;
+    // Writes the results, after a context object of the given names and values describing the run
+    void writeJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context) const;
+
+    // Keeps the compiler from optimizing away a value that is otherwise unused
+    static void keep(double value);
+};
+
+#endif // BENCHMARK_RUNNER_H
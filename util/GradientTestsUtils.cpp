@@ -4,11 +4,29 @@
 #include <stdio.h>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <algorithm>
 #include "../data/DataSet.h"
 #include "../network/LossFunction.h"
 #include "Vector.h"
 #include "Log.h"
 #include "../network/NeuralNetwork.h"
+#include "../network/Optimizer.h"
+#include "../network/LearningRateSchedule.h"
+#include "../network/EarlyStopping.h"
+#include "../network/ParallelGradient.h"
+#include "../network/LBFGS.h"
+#include "../network/ModelFile.h"
+#include "../network/InferenceBatcher.h"
+#include "../network/ModelHandle.h"
+#include "../network/SnapshotWriter.h"
+#include "../network/TrainingSession.h"
+#include "../network/Ensemble.h"
+#include "AllocationCounter.h"
+#include <atomic>
+#include "LatencyHistogram.h"
+#include <thread>
+#include "ThreadPool.h"
 #include "../data/Instance.h"
 #include "BasicTestsUtils.h"
 #include "NNTestsUtils.h"
@@ -268,7 +286,7 @@ void testTinyGradients(DataSet dataSet, LossFunction lossFunction) {
                     throw std::runtime_error("testTinyGradients failed on repeat " + std::to_string(repeat) + " and instance" + std::to_string(i) + "!");
                 }
             }
-            Log::trace("testTinyGradients passed repeat " + std::to_string(repeat) + "!");
+            LOG_TRACE("testTinyGradients passed repeat " + std::to_string(repeat) + "!");
 
             if ((repeat % 10) == 0) {
                 Log::info("testTinyGradients repeat " + std::to_string(repeat) + " completed.");
@@ -306,7 +324,7 @@ void testSmallGradients(DataSet dataSet, LossFunction lossFunction) {
                     throw   std::runtime_error("testSmallGradients failed on repeat " + std::to_string(repeat) + " and instance" + std::to_string(i) + "!");
                 }
             }
-            Log::trace("testSmallGradients passed repeat " + std::to_string(repeat) + "!");
+            LOG_TRACE("testSmallGradients passed repeat " + std::to_string(repeat) + "!");
 
             if ((repeat % 10) == 0) {
                 Log::info("testSmallGradients repeat " + std::to_string(repeat) + " completed.");
@@ -346,7 +364,7 @@ void testLargeGradients(DataSet dataSet, LossFunction lossFunction) {
                     throw   std::runtime_error("testLargeGradients failed on repeat " + std::to_string(repeat) + " and instance" + std::to_string(i) + "!");
                 }
             }
-            Log::trace("testLargeGradients passed repeat " + std::to_string(repeat) + "!");
+            LOG_TRACE("testLargeGradients passed repeat " + std::to_string(repeat) + "!");
 
             if ((repeat % 10) == 0) {
                 Log::info("testLargeGradients repeat " + std::to_string(repeat) + " completed.");
@@ -375,7 +393,7 @@ void testNetworkOnInstances(NeuralNetwork& nn, std::vector<Instance>& instances,
         throw   std::runtime_error(description + " failed!");
     }
 
-    Log::trace(description + " passed!");
+    LOG_TRACE(description + " passed!");
 }
 
 void testTinyGradientsMultiInstance(DataSet dataSet, LossFunction lossFunction) {
@@ -501,6 +519,932 @@ void testLargeGradientsMultiInstance(DataSet dataSet, LossFunction lossFunction)
 
 }
 
+/**
+ * This tests the fused optimizer steps against the per weight update
+ * formulas they replace, over several steps so the state buffers are
+ * exercised, and checks that a step over a set of ranges leaves the
+ * weights (and state) outside of those ranges alone.
+ */
+void testOptimizers() {
+    try {
+        OptimizerParameters parameters;
+        parameters.learningRate = 0.05;
+        parameters.mu = 0.9;
+        parameters.decayRate = 0.95;
+        parameters.eps = 1e-7;
+        parameters.beta1 = 0.9;
+        parameters.beta2 = 0.999;
+        parameters.weightDecay = 0.01;
+
+        const int numberWeights = 37;
+        const int numberSteps = 5;
+        std::vector<double> initialWeights(numberWeights);
+        std::vector<std::vector<double>> gradients(numberSteps, std::vector<double>(numberWeights));
+        for (int j = 0; j < numberWeights; j++) {
+            initialWeights[j] = (random_double() * 2.0) - 1.0;
+        }
+        for (int step = 0; step < numberSteps; step++) {
+            for (int j = 0; j < numberWeights; j++) {
+                gradients[step][j] = (random_double() * 2.0) - 1.0;
+            }
+        }
+
+        for (std::string name : {"sgd", "nesterov", "rmsprop", "adam", "adamw"}) {
+            std::unique_ptr<Optimizer> optimizer = Optimizer::create(name, numberWeights, parameters);
+            if (optimizer->getName() != name) {
+                throw std::runtime_error("Optimizer::create('" + name + "') created '" + optimizer->getName() + "'.");
+            }
+
+            std::vector<double> weights = initialWeights;
+            std::vector<double> expected = initialWeights;
+            std::vector<double> velocity(numberWeights, 0.0), cache(numberWeights, 0.0), m(numberWeights, 0.0);
+            for (int step = 0; step < numberSteps; step++) {
+                const std::vector<double>& gradient = gradients[step];
+                optimizer->step(weights, gradient);
+
+                for (int j = 0; j < numberWeights; j++) {
+                    if (name == "sgd") {
+                        expected[j] -= parameters.learningRate * gradient[j];
+                    }
+                    else if (name == "nesterov") {
+                        double previous = velocity[j];
+                        velocity[j] = parameters.mu * velocity[j] - parameters.learningRate * gradient[j];
+                        expected[j] += (-1 * parameters.mu * previous) + ((1 + parameters.mu) * velocity[j]);
+                    }
+                    else if (name == "rmsprop") {
+                        cache[j] = parameters.decayRate * cache[j] + (1 - parameters.decayRate) * std::pow(gradient[j], 2);
+                        expected[j] -= (parameters.learningRate / (std::sqrt(cache[j]) + parameters.eps)) * gradient[j];
+                    }
+                    else {
+                        m[j] = parameters.beta1 * m[j] + (1 - parameters.beta1) * gradient[j];
+                        velocity[j] = parameters.beta2 * velocity[j] + (1 - parameters.beta2) * std::pow(gradient[j], 2);
+                        double decay = name == "adamw" ? parameters.weightDecay * expected[j] : 0.0;
+                        expected[j] -= parameters.learningRate * (m[j] / std::sqrt(velocity[j] + parameters.eps) + decay);
+                    }
+                }
+            }
+
+            for (int j = 0; j < numberWeights; j++) {
+                if (std::fabs(weights[j] - expected[j]) > 1e-12) {
+                    throw std::runtime_error(name + " weight " + std::to_string(j) + " was " + std::to_string(weights[j]) + " instead of " + std::to_string(expected[j]) + ".");
+                }
+            }
+
+            // Only the weights in the ranges may change
+            std::vector<std::pair<int, int>> ranges{std::make_pair(2, 5), std::make_pair(10, 11), std::make_pair(30, numberWeights)};
+            std::vector<double> before = weights;
+            optimizer->step(weights, gradients[0], ranges);
+            for (int j = 0; j < numberWeights; j++) {
+                bool inRange = (j >= 2 && j < 5) || j == 10 || j >= 30;
+                if (inRange == (weights[j] == before[j])) {
+                    throw std::runtime_error(name + " step over ranges " + (inRange ? "did not update" : "updated") + " weight " + std::to_string(j) + ".");
+                }
+            }
+            Log::info("Passed testOptimizers " + name + ".");
+        }
+
+        bool threw = false;
+        try {
+            Optimizer::create("adagrad", numberWeights, parameters);
+        } catch (const std::runtime_error& e) {
+            threw = true;
+        }
+        if (!threw) throw std::runtime_error("Optimizer::create did not reject an unknown optimizer.");
+
+        Log::info("Passed testOptimizers.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testOptimizers!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * This tests the layer ranges of the weights and that LARS and LAMB
+ * compute their trust ratios over each layer separately, by comparing
+ * them to the update formulas applied to every layer on its own, also
+ * when a lazy step only updates some of the weights of a layer.
+ */
+void testLayerWiseOptimizers(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        NeuralNetwork smallNN = createSmallNeuralNetwork(dataSet, lossFunction);
+        std::vector<std::pair<int, int>> layers = smallNN.getLayerWeightRanges();
+        int position = 0;
+        for (const std::pair<int, int>& layer : layers) {
+            if (layer.first != position || layer.second < layer.first) {
+                throw std::runtime_error("the layer weight ranges are not contiguous at weight " + std::to_string(position) + ".");
+            }
+            position = layer.second;
+        }
+        if (position != smallNN.getNumberWeights() || layers.back().first != layers.back().second) {
+            throw std::runtime_error("the layer weight ranges do not end with the empty output layer at the last weight.");
+        }
+
+        OptimizerParameters parameters;
+        parameters.learningRate = 0.5;
+        parameters.mu = 0.9;
+        parameters.eps = 1e-6;
+        parameters.beta1 = 0.9;
+        parameters.beta2 = 0.999;
+        parameters.weightDecay = 0.01;
+        parameters.trustCoefficient = 0.02;
+
+        int numberWeights = smallNN.getNumberWeights();
+        std::vector<double> initialWeights(numberWeights);
+        for (int j = 0; j < numberWeights; j++) {
+            initialWeights[j] = (random_double() * 2.0) - 1.0;
+        }
+        const int numberSteps = 3;
+
+        for (std::string name : {"lars", "lamb"}) {
+            std::unique_ptr<Optimizer> optimizer = Optimizer::create(name, numberWeights, parameters);
+            optimizer->setParameterGroups(layers);
+            std::vector<double> weights = initialWeights;
+            std::vector<double> expected = initialWeights;
+            std::vector<double> velocity(numberWeights, 0.0), m(numberWeights, 0.0);
+            for (int step = 1; step <= numberSteps; step++) {
+                std::vector<double> gradient(numberWeights);
+                for (int j = 0; j < numberWeights; j++) {
+                    gradient[j] = (random_double() * 2.0) - 1.0;
+                }
+                optimizer->step(weights, gradient);
+
+                for (const std::pair<int, int>& layer : layers) {
+                    double weightNorm = 0.0, otherNorm = 0.0;
+                    std::vector<double> update(numberWeights, 0.0);
+                    for (int j = layer.first; j < layer.second; j++) {
+                        weightNorm += expected[j] * expected[j];
+                        if (name == "lars") {
+                            otherNorm += gradient[j] * gradient[j];
+                        }
+                        else {
+                            m[j] = parameters.beta1 * m[j] + (1 - parameters.beta1) * gradient[j];
+                            velocity[j] = parameters.beta2 * velocity[j] + (1 - parameters.beta2) * gradient[j] * gradient[j];
+                            double mHat = m[j] / (1 - std::pow(parameters.beta1, step));
+                            double vHat = velocity[j] / (1 - std::pow(parameters.beta2, step));
+                            update[j] = mHat / (std::sqrt(vHat) + parameters.eps) + parameters.weightDecay * expected[j];
+                            otherNorm += update[j] * update[j];
+                        }
+                    }
+                    weightNorm = std::sqrt(weightNorm);
+                    otherNorm = std::sqrt(otherNorm);
+                    for (int j = layer.first; j < layer.second; j++) {
+                        if (name == "lars") {
+                            double trustRatio = parameters.trustCoefficient * weightNorm / (otherNorm + parameters.weightDecay * weightNorm);
+                            velocity[j] = parameters.mu * velocity[j] + parameters.learningRate * trustRatio * (gradient[j] + parameters.weightDecay * expected[j]);
+                            expected[j] -= velocity[j];
+                        }
+                        else {
+                            expected[j] -= parameters.learningRate * (weightNorm / otherNorm) * update[j];
+                        }
+                    }
+                }
+            }
+
+            for (int j = 0; j < numberWeights; j++) {
+                if (std::fabs(weights[j] - expected[j]) > 1e-12) {
+                    throw std::runtime_error(name + " weight " + std::to_string(j) + " was " + std::to_string(weights[j]) + " instead of " + std::to_string(expected[j]) + ".");
+                }
+            }
+            Log::info("Passed testLayerWiseOptimizers " + name + ".");
+        }
+
+        // A lazy step takes the trust ratio over the whole layer, as a full step does when the
+        // gradient outside the ranges is zero, so the updated weights are the same
+        std::vector<std::pair<int, int>> lazyRanges{std::make_pair(0, 2), std::make_pair(layers[1].first, numberWeights)};
+        std::vector<double> lazyGradient(numberWeights);
+        for (int j = 0; j < numberWeights; j++) {
+            bool inRange = j < 2 || j >= layers[1].first;
+            lazyGradient[j] = inRange ? (random_double() * 2.0) - 1.0 : 0.0;
+        }
+        for (std::string name : {"lars", "lamb"}) {
+            std::unique_ptr<Optimizer> lazy = Optimizer::create(name, numberWeights, parameters);
+            std::unique_ptr<Optimizer> full = Optimizer::create(name, numberWeights, parameters);
+            lazy->setParameterGroups(layers);
+            full->setParameterGroups(layers);
+            std::vector<double> lazyWeights = initialWeights, fullWeights = initialWeights;
+            std::vector<double> firstGradient(numberWeights, 0.25);
+            lazy->step(lazyWeights, firstGradient);
+            full->step(fullWeights, firstGradient);
+            std::vector<double> before = lazyWeights;
+            lazy->step(lazyWeights, lazyGradient, lazyRanges);
+            full->step(fullWeights, lazyGradient);
+            for (int j = 0; j < numberWeights; j++) {
+                bool inRange = j < 2 || j >= layers[1].first;
+                if (inRange && lazyWeights[j] != fullWeights[j]) {
+                    throw std::runtime_error(name + " lazy step updated weight " + std::to_string(j) + " to " + std::to_string(lazyWeights[j])
+                        + " instead of " + std::to_string(fullWeights[j]) + ", its trust ratio was not that of the whole layer.");
+                }
+                if (!inRange && lazyWeights[j] != before[j]) {
+                    throw std::runtime_error(name + " lazy step updated weight " + std::to_string(j) + " outside of its ranges.");
+                }
+            }
+        }
+
+        // Splitting the weights into groups makes no difference to an element-wise optimizer
+        std::unique_ptr<Optimizer> grouped = Optimizer::create("adam", numberWeights, parameters);
+        std::unique_ptr<Optimizer> ungrouped = Optimizer::create("adam", numberWeights, parameters);
+        grouped->setParameterGroups(layers);
+        std::vector<double> groupedWeights = initialWeights, ungroupedWeights = initialWeights;
+        std::vector<double> gradient(numberWeights, 0.25);
+        grouped->step(groupedWeights, gradient);
+        ungrouped->step(ungroupedWeights, gradient);
+        if (groupedWeights != ungroupedWeights) {
+            throw std::runtime_error("setting the parameter groups changed the updates of adam.");
+        }
+
+        Log::info("Passed testLayerWiseOptimizers.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testLayerWiseOptimizers!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * This tests the learning rates the schedules give for each epoch,
+ * including the warmup and the reaction of the plateau schedule to
+ * the loss, and that malformed schedules are rejected.
+ */
+void testLearningRateSchedules() {
+    try {
+        auto expectRate = [](const LearningRateSchedule& schedule, int epoch, double expected, const std::string& description) {
+            double rate = schedule.getLearningRate(epoch);
+            if (std::fabs(rate - expected) > 1e-12) {
+                throw std::runtime_error(description + " gave a learning rate of " + std::to_string(rate) + " instead of " + std::to_string(expected) + " in epoch " + std::to_string(epoch) + ".");
+            }
+        };
+
+        std::unique_ptr<LearningRateSchedule> constant = LearningRateSchedule::create("constant", 0.1, 10);
+        expectRate(*constant, 0, 0.1, "constant");
+        expectRate(*constant, 9, 0.1, "constant");
+
+        std::unique_ptr<LearningRateSchedule> step = LearningRateSchedule::create("step:3:0.5", 0.1, 10);
+        expectRate(*step, 2, 0.1, "step");
+        expectRate(*step, 3, 0.05, "step");
+        expectRate(*step, 7, 0.025, "step");
+
+        std::unique_ptr<LearningRateSchedule> exponential = LearningRateSchedule::create("exponential:0.9", 0.1, 10);
+        expectRate(*exponential, 2, 0.1 * 0.81, "exponential");
+
+        std::unique_ptr<LearningRateSchedule> cosine = LearningRateSchedule::create("cosine:0.01", 0.1, 10);
+        expectRate(*cosine, 0, 0.1, "cosine");
+        expectRate(*cosine, 5, 0.055, "cosine");
+        expectRate(*cosine, 10, 0.01, "cosine");
+
+        // The warmup ramps up over the first 4 epochs, then the cosine anneals over the remaining 10
+        std::unique_ptr<LearningRateSchedule> warmup = LearningRateSchedule::create("cosine", 0.1, 14, 4);
+        expectRate(*warmup, 0, 0.02, "warmup");
+        expectRate(*warmup, 3, 0.08, "warmup");
+        expectRate(*warmup, 4, 0.1, "warmup");
+        expectRate(*warmup, 9, 0.05, "warmup");
+
+        std::unique_ptr<LearningRateSchedule> plateau = LearningRateSchedule::create("plateau:2:0.5:0.03", 0.1, 10);
+        std::vector<double> losses{1.0, 0.9, 0.95, 0.92, 0.8, 0.85, 0.85, 0.9, 0.9};
+        std::vector<double> rates{0.1, 0.1, 0.1, 0.05, 0.05, 0.05, 0.03, 0.03, 0.03};
+        for (size_t epoch = 0; epoch < losses.size(); epoch++) {
+            plateau->endEpoch(losses[epoch]);
+            expectRate(*plateau, epoch + 1, rates[epoch], "plateau");
+        }
+
+        for (std::string malformed : {"linear", "step:3", "step:0:0.5", "exponential:x", "plateau:2", ""}) {
+            bool threw = false;
+            try {
+                LearningRateSchedule::create(malformed, 0.1, 10);
+            } catch (const std::runtime_error& e) {
+                threw = true;
+            }
+            if (!threw) throw std::runtime_error("the malformed schedule '" + malformed + "' was not rejected.");
+        }
+
+        Log::info("Passed testLearningRateSchedules.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testLearningRateSchedules!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * This tests that early stopping waits patience epochs without an
+ * improvement larger than the minimum delta and keeps the weights of
+ * the best epoch.
+ */
+void testEarlyStopping() {
+    try {
+        EarlyStopping earlyStopping(3, 0.01);
+        std::vector<double> losses{1.0, 0.8, 0.795, 0.7, 0.71, 0.695, 0.75};
+        std::vector<bool> stops{false, false, false, false, false, false, true};
+        for (size_t epoch = 0; epoch < losses.size(); epoch++) {
+            std::vector<double> weights(4, static_cast<double>(epoch));
+            if (earlyStopping.update(epoch, losses[epoch], weights) != stops[epoch]) {
+                throw std::runtime_error("early stopping " + std::string(stops[epoch] ? "did not stop" : "stopped") + " after epoch " + std::to_string(epoch) + ".");
+            }
+        }
+        if (earlyStopping.getBestEpoch() != 3 || earlyStopping.getBestLoss() != 0.7) {
+            throw std::runtime_error("the best epoch was " + std::to_string(earlyStopping.getBestEpoch()) + " instead of 3.");
+        }
+        if (earlyStopping.getBestWeights() != std::vector<double>(4, 3.0)) {
+            throw std::runtime_error("early stopping did not keep the weights of the best epoch.");
+        }
+
+        Log::info("Passed testEarlyStopping.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testEarlyStopping!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * This tests that a copy of a neural network is independent of the
+ * original but computes exactly the same gradients, that gradients
+ * accumulated over several micro-batches equal the gradient of the
+ * whole batch, and that the data-parallel gradient matches the serial one.
+ */
+void testParallelGradient(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        NeuralNetwork smallNN = createSmallNeuralNetwork(dataSet, lossFunction);
+        std::vector<double> weights(smallNN.getNumberWeights());
+        for (size_t j = 0; j < weights.size(); j++) {
+            weights[j] = (random_double() * 2.0) - 1.0;
+        }
+        smallNN.setWeights(weights);
+
+        std::vector<Instance> instances;
+        for (int repeat = 0; repeat < 50; repeat++) {
+            for (size_t i = 0; i < dataSet.getNumberInstances(); i++) {
+                instances.push_back(dataSet.getInstance(i));
+            }
+        }
+        std::vector<double> serialGradient = smallNN.getGradient(instances);
+
+        NeuralNetwork copy = smallNN;
+        if (copy.getWeights() != weights || copy.getGradient(instances) != serialGradient) {
+            throw std::runtime_error("a copy of the network did not have the same weights and gradient as the original.");
+        }
+        std::vector<double> otherWeights(weights.size(), 0.5);
+        copy.setWeights(otherWeights);
+        if (smallNN.getWeights() != weights || smallNN.getGradient(instances) != serialGradient) {
+            throw std::runtime_error("changing the weights of a copy changed the original network.");
+        }
+
+        // Accumulating micro-batches adds the instances in the same order, so the sum is exactly the same
+        std::vector<double> accumulated(smallNN.getNumberWeights(), 0.0);
+        for (size_t begin = 0; begin < instances.size(); begin += 30) {
+            smallNN.addGradient(instances, begin, std::min(begin + 30, instances.size()), accumulated);
+        }
+        if (accumulated != serialGradient) {
+            throw std::runtime_error("the gradient accumulated over micro-batches was not the gradient of the whole batch.");
+        }
+
+        ThreadPool pool(4);
+        ParallelGradient parallelGradient(smallNN, &pool, 8);
+        for (int repeat = 0; repeat < 3; repeat++) {
+            std::vector<double> parallel(smallNN.getNumberWeights(), 0.0);
+            parallelGradient.addGradient(smallNN, instances, parallel);
+            if (!gradientsCloseEnough(serialGradient, parallel)) {
+                throw std::runtime_error("the data-parallel gradient did not match the serial gradient on repeat " + std::to_string(repeat) + ".");
+            }
+        }
+
+        // The replicas follow the weights of the network
+        for (size_t j = 0; j < weights.size(); j++) {
+            weights[j] = (random_double() * 2.0) - 1.0;
+        }
+        smallNN.setWeights(weights);
+        serialGradient = smallNN.getGradient(instances);
+        std::vector<double> parallel(smallNN.getNumberWeights(), 0.0);
+        parallelGradient.addGradient(smallNN, instances, parallel);
+        if (!gradientsCloseEnough(serialGradient, parallel)) {
+            throw std::runtime_error("the data-parallel gradient did not follow the new weights of the network.");
+        }
+
+        // 64 slices of 33 would leave the last one past the end of a batch of 2049, so only 63 replicas take part
+        std::vector<Instance> wideBatch;
+        while (wideBatch.size() < 2049) {
+            wideBatch.push_back(instances[wideBatch.size() % instances.size()]);
+        }
+        ThreadPool widePool(64);
+        ParallelGradient wideGradient(smallNN, &widePool, 32);
+        serialGradient = smallNN.getGradient(wideBatch);
+        parallel.assign(smallNN.getNumberWeights(), 0.0);
+        wideGradient.addGradient(smallNN, wideBatch, parallel);
+        if (!gradientsCloseEnough(serialGradient, parallel)) {
+            throw std::runtime_error("the data-parallel gradient of a batch that does not split evenly did not match the serial gradient.");
+        }
+
+        Log::info("Passed testParallelGradient.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testParallelGradient!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * This tests that L-BFGS finds the minimum of the Rosenbrock function
+ * in far fewer iterations than gradient descent would need, and that
+ * every iteration on a neural network decreases its loss.
+ */
+void testLBFGS(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        LBFGS::Objective rosenbrock = [](const std::vector<double>& x, std::vector<double>& gradient) {
+            double a = 1.0 - x[0];
+            double b = x[1] - x[0] * x[0];
+            gradient[0] = -2.0 * a - 400.0 * x[0] * b;
+            gradient[1] = 200.0 * b;
+            return a * a + 100.0 * b * b;
+        };
+        LBFGS lbfgs(5);
+        std::vector<double> x{-1.2, 1.0};
+        std::vector<double> gradient(2);
+        double loss = rosenbrock(x, gradient);
+        int iterations = 0;
+        while (iterations < 100 && loss > 1e-12 && lbfgs.step(rosenbrock, x, loss, gradient)) {
+            iterations++;
+        }
+        if (std::fabs(x[0] - 1.0) > 1e-4 || std::fabs(x[1] - 1.0) > 1e-4) {
+            throw std::runtime_error("L-BFGS ended at (" + std::to_string(x[0]) + ", " + std::to_string(x[1]) + ") instead of (1, 1) after " + std::to_string(iterations) + " iterations.");
+        }
+        Log::info("testLBFGS found the minimum of the Rosenbrock function in " + std::to_string(iterations) + " iterations and " + std::to_string(lbfgs.getNumberEvaluations()) + " evaluations.");
+
+        NeuralNetwork smallNN = createSmallNeuralNetwork(dataSet, lossFunction);
+        std::vector<double> weights(smallNN.getNumberWeights());
+        for (size_t j = 0; j < weights.size(); j++) {
+            weights[j] = (random_double() * 2.0) - 1.0;
+        }
+        const std::vector<Instance>& instances = dataSet.getInstances();
+        LBFGS::Objective objective = [&](const std::vector<double>& w, std::vector<double>& g) {
+            smallNN.setWeights(w);
+            g = smallNN.getGradient(instances);
+            return smallNN.forwardPass(instances);
+        };
+        LBFGS networkLBFGS(10);
+        gradient.assign(weights.size(), 0.0);
+        loss = objective(weights, gradient);
+        for (int iteration = 0; iteration < 20; iteration++) {
+            double previousLoss = loss;
+            if (!networkLBFGS.step(objective, weights, loss, gradient)) break;
+            if (!(loss < previousLoss)) {
+                throw std::runtime_error("L-BFGS iteration " + std::to_string(iteration) + " increased the loss from " + std::to_string(previousLoss) + " to " + std::to_string(loss) + ".");
+            }
+            smallNN.setWeights(weights);
+            if (!gradientsCloseEnough(smallNN.getGradient(instances), gradient)) {
+                throw std::runtime_error("the gradient L-BFGS kept after iteration " + std::to_string(iteration) + " was not the gradient at its weights.");
+            }
+        }
+
+        Log::info("Passed testLBFGS.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testLBFGS!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * Saves a sparsely connected and a fully connected network as model
+ * files and checks that the memory mapped models predict exactly the
+ * outputs of the networks, and that loading them back gives the same
+ * weights, output biases and normalizer.
+ */
+void testModelFile(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        NeuralNetwork sparseNN = createSmallNeuralNetwork(dataSet, lossFunction);
+        NeuralNetwork denseNN(dataSet.getNumberInputs(), std::vector<int>{5, 4}, dataSet.getNumberOutputs(), lossFunction);
+        denseNN.connectFully();
+
+        std::vector<double> means(dataSet.getNumberInputs());
+        std::vector<double> standardDeviations(dataSet.getNumberInputs());
+        for (int j = 0; j < dataSet.getNumberInputs(); j++) {
+            means[j] = random_double() - 0.5;
+            standardDeviations[j] = random_double() + 0.5;
+        }
+        Normalizer normalizer(means, standardDeviations);
+
+        std::string filename = "test_model.nnm";
+        for (NeuralNetwork* nn : {&sparseNN, &denseNN}) {
+            // The output biases are not among the weights, the file has to keep them as well
+            nn->initializeRandomly(0.1);
+            std::vector<double> weights(nn->getNumberWeights());
+            for (size_t j = 0; j < weights.size(); j++) {
+                weights[j] = (random_double() * 2.0) - 1.0;
+            }
+            nn->setWeights(weights);
+            ModelFile::save(filename, *nn, &normalizer);
+
+            MappedModel model(filename);
+            if (model.isFullyConnected() != (nn == &denseNN)) {
+                throw std::runtime_error("the model file of the " + std::string(nn == &denseNN ? "fully" : "sparsely") + " connected network was not marked as such.");
+            }
+            for (const Instance& instance : dataSet.getInstances()) {
+                std::vector<double> inputs = instance.getInputs();
+                std::vector<double> outputs = model.predict(inputs);
+                normalizer.apply(inputs);
+                Instance normalized(instance.expectedOutputs, inputs);
+                nn->forwardPass(normalized);
+                if (outputs != nn->getOutputValues()) {
+                    throw std::runtime_error("the mapped model predicted different outputs than the network.");
+                }
+            }
+
+            Normalizer loadedNormalizer;
+            NeuralNetwork loaded = ModelFile::load(filename, &loadedNormalizer);
+            if (loaded.getWeights() != weights || loaded.getOutputBiases() != nn->getOutputBiases()) {
+                throw std::runtime_error("the loaded network did not have the saved weights and output biases.");
+            }
+            for (const Instance& instance : dataSet.getInstances()) {
+                nn->forwardPass(instance);
+                loaded.forwardPass(instance);
+                if (loaded.getOutputValues() != nn->getOutputValues()) {
+                    throw std::runtime_error("the loaded network computed different outputs than the saved one.");
+                }
+            }
+            if (loadedNormalizer.getMeans() != means || loadedNormalizer.getStandardDeviations() != standardDeviations) {
+                throw std::runtime_error("the loaded normalizer did not have the saved means and standard deviations.");
+            }
+        }
+        remove(filename.c_str());
+
+        Log::info("Passed testModelFile.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testModelFile!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * Has several threads predict through an InferenceBatcher at once and
+ * checks every request gets exactly the outputs of the model, and that the
+ * latency histogram's percentiles land in the right buckets.
+ */
+void testInferenceBatcher(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        LatencyHistogram histogram;
+        for (int i = 1; i <= 1000; i++) {
+            histogram.record(i);
+        }
+        if (std::fabs(histogram.getPercentile(50.0) - 500.0) > 25.0 || std::fabs(histogram.getPercentile(99.0) - 990.0) > 45.0 || histogram.getMaximum() != 1000.0) {
+            throw std::runtime_error("the latency histogram gave p50 " + std::to_string(histogram.getPercentile(50.0)) + " and p99 " + std::to_string(histogram.getPercentile(99.0)) + " for the latencies 1 to 1000.");
+        }
+
+        NeuralNetwork nn(dataSet.getNumberInputs(), std::vector<int>{5, 4}, dataSet.getNumberOutputs(), lossFunction);
+        nn.connectFully();
+        nn.initializeRandomly(0.1);
+        std::string filename = "test_batcher.nnm";
+        ModelFile::save(filename, nn);
+        MappedModel model(filename);
+        ModelHandle handle(std::unique_ptr<MappedModel>(new MappedModel(filename)));
+
+        ThreadPool pool(3);
+        InferenceBatcher batcher(handle, &pool, 4, std::chrono::microseconds(500));
+        const std::vector<Instance>& instances = dataSet.getInstances();
+        const int numberClients = 8;
+        const int requestsPerClient = 50;
+        std::vector<int> mismatches(numberClients, 0);
+        std::vector<std::thread> clients;
+        for (int client = 0; client < numberClients; client++) {
+            clients.push_back(std::thread([&, client] {
+                std::vector<double> outputs(model.getNumberOutputs());
+                for (int r = 0; r < requestsPerClient; r++) {
+                    std::vector<double> inputs = instances[(client + r) % instances.size()].getInputs();
+                    batcher.predict(inputs.data(), outputs.data());
+                    if (outputs != model.predict(inputs)) mismatches[client]++;
+                }
+            }));
+        }
+        for (std::thread& client : clients) {
+            client.join();
+        }
+        remove(filename.c_str());
+
+        for (int client = 0; client < numberClients; client++) {
+            if (mismatches[client] > 0) {
+                throw std::runtime_error(std::to_string(mismatches[client]) + " requests of client " + std::to_string(client) + " got outputs other than the model's.");
+            }
+        }
+        if (batcher.getNumberRequests() != numberClients * requestsPerClient || batcher.getLatencies().getCount() != batcher.getNumberRequests()) {
+            throw std::runtime_error("the batcher counted " + std::to_string(batcher.getNumberRequests()) + " requests instead of " + std::to_string(numberClients * requestsPerClient) + ".");
+        }
+        Log::info("testInferenceBatcher ran " + std::to_string(batcher.getNumberRequests()) + " requests in " + std::to_string(batcher.getNumberBatches()) + " batches.");
+
+        Log::info("Passed testInferenceBatcher.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testInferenceBatcher!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * Has reader threads predict through a ModelHandle while the writer keeps
+ * publishing other models, and checks every prediction is exactly the
+ * output of one of the published models, and that a replaced model is
+ * only freed once its last reader is done.
+ */
+void testModelHandle(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        const int numberModels = 3;
+        std::vector<std::string> filenames;
+        std::vector<std::unique_ptr<MappedModel>> models;
+        for (int i = 0; i < numberModels; i++) {
+            NeuralNetwork nn(dataSet.getNumberInputs(), std::vector<int>{4}, dataSet.getNumberOutputs(), lossFunction);
+            nn.connectFully();
+            nn.initializeRandomly(0.1);
+            filenames.push_back("test_handle_" + std::to_string(i) + ".nnm");
+            ModelFile::save(filenames.back(), nn);
+            models.push_back(std::unique_ptr<MappedModel>(new MappedModel(filenames.back())));
+        }
+        std::vector<double> inputs = dataSet.getInstances()[0].getInputs();
+
+        ModelHandle handle(std::unique_ptr<MappedModel>(new MappedModel(filenames[0])));
+        std::atomic<bool> stop(false);
+        std::atomic<int> wrongPredictions(0);
+        std::atomic<long> numberReads(0);
+        std::vector<std::thread> readers;
+        for (int reader = 0; reader < 4; reader++) {
+            readers.push_back(std::thread([&] {
+                while (!stop.load()) {
+                    ModelHandle::Reader model = handle.read();
+                    std::vector<double> outputs = model->predict(inputs);
+                    bool matches = false;
+                    for (int i = 0; i < numberModels; i++) {
+                        if (outputs == models[i]->predict(inputs)) matches = true;
+                    }
+                    if (!matches) wrongPredictions++;
+                    numberReads++;
+                }
+            }));
+        }
+        const int numberPublishes = 200;
+        for (int i = 1; i <= numberPublishes; i++) {
+            handle.publish(std::unique_ptr<MappedModel>(new MappedModel(filenames[i % numberModels])));
+        }
+        stop.store(true);
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+
+        if (wrongPredictions > 0) {
+            throw std::runtime_error(std::to_string(wrongPredictions.load()) + " predictions read through the handle were not those of a published model.");
+        }
+        if (handle.reclaim() != 0 || handle.getVersion() != numberPublishes) {
+            throw std::runtime_error("the handle did not free every replaced model once there were no readers.");
+        }
+
+        //a model replaced while it is being read is only freed after its reader is done
+        {
+            ModelHandle::Reader model = handle.read();
+            handle.publish(std::unique_ptr<MappedModel>(new MappedModel(filenames[0])));
+            if (handle.reclaim() != 1 || model->predict(inputs) != models[numberPublishes % numberModels]->predict(inputs)) {
+                throw std::runtime_error("a replaced model was freed while it was still being read.");
+            }
+        }
+        if (handle.reclaim() != 0) {
+            throw std::runtime_error("a replaced model was not freed after its last reader was done.");
+        }
+        Log::info("testModelHandle made " + std::to_string(numberReads.load()) + " reads during " + std::to_string(numberPublishes) + " publishes.");
+
+        for (const std::string& filename : filenames) {
+            remove(filename.c_str());
+        }
+        Log::info("Passed testModelHandle.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testModelHandle!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+void testSnapshotWriter(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        const std::string filename = "test_snapshot.nnm";
+        NeuralNetwork nn(dataSet.getNumberInputs(), std::vector<int>{4}, dataSet.getNumberOutputs(), lossFunction);
+        nn.connectFully();
+        nn.initializeRandomly(0.1);
+        std::vector<double> inputs = dataSet.getInstances()[0].getInputs();
+
+        //snapshots taken faster than they can be written are
+        //replaced by newer ones, the last one is always saved
+        std::vector<double> weights = nn.getWeights();
+        {
+            SnapshotWriter snapshots(filename, nn);
+            for (int i = 0; i < 100; i++) {
+                for (double& weight : weights) weight += 0.01;
+                snapshots.save(weights);
+            }
+            //the network given to the writer is only used for its topology
+            nn.initializeRandomly(0.1);
+        }
+        nn.setWeights(weights);
+        MappedModel model(filename);
+        if (!vectorsCloseEnough(std::vector<double>(model.getWeights(), model.getWeights() + model.getNumberWeights()), weights)) {
+            throw std::runtime_error("the saved snapshot does not have the weights of the last snapshot taken.");
+        }
+        nn.forwardPass(Instance(std::vector<double>(dataSet.getNumberOutputs(), 0.0), inputs));
+        if (!vectorsCloseEnough(model.predict(inputs), nn.getOutputValues())) {
+            throw std::runtime_error("the saved snapshot does not predict the same as the network.");
+        }
+
+        remove(filename.c_str());
+        Log::info("Passed testSnapshotWriter.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testSnapshotWriter!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+/**
+ * This tests that a training session takes the same steps as
+ * computing the gradient and updating the weights by hand, and
+ * that once it is warmed up its steps make no heap allocations,
+ * serially and with the data-parallel gradient.
+ */
+void testTrainingSession(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        std::vector<Instance> instances;
+        for (int repeat = 0; repeat < 50; repeat++) {
+            for (size_t i = 0; i < dataSet.getNumberInstances(); i++) {
+                instances.push_back(dataSet.getInstance(i));
+            }
+        }
+        OptimizerParameters parameters;
+        parameters.learningRate = 0.01;
+
+        for (const char* name : { "sgd", "adam", "lamb" }) {
+            NeuralNetwork nn = createSmallNeuralNetwork(dataSet, lossFunction);
+            NeuralNetwork expected = nn;
+            std::unique_ptr<Optimizer> optimizer = Optimizer::create(name, nn.getNumberWeights(), parameters);
+            optimizer->setParameterGroups(nn.getLayerWeightRanges());
+            std::unique_ptr<Optimizer> expectedOptimizer = Optimizer::create(name, nn.getNumberWeights(), parameters);
+            expectedOptimizer->setParameterGroups(nn.getLayerWeightRanges());
+
+            //the steps of the session are those taken by hand
+            TrainingSession session(nn, *optimizer);
+            for (size_t begin = 0; begin < instances.size(); begin += 32) {
+                size_t end = std::min(begin + 32, instances.size());
+                session.step(instances, begin, end);
+
+                std::vector<Instance> batch(instances.begin() + begin, instances.begin() + end);
+                std::vector<double> gradient = expected.getGradient(batch);
+                std::vector<double> weights = expected.getWeights();
+                expectedOptimizer->step(weights, gradient);
+                expected.setWeights(weights);
+            }
+            if (nn.getWeights() != expected.getWeights()) {
+                throw std::runtime_error("the weights trained by the session with " + std::string(name) + " were not those trained by hand.");
+            }
+
+            //warmed up, neither the serial nor the data-parallel steps allocate
+            ThreadPool pool(4);
+            ParallelGradient parallelGradient(nn, &pool, 8);
+            TrainingSession parallelSession(nn, *optimizer, &parallelGradient);
+            parallelSession.step(instances, 0, 128);
+            AllocationCounter::setEnabled(true);
+            AllocationCount start = AllocationCounter::get();
+            for (size_t begin = 0; begin < instances.size(); begin += 32) {
+                session.step(instances, begin, std::min(begin + 32, instances.size()));
+            }
+            AllocationCount serial = AllocationCounter::get() - start;
+            start = AllocationCounter::get();
+            for (int step = 0; step < 10; step++) {
+                parallelSession.step(instances, 0, 128);
+            }
+            AllocationCount parallel = AllocationCounter::get() - start;
+            AllocationCounter::setEnabled(false);
+            if (AllocationCounter::isAvailable() && (serial.allocations != 0 || parallel.allocations != 0)) {
+                throw std::runtime_error("the steps with " + std::string(name) + " made " + std::to_string(serial.allocations) + " serial and "
+                    + std::to_string(parallel.allocations) + " data-parallel heap allocations.");
+            }
+        }
+
+        Log::info("Passed testTrainingSession.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testTrainingSession!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
+void testEnsemble(DataSet dataSet, LossFunction lossFunction) {
+    try {
+        std::vector<Instance> instances;
+        for (int repeat = 0; repeat < 20; repeat++) {
+            for (size_t i = 0; i < dataSet.getNumberInstances(); i++) {
+                instances.push_back(dataSet.getInstance(i));
+            }
+        }
+        OptimizerParameters parameters;
+        parameters.learningRate = 0.01;
+        const std::vector<std::string> names = { "sgd", "adam", "lamb" };
+
+        //the kernel of the ensemble needs fully connected networks
+        bool rejected = false;
+        try {
+            std::vector<NeuralNetwork> sparse(1, createSmallNeuralNetwork(dataSet, lossFunction));
+            std::vector<std::unique_ptr<Optimizer>> sparseOptimizers;
+            sparseOptimizers.push_back(Optimizer::create("sgd", sparse[0].getNumberWeights(), parameters));
+            Ensemble sparseEnsemble(sparse, std::move(sparseOptimizers));
+        } catch (const std::runtime_error& e) {
+            rejected = true;
+        }
+        if (!rejected) {
+            throw std::runtime_error("an ensemble of a network that is not fully connected was not rejected.");
+        }
+
+        //every model starts from its own weights and has its own optimizer
+        std::vector<NeuralNetwork> expected;
+        std::vector<std::unique_ptr<Optimizer>> optimizers;
+        std::vector<std::unique_ptr<Optimizer>> expectedOptimizers;
+        for (const std::string& name : names) {
+            NeuralNetwork nn(dataSet.getNumberInputs(), std::vector<int>{3, 3}, dataSet.getNumberOutputs(), lossFunction);
+            nn.connectFully();
+            std::vector<double> weights(nn.getNumberWeights());
+            for (double& weight : weights) weight = random_double() * 2 - 1;
+            nn.setWeights(weights);
+            std::vector<double> biases(nn.getOutputBiases().size());
+            for (double& bias : biases) bias = random_double() - 0.5;
+            nn.setOutputBiases(biases);
+            optimizers.push_back(Optimizer::create(name, nn.getNumberWeights(), parameters));
+            optimizers.back()->setParameterGroups(nn.getLayerWeightRanges());
+            expectedOptimizers.push_back(Optimizer::create(name, nn.getNumberWeights(), parameters));
+            expectedOptimizers.back()->setParameterGroups(nn.getLayerWeightRanges());
+            expected.push_back(std::move(nn));
+        }
+        Ensemble ensemble(expected, std::move(optimizers));
+        int numberModels = ensemble.getNumberModels();
+
+        //each model of the ensemble takes the steps its network takes alone
+        for (size_t begin = 0; begin < instances.size(); begin += 16) {
+            size_t end = std::min(begin + 16, instances.size());
+            ensemble.step(instances, begin, end);
+
+            std::vector<Instance> batch(instances.begin() + begin, instances.begin() + end);
+            for (int m = 0; m < numberModels; m++) {
+                std::vector<double> gradient = expected[m].getGradient(batch);
+                std::vector<double> ensembleGradient(gradient.size());
+                for (size_t i = 0; i < gradient.size(); i++) {
+                    ensembleGradient[i] = ensemble.getGradient()[i * numberModels + m];
+                }
+                if (!gradientsCloseEnough(gradient, ensembleGradient)) {
+                    throw std::runtime_error("the gradient of model " + std::to_string(m) + " of the ensemble was not that of its network.");
+                }
+                std::vector<double> weights = expected[m].getWeights();
+                expectedOptimizers[m]->step(weights, gradient);
+                expected[m].setWeights(weights);
+            }
+        }
+        for (int m = 0; m < numberModels; m++) {
+            std::vector<double> weights;
+            ensemble.getWeights(m, weights);
+            std::vector<double> expectedWeights = expected[m].getWeights();
+            for (size_t i = 0; i < weights.size(); i++) {
+                if (fabs(weights[i] - expectedWeights[i]) > 1e-9) {
+                    throw std::runtime_error("the weights of model " + std::to_string(m) + " trained with " + names[m] + " were not those of its network.");
+                }
+            }
+            NeuralNetwork nn = ensemble.toNeuralNetwork(m);
+            if (nn.getWeights() != weights || nn.getOutputBiases() != expected[m].getOutputBiases()) {
+                throw std::runtime_error("the network of model " + std::to_string(m) + " did not have its weights and output biases.");
+            }
+        }
+
+        //the ensemble predicts with the outputs averaged over the models
+        std::vector<double> losses;
+        std::vector<double> accuracies;
+        double ensembleAccuracy;
+        ensemble.evaluate(instances, losses, accuracies, ensembleAccuracy);
+        size_t ensembleCorrect = 0;
+        for (const Instance& instance : instances) {
+            std::vector<double> average(dataSet.getNumberOutputs(), 0.0);
+            for (NeuralNetwork& nn : expected) {
+                nn.forwardPass(instance);
+                std::vector<double> outputs = nn.getOutputValues();
+                for (size_t i = 0; i < outputs.size(); i++) average[i] += outputs[i] / numberModels;
+            }
+            std::vector<double> outputs = ensemble.predict(instance);
+            for (size_t i = 0; i < outputs.size(); i++) {
+                if (fabs(outputs[i] - average[i]) > 1e-9) {
+                    throw std::runtime_error("the prediction of the ensemble was not the average of its models.");
+                }
+            }
+            int predicted = ensemble.predictClass(instance);
+            if (predicted == static_cast<int>(instance.expectedOutputs[0])) ensembleCorrect++;
+        }
+        if (fabs(ensembleAccuracy - static_cast<double>(ensembleCorrect) / instances.size()) > 1e-12) {
+            throw std::runtime_error("the ensemble accuracy was not that of its predictions.");
+        }
+        for (int m = 0; m < numberModels; m++) {
+            double expectedLoss = 0.0;
+            for (const Instance& instance : instances) expectedLoss += expected[m].forwardPass(instance);
+            if (fabs(losses[m] - expectedLoss) > 1e-6 * std::max(1.0, fabs(expectedLoss))) {
+                throw std::runtime_error("the loss of model " + std::to_string(m) + " was " + std::to_string(losses[m]) + " instead of " + std::to_string(expectedLoss) + ".");
+            }
+            double expectedAccuracy = expected[m].calculateAccuracy(instances);
+            if (fabs(accuracies[m] - expectedAccuracy) > 1e-12) {
+                throw std::runtime_error("the accuracy of model " + std::to_string(m) + " was not that of its network.");
+            }
+        }
+
+        Log::info("Passed testEnsemble.");
+    } catch (const std::exception& e) {
+        Log::fatal("FAILED testEnsemble!");
+        Log::fatal("Threw exception: " + (std::string) e.what());
+    }
+}
+
 double random_double() {
     return rand() / (RAND_MAX + 1.);
 }
@@ -13,4 +13,16 @@ void testNetworkOnInstances(NeuralNetwork& nn, std::vector<Instance>& instances,
 void testTinyGradientsMultiInstance(DataSet dataSet, LossFunction lossFunction);
 void testSmallGradientsMultiInstance(DataSet dataSet, LossFunction lossFunction);
 void testLargeGradientsMultiInstance(DataSet dataSet, LossFunction lossFunction);
+void testOptimizers();
+void testLayerWiseOptimizers(DataSet dataSet, LossFunction lossFunction);
+void testLearningRateSchedules();
+void testEarlyStopping();
+void testParallelGradient(DataSet dataSet, LossFunction lossFunction);
+void testLBFGS(DataSet dataSet, LossFunction lossFunction);
+void testModelFile(DataSet dataSet, LossFunction lossFunction);
+void testInferenceBatcher(DataSet dataSet, LossFunction lossFunction);
+void testModelHandle(DataSet dataSet, LossFunction lossFunction);
+void testSnapshotWriter(DataSet dataSet, LossFunction lossFunction);
+void testTrainingSession(DataSet dataSet, LossFunction lossFunction);
+void testEnsemble(DataSet dataSet, LossFunction lossFunction);
 double random_double();
\ No newline at end of file
@@ -0,0 +1,24 @@
+// Json.h
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdio>
+#include <string>
+
+// Quotes text as a JSON string, escaping quotes, backslashes and control characters
+inline std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+            continue;
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+#endif // JSON_H
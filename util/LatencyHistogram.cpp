@@ -0,0 +1,74 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram() : counts(new std::atomic<uint64_t>[NUMBER_BUCKETS]) {
+    reset();
+}
+
+void LatencyHistogram::record(double microseconds) {
+    int bucket = 0;
+    if (microseconds > 1.0) {
+        bucket = std::min(NUMBER_BUCKETS - 1, static_cast<int>(std::log2(microseconds) * BUCKETS_PER_DOUBLING));
+    }
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t nanoseconds = static_cast<uint64_t>(std::max(0.0, microseconds) * 1000.0);
+    totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t maximum = maximumNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > maximum && !maximumNanoseconds.compare_exchange_weak(maximum, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < NUMBER_BUCKETS; ++i) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    totalNanoseconds.store(0, std::memory_order_relaxed);
+    maximumNanoseconds.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::getMean() const {
+    uint64_t n = getCount();
+    return n == 0 ? 0.0 : totalNanoseconds.load(std::memory_order_relaxed) / 1000.0 / n;
+}
+
+double LatencyHistogram::getMaximum() const {
+    return maximumNanoseconds.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double LatencyHistogram::getPercentile(double percentile) const {
+    // Summing the buckets rather than using count keeps the answer consistent while other threads record
+    uint64_t total = 0;
+    for (int i = 0; i < NUMBER_BUCKETS; ++i) {
+        total += counts[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0) return 0.0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * total));
+    rank = std::max<uint64_t>(1, std::min(total, rank));
+    uint64_t seen = 0;
+    for (int i = 0; i < NUMBER_BUCKETS; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // The geometric middle of the bucket, but never above the largest latency seen
+            double middle = i == 0 ? 1.0 : std::exp2((i + 0.5) / BUCKETS_PER_DOUBLING);
+            return std::min(middle, getMaximum());
+        }
+    }
+    return getMaximum();
+}
+
+std::string LatencyHistogram::getSummary() const {
+    char summary[256];
+    snprintf(summary, sizeof(summary), "n=%llu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus",
+             static_cast<unsigned long long>(getCount()), getMean(), getPercentile(50.0), getPercentile(90.0), getPercentile(99.0), getMaximum());
+    return summary;
+}
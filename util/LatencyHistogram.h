@@ -0,0 +1,46 @@
+// LatencyHistogram.h
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Counts latencies in logarithmic buckets, 16 to every doubling of the
+ * number of microseconds, so a percentile is within about 2% of the true
+ * latency. Recording is a few atomic operations, so any number of threads
+ * can record into the same histogram while another one reads it.
+ */
+class LatencyHistogram {
+private:
+    static const int BUCKETS_PER_DOUBLING = 16;
+    // Up to 2^40 microseconds, about 12 days
+    static const int NUMBER_BUCKETS = 40 * BUCKETS_PER_DOUBLING;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalNanoseconds;
+    std::atomic<uint64_t> maximumNanoseconds;
+
+public:
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(double microseconds);
+    void reset();
+
+    uint64_t getCount() const;
+    double getMean() const;
+    double getMaximum() const;
+    // The latency in microseconds that the given percentage (0 to 100) of the recorded latencies are below
+    double getPercentile(double percentile) const;
+
+    // The count, mean, p50, p90, p99 and maximum on one line
+    std::string getSummary() const;
+};
+
+#endif // LATENCY_HISTOGRAM_H
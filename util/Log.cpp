@@ -1,35 +1,152 @@
 #include "Log.h"
-#include <iostream>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
 
-Log::Level Log::logLevel = Log::INFO;  // Default level
+namespace {
+
+/**
+ * The background thread of an asynchronous log: the messages are appended
+ * to a pending buffer, which the thread swaps out and writes in one go.
+ */
+class AsyncSink {
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable drained;
+    std::string pending;
+    bool writing;
+    bool stopping;
+    std::thread thread;
+
+    void run() {
+        std::string lines;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            available.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            lines.swap(pending);
+            writing = true;
+            lock.unlock();
+            fwrite(lines.data(), 1, lines.size(), stdout);
+            fflush(stdout);
+            lines.clear();
+            lock.lock();
+            writing = false;
+            drained.notify_all();
+        }
+    }
+
+public:
+    AsyncSink() : writing(false), stopping(false) {
+        thread = std::thread(&AsyncSink::run, this);
+    }
+
+    // Writes out the pending messages before stopping
+    ~AsyncSink() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_one();
+        thread.join();
+    }
+
+    void push(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += line;
+        available.notify_one();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return pending.empty() && !writing; });
+    }
+};
+
+// Serializes the lines of the threads logging, and guards the sink
+std::mutex outputMutex;
+AsyncSink* sink = nullptr;
+
+// Stops the background thread at exit, after writing out what is still queued
+struct SinkShutdown {
+    ~SinkShutdown() {
+        Log::setAsynchronous(false);
+    }
+} sinkShutdown;
+
+} // namespace
+
+std::atomic<Log::Level> Log::logLevel(Log::INFO);  // Default level
 
 void Log::setLevel(Log::Level newLevel) {
-    logLevel = newLevel;
-    printf("Log level set to %s\n", levelToString(newLevel).c_str());
+    logLevel.store(newLevel, std::memory_order_relaxed);
+    write("", "Log level set to " + levelToString(newLevel));
+}
+
+void Log::setAsynchronous(bool asynchronous) {
+    AsyncSink* stopped = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (asynchronous && sink == nullptr) {
+            // Anything printed directly so far comes out before the background thread's output
+            fflush(stdout);
+            sink = new AsyncSink();
+        }
+        else if (!asynchronous) {
+            stopped = sink;
+            sink = nullptr;
+        }
+    }
+    delete stopped;
+}
+
+void Log::flush() {
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (sink != nullptr) sink->flush();
+    }
+    fflush(stdout);
+}
+
+void Log::write(const char* prefix, const std::string& message) {
+    std::string line = prefix + message + "\n";
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (sink != nullptr) {
+        sink->push(line);
+    }
+    else {
+        fwrite(line.data(), 1, line.size(), stdout);
+    }
 }
 
 void Log::fatal(const std::string& message) {
-    if (Log::FATAL <= logLevel) { printf("[FATAL  ] %s\n", message.c_str()); }
+    if (isEnabled(Log::FATAL)) {
+        write("[FATAL  ] ", message);
+        // Usually the program exits next
+        flush();
+    }
 }
 
 void Log::error(const std::string& message) {
-    if (Log::ERROR <= logLevel) { printf("[ERROR  ] %s\n", message.c_str()); }
+    if (isEnabled(Log::ERROR)) write("[ERROR  ] ", message);
 }
 
 void Log::warning(const std::string& message) {
-    if (Log::WARNING <= logLevel) { printf("[WARNING] %s\n", message.c_str()); }
+    if (isEnabled(Log::WARNING)) write("[WARNING] ", message);
 }
 
 void Log::info(std::string message) {
-    if (Log::INFO <= logLevel) { printf("[INFO   ] %s\n", message.c_str()); } 
+    if (isEnabled(Log::INFO)) write("[INFO   ] ", message);
 }
 
 void Log::debug(const std::string& message) {
-    if (Log::DEBUG <= logLevel) { printf("[DEBUG  ] %s\n", message.c_str()); }
+    if (isEnabled(Log::DEBUG)) write("[DEBUG  ] ", message);
 }
 
 void Log::trace(const std::string& message) {
-    if (Log::TRACE <= logLevel) { printf("[TRACE  ] %s\n", message.c_str()); }
+    if (isEnabled(Log::TRACE)) write("[TRACE  ] ", message);
 }
 
 std::string Log::levelToString(Log::Level level) {
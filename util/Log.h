@@ -1,8 +1,15 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <atomic>
 #include <string>
 
+// The most verbose level the LOG_ macros are compiled in for: the messages above it are removed by
+// the compiler, e.g. building with -DLOG_COMPILED_LEVEL=4 keeps everything up to INFO and no DEBUG or TRACE
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 6
+#endif
+
 class Log {
 public:
     enum Level {
@@ -10,6 +17,16 @@ public:
     };
 
     static void setLevel(Level newLevel);
+    static bool isEnabled(Level level) {
+        return level <= logLevel.load(std::memory_order_relaxed);
+    }
+
+    // Hands the messages to a background thread that writes them out, so the threads logging never wait
+    // for the output; turning it off writes out the messages still queued first
+    static void setAsynchronous(bool asynchronous);
+    // Waits until every message logged so far is written
+    static void flush();
+
     static void fatal(const std::string& message);
     static void error(const std::string& message);
     static void warning(const std::string& message);
@@ -18,8 +35,20 @@ public:
     static void trace(const std::string& message);
 
 private:
-    static Level logLevel;
+    static std::atomic<Level> logLevel;
     static std::string levelToString(Level level);
+    static void write(const char* prefix, const std::string& message);
 };
 
+// Logs a message only if its level is enabled, without building the message otherwise
+#define LOG_AT(level, method, message) \
+    do { if ((level) <= LOG_COMPILED_LEVEL && Log::isEnabled(level)) Log::method(message); } while (0)
+
+#define LOG_FATAL(message) LOG_AT(Log::FATAL, fatal, message)
+#define LOG_ERROR(message) LOG_AT(Log::ERROR, error, message)
+#define LOG_WARNING(message) LOG_AT(Log::WARNING, warning, message)
+#define LOG_INFO(message) LOG_AT(Log::INFO, info, message)
+#define LOG_DEBUG(message) LOG_AT(Log::DEBUG, debug, message)
+#define LOG_TRACE(message) LOG_AT(Log::TRACE, trace, message)
+
 #endif // LOG_H
@@ -45,7 +45,7 @@ NeuralNetwork createTinyNeuralNetwork(DataSet dataSet, LossFunction lossFunction
             throw std::runtime_error("Failed getNumberWeights on tinyNN, returned " + std::to_string(numberWeights) + " which should have been " + std::to_string(expectedWeights) + ".");
         }
         checkGetSetWeights(tinyNN, "tinyNN");
-        Log::debug("successfully created tinyNN");
+        LOG_DEBUG("successfully created tinyNN");
         return tinyNN;
     } catch (std::runtime_error e) {
         Log::fatal("Failed creating tinyNN");
@@ -83,7 +83,7 @@ NeuralNetwork createSmallNeuralNetwork(DataSet dataSet, LossFunction lossFunctio
             //same order as the weights we set
             checkGetSetWeights(smallNN, "smallNN");
 
-            Log::debug("successfully created smallNN");
+            LOG_DEBUG("successfully created smallNN");
             return smallNN;
         } else if (dataSet.getName() == "mushroom data") {
             NeuralNetwork smallNN = NeuralNetwork(dataSet.getNumberInputs(), std::vector<int>{3, 3}, dataSet.getNumberClasses(), lossFunction);
@@ -102,7 +102,7 @@ NeuralNetwork createSmallNeuralNetwork(DataSet dataSet, LossFunction lossFunctio
             //same order as the weights we set
             checkGetSetWeights(smallNN, "smallNN");
 
-            Log::debug("successfully created smallNN");
+            LOG_DEBUG("successfully created smallNN");
             return smallNN;
         } else {
             NeuralNetwork smallNN = NeuralNetwork(dataSet.getNumberInputs(), std::vector<int>{3, 3}, dataSet.getNumberOutputs(), lossFunction);
@@ -139,7 +139,7 @@ NeuralNetwork createSmallNeuralNetwork(DataSet dataSet, LossFunction lossFunctio
             //same order as the weights we set
             checkGetSetWeights(smallNN, "smallNN");
 
-            Log::debug("successfully created smallNN");
+            LOG_DEBUG("successfully created smallNN");
             return smallNN;
         }
     } catch (std::runtime_error e) {
@@ -177,7 +177,7 @@ NeuralNetwork createLargeNeuralNetwork(DataSet dataSet, LossFunction lossFunctio
             //same order as the weights we set
             checkGetSetWeights(largeNN, "largeNN");
 
-            Log::debug("successfully created largeNN");
+            LOG_DEBUG("successfully created largeNN");
             return largeNN;
         } else if (dataSet.getName()  == "mushroom data") {
             NeuralNetwork largeNN = NeuralNetwork(dataSet.getNumberInputs(), std::vector<int>{3, 5, 4}, dataSet.getNumberClasses(), lossFunction);
@@ -196,7 +196,7 @@ NeuralNetwork createLargeNeuralNetwork(DataSet dataSet, LossFunction lossFunctio
             //same order as the weights we set
             checkGetSetWeights(largeNN, "largeNN");
 
-            Log::debug("successfully created largeNN");
+            LOG_DEBUG("successfully created largeNN");
             return largeNN;
         } else {
             NeuralNetwork largeNN = NeuralNetwork(dataSet.getNumberInputs(), std::vector<int>{3, 5, 4}, dataSet.getNumberOutputs(), lossFunction);
@@ -258,7 +258,7 @@ NeuralNetwork createLargeNeuralNetwork(DataSet dataSet, LossFunction lossFunctio
             //same order as the weights we set
             checkGetSetWeights(largeNN, "largeNN");
 
-            Log::debug("successfully created largeNN");
+            LOG_DEBUG("successfully created largeNN");
             return largeNN;
         }
     } catch (std::runtime_error e) {
@@ -440,7 +440,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw std::runtime_error("Failed forward pass test on tinyNN and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         tinyNN.reset();
@@ -452,7 +452,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on tinyNN and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         tinyNN.reset();
@@ -464,7 +464,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on tinyNN and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         tinyNN.reset();
@@ -476,7 +476,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on tinyNN and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         Log::info("Passed testXORNeuralNetworkForwardPass 1");
@@ -513,7 +513,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork1.reset();
@@ -525,7 +525,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork1.reset();
@@ -537,7 +537,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork1.reset();
@@ -549,7 +549,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
 
@@ -591,7 +591,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork2.reset();
@@ -603,7 +603,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance10, output was: " + std::to_string(outputValues[0] )+ " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance10, output was: " + std::to_string(outputValues[0] )+ " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork2.reset();
@@ -615,7 +615,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork2.reset();
@@ -627,7 +627,7 @@ void textXORNeuralNetworkForwardPass(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         Log::info("Passed testXORNeuralNetworkForwardPass 2");
@@ -689,7 +689,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork1.reset();
@@ -701,7 +701,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork1.reset();
@@ -713,7 +713,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork1.reset();
@@ -725,7 +725,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 1 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         Log::info("Passed testXORNeuralNetworForwardPassBonus 1");
@@ -790,7 +790,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance00, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork2.reset();
@@ -802,7 +802,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance10, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork2.reset();
@@ -814,7 +814,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance01, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         xorNeuralNetwork2.reset();
@@ -826,7 +826,7 @@ void textXORNeuralNetworkForwardPassBonus(DataSet xorData) {
         if (! closeEnough(outputValues[0], expectedOutput)) {
             throw   std::runtime_error("Failed forward pass test on xorNeuralNetwork2 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         } else {
-            Log::debug("Passed forward pass on xorNeuralNetwork 2 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
+            LOG_DEBUG("Passed forward pass on xorNeuralNetwork 2 and instance11, output was: " + std::to_string(outputValues[0]) + " and expected was " + std::to_string(expectedOutput));
         }
 
         Log::info("Passed testXORNeuralNetworkForwardPassBonus 2");
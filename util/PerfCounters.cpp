@@ -0,0 +1,132 @@
+// PerfCounters.cpp
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+int openCounter(PerfCounters::Counter counter, int groupLeader) {
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    switch (counter) {
+        case PerfCounters::CYCLES:
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfCounters::INSTRUCTIONS:
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfCounters::L1_MISSES:
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfCounters::LLC_MISSES:
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PerfCounters::BRANCH_MISSES:
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            return -1;
+    }
+    // Only the user space work of this thread, which is what the measured code does
+    attributes.disabled = groupLeader == -1 ? 1 : 0;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, groupLeader, 0));
+}
+#endif
+
+} // namespace
+
+PerfCounters::PerfCounters() : leader(-1), numberOpen(0), owner(std::this_thread::get_id()) {
+    for (int i = 0; i < NUMBER_COUNTERS; i++) {
+        descriptors[i] = -1;
+        positions[i] = -1;
+    }
+#ifdef __linux__
+    for (int i = 0; i < NUMBER_COUNTERS; i++) {
+        Counter counter = static_cast<Counter>(i);
+        descriptors[i] = openCounter(counter, leader);
+        if (descriptors[i] == -1) {
+            if (!unavailableReason.empty()) unavailableReason += "; ";
+            unavailableReason += getName(counter) + ": " + std::strerror(errno);
+            continue;
+        }
+        if (leader == -1) leader = descriptors[i];
+        positions[i] = numberOpen++;
+    }
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    unavailableReason = "hardware counters are only read on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < NUMBER_COUNTERS; i++) {
+        if (descriptors[i] != -1) close(descriptors[i]);
+    }
+#endif
+}
+
+bool PerfCounters::isAvailable() const {
+    return numberOpen > 0;
+}
+
+bool PerfCounters::isAvailable(Counter counter) const {
+    return descriptors[counter] != -1;
+}
+
+const std::string& PerfCounters::getUnavailableReason() const {
+    return unavailableReason;
+}
+
+bool PerfCounters::countsThisThread() const {
+    return std::this_thread::get_id() == owner;
+}
+
+std::vector<double> PerfCounters::read() const {
+    std::vector<double> counts(NUMBER_COUNTERS, std::nan(""));
+#ifdef __linux__
+    if (leader == -1) return counts;
+    // The number of counters, the times enabled and running, then the value of each counter
+    uint64_t values[3 + NUMBER_COUNTERS];
+    ssize_t size = ::read(leader, values, sizeof(values));
+    if (size < static_cast<ssize_t>((3 + numberOpen) * sizeof(uint64_t)) || values[2] == 0) return counts;
+    double scale = static_cast<double>(values[1]) / values[2];
+    for (int i = 0; i < NUMBER_COUNTERS; i++) {
+        if (positions[i] != -1) counts[i] = values[3 + positions[i]] * scale;
+    }
+#endif
+    return counts;
+}
+
+std::string PerfCounters::getName(Counter counter) {
+    switch (counter) {
+        case CYCLES: return "cycles";
+        case INSTRUCTIONS: return "instructions";
+        case L1_MISSES: return "l1_misses";
+        case LLC_MISSES: return "llc_misses";
+        case BRANCH_MISSES: return "branch_misses";
+        default: return "unknown";
+    }
+}
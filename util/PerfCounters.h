@@ -0,0 +1,55 @@
+// PerfCounters.h
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * The hardware performance counters of the calling thread, read through
+ * Linux perf_event_open: cycles, instructions, L1 data cache misses, last
+ * level cache misses and branch misses. They are opened as one group so
+ * a single read gets all of them at the same moment. Counters the CPU,
+ * kernel or permissions (perf_event_paranoid) do not allow are left out,
+ * and read as NaN; on other systems none are available. The counts are
+ * scaled up if the kernel had to multiplex the counters.
+ */
+class PerfCounters {
+public:
+    enum Counter {
+        CYCLES, INSTRUCTIONS, L1_MISSES, LLC_MISSES, BRANCH_MISSES, NUMBER_COUNTERS
+    };
+
+private:
+    // -1 for a counter that could not be opened, the first open one leads the group
+    int descriptors[NUMBER_COUNTERS];
+    int leader;
+    // The position of each open counter in a read of the group
+    int positions[NUMBER_COUNTERS];
+    int numberOpen;
+    std::string unavailableReason;
+    // The thread the counters count, the one that opened them
+    std::thread::id owner;
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool isAvailable() const;
+    bool isAvailable(Counter counter) const;
+    // Why no or only some of the counters could be opened
+    const std::string& getUnavailableReason() const;
+    // Whether the calling thread is the one counted
+    bool countsThisThread() const;
+
+    // The counts since the counters were opened, NaN for the unavailable ones
+    std::vector<double> read() const;
+
+    static std::string getName(Counter counter);
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,78 @@
+// PhaseTimer.cpp
+#include "PhaseTimer.h"
+#include "PerfCounters.h"
+
+std::atomic<bool> PhaseTimer::enabled(false);
+std::atomic<uint64_t> PhaseTimer::nanoseconds[static_cast<int>(Phase::NUMBER_PHASES)];
+std::atomic<uint64_t> PhaseTimer::counts[static_cast<int>(Phase::NUMBER_PHASES)];
+const PerfCounters* PhaseTimer::counters = nullptr;
+std::vector<double> PhaseTimer::counterTotals[static_cast<int>(Phase::NUMBER_PHASES)];
+
+void PhaseTimer::setEnabled(bool enabled) {
+    PhaseTimer::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void PhaseTimer::add(Phase phase, uint64_t elapsed, uint64_t count) {
+    nanoseconds[static_cast<int>(phase)].fetch_add(elapsed, std::memory_order_relaxed);
+    counts[static_cast<int>(phase)].fetch_add(count, std::memory_order_relaxed);
+}
+
+void PhaseTimer::reset() {
+    for (int i = 0; i < static_cast<int>(Phase::NUMBER_PHASES); i++) {
+        nanoseconds[i].store(0, std::memory_order_relaxed);
+        counts[i].store(0, std::memory_order_relaxed);
+        counterTotals[i].clear();
+    }
+}
+
+double PhaseTimer::getSeconds(Phase phase) {
+    return nanoseconds[static_cast<int>(phase)].load(std::memory_order_relaxed) / 1e9;
+}
+
+uint64_t PhaseTimer::getCount(Phase phase) {
+    return counts[static_cast<int>(phase)].load(std::memory_order_relaxed);
+}
+
+void PhaseTimer::setCounters(const PerfCounters* counters) {
+    PhaseTimer::counters = counters;
+}
+
+bool PhaseTimer::isCounting() {
+    return counters != nullptr && counters->countsThisThread();
+}
+
+std::vector<double> PhaseTimer::readCounters() {
+    return counters->read();
+}
+
+void PhaseTimer::addCounters(Phase phase, const std::vector<double>& start) {
+    std::vector<double> end = counters->read();
+    std::vector<double>& totals = counterTotals[static_cast<int>(phase)];
+    totals.resize(end.size(), 0.0);
+    for (size_t i = 0; i < end.size(); i++) {
+        totals[i] += end[i] - start[i];
+    }
+}
+
+std::vector<double> PhaseTimer::getCounters(Phase phase) {
+    return counterTotals[static_cast<int>(phase)];
+}
+
+std::string PhaseTimer::getName(Phase phase) {
+    return getLabel(phase);
+}
+
+const char* PhaseTimer::getLabel(Phase phase) {
+    switch (phase) {
+        case Phase::LOADING: return "loading";
+        case Phase::NORMALIZATION: return "normalization";
+        case Phase::SHUFFLING: return "shuffling";
+        case Phase::BATCHING: return "batching";
+        case Phase::GRADIENT: return "gradient";
+        case Phase::FORWARD: return "forward";
+        case Phase::BACKWARD: return "backward";
+        case Phase::UPDATE: return "update";
+        case Phase::EVALUATION: return "evaluation";
+        default: return "unknown";
+    }
+}
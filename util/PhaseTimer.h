@@ -0,0 +1,113 @@
+// PhaseTimer.h
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TraceRecorder.h"
+
+class PerfCounters;
+
+// The phases of training that are timed
+enum class Phase {
+    // Reading the data set, which includes normalizing it
+    LOADING,
+    NORMALIZATION,
+    SHUFFLING,
+    BATCHING,
+    // Computing the gradient of a batch, which includes the forward and backward passes
+    GRADIENT,
+    FORWARD,
+    BACKWARD,
+    UPDATE,
+    EVALUATION,
+    NUMBER_PHASES
+};
+
+/**
+ * Adds up the time spent in each phase of training, for a breakdown of
+ * where an epoch goes. The phases are timed by ScopedPhase objects, which
+ * only read the clock while timing is enabled, so the instrumentation
+ * costs one predictable branch when it is off. Any thread can add to a
+ * phase; the forward and backward passes of the data-parallel gradient add
+ * up the time of every thread, so they can be more than the time the
+ * gradient took. With hardware counters set, the phases timed on the
+ * thread the counters count also add up their counter deltas; the work of
+ * other threads, e.g. the workers of the data-parallel gradient, is not in
+ * them.
+ */
+class PhaseTimer {
+private:
+    // Read by every thread that times a phase
+    static std::atomic<bool> enabled;
+    static std::atomic<uint64_t> nanoseconds[static_cast<int>(Phase::NUMBER_PHASES)];
+    static std::atomic<uint64_t> counts[static_cast<int>(Phase::NUMBER_PHASES)];
+    static const PerfCounters* counters;
+    // Only added to by the thread the counters count
+    static std::vector<double> counterTotals[static_cast<int>(Phase::NUMBER_PHASES)];
+
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // Adds the time of count timed sections, e.g. the forward passes of a range of instances
+    static void add(Phase phase, uint64_t nanoseconds, uint64_t count = 1);
+    // Sets every phase back to 0, e.g. at the start of an epoch
+    static void reset();
+
+    static double getSeconds(Phase phase);
+    static uint64_t getCount(Phase phase);
+
+    // Also adds up the hardware counter deltas of the phases, nullptr to stop
+    static void setCounters(const PerfCounters* counters);
+    // Whether the calling thread reads counters for its phases
+    static bool isCounting();
+    // The counts now, for addCounters() at the end of the phase
+    static std::vector<double> readCounters();
+    static void addCounters(Phase phase, const std::vector<double>& start);
+    // The counter deltas of a phase in the order of PerfCounters::Counter, empty without counters
+    static std::vector<double> getCounters(Phase phase);
+    static std::string getName(Phase phase);
+    // The name as a string literal, for the trace recorder
+    static const char* getLabel(Phase phase);
+};
+
+// Adds the time from its construction to its destruction to a phase, if timing is enabled,
+// and records it as an event of the timeline, if the trace recorder is started
+class ScopedPhase {
+private:
+    Phase phase;
+    bool timing;
+    bool tracing;
+    std::chrono::steady_clock::time_point start;
+    int64_t begin;
+    // Empty unless the hardware counters are read for this phase
+    std::vector<double> startCounts;
+
+public:
+    explicit ScopedPhase(Phase phase) : phase(phase), timing(PhaseTimer::isEnabled()), tracing(TraceRecorder::isEnabled()) {
+        if (timing) {
+            if (PhaseTimer::isCounting()) startCounts = PhaseTimer::readCounters();
+            start = std::chrono::steady_clock::now();
+        }
+        if (tracing) begin = TraceRecorder::now();
+    }
+
+    ~ScopedPhase() {
+        if (timing) {
+            PhaseTimer::add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            if (!startCounts.empty()) PhaseTimer::addCounters(phase, startCounts);
+        }
+        if (tracing) TraceRecorder::record(PhaseTimer::getLabel(phase), "phase", begin, TraceRecorder::now());
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+
+#endif // PHASE_TIMER_H
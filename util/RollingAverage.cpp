@@ -0,0 +1,25 @@
+#include "RollingAverage.h"
+#include <algorithm>
+
+RollingAverage::RollingAverage(size_t window) : values(std::max<size_t>(1, window), 0.0), next(0), count(0), sum(0.0) {
+}
+
+void RollingAverage::add(double value) {
+    sum += value - values[next];
+    values[next] = value;
+    next++;
+    if (next == values.size()) {
+        next = 0;
+        sum = 0.0;
+        for (double v : values) sum += v;
+    }
+    if (count < values.size()) count++;
+}
+
+double RollingAverage::getAverage() const {
+    return count == 0 ? 0.0 : sum / count;
+}
+
+size_t RollingAverage::getCount() const {
+    return count;
+}
@@ -0,0 +1,31 @@
+// RollingAverage.h
+#ifndef ROLLING_AVERAGE_H
+#define ROLLING_AVERAGE_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * The average of the last window values added, such as the loss of the
+ * most recent instances of an online training stream. Adding a value is
+ * constant time; the sum is recomputed each time the window wraps around
+ * so rounding errors cannot build up over a long stream.
+ */
+class RollingAverage {
+private:
+    std::vector<double> values;
+    size_t next;
+    size_t count;
+    double sum;
+
+public:
+    explicit RollingAverage(size_t window);
+
+    void add(double value);
+    // The average of the values in the window, 0 before any were added
+    double getAverage() const;
+    // The number of values in the window
+    size_t getCount() const;
+};
+
+#endif // ROLLING_AVERAGE_H
@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int numberThreads)
+    : numberThreads(numberThreads > 0 ? numberThreads : getDefaultNumberThreads()), task(nullptr), generation(0), remaining(0), stopping(false) {
+    for (int thread = 1; thread < this->numberThreads; ++thread) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::getNumberThreads() const {
+    return numberThreads;
+}
+
+int ThreadPool::getDefaultNumberThreads() {
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? static_cast<int>(hardwareThreads) : 1;
+}
+
+void ThreadPool::runTask(int thread) {
+    // The gaps between the tasks of a worker in the timeline are the time it sat idle
+    ScopedTrace trace("task", "pool");
+    try {
+        (*task)(thread);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failure) failure = std::current_exception();
+    }
+}
+
+void ThreadPool::workerLoop(int thread) {
+    if (TraceRecorder::isEnabled()) TraceRecorder::setThreadName("pool worker " + std::to_string(thread));
+    unsigned long lastGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [&] { return stopping || generation != lastGeneration; });
+            if (stopping) return;
+            lastGeneration = generation;
+        }
+
+        runTask(thread);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) workFinished.notify_one();
+    }
+}
+
+void ThreadPool::run(const std::function<void(int)>& newTask) {
+    if (numberThreads == 1) {
+        newTask(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &newTask;
+        remaining = numberThreads - 1;
+        failure = nullptr;
+        generation++;
+    }
+    workAvailable.notify_all();
+
+    runTask(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    workFinished.wait(lock, [&] { return remaining == 0; });
+    task = nullptr;
+    if (failure) {
+        std::exception_ptr thrown = failure;
+        failure = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t, int)>& body) {
+    // The task only captures one reference, so std::function keeps it without allocating
+    struct Split {
+        size_t count;
+        size_t perThread;
+        const std::function<void(size_t, size_t, int)>& body;
+    } split = { count, (count + numberThreads - 1) / numberThreads, body };
+    run([&split](int thread) {
+        size_t begin = std::min(split.count, thread * split.perThread);
+        size_t end = std::min(split.count, begin + split.perThread);
+        if (begin < end) split.body(begin, end, thread);
+    });
+}
@@ -0,0 +1,56 @@
+// ThreadPool.h
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that all run the same task together, which
+ * is how the data set statistics, data-parallel gradients and bulk scoring
+ * split their work. The calling thread takes part as thread 0, so a pool
+ * of one thread runs everything inline.
+ */
+class ThreadPool {
+private:
+    int numberThreads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workFinished;
+    const std::function<void(int)>* task;
+    unsigned long generation;
+    int remaining;
+    bool stopping;
+    std::exception_ptr failure;
+
+    void workerLoop(int thread);
+    void runTask(int thread);
+
+public:
+    // numberThreads <= 0 uses one thread per hardware thread
+    explicit ThreadPool(int numberThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getNumberThreads() const;
+
+    // Runs task(thread) on every thread and waits for all of them to finish,
+    // rethrowing the first exception thrown by any of them. Running a task does not
+    // allocate, but a lambda capturing more than two pointers makes its std::function allocate
+    void run(const std::function<void(int)>& task);
+
+    // Splits [0, count) into one contiguous range per thread and runs body(begin, end, thread) on each
+    void parallelFor(size_t count, const std::function<void(size_t, size_t, int)>& body);
+
+    static int getDefaultNumberThreads();
+};
+
+#endif // THREAD_POOL_H
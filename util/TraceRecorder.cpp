@@ -0,0 +1,123 @@
+// TraceRecorder.cpp
+#include "TraceRecorder.h"
+#include "Json.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    int64_t begin;
+    int64_t end;
+    const char* argumentName;
+    int64_t argument;
+};
+
+struct ThreadBuffer {
+    int id;
+    std::string name;
+    std::vector<TraceEvent> events;
+    size_t dropped;
+};
+
+std::chrono::steady_clock::time_point origin;
+size_t maxEventsPerThread = 0;
+// The buffers outlive their threads, so the events of finished threads are still written
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& getThreadBuffer() {
+    if (threadBuffer == nullptr) {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->dropped = 0;
+        buffer->events.reserve(std::min<size_t>(maxEventsPerThread, 4096));
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffer->id = static_cast<int>(buffers.size()) + 1;
+        buffer->name = "thread " + std::to_string(buffer->id);
+        threadBuffer = buffer.get();
+        buffers.push_back(std::move(buffer));
+    }
+    return *threadBuffer;
+}
+
+} // namespace
+
+std::atomic<bool> TraceRecorder::enabled(false);
+
+void TraceRecorder::start(size_t maxEvents) {
+    origin = std::chrono::steady_clock::now();
+    maxEventsPerThread = maxEvents;
+    enabled.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::stop() {
+    enabled.store(false, std::memory_order_relaxed);
+}
+
+int64_t TraceRecorder::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void TraceRecorder::record(const char* name, const char* category, int64_t begin, int64_t end, const char* argumentName, int64_t argument) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    if (buffer.events.size() >= maxEventsPerThread) {
+        buffer.dropped++;
+        return;
+    }
+    buffer.events.push_back(TraceEvent{ name, category, begin, end, argumentName, argument });
+}
+
+void TraceRecorder::setThreadName(const std::string& name) {
+    getThreadBuffer().name = name;
+}
+
+size_t TraceRecorder::write(const std::string& filename) {
+    std::ofstream out(filename, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("could not open the trace file '" + filename + "'");
+    }
+
+    // Timestamps and durations are in microseconds, with the nanoseconds as decimals
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    size_t numberEvents = 0;
+    char number[64];
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"neural network\"}}";
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id << ", \"args\": {\"name\": " << jsonString(buffer->name) << "}}";
+        out << ",\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id << ", \"args\": {\"sort_index\": " << buffer->id << "}}";
+        for (const TraceEvent& event : buffer->events) {
+            out << ",\n{\"name\": " << jsonString(event.name) << ", \"cat\": " << jsonString(event.category) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id;
+            snprintf(number, sizeof(number), ", \"ts\": %.3f, \"dur\": %.3f", event.begin / 1e3, (event.end - event.begin) / 1e3);
+            out << number;
+            if (event.argumentName != nullptr) {
+                out << ", \"args\": {" << jsonString(event.argumentName) << ": " << event.argument << "}";
+            }
+            out << "}";
+            numberEvents++;
+        }
+    }
+    out << "\n]}\n";
+    out.close();
+    if (!out) {
+        throw std::runtime_error("failed writing the trace file '" + filename + "'");
+    }
+    return numberEvents;
+}
+
+size_t TraceRecorder::getNumberDropped() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    size_t dropped = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        dropped += buffer->dropped;
+    }
+    return dropped;
+}
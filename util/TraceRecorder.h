@@ -0,0 +1,73 @@
+// TraceRecorder.h
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Records a timeline of what every thread was doing, as complete events
+ * with a begin and an end, and writes it in the Chrome trace event format
+ * that chrome://tracing and Perfetto (ui.perfetto.dev) display. Each thread
+ * appends to a buffer of its own, so recording takes no locks once a thread
+ * has its buffer; only the first event of a thread registers the buffer.
+ * The buffers keep the first events up to a limit per thread and count the
+ * rest as dropped. Event names must be string literals, they are kept as
+ * pointers. While it is not started nothing is recorded and every
+ * instrumented place costs one predictable branch.
+ */
+class TraceRecorder {
+private:
+    // Set after the origin and the limit, which the threads that see it started read
+    static std::atomic<bool> enabled;
+
+public:
+    // Starts recording, keeping up to maxEventsPerThread events of each thread
+    static void start(size_t maxEventsPerThread = 1 << 20);
+    // Stops recording, the events recorded so far are kept for write()
+    static void stop();
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_acquire);
+    }
+
+    // Nanoseconds since the recording started
+    static int64_t now();
+
+    // Records an event of the calling thread from begin to end, as returned by now(). The
+    // argument, e.g. the layer of a pass, is shown with the event if it has a name
+    static void record(const char* name, const char* category, int64_t begin, int64_t end, const char* argumentName = nullptr, int64_t argument = 0);
+
+    // Names the calling thread in the timeline, otherwise it is "thread <n>"
+    static void setThreadName(const std::string& name);
+
+    // Writes the events of every thread to a JSON file and returns the number written. It must
+    // only be called while no other thread is recording, e.g. once the work is done
+    static size_t write(const std::string& filename);
+    static size_t getNumberDropped();
+};
+
+// Records an event from its construction to its destruction, if the recorder is started
+class ScopedTrace {
+private:
+    const char* name;
+    const char* category;
+    bool tracing;
+    int64_t begin;
+
+public:
+    ScopedTrace(const char* name, const char* category) : name(name), category(category), tracing(TraceRecorder::isEnabled()) {
+        if (tracing) begin = TraceRecorder::now();
+    }
+
+    ~ScopedTrace() {
+        if (tracing) TraceRecorder::record(name, category, begin, TraceRecorder::now());
+    }
+
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+};
+
+#endif // TRACE_RECORDER_H